@@ -0,0 +1,75 @@
+#include "AhtDriver.h"
+
+#define AHT_STATUS_BUSY 0x80
+#define AHT_STATUS_CALIBRATED 0x08
+#define AHT10_INIT 0xE1
+#define AHT20_INIT 0xBE
+#define AHT_TRIGGER 0xAC
+
+#define AHT_INIT_MS 10
+#define AHT_BUSY_RETRIES 3   // Extra 10 ms polls when the conversion runs late
+
+AhtDriver::AhtDriver(I2cBus& bus, AhtModel model) : bus(bus), model(model) {
+}
+
+const char* AhtDriver::name() const {
+    return model == AHT_MODEL_AHT20 ? "AHT20" : "AHT10";
+}
+
+uint8_t AhtDriver::channels() const {
+    return SENSOR_TEMPERATURE | SENSOR_HUMIDITY;
+}
+
+uint16_t AhtDriver::powerUpMs() const {
+    return 40;
+}
+
+bool AhtDriver::start() {
+    uint8_t status;
+    if (!bus.read(AHT_ADDRESS, &status, 1)) {
+        return false;
+    }
+    // Loads the calibration from the chip's OTP; needed once per power-up
+    if (!(status & AHT_STATUS_CALIBRATED)) {
+        const uint8_t init[] = { (uint8_t)(model == AHT_MODEL_AHT20 ? AHT20_INIT : AHT10_INIT), 0x08, 0x00 };
+        if (!bus.write(AHT_ADDRESS, init, sizeof(init))) {
+            return false;
+        }
+        delay(AHT_INIT_MS);
+    }
+    const uint8_t trigger[] = { AHT_TRIGGER, 0x33, 0x00 };
+    return bus.write(AHT_ADDRESS, trigger, sizeof(trigger));
+}
+
+uint16_t AhtDriver::conversionMs() const {
+    return 80;
+}
+
+bool AhtDriver::read(Measurement& measurement) {
+    // Status, 20 bits humidity, 20 bits temperature; AHT20 adds a CRC
+    uint8_t data[7];
+    size_t length = model == AHT_MODEL_AHT20 ? 7 : 6;
+    for (uint8_t attempt = 0; ; attempt++) {
+        if (!bus.read(AHT_ADDRESS, data, length)) {
+            return false;
+        }
+        if (!(data[0] & AHT_STATUS_BUSY)) {
+            break;
+        }
+        if (attempt == AHT_BUSY_RETRIES) {
+            Serial.println("AHT conversion timed out");
+            return false;
+        }
+        delay(AHT_INIT_MS);
+    }
+    if (model == AHT_MODEL_AHT20 && I2cBus::crc8(data, 6) != data[6]) {
+        Serial.println("AHT20 CRC mismatch");
+        return false;
+    }
+    
+    uint32_t rawHumidity = ((uint32_t)data[1] << 12) | ((uint32_t)data[2] << 4) | (data[3] >> 4);
+    uint32_t rawTemperature = ((uint32_t)(data[3] & 0x0F) << 16) | ((uint32_t)data[4] << 8) | data[5];
+    measurement.set(SENSOR_TEMPERATURE, rawTemperature * 200.0f / 1048576.0f - 50.0f);
+    measurement.set(SENSOR_HUMIDITY, rawHumidity * 100.0f / 1048576.0f);
+    return true;
+}
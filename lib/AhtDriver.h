@@ -0,0 +1,42 @@
+#ifndef AHT_DRIVER_H
+#define AHT_DRIVER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "I2cBus.h"
+#include "SensorDriver.h"
+
+#define AHT_ADDRESS 0x38
+
+// The two chips answer the same commands except initialization, and the
+// AHT20 appends a CRC to its result. Nothing in their replies tells them
+// apart reliably, so the board says which one is fitted.
+enum AhtModel {
+    AHT_MODEL_AHT10 = 0,
+    AHT_MODEL_AHT20
+};
+
+// Aosong AHT10/AHT20 on raw register transactions: start() triggers the
+// conversion and read() collects it, so the chip converts in parallel
+// with the other sensors
+class AhtDriver : public SensorDriver {
+public:
+    AhtDriver(I2cBus& bus, AhtModel model);
+    
+    const char* name() const;
+    uint8_t channels() const;
+    uint16_t powerUpMs() const;
+    bool start();
+    uint16_t conversionMs() const;
+    bool read(Measurement& measurement);
+    
+private:
+    I2cBus& bus;
+    AhtModel model;
+};
+
+#endif
@@ -0,0 +1,448 @@
+#include "BinaryProtocol.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+void putU16(uint8_t* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+void putU32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+uint16_t getU16(const uint8_t* p) {
+    return p[0] | ((uint16_t)p[1] << 8);
+}
+
+uint32_t getU32(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void putHeader(uint8_t* p, uint8_t version, uint8_t type, const uint8_t deviceId[6],
+               uint32_t timeOffset, uint16_t count) {
+    p[0] = 'M';
+    p[1] = 'S';
+    p[2] = version;
+    p[3] = type;
+    memcpy(p + 4, deviceId, 6);
+    putU32(p + 10, timeOffset);
+    putU16(p + 14, count);
+}
+
+// Zigzag varint of a signed delta; fields are at most 16 bits wide
+// so a value never needs more than 3 bytes
+size_t putDelta(uint8_t* p, int32_t delta) {
+    uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    size_t length = 0;
+    while (value >= 0x80) {
+        p[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    p[length++] = value;
+    return length;
+}
+
+// Returns bytes read, 0 if truncated or longer than 3 bytes
+size_t getDelta(const uint8_t* p, size_t length, int32_t& delta) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < length && i < 3; i++) {
+        value |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+        if ((p[i] & 0x80) == 0) {
+            delta = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Index of a channel bit into the per-channel delta state
+uint8_t channelIndex(uint8_t channel) {
+    uint8_t index = 0;
+    while (index < 7 && !(channel & (1 << index))) {
+        index++;
+    }
+    return index;
+}
+
+// Value with 'decimals' implied decimal places, trailing zeros dropped
+// like LineProtocol does on the station
+int formatScaled(char* buf, size_t size, int16_t value, uint8_t decimals) {
+    int scale = decimals == 2 ? 100 : 10;
+    int magnitude = value < 0 ? -value : value;
+    int fraction = magnitude % scale;
+    int digits = decimals;
+    while (digits > 0 && fraction % 10 == 0 && fraction > 0) {
+        fraction /= 10;
+        digits--;
+    }
+    if (fraction == 0) {
+        return snprintf(buf, size, "%s%d", value < 0 ? "-" : "", magnitude / scale);
+    }
+    return snprintf(buf, size, "%s%d.%0*d", value < 0 ? "-" : "", magnitude / scale, digits, fraction);
+}
+
+}  // namespace
+
+BinaryBlockEncoder::BinaryBlockEncoder() : buf(nullptr), size(0), length(0), records(0), channels(false) {
+    memset(&last, 0, sizeof(last));
+    memset(lastSlot, 0, sizeof(lastSlot));
+}
+
+void BinaryBlockEncoder::begin(uint8_t* b, size_t s, const uint8_t deviceId[6], uint32_t timeOffset,
+                               bool withChannels) {
+    buf = b;
+    size = s;
+    records = 0;
+    length = 0;
+    channels = withChannels;
+    memset(&last, 0, sizeof(last));
+    memset(lastSlot, 0, sizeof(lastSlot));
+    if (size >= BINARY_HEADER_SIZE) {
+        putHeader(buf, channels ? BINARY_PROTOCOL_VERSION : BINARY_PLAIN_RECORDS_VERSION,
+                  BINARY_BLOCK_RECORDS, deviceId, timeOffset, 0);
+        length = BINARY_HEADER_SIZE;
+    }
+}
+
+bool BinaryBlockEncoder::add(const BinaryRecord& record) {
+    if (length == 0 || records >= BINARY_MAX_BLOCK_RECORDS) {
+        return false;
+    }
+    bool slot = record.humidity == SENSOR_CHANNEL_SLOT;
+    if (slot && !channels) {
+        return false;
+    }
+
+    if (records == 0) {
+        if (length + 4 > size) {
+            return false;
+        }
+        putU16(buf + length, record.timestamp);
+        buf[length + 2] = record.temperature;
+        buf[length + 3] = record.humidity;
+        length += 4;
+    } else if (!channels) {
+        if (length + 9 > size) {
+            return false;
+        }
+        length += putDelta(buf + length, (int32_t)record.timestamp - last.timestamp);
+        length += putDelta(buf + length, (int32_t)record.temperature - last.temperature);
+        length += putDelta(buf + length, (int32_t)record.humidity - last.humidity);
+    } else if (slot) {
+        if (length + 5 > size) {
+            return false;
+        }
+        buf[length++] = record.humidity;
+        buf[length++] = record.temperature;
+        uint16_t previous = lastSlot[channelIndex(record.temperature)];
+        length += putDelta(buf + length, (int32_t)(int16_t)record.timestamp - (int16_t)previous);
+    } else {
+        if (length + 7 > size) {
+            return false;
+        }
+        buf[length++] = record.humidity;
+        length += putDelta(buf + length, (int32_t)record.timestamp - last.timestamp);
+        length += putDelta(buf + length, (int32_t)record.temperature - last.temperature);
+    }
+
+    if (slot) {
+        lastSlot[channelIndex(record.temperature)] = record.timestamp;
+    } else {
+        last = record;
+    }
+    records++;
+    return true;
+}
+
+size_t BinaryBlockEncoder::finish() {
+    if (records == 0) {
+        return 0;
+    }
+    putU16(buf + 14, records);
+    return length;
+}
+
+uint16_t BinaryBlockEncoder::count() const {
+    return records;
+}
+
+bool BinaryBlockEncoder::hasChannels() const {
+    return channels;
+}
+
+size_t BinaryBlockEncoder::encodeBattery(uint8_t* buf, size_t size, const uint8_t deviceId[6],
+                                         uint32_t timeOffset, uint32_t timestamp, uint16_t millivolts,
+                                         uint16_t sequence) {
+    if (size < BINARY_BATTERY_SIZE) {
+        return 0;
+    }
+    // Same payload since version 2, so older ingest services accept it
+    putHeader(buf, BINARY_PLAIN_RECORDS_VERSION, BINARY_BLOCK_BATTERY, deviceId, timeOffset, 1);
+    putU32(buf + BINARY_HEADER_SIZE, timestamp);
+    putU16(buf + BINARY_HEADER_SIZE + 4, millivolts);
+    putU16(buf + BINARY_HEADER_SIZE + 6, sequence);
+    return BINARY_BATTERY_SIZE;
+}
+
+size_t BinaryBlockEncoder::encodeLocation(uint8_t* buf, size_t size, const uint8_t deviceId[6],
+                                          const char* location) {
+    size_t length = location ? strlen(location) : 0;
+    if (length == 0 || length > BINARY_MAX_LOCATION || size < BINARY_HEADER_SIZE + length) {
+        return 0;
+    }
+    putHeader(buf, BINARY_PROTOCOL_VERSION, BINARY_BLOCK_LOCATION, deviceId, 0, (uint16_t)length);
+    memcpy(buf + BINARY_HEADER_SIZE, location, length);
+    return BINARY_HEADER_SIZE + length;
+}
+
+size_t BinaryBlockEncoder::encodeExportHeader(uint8_t* buf, size_t size, const uint8_t deviceId[6],
+                                              uint32_t timeOffset, uint16_t count) {
+    if (size < BINARY_HEADER_SIZE) {
+        return 0;
+    }
+    putHeader(buf, BINARY_PROTOCOL_VERSION, BINARY_BLOCK_EXPORT, deviceId, timeOffset, count);
+    return BINARY_HEADER_SIZE;
+}
+
+size_t BinaryBlockDecoder::decode(const uint8_t* buf, size_t length, BinaryBlock& block) {
+    if (length < BINARY_HEADER_SIZE || buf[0] != 'M' || buf[1] != 'S') {
+        return 0;
+    }
+
+    block.version = buf[2];
+    block.type = buf[3];
+    memcpy(block.deviceId, buf + 4, 6);
+    block.timeOffset = getU32(buf + 10);
+    block.count = getU16(buf + 14);
+    block.batteryTime = 0;
+    block.batteryMillivolts = 0;
+    block.sequence = 0;
+    block.location[0] = '\0';
+
+    if (block.version < 1 || block.version > BINARY_PROTOCOL_VERSION) {
+        return 0;
+    }
+
+    size_t pos = BINARY_HEADER_SIZE;
+
+    if (block.type == BINARY_BLOCK_BATTERY) {
+        size_t payload = block.version >= 2 ? 8 : 6;
+        if (block.count != 1 || length < pos + payload) {
+            return 0;
+        }
+        block.batteryTime = getU32(buf + pos);
+        block.batteryMillivolts = getU16(buf + pos + 4);
+        if (block.version >= 2) {
+            block.sequence = getU16(buf + pos + 6);
+        }
+        return pos + payload;
+    }
+
+    if (block.type == BINARY_BLOCK_LOCATION) {
+        if (block.version < 3 || block.count == 0 || block.count > BINARY_MAX_LOCATION ||
+            length < pos + block.count) {
+            return 0;
+        }
+        // Control characters would break the line it ends up in
+        for (uint16_t i = 0; i < block.count; i++) {
+            if (buf[pos + i] < 0x20 || buf[pos + i] == 0x7F) {
+                return 0;
+            }
+        }
+        memcpy(block.location, buf + pos, block.count);
+        block.location[block.count] = '\0';
+        return pos + block.count;
+    }
+
+    if (block.type != BINARY_BLOCK_RECORDS || block.count == 0 ||
+        block.count > BINARY_MAX_BLOCK_RECORDS || length < pos + 4) {
+        return 0;
+    }
+
+    BinaryRecord record;
+    record.timestamp = getU16(buf + pos);
+    record.temperature = buf[pos + 2];
+    record.humidity = buf[pos + 3];
+    block.records[0] = record;
+    pos += 4;
+
+    if (block.version >= 3) {
+        return decodeChannelRecords(buf, length, pos, block);
+    }
+
+    for (uint16_t i = 1; i < block.count; i++) {
+        int32_t deltas[3];
+        for (int field = 0; field < 3; field++) {
+            size_t n = getDelta(buf + pos, length - pos, deltas[field]);
+            if (n == 0) {
+                return 0;
+            }
+            pos += n;
+        }
+        record.timestamp = (uint16_t)(record.timestamp + deltas[0]);
+        record.temperature = (uint8_t)(record.temperature + deltas[1]);
+        record.humidity = (uint8_t)(record.humidity + deltas[2]);
+        block.records[i] = record;
+    }
+    return pos;
+}
+
+// Version 3 records after the first, see BinaryProtocol.h
+size_t BinaryBlockDecoder::decodeChannelRecords(const uint8_t* buf, size_t length, size_t pos,
+                                                BinaryBlock& block) {
+    BinaryRecord last = block.records[0];
+    uint16_t lastSlot[8] = {};
+    if (last.humidity == SENSOR_CHANNEL_SLOT) {
+        lastSlot[channelIndex(last.temperature)] = last.timestamp;
+        memset(&last, 0, sizeof(last));
+    }
+
+    for (uint16_t i = 1; i < block.count; i++) {
+        BinaryRecord record;
+        int32_t delta;
+        size_t n;
+        if (pos >= length) {
+            return 0;
+        }
+        record.humidity = buf[pos++];
+
+        if (record.humidity == SENSOR_CHANNEL_SLOT) {
+            if (pos >= length) {
+                return 0;
+            }
+            record.temperature = buf[pos++];
+            uint16_t& previous = lastSlot[channelIndex(record.temperature)];
+            if ((n = getDelta(buf + pos, length - pos, delta)) == 0) {
+                return 0;
+            }
+            pos += n;
+            record.timestamp = (uint16_t)((int16_t)previous + delta);
+            previous = record.timestamp;
+        } else {
+            if ((n = getDelta(buf + pos, length - pos, delta)) == 0) {
+                return 0;
+            }
+            pos += n;
+            record.timestamp = (uint16_t)(last.timestamp + delta);
+            if ((n = getDelta(buf + pos, length - pos, delta)) == 0) {
+                return 0;
+            }
+            pos += n;
+            record.temperature = (uint8_t)(last.temperature + delta);
+            last = record;
+        }
+        block.records[i] = record;
+    }
+    return pos;
+}
+
+size_t BinaryBlockDecoder::decodeExportHeader(const uint8_t* buf, size_t length, BinaryBlock& block) {
+    if (length < BINARY_HEADER_SIZE || buf[0] != 'M' || buf[1] != 'S' ||
+        buf[2] < 2 || buf[2] > BINARY_PROTOCOL_VERSION || buf[3] != BINARY_BLOCK_EXPORT) {
+        return 0;
+    }
+    memset(&block, 0, sizeof(block));
+    block.version = buf[2];
+    block.type = buf[3];
+    memcpy(block.deviceId, buf + 4, 6);
+    block.timeOffset = getU32(buf + 10);
+    block.count = getU16(buf + 14);
+    return BINARY_HEADER_SIZE;
+}
+
+BinaryRecord BinaryBlockDecoder::decodeExportRecord(const uint8_t* buf) {
+    BinaryRecord record;
+    record.timestamp = getU16(buf);
+    record.temperature = buf[2];
+    record.humidity = buf[3];
+    return record;
+}
+
+uint32_t BinaryBlockDecoder::timestampSeconds(const BinaryBlock& block, const BinaryRecord& record) {
+    // Same rounding as SensorRecord::getTimestampSeconds
+    return (block.timeOffset / 60 + record.timestamp) * 60;
+}
+
+int BinaryBlockDecoder::temperature(const BinaryRecord& record) {
+    return (int)record.temperature - 100;
+}
+
+void BinaryBlockDecoder::formatDeviceId(char* buf, const uint8_t deviceId[6]) {
+    snprintf(buf, 13, "%02x%02x%02x%02x%02x%02x",
+             deviceId[0], deviceId[1], deviceId[2], deviceId[3], deviceId[4], deviceId[5]);
+}
+
+// "<measurement>,device=<mac>[,location=<loc>]", snprintf-style length
+int BinaryBlockDecoder::formatSeries(char* buf, size_t size, const char* measurement,
+                                     const BinaryBlock& block, const char* location) {
+    char device[13];
+    formatDeviceId(device, block.deviceId);
+    int length = snprintf(buf, size, "%s,device=%s", measurement, device);
+    if (length <= 0 || (size_t)length >= size || !location || !*location) {
+        return length;
+    }
+
+    // Escaped like LineProtocol::encodeSeries does
+    char escaped[BINARY_MAX_LOCATION * 2 + 1];
+    size_t n = 0;
+    for (const char* c = location; *c && n + 2 < sizeof(escaped); c++) {
+        if (strchr(",= ", *c)) {
+            escaped[n++] = '\\';
+        }
+        escaped[n++] = *c;
+    }
+    escaped[n] = '\0';
+    return length + snprintf(buf + length, size - length, ",location=%s", escaped);
+}
+
+size_t BinaryBlockDecoder::formatRecordLine(char* buf, size_t size, const char* measurement,
+                                            const BinaryBlock& block, const BinaryRecord& record,
+                                            const BinaryRecord* slots, size_t slotCount,
+                                            const char* location) {
+    int length = formatSeries(buf, size, measurement, block, location);
+    if (length > 0 && (size_t)length < size) {
+        length += snprintf(buf + length, size - length, " temperature=%d", temperature(record));
+    }
+    if (length > 0 && (size_t)length < size && record.humidity <= 100) {
+        length += snprintf(buf + length, size - length, ",humidity=%u", (unsigned int)record.humidity);
+    }
+    for (size_t i = 0; i < slotCount && length > 0 && (size_t)length < size; i++) {
+        const char* name = sensorChannelName(slots[i].temperature);
+        if (!name) {
+            continue;
+        }
+        length += snprintf(buf + length, size - length, ",%s=", name);
+        if ((size_t)length < size) {
+            length += formatScaled(buf + length, size - length, (int16_t)slots[i].timestamp,
+                                   sensorChannelDecimals(slots[i].temperature));
+        }
+    }
+    if (length > 0 && (size_t)length < size) {
+        length += snprintf(buf + length, size - length, " %u\n",
+                           (unsigned int)timestampSeconds(block, record));
+    }
+    return length > 0 && (size_t)length < size ? length : 0;
+}
+
+size_t BinaryBlockDecoder::formatBatteryLine(char* buf, size_t size, const char* measurement,
+                                             const BinaryBlock& block, const char* location) {
+    unsigned int centivolts = (block.batteryMillivolts + 5) / 10;
+    int length = formatSeries(buf, size, measurement, block, location);
+    if (length <= 0 || (size_t)length >= size) {
+        return 0;
+    }
+    if (block.version >= 2) {
+        length += snprintf(buf + length, size - length, " battery_voltage=%u.%02u,upload_seq=%ui %u\n",
+                           centivolts / 100, centivolts % 100,
+                           (unsigned int)block.sequence, (unsigned int)block.batteryTime);
+    } else {
+        length += snprintf(buf + length, size - length, " battery_voltage=%u.%02u %u\n",
+                           centivolts / 100, centivolts % 100, (unsigned int)block.batteryTime);
+    }
+    return length > 0 && (size_t)length < size ? length : 0;
+}
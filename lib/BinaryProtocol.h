@@ -0,0 +1,160 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+// Compact upload format shared by the device (BinaryUploadSink) and the
+// host-side ingest service (tools/ingest). Plain C++ - no Arduino headers.
+//
+// A request body is a sequence of blocks. Each block has a 16-byte
+// header (little endian):
+//
+//   0  'M' 'S'      magic
+//   2  version      BINARY_PROTOCOL_VERSION
+//   3  type         BINARY_BLOCK_RECORDS, BINARY_BLOCK_BATTERY or
+//                   BINARY_BLOCK_LOCATION
+//   4  deviceId[6]  station MAC address
+//   10 timeOffset   uint32, seconds (Config::timeOffset)
+//   14 count        uint16, number of entries
+//
+// Records payload: the first record as stored in SensorRecord
+// (timestamp u16, temperature u8, humidity u8), then for every further
+// record the zigzag varint deltas of timestamp, temperature and humidity.
+// A steady interval with slow-moving values costs 3 bytes per record.
+//
+// Version 3 records blocks also carry channel slots (SensorChannels.h):
+// every further record starts with its raw humidity byte. A slot
+// (SENSOR_CHANNEL_SLOT) continues with its raw channel byte and the
+// varint delta of its value against the previous slot of that channel;
+// a measurement with the timestamp and temperature deltas against the
+// previous measurement. Blocks without slots and battery blocks are sent
+// as version 2, so an AHT-only station still talks to older ingest
+// services.
+//
+// Battery payload: uint32 timestamp (seconds), uint16 millivolts,
+// uint16 upload session sequence (version 2; version 1 has no sequence).
+//
+// Location payload (version 3): count bytes of the station's "location"
+// tag (Config::location, no terminator). It tags the blocks after it in
+// the same request body, so it leads each request of a station with a
+// location set; stations without one never send it.
+//
+// Backlog export (GET /export on the config portal): a header of type
+// BINARY_BLOCK_EXPORT with count = number of records, followed by the
+// records exactly as stored (4 bytes each, no deltas). Fixed-size records
+// let an HTTP byte range map straight onto records, so an interrupted
+// download can resume. From version 3 these may include channel slots.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SensorChannels.h"
+
+#define BINARY_PROTOCOL_VERSION 3
+#define BINARY_PLAIN_RECORDS_VERSION 2   // Battery blocks and records blocks without channel slots
+#define BINARY_INGEST_PATH "/ingest"
+#define BINARY_BLOCK_RECORDS 1
+#define BINARY_BLOCK_BATTERY 2
+#define BINARY_BLOCK_EXPORT 3
+#define BINARY_BLOCK_LOCATION 4
+
+#define BINARY_HEADER_SIZE 16
+#define BINARY_BATTERY_SIZE (BINARY_HEADER_SIZE + 8)
+#define BINARY_EXPORT_RECORD_SIZE 4
+#define BINARY_MAX_LOCATION 15   // Same as Config::location
+#define BINARY_MAX_LOCATION_SIZE (BINARY_HEADER_SIZE + BINARY_MAX_LOCATION)
+#define BINARY_MAX_BLOCK_RECORDS 32
+// Header + first record + worst case of three 3-byte varints per delta
+#define BINARY_MAX_BLOCK_SIZE (BINARY_HEADER_SIZE + 4 + (BINARY_MAX_BLOCK_RECORDS - 1) * 9)
+
+// Same fields as SensorRecord, channel slots included
+struct BinaryRecord {
+    uint16_t timestamp;     // Minutes since timeOffset; slot: int16 value
+    uint8_t temperature;    // Celsius + 100; slot: channel bit
+    uint8_t humidity;       // Percent, SENSOR_NO_HUMIDITY or SENSOR_CHANNEL_SLOT
+};
+
+struct BinaryBlock {
+    uint8_t version;
+    uint8_t type;
+    uint8_t deviceId[6];
+    uint32_t timeOffset;
+    uint16_t count;
+    BinaryRecord records[BINARY_MAX_BLOCK_RECORDS];
+    uint32_t batteryTime;        // Battery blocks only
+    uint16_t batteryMillivolts;
+    uint16_t sequence;           // Upload session, battery blocks from version 2
+    char location[BINARY_MAX_LOCATION + 1];   // Location blocks only
+};
+
+// Builds one records block in a caller-supplied buffer
+class BinaryBlockEncoder {
+public:
+    BinaryBlockEncoder();
+
+    // 'channels' selects the version 3 layout, needed to add slots
+    void begin(uint8_t* buf, size_t size, const uint8_t deviceId[6], uint32_t timeOffset,
+               bool channels = false);
+    bool add(const BinaryRecord& record);   // false when the block is full
+    size_t finish();                        // Block length, count patched in
+    uint16_t count() const;
+    bool hasChannels() const;
+
+    // Complete battery block, returns its length (0 if buf is too small)
+    static size_t encodeBattery(uint8_t* buf, size_t size, const uint8_t deviceId[6],
+                                uint32_t timeOffset, uint32_t timestamp, uint16_t millivolts,
+                                uint16_t sequence);
+
+    // Location block for a non-empty tag of at most BINARY_MAX_LOCATION
+    // characters, returns its length (0 otherwise)
+    static size_t encodeLocation(uint8_t* buf, size_t size, const uint8_t deviceId[6],
+                                 const char* location);
+
+    // Header of a backlog export holding 'count' records
+    static size_t encodeExportHeader(uint8_t* buf, size_t size, const uint8_t deviceId[6],
+                                     uint32_t timeOffset, uint16_t count);
+
+private:
+    uint8_t* buf;
+    size_t size;
+    size_t length;
+    uint16_t records;
+    bool channels;
+    BinaryRecord last;            // Previous measurement
+    uint16_t lastSlot[8];         // Previous value per channel bit
+};
+
+class BinaryBlockDecoder {
+public:
+    // Decode the block at buf (version 1 to 3). Returns the bytes consumed,
+    // or 0 if the data is truncated or not a valid block.
+    static size_t decode(const uint8_t* buf, size_t length, BinaryBlock& block);
+
+    // Backlog export: the header (block.records stays empty, returns
+    // BINARY_HEADER_SIZE or 0) and then each BINARY_EXPORT_RECORD_SIZE record
+    static size_t decodeExportHeader(const uint8_t* buf, size_t length, BinaryBlock& block);
+    static BinaryRecord decodeExportRecord(const uint8_t* buf);
+
+    // Absolute values of a decoded record
+    static uint32_t timestampSeconds(const BinaryBlock& block, const BinaryRecord& record);
+    static int temperature(const BinaryRecord& record);
+
+    // "<measurement>,device=<mac>[,location=<loc>] temperature=..,humidity=..
+    // <seconds>\n" (seconds precision, battery lines add upload_seq) with a
+    // field for each of the record's 'slots'; 'location' comes from the
+    // location block before, if any. Returns length, 0 if buf is too small.
+    static size_t formatRecordLine(char* buf, size_t size, const char* measurement,
+                                   const BinaryBlock& block, const BinaryRecord& record,
+                                   const BinaryRecord* slots = nullptr, size_t slotCount = 0,
+                                   const char* location = nullptr);
+    static size_t formatBatteryLine(char* buf, size_t size, const char* measurement,
+                                    const BinaryBlock& block, const char* location = nullptr);
+
+    // Lower-case hex MAC without separators
+    static void formatDeviceId(char* buf, const uint8_t deviceId[6]);
+
+private:
+    static int formatSeries(char* buf, size_t size, const char* measurement,
+                            const BinaryBlock& block, const char* location);
+    static size_t decodeChannelRecords(const uint8_t* buf, size_t length, size_t pos, BinaryBlock& block);
+};
+
+#endif
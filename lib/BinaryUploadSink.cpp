@@ -0,0 +1,184 @@
+#include "BinaryUploadSink.h"
+
+BinaryUploadSink::BinaryUploadSink()
+    : writer(wifiClient), blockOffset(0), recordsSent(0), bytesSent(0) {
+    // Block timestamps are minutes since timeOffset; battery is in seconds
+    precision = PRECISION_M;
+}
+
+BinaryUploadSink::~BinaryUploadSink() {
+    writer.stop();
+}
+
+bool BinaryUploadSink::begin(Config* cfg) {
+    config = cfg;
+    
+    if (!config || !config->isValid()) {
+        Serial.println("Invalid configuration for binary upload");
+        return false;
+    }
+    
+    writer.setEndpoint(config->influxServer, config->influxPort, BINARY_INGEST_PATH);
+    writer.setContentType("application/octet-stream");
+    writer.beginSession();
+    
+    encoder.begin(block, sizeof(block), deviceId, 0);
+    recordsSent = 0;
+    bytesSent = 0;
+    lastError = "";
+    lastErrorKind = UPLOAD_OK;
+    
+    Serial.printf("Binary upload to %s:%d%s\n", 
+                  config->influxServer, config->influxPort, BINARY_INGEST_PATH);
+    return true;
+}
+
+bool BinaryUploadSink::writeLine(const char* line, size_t length) {
+    lastError = "Line protocol not supported by binary upload";
+    return false;
+}
+
+bool BinaryUploadSink::writeSensorRecord(const SensorRecord& record, uint32_t timeOffset) {
+    return writeSensorRecords(&record, 1, timeOffset);
+}
+
+bool BinaryUploadSink::writeSensorRecords(const SensorRecord* records, size_t count, uint32_t timeOffset) {
+    if (!config) {
+        return false;
+    }
+    
+    size_t i = 0;
+    while (i < count) {
+        // A measurement and its channel slots stay in one block
+        size_t group = 1 + SensorRecord::countSlots(records + i, count - i);
+        bool slots = group > 1 || records[i].isChannelSlot();
+        
+        // A block carries a single timeOffset and layout
+        if (encoder.count() > 0 &&
+            (timeOffset != blockOffset || encoder.count() + group > BINARY_MAX_BLOCK_RECORDS ||
+             (slots && !encoder.hasChannels())) &&
+            !sendBlock()) {
+            return false;
+        }
+        if (encoder.count() == 0) {
+            encoder.begin(block, sizeof(block), deviceId, timeOffset, hasSlots(records + i, count - i));
+            blockOffset = timeOffset;
+        }
+        
+        for (size_t end = i + group; i < end; i++) {
+            BinaryRecord packed;
+            packed.timestamp = records[i].timestamp;
+            packed.temperature = (uint8_t)records[i].temperature;
+            packed.humidity = records[i].humidity;
+            encoder.add(packed);
+        }
+        
+        if (encoder.count() >= BINARY_MAX_BLOCK_RECORDS && !sendBlock()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Version 3 layout only when the next block needs it
+bool BinaryUploadSink::hasSlots(const SensorRecord* records, size_t count) {
+    for (size_t i = 0; i < count && i < BINARY_MAX_BLOCK_RECORDS; i++) {
+        if (records[i].isChannelSlot()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinaryUploadSink::writeBatteryVoltage(float voltage, uint16_t sequence, uint32_t timestampSeconds) {
+    if (!config || !sendBlock()) {
+        return false;
+    }
+    
+    uint8_t battery[BINARY_BATTERY_SIZE];
+    uint16_t millivolts = voltage > 0 ? (uint16_t)(voltage * 1000 + 0.5f) : 0;
+    size_t length = BinaryBlockEncoder::encodeBattery(battery, sizeof(battery), deviceId, 
+                                                      config->timeOffset, timestampSeconds,
+                                                      millivolts, sequence);
+    return send(battery, length);
+}
+
+bool BinaryUploadSink::sendBlock() {
+    uint16_t count = encoder.count();
+    if (count == 0) {
+        return true;
+    }
+    
+    size_t length = encoder.finish();
+    bool sent = send(block, length);
+    encoder.begin(block, sizeof(block), deviceId, blockOffset);
+    
+    if (!sent) {
+        return false;
+    }
+    recordsSent += count;
+    return true;
+}
+
+bool BinaryUploadSink::send(const uint8_t* data, size_t length) {
+    // The ingest service scopes the location tag to one request body
+    if (!writer.isRequestOpen() && !sendLocation()) {
+        return false;
+    }
+    if (!writer.begin() || !writer.write((const char*)data, length)) {
+        lastError = writer.getError();
+        lastErrorKind = writer.getErrorKind();
+        return false;
+    }
+    bytesSent += length;
+    return true;
+}
+
+bool BinaryUploadSink::sendLocation() {
+    uint8_t header[BINARY_MAX_LOCATION_SIZE];
+    size_t length = BinaryBlockEncoder::encodeLocation(header, sizeof(header), deviceId,
+                                                       config->location);
+    if (length == 0) {
+        return true;
+    }
+    if (!writer.begin() || !writer.write((const char*)header, length)) {
+        lastError = writer.getError();
+        lastErrorKind = writer.getErrorKind();
+        return false;
+    }
+    bytesSent += length;
+    return true;
+}
+
+bool BinaryUploadSink::flush() {
+    if (!config) {
+        return false;
+    }
+    
+    bool success = sendBlock() && lastError.length() == 0;
+    
+    if (writer.isRequestOpen() && !writer.end()) {
+        success = false;
+    }
+    
+    if (success) {
+        Serial.printf("Binary upload: %u records in %u bytes\n", 
+                      (unsigned int)recordsSent, (unsigned int)bytesSent);
+    } else if (lastError.length() == 0) {
+        lastError = writer.getError();
+        lastErrorKind = writer.getErrorKind();
+    }
+    return success;
+}
+
+void BinaryUploadSink::close() {
+    writer.stop();
+}
+
+uint16_t BinaryUploadSink::getRecordsSent() const {
+    return recordsSent;
+}
+
+uint32_t BinaryUploadSink::getBytesSent() const {
+    return bytesSent;
+}
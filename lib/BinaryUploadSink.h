@@ -0,0 +1,58 @@
+#ifndef BINARY_UPLOAD_SINK_H
+#define BINARY_UPLOAD_SINK_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#include "../test/native_mocks/WiFiClient.h"
+#else
+#include <Arduino.h>
+#include <WiFiClient.h>
+#endif
+
+#include "UploadSink.h"
+#include "BinaryProtocol.h"
+#include "InfluxHttpWriter.h"
+
+// Compact upload to the meteo-ingest service (tools/ingest): records go
+// out as delta-encoded blocks (see BinaryProtocol.h) in one chunked POST,
+// and the service turns them into line protocol for InfluxDB. A location
+// set in Config leads each request as a location block.
+// Server host/port come from the InfluxDB fields of Config.
+class BinaryUploadSink : public UploadSink {
+public:
+    BinaryUploadSink();
+    ~BinaryUploadSink();
+    
+    bool begin(Config* cfg);
+    bool flush();
+    void close();
+    
+    bool writeSensorRecord(const SensorRecord& record, uint32_t timeOffset);
+    // Blocks carry the raw record fields, nothing to decode; channel slots
+    // switch the block to the version 3 layout
+    bool writeSensorRecords(const SensorRecord* records, size_t count, uint32_t timeOffset);
+    bool writeBatteryVoltage(float voltage, uint16_t sequence, uint32_t timestampSeconds);
+    
+    uint16_t getRecordsSent() const;
+    uint32_t getBytesSent() const;
+    
+protected:
+    // Records never travel as text here
+    bool writeLine(const char* line, size_t length);
+    
+private:
+    WiFiClient wifiClient;
+    InfluxHttpWriter writer;
+    BinaryBlockEncoder encoder;
+    uint8_t block[BINARY_MAX_BLOCK_SIZE];
+    uint32_t blockOffset;
+    uint16_t recordsSent;
+    uint32_t bytesSent;
+    
+    bool sendBlock();
+    static bool hasSlots(const SensorRecord* records, size_t count);
+    bool send(const uint8_t* data, size_t length);
+    bool sendLocation();
+};
+
+#endif
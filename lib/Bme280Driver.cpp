@@ -0,0 +1,124 @@
+#include "Bme280Driver.h"
+
+#define BME280_REG_CALIB_T_P 0x88   // 26 bytes, dig_T1..dig_P9 and dig_H1
+#define BME280_REG_CHIP_ID 0xD0
+#define BME280_REG_CALIB_H 0xE1     // 7 bytes, dig_H2..dig_H6
+#define BME280_REG_CTRL_HUM 0xF2
+#define BME280_REG_CTRL_MEAS 0xF4
+#define BME280_REG_DATA 0xF7        // 8 bytes: pressure, temperature, humidity
+#define BME280_CHIP_ID 0x60
+
+#define BME280_OVERSAMPLING_1X 0x01
+#define BME280_MODE_FORCED 0x01
+
+Bme280Driver::Bme280Driver(I2cBus& bus, uint8_t address) : bus(bus), address(address) {
+    memset(&calibration, 0, sizeof(calibration));
+}
+
+const char* Bme280Driver::name() const {
+    return "BME280";
+}
+
+uint8_t Bme280Driver::channels() const {
+    return SENSOR_TEMPERATURE | SENSOR_HUMIDITY | SENSOR_PRESSURE;
+}
+
+uint16_t Bme280Driver::powerUpMs() const {
+    return 2;
+}
+
+bool Bme280Driver::start() {
+    uint8_t id;
+    if (!readRegisters(BME280_REG_CHIP_ID, &id, 1) || id != BME280_CHIP_ID || !readCalibration()) {
+        return false;
+    }
+    // ctrl_hum only takes effect with the next ctrl_meas write
+    return writeRegister(BME280_REG_CTRL_HUM, BME280_OVERSAMPLING_1X) &&
+           writeRegister(BME280_REG_CTRL_MEAS, (BME280_OVERSAMPLING_1X << 5) |
+                                               (BME280_OVERSAMPLING_1X << 2) | BME280_MODE_FORCED);
+}
+
+uint16_t Bme280Driver::conversionMs() const {
+    // Datasheet 9.1: 1.25 + 2.3 + 2 * (2.3 + 0.575) ms at 1x oversampling
+    return 10;
+}
+
+bool Bme280Driver::read(Measurement& measurement) {
+    uint8_t data[8];
+    if (!readRegisters(BME280_REG_DATA, data, sizeof(data))) {
+        return false;
+    }
+    int32_t adcP = ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | (data[2] >> 4);
+    int32_t adcT = ((int32_t)data[3] << 12) | ((int32_t)data[4] << 4) | (data[5] >> 4);
+    int32_t adcH = ((int32_t)data[6] << 8) | data[7];
+    if (adcT == 0x80000) {
+        return false;   // Skipped: the conversion never ran
+    }
+    const Calibration& c = calibration;
+    
+    // Compensation formulas of the datasheet (section 4.2.3), integer versions
+    int32_t var1 = ((((adcT >> 3) - ((int32_t)c.t1 << 1))) * c.t2) >> 11;
+    int32_t var2 = (((((adcT >> 4) - (int32_t)c.t1) * ((adcT >> 4) - (int32_t)c.t1)) >> 12) * c.t3) >> 14;
+    int32_t tFine = var1 + var2;
+    measurement.set(SENSOR_TEMPERATURE, ((tFine * 5 + 128) >> 8) / 100.0f);
+    
+    int64_t p1 = (int64_t)tFine - 128000;
+    int64_t p2 = p1 * p1 * c.p6;
+    p2 = p2 + ((p1 * c.p5) << 17);
+    p2 = p2 + ((int64_t)c.p4 << 35);
+    p1 = ((p1 * p1 * c.p3) >> 8) + ((p1 * c.p2) << 12);
+    p1 = ((((int64_t)1) << 47) + p1) * c.p1 >> 33;
+    if (p1 != 0) {
+        int64_t p = 1048576 - adcP;
+        p = (((p << 31) - p2) * 3125) / p1;
+        p1 = ((int64_t)c.p9 * (p >> 13) * (p >> 13)) >> 25;
+        p2 = ((int64_t)c.p8 * p) >> 19;
+        p = ((p + p1 + p2) >> 8) + ((int64_t)c.p7 << 4);
+        measurement.set(SENSOR_PRESSURE, (uint32_t)p / 25600.0f);   // Q24.8 Pa to hPa
+    }
+    
+    if (adcH != 0x8000) {
+        int32_t h = tFine - 76800;
+        h = (((((adcH << 14) - ((int32_t)c.h4 << 20) - ((int32_t)c.h5 * h)) + 16384) >> 15) *
+             (((((((h * c.h6) >> 10) * (((h * c.h3) >> 11) + 32768)) >> 10) + 2097152) * c.h2 + 8192) >> 14));
+        h = h - (((((h >> 15) * (h >> 15)) >> 7) * c.h1) >> 4);
+        h = h < 0 ? 0 : h;
+        h = h > 419430400 ? 419430400 : h;
+        measurement.set(SENSOR_HUMIDITY, (h >> 12) / 1024.0f);
+    }
+    return true;
+}
+
+bool Bme280Driver::readCalibration() {
+    uint8_t tp[26];
+    uint8_t h[7];
+    if (!readRegisters(BME280_REG_CALIB_T_P, tp, sizeof(tp)) ||
+        !readRegisters(BME280_REG_CALIB_H, h, sizeof(h))) {
+        return false;
+    }
+    Calibration& c = calibration;
+    c.t1 = tp[0] | (tp[1] << 8);
+    c.t2 = (int16_t)(tp[2] | (tp[3] << 8));
+    c.t3 = (int16_t)(tp[4] | (tp[5] << 8));
+    c.p1 = tp[6] | (tp[7] << 8);
+    int16_t* p[8] = { &c.p2, &c.p3, &c.p4, &c.p5, &c.p6, &c.p7, &c.p8, &c.p9 };
+    for (int i = 0; i < 8; i++) {
+        *p[i] = (int16_t)(tp[8 + 2 * i] | (tp[9 + 2 * i] << 8));
+    }
+    c.h1 = tp[25];
+    c.h2 = (int16_t)(h[0] | (h[1] << 8));
+    c.h3 = h[2];
+    c.h4 = (int16_t)(((int8_t)h[3] << 4) | (h[4] & 0x0F));
+    c.h5 = (int16_t)(((int8_t)h[5] << 4) | (h[4] >> 4));
+    c.h6 = (int8_t)h[6];
+    return true;
+}
+
+bool Bme280Driver::readRegisters(uint8_t reg, uint8_t* data, size_t length) {
+    return bus.readRegisters(address, reg, data, length);
+}
+
+bool Bme280Driver::writeRegister(uint8_t reg, uint8_t value) {
+    const uint8_t data[] = { reg, value };
+    return bus.write(address, data, sizeof(data));
+}
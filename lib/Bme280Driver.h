@@ -0,0 +1,49 @@
+#ifndef BME280_DRIVER_H
+#define BME280_DRIVER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "I2cBus.h"
+#include "SensorDriver.h"
+
+#define BME280_ADDRESS 0x76   // SDO low; 0x77 when high
+
+// Bosch BME280 in forced mode with 1x oversampling and no filter - the
+// weather monitoring setting of the datasheet. The chip loses its
+// settings with the power, so start() reads the calibration each time.
+class Bme280Driver : public SensorDriver {
+public:
+    explicit Bme280Driver(I2cBus& bus, uint8_t address = BME280_ADDRESS);
+    
+    const char* name() const;
+    uint8_t channels() const;
+    uint16_t powerUpMs() const;
+    bool start();
+    uint16_t conversionMs() const;
+    bool read(Measurement& measurement);
+    
+private:
+    struct Calibration {
+        uint16_t t1;
+        int16_t t2, t3;
+        uint16_t p1;
+        int16_t p2, p3, p4, p5, p6, p7, p8, p9;
+        uint8_t h1, h3;
+        int16_t h2, h4, h5;
+        int8_t h6;
+    };
+    
+    I2cBus& bus;
+    uint8_t address;
+    Calibration calibration;
+    
+    bool readRegisters(uint8_t reg, uint8_t* data, size_t length);
+    bool writeRegister(uint8_t reg, uint8_t value);
+    bool readCalibration();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "Config.h"
 
+#include <stddef.h>
+
 #ifdef NATIVE
 #include "../test/native_mocks/EEPROM.h"
 #include <time.h>
@@ -8,6 +10,103 @@
 #include <time.h>
 #endif
 
+// Versioned image: header, then the payload fields back to back
+struct ConfigHeader {
+    uint32_t magic;     // CONFIG_STORE_MAGIC
+    uint8_t version;    // Newest format that wrote a field in the payload
+    uint8_t reserved;
+    uint16_t length;    // Payload bytes
+    uint32_t crc;       // CRC-32 of the payload
+};
+
+struct ConfigField {
+    uint16_t offset;    // In Config
+    uint16_t size;
+    bool text;          // Forced NUL-terminated on load
+};
+
+#define CONFIG_FIELD(name, text) { offsetof(Config, name), sizeof(Config::name), text }
+
+// Payload layout. Append only: older firmware reads the fields it knows
+// and skips the rest, newer firmware keeps the defaults for fields a
+// shorter image does not have.
+static constexpr ConfigField CONFIG_FIELDS[] = {
+    CONFIG_FIELD(ssid, true),
+    CONFIG_FIELD(password, true),
+    CONFIG_FIELD(interval, false),
+    CONFIG_FIELD(influxServer, true),
+    CONFIG_FIELD(influxPort, false),
+    CONFIG_FIELD(influxDb, true),
+    CONFIG_FIELD(influxUser, true),
+    CONFIG_FIELD(influxPass, true),
+    CONFIG_FIELD(influxMeasurement, true),
+    CONFIG_FIELD(influxVersion, false),
+    CONFIG_FIELD(uploadSink, false),
+    CONFIG_FIELD(influxOrg, true),
+    CONFIG_FIELD(influxBucket, true),
+    CONFIG_FIELD(influxToken, true),
+    CONFIG_FIELD(location, true),
+    CONFIG_FIELD(timeOffset, false),
+    CONFIG_FIELD(otaUrl, true),          // Version 3
+    CONFIG_FIELD(configPath, true),      // Version 4
+    CONFIG_FIELD(configVersion, false),
+};
+
+static const size_t CONFIG_FIELD_COUNT = sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]);
+
+static constexpr size_t payloadSize(size_t fields) {
+    return fields == 0 ? 0 : CONFIG_FIELDS[fields - 1].size + payloadSize(fields - 1);
+}
+
+static const size_t CONFIG_PAYLOAD_SIZE = payloadSize(CONFIG_FIELD_COUNT);
+
+static_assert(CONFIG_ADDR + sizeof(ConfigHeader) + CONFIG_PAYLOAD_SIZE <= ROM_DATA_START,
+              "Config image overlaps the record area");
+
+// Version 1 image: the class as the firmware before versioning dumped it
+// with EEPROM.put(), which is what stations in the field have stored.
+// Frozen; only used to migrate to and from older firmware.
+struct ConfigV1 {
+    char ssid[32];
+    char password[64];
+    uint16_t interval;
+    char influxServer[64];
+    uint16_t influxPort;
+    char influxDb[32];
+    char influxUser[32];
+    char influxPass[64];
+    char influxMeasurement[32];
+    uint32_t timeOffset;
+    uint32_t magic;     // CONFIG_MAGIC
+};
+
+static_assert(sizeof(ConfigV1) == 332, "Version 1 image layout changed");
+static_assert(offsetof(ConfigV1, magic) == 328, "Version 1 image layout changed");
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return crc;
+}
+
+// True if 'image' holds an intact versioned config
+static bool readHeader(const uint8_t* image, ConfigHeader& header) {
+    memcpy(&header, image, sizeof(header));
+    return header.magic == CONFIG_STORE_MAGIC &&
+           header.length <= ROM_DATA_START - CONFIG_ADDR - sizeof(header) &&
+           header.crc == ~crc32(0xFFFFFFFF, image + sizeof(header), header.length);
+}
+
+// Copies between fields of the same meaning, truncating if sizes differ
+template<typename To, typename From>
+static void copyField(To& to, const From& from) {
+    memcpy(&to, &from, sizeof(to) < sizeof(from) ? sizeof(to) : sizeof(from));
+}
+
 Config::Config() {
     setDefaults();
 }
@@ -23,7 +122,16 @@ void Config::setDefaults() {
     memset(influxPass, 0, sizeof(influxPass));
     memset(influxMeasurement, 0, sizeof(influxMeasurement));
     strcpy(influxMeasurement, "environment");
+    influxVersion = INFLUX_API_V1;
+    uploadSink = UPLOAD_SINK_INFLUX_HTTP;
+    memset(influxOrg, 0, sizeof(influxOrg));
+    memset(influxBucket, 0, sizeof(influxBucket));
+    memset(influxToken, 0, sizeof(influxToken));
+    memset(location, 0, sizeof(location));
     timeOffset = 0;
+    memset(otaUrl, 0, sizeof(otaUrl));
+    memset(configPath, 0, sizeof(configPath));
+    configVersion = 0;
     magic = 0;
 }
 
@@ -49,30 +157,216 @@ String Config::getTimeOffsetString() const {
 }
 
 bool Config::load() {
-    EEPROM.get(CONFIG_ADDR, *this);
-    return isValid();
+    setDefaults();
+    const uint8_t* image = EEPROM.getConstDataPtr();
+    if (!image) {
+        return false;
+    }
+    image += CONFIG_ADDR;
+    
+    ConfigHeader header;
+    if (readHeader(image, header)) {
+        const uint8_t* payload = image + sizeof(header);
+        size_t pos = 0;
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            const ConfigField& field = CONFIG_FIELDS[i];
+            if (pos + field.size > header.length) {
+                break;   // Written by older firmware
+            }
+            uint8_t* member = (uint8_t*)this + field.offset;
+            memcpy(member, payload + pos, field.size);
+            if (field.text) {
+                member[field.size - 1] = 0;
+            }
+            pos += field.size;
+        }
+        magic = CONFIG_MAGIC;
+        return true;
+    }
+    
+    if (upgradeLegacy(image)) {
+        Serial.printf("Config migrated from version %d to %d\n", CONFIG_VERSION_LEGACY, CONFIG_VERSION);
+        return save();
+    }
+    return false;
 }
 
-void Config::save() {
+bool Config::save(uint8_t version) {
     magic = CONFIG_MAGIC;
-    EEPROM.put(CONFIG_ADDR, *this);
-#ifndef NATIVE
-    EEPROM.commit();
-#endif
+    const uint8_t* stored = EEPROM.getConstDataPtr();
+    if (!stored) {
+        return false;
+    }
+    stored += CONFIG_ADDR;
+    
+    if (version == CONFIG_VERSION_LEGACY) {
+        downgradeLegacy(EEPROM.getDataPtr() + CONFIG_ADDR);
+        return EEPROM.commit();
+    }
+    
+    // Keep fields that newer firmware appended after ours
+    ConfigHeader previous;
+    size_t tail = 0;
+    if (readHeader(stored, previous) && previous.length > CONFIG_PAYLOAD_SIZE) {
+        tail = previous.length - CONFIG_PAYLOAD_SIZE;
+    }
+    
+    ConfigHeader header;
+    header.magic = CONFIG_STORE_MAGIC;
+    header.version = tail > 0 ? previous.version : CONFIG_VERSION;
+    header.reserved = 0;
+    header.length = CONFIG_PAYLOAD_SIZE + tail;
+    
+    uint32_t crc = 0xFFFFFFFF;
+    bool unchanged = true;
+    size_t pos = sizeof(header);
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const uint8_t* member = (const uint8_t*)this + CONFIG_FIELDS[i].offset;
+        crc = crc32(crc, member, CONFIG_FIELDS[i].size);
+        unchanged = unchanged && memcmp(stored + pos, member, CONFIG_FIELDS[i].size) == 0;
+        pos += CONFIG_FIELDS[i].size;
+    }
+    header.crc = ~crc32(crc, stored + pos, tail);
+    
+    // Flash wears out; NTP sync saves on every upload
+    if (unchanged && memcmp(stored, &header, sizeof(header)) == 0) {
+        return true;
+    }
+    
+    uint8_t* image = EEPROM.getDataPtr() + CONFIG_ADDR;
+    memcpy(image, &header, sizeof(header));
+    pos = sizeof(header);
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        memcpy(image + pos, (const uint8_t*)this + CONFIG_FIELDS[i].offset, CONFIG_FIELDS[i].size);
+        pos += CONFIG_FIELDS[i].size;
+    }
+    return EEPROM.commit();
+}
+
+bool Config::upgradeLegacy(const uint8_t* image) {
+    ConfigV1 v1;
+    memcpy(&v1, image, sizeof(v1));
+    if (v1.magic != CONFIG_MAGIC) {
+        return false;
+    }
+    
+    copyField(ssid, v1.ssid);
+    copyField(password, v1.password);
+    copyField(interval, v1.interval);
+    copyField(influxServer, v1.influxServer);
+    copyField(influxPort, v1.influxPort);
+    copyField(influxDb, v1.influxDb);
+    copyField(influxUser, v1.influxUser);
+    copyField(influxPass, v1.influxPass);
+    copyField(influxMeasurement, v1.influxMeasurement);
+    copyField(timeOffset, v1.timeOffset);
+    magic = CONFIG_MAGIC;
+    return true;
+}
+
+void Config::downgradeLegacy(uint8_t* image) const {
+    ConfigV1 v1;
+    memset(&v1, 0, sizeof(v1));
+    copyField(v1.ssid, ssid);
+    copyField(v1.password, password);
+    copyField(v1.interval, interval);
+    copyField(v1.influxServer, influxServer);
+    copyField(v1.influxPort, influxPort);
+    copyField(v1.influxDb, influxDb);
+    copyField(v1.influxUser, influxUser);
+    copyField(v1.influxPass, influxPass);
+    copyField(v1.influxMeasurement, influxMeasurement);
+    copyField(v1.timeOffset, timeOffset);
+    v1.magic = CONFIG_MAGIC;
+    memcpy(image, &v1, sizeof(v1));
 }
 
 bool Config::isValid() const {
     return magic == CONFIG_MAGIC;
 }
 
+const char* Config::validate() const {
+    size_t passwordLength = strlen(password);
+    
+    if (strlen(ssid) == 0) {
+        return "WiFi SSID is required";
+    }
+    if (passwordLength > 0 && passwordLength < 8) {
+        return "WiFi password must be at least 8 characters (or empty for an open network)";
+    }
+    // The field itself caps it at CONFIG_MAX_INTERVAL
+    if (interval < CONFIG_MIN_INTERVAL) {
+        return "Interval must be between 60 and 65535 seconds";
+    }
+    if (strlen(influxServer) == 0) {
+        return "Server is required";
+    }
+    if (influxPort == 0) {
+        return "Port must be between 1 and 65535";
+    }
+    if (strlen(influxMeasurement) == 0) {
+        return "Measurement name is required";
+    }
+    
+    // The other sinks only use server and port (and MQTT the user)
+    if (uploadSink == UPLOAD_SINK_INFLUX_HTTP) {
+        if (influxVersion == INFLUX_API_V2 && 
+            (strlen(influxOrg) == 0 || strlen(influxBucket) == 0 || strlen(influxToken) == 0)) {
+            return "InfluxDB 2.x needs organization, bucket and token";
+        }
+        if (influxVersion != INFLUX_API_V2 && strlen(influxDb) == 0) {
+            return "InfluxDB 1.x needs a database name";
+        }
+    }
+    // A line break in the tag would split every line it goes into
+    for (const char* c = location; *c; c++) {
+        if ((uint8_t)*c < 0x20 || *c == 0x7F) {
+            return "Location must be printable text";
+        }
+    }
+    if (strlen(otaUrl) > 0 && strncmp(otaUrl, "http://", 7) != 0) {
+        return "Firmware update URL must start with http://";
+    }
+    if (strlen(configPath) > 0 && (configPath[0] != '/' || uploadSink != UPLOAD_SINK_INFLUX_HTTP)) {
+        return "Remote config path must start with / and needs the HTTP upload backend";
+    }
+    return nullptr;
+}
+
+bool Config::sameSettings(const Config& other) const {
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        if (memcmp((const uint8_t*)this + CONFIG_FIELDS[i].offset,
+                   (const uint8_t*)&other + CONFIG_FIELDS[i].offset, CONFIG_FIELDS[i].size) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void Config::print() const {
 #ifndef NATIVE
     Serial.println("Configuration:");
     Serial.printf("  SSID: %s\n", ssid);
     Serial.printf("  Interval: %d seconds\n", interval);
-    Serial.printf("  InfluxDB: %s:%d\n", influxServer, influxPort);
-    Serial.printf("  Database: %s\n", influxDb);
+    Serial.printf("  InfluxDB: %s:%d (v%d API)\n", influxServer, influxPort, influxVersion);
+    if (influxVersion == INFLUX_API_V2) {
+        Serial.printf("  Org/bucket: %s/%s\n", influxOrg, influxBucket);
+    } else {
+        Serial.printf("  Database: %s\n", influxDb);
+    }
+    Serial.printf("  Upload via: %s\n", uploadSink == UPLOAD_SINK_MQTT ? "MQTT" :
+                  uploadSink == UPLOAD_SINK_BINARY ? "binary" :
+                  uploadSink == UPLOAD_SINK_INFLUX_UDP ? "UDP" : "HTTP");
     Serial.printf("  Measurement: %s\n", influxMeasurement);
+    if (strlen(location) > 0) {
+        Serial.printf("  Location: %s\n", location);
+    }
     Serial.printf("  Time offset: %s\n", getTimeOffsetString().c_str());
+    if (strlen(otaUrl) > 0) {
+        Serial.printf("  Firmware updates: %s\n", otaUrl);
+    }
+    if (strlen(configPath) > 0) {
+        Serial.printf("  Remote config: %s (version %u)\n", configPath, (unsigned int)configVersion);
+    }
 #endif
 }
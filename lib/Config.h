@@ -7,8 +7,29 @@
 #include <Arduino.h>
 #endif
 
-#define CONFIG_MAGIC 0xABCD1234
+#define CONFIG_MAGIC 0xABCD1234         // Loaded config is valid; also ends a version 1 image
+#define CONFIG_STORE_MAGIC 0x4746434D   // "MCFG", starts a versioned image
+#define CONFIG_VERSION 4                // Format written by this firmware
+#define CONFIG_VERSION_LEGACY 1         // Raw dump of the class, before versioning
+
+// EEPROM layout: config image, then the record area (see RecordStore).
+// The gap after the current image leaves room for new config fields.
 #define CONFIG_ADDR 0
+#define ROM_DATA_START 640
+#define MAX_ROM_RECORDS 864   // Fills the rest of the 4 KB EEPROM
+
+// InfluxDB write API flavour
+#define INFLUX_API_V1 1   // /write with db, user, pass
+#define INFLUX_API_V2 2   // /api/v2/write with org, bucket, token
+
+// Upload backend (all but BINARY carry line protocol)
+#define UPLOAD_SINK_INFLUX_HTTP 0
+#define UPLOAD_SINK_INFLUX_UDP 1
+#define UPLOAD_SINK_MQTT 2
+#define UPLOAD_SINK_BINARY 3   // meteo-ingest service, see BinaryProtocol.h
+
+#define CONFIG_MIN_INTERVAL 60       // Seconds between measurements
+#define CONFIG_MAX_INTERVAL 65535    // Most the uint16_t field holds (~18 h)
 
 class Config {
 public:
@@ -21,20 +42,44 @@ public:
     char influxUser[32];
     char influxPass[64];
     char influxMeasurement[32];
+    uint8_t influxVersion;
+    uint8_t uploadSink;
+    char influxOrg[32];
+    char influxBucket[32];
+    char influxToken[96];
+    char location[16];      // Optional "location" tag value
     uint32_t timeOffset;
+    char otaUrl[96];        // Optional firmware update URL, checked after each upload
+    char configPath[12];    // Optional remote config document on the upload server
+    uint16_t configVersion; // Version of the last remote config applied
     uint32_t magic;
     
     Config();
     
+    // Single pass over the stored image; a version 1 image is migrated
+    // and written back once
     bool load();
-    void save();
+    // Writes only if the stored image differs. Fields stored by newer
+    // firmware are kept, so going back and forth loses nothing.
+    // CONFIG_VERSION_LEGACY writes the image older firmware expects.
+    bool save(uint8_t version = CONFIG_VERSION);
     bool isValid() const;
     void setDefaults();
+    
+    // Checks settings entered in config mode; returns what is wrong
+    // with them, or nullptr if they are usable
+    const char* validate() const;
+    // Same stored settings, ignoring the validity marker
+    bool sameSettings(const Config& other) const;
     void print() const;
     
     // Time offset management
     void updateTimeOffset(uint32_t currentTime);
     String getTimeOffsetString() const;
+    
+private:
+    bool upgradeLegacy(const uint8_t* image);
+    void downgradeLegacy(uint8_t* image) const;
 };
 
 #endif
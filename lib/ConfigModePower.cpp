@@ -0,0 +1,75 @@
+#include "ConfigModePower.h"
+
+static const uint16_t POLL_MS[POWER_STATES] = { POWER_ACTIVE_POLL_MS, POWER_IDLE_POLL_MS, POWER_NO_CLIENT_POLL_MS };
+static const uint8_t CURRENT_MA[POWER_STATES] = { POWER_ACTIVE_MA, POWER_IDLE_MA, POWER_NO_CLIENT_MA };
+
+ConfigModePower::ConfigModePower() {
+    begin(0);
+}
+
+void ConfigModePower::begin(uint32_t now) {
+    start = now;
+    lastRequest = now;
+    lastUpdate = now;
+    state = POWER_NO_CLIENT;
+    requests = 0;
+    memset(stateMs, 0, sizeof(stateMs));
+}
+
+void ConfigModePower::noteRequest(uint32_t now) {
+    lastRequest = now;
+    requests++;
+}
+
+uint8_t ConfigModePower::update(uint32_t now, uint8_t stations) {
+    stateMs[state] += now - lastUpdate;
+    lastUpdate = now;
+    
+    if (requests > 0 && now - lastRequest < CONFIG_ACTIVE_MS) {
+        state = POWER_ACTIVE;
+    } else if (stations > 0) {
+        state = POWER_IDLE;
+    } else {
+        state = POWER_NO_CLIENT;
+    }
+    return state;
+}
+
+bool ConfigModePower::expired(uint32_t now) const {
+    return remaining(now) == 0;
+}
+
+uint32_t ConfigModePower::remaining(uint32_t now) const {
+    uint32_t idle = now - lastRequest;
+    uint32_t total = now - start;
+    if (idle >= CONFIG_IDLE_TIMEOUT_MS || total >= CONFIG_MAX_TIME_MS) {
+        return 0;
+    }
+    uint32_t idleLeft = CONFIG_IDLE_TIMEOUT_MS - idle;
+    uint32_t totalLeft = CONFIG_MAX_TIME_MS - total;
+    return idleLeft < totalLeft ? idleLeft : totalLeft;
+}
+
+uint8_t ConfigModePower::getState() const {
+    return state;
+}
+
+uint32_t ConfigModePower::pollDelay() const {
+    return POLL_MS[state];
+}
+
+uint32_t ConfigModePower::getRequests() const {
+    return requests;
+}
+
+uint32_t ConfigModePower::getStateMillis(uint8_t s) const {
+    return s < POWER_STATES ? stateMs[s] : 0;
+}
+
+float ConfigModePower::getChargeMah() const {
+    float mAms = 0;
+    for (uint8_t s = 0; s < POWER_STATES; s++) {
+        mAms += (float)stateMs[s] * CURRENT_MA[s];
+    }
+    return mAms / 3600000.0f;
+}
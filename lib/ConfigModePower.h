@@ -0,0 +1,65 @@
+#ifndef CONFIG_MODE_POWER_H
+#define CONFIG_MODE_POWER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#define CONFIG_IDLE_TIMEOUT_MS (5 * 60 * 1000UL)   // No request for this long: leave config mode
+#define CONFIG_MAX_TIME_MS (15 * 60 * 1000UL)      // Config mode never runs longer than this
+#define CONFIG_ACTIVE_MS 2000                      // A request keeps the portal responsive this long
+
+// Power states, with the poll interval and the nominal current of a
+// D1 mini running the soft AP in each
+#define POWER_ACTIVE 0       // Requests coming in: poll continuously
+#define POWER_IDLE 1         // A phone is associated but quiet
+#define POWER_NO_CLIENT 2    // Nobody associated
+#define POWER_STATES 3
+
+#define POWER_ACTIVE_POLL_MS 0
+#define POWER_IDLE_POLL_MS 20
+#define POWER_NO_CLIENT_POLL_MS 100
+
+#define POWER_ACTIVE_MA 80
+#define POWER_IDLE_MA 72
+#define POWER_NO_CLIENT_MA 70
+
+// Decides how hard the config portal runs and when it gives up. The soft
+// AP keeps the radio receiving, so the saving comes from the CPU idling
+// in delay() between polls and from not staying in config mode forever.
+// Time spent per state is counted for the status page.
+class ConfigModePower {
+private:
+    uint32_t start;
+    uint32_t lastRequest;
+    uint32_t lastUpdate;
+    uint8_t state;
+    uint32_t requests;
+    uint32_t stateMs[POWER_STATES];
+    
+public:
+    ConfigModePower();
+    
+    void begin(uint32_t now);
+    void noteRequest(uint32_t now);
+    
+    // Charges the time since the last update to the state it was spent
+    // in and picks the next state; returns it
+    uint8_t update(uint32_t now, uint8_t stations);
+    
+    // Idle timeout or time limit reached
+    bool expired(uint32_t now) const;
+    // Milliseconds until expired() turns true
+    uint32_t remaining(uint32_t now) const;
+    
+    uint8_t getState() const;
+    uint32_t pollDelay() const;
+    uint32_t getRequests() const;
+    uint32_t getStateMillis(uint8_t state) const;
+    // Estimated charge used in config mode so far, from the nominal currents
+    float getChargeMah() const;
+};
+
+#endif
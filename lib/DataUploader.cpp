@@ -1,44 +1,94 @@
 #include "DataUploader.h"
-#include <EEPROM.h>
-
-#define ROM_DATA_START 512
-#define MAX_ROM_RECORDS 896
+#include "UdpLineSink.h"
+#include "MqttLineSink.h"
+#include "BinaryUploadSink.h"
+#include "InfluxDBWrapper.h"
+#include "HostResolver.h"
+#include "RecordStore.h"
+#include "RemoteConfig.h"
+#include <time.h>
 
 DataUploader::DataUploader(Config* cfg, RTCData* rtc) 
-    : config(cfg), rtcData(rtc) {
+    : config(cfg), rtcData(rtc), sink(nullptr), validateFirst(false), lastErrorKind(UPLOAD_OK) {
+}
+
+DataUploader::~DataUploader() {
+    if (sink) {
+        delete sink;
+    }
+}
+
+UploadSink* DataUploader::createSink(uint8_t type) {
+    switch (type) {
+        case UPLOAD_SINK_INFLUX_UDP:
+            return new UdpLineSink();
+        case UPLOAD_SINK_MQTT:
+            return new MqttLineSink();
+        case UPLOAD_SINK_BINARY:
+            return new BinaryUploadSink();
+        case UPLOAD_SINK_INFLUX_HTTP:
+        default:
+            return new InfluxDBWrapper();
+    }
 }
 
 bool DataUploader::uploadAllData(float batteryVoltage) {
-    Serial.println("Uploading to InfluxDB...");
+    Serial.printf("Uploading data, session %u...\n", (unsigned int)rtcData->uploadSequence);
     Serial.printf("ROM records: %d, RAM records: %d\n", 
                   rtcData->romRecordCount, rtcData->recordCount);
     
-    if (!influxClient.begin(config)) {
-        Serial.println("Failed to initialize InfluxDB client");
+    // Server address from an earlier wake saves a DNS round trip
+    HostResolver::useCache(&rtcData->dnsCache, rtcData->clock + millis() / 1000);
+    
+    // Only the selected backend is allocated
+    if (sink) {
+        delete sink;
+    }
+    sink = createSink(config->uploadSink);
+    
+    lastErrorKind = UPLOAD_OK;
+    if (!sink || !sink->begin(config)) {
+        Serial.println("Failed to initialize upload backend");
         return false;
     }
     
-    if (!influxClient.validateConnection()) {
-        Serial.println("Failed to connect to InfluxDB");
+    if (validateFirst && !sink->validateConnection()) {
+        lastErrorKind = sink->getErrorKind();
+        Serial.println("Failed to connect to upload backend");
         return false;
     }
     
-    bool success = true;
+    // ROM records, RAM records, battery voltage. The first failed write
+    // ends the session: the rest would only be retried anyway.
+    bool success = uploadROMRecords() &&
+                   uploadRAMRecords() &&
+                   addBatteryReading(batteryVoltage);
     
-    // Upload ROM records
-    if (!uploadROMRecords()) {
+    // Finish the last batch and check every response
+    if (!sink->flush()) {
         success = false;
     }
     
-    // Upload RAM records
-    if (!uploadRAMRecords()) {
-        success = false;
+    // A server that rejected the points can still fix the settings that
+    // made it reject them; one that was never reached cannot
+    UploadError kind = success ? UPLOAD_OK : sink->getErrorKind();
+    if (strlen(config->configPath) > 0 && kind != UPLOAD_ERROR_DNS && kind != UPLOAD_ERROR_CONNECT &&
+        kind != UPLOAD_ERROR_NETWORK) {
+        checkRemoteConfig();
     }
+    sink->close();
     
-    // Upload battery voltage
-    addBatteryReading(batteryVoltage);
+    Serial.printf("DNS: %u lookups (%u ms), %u from cache\n",
+                  (unsigned int)HostResolver::getLookups(), (unsigned int)HostResolver::getLookupMs(),
+                  (unsigned int)HostResolver::getCacheHits());
     
-    if (success) {
+    if (!success) {
+        lastErrorKind = sink->getErrorKind();
+        Serial.printf("Upload failed (%s): %s\n", UploadSink::errorKindName(lastErrorKind),
+                      sink->getLastError().c_str());
+    } else {
+        // Only a confirmed session moves on to the next sequence number
+        rtcData->uploadSequence++;
         clearData();
         Serial.println("All data uploaded successfully!");
     }
@@ -46,36 +96,116 @@ bool DataUploader::uploadAllData(float batteryVoltage) {
     return success;
 }
 
-bool DataUploader::uploadROMRecords() {
-    for (uint16_t i = 0; i < rtcData->romRecordCount && i < MAX_ROM_RECORDS; i++) {
-        SensorRecord record;
-        EEPROM.get(ROM_DATA_START + i * sizeof(SensorRecord), record);
-        
-        if (!influxClient.writeSensorRecord(record, config->timeOffset)) {
-            Serial.printf("Failed to upload ROM record %d\n", i);
-            return false;
+// Runs on the upload connection before it is closed; failures here never
+// fail the upload, the next session simply asks again
+void DataUploader::checkRemoteConfig() {
+    char headers[96];
+    char document[REMOTE_CONFIG_MAX_SIZE];
+    int status = 0;
+    RemoteConfig::requestHeaders(headers, sizeof(headers), *config, sink->getDeviceId());
+    if (!sink->fetch(config->configPath, headers, document, sizeof(document), status)) {
+        return;
+    }
+    if (status == 304) {
+        return;
+    }
+    if (status != 200) {
+        Serial.printf("Remote config: HTTP status %d\n", status);
+        return;
+    }
+    
+    const char* error;
+    uint8_t result = RemoteConfig::apply(*config, document, error);
+    if (result == REMOTE_CONFIG_INVALID) {
+        Serial.printf("Remote config rejected: %s\n", error);
+    } else if (result == REMOTE_CONFIG_APPLIED) {
+        Serial.printf("Remote config version %u applied\n", (unsigned int)config->configVersion);
+        if (!config->save()) {
+            Serial.println("EEPROM commit failed!");
         }
     }
+}
+
+bool DataUploader::uploadROMRecords() {
+    // Read in place from the EEPROM cache, no per-record copies
+    uint16_t count = MAX_ROM_RECORDS;
+    const SensorRecord* records = RecordStore::span(*rtcData, 0, count);
+    if (count == 0) {
+        return true;
+    }
+    
+    if (!sink->writeSensorRecords(records, count, config->timeOffset)) {
+        Serial.println("Failed to upload ROM records");
+        return false;
+    }
     return true;
 }
 
 bool DataUploader::uploadRAMRecords() {
-    for (uint16_t i = 0; i < rtcData->recordCount; i++) {
-        if (!influxClient.writeSensorRecord(rtcData->buffer[i], config->timeOffset)) {
-            Serial.printf("Failed to upload RAM record %d\n", i);
-            return false;
-        }
+    // The RTC buffer is already contiguous
+    if (!sink->writeSensorRecords(rtcData->buffer, rtcData->recordCount, config->timeOffset)) {
+        Serial.println("Failed to upload RAM records");
+        return false;
     }
     return true;
 }
 
-void DataUploader::addBatteryReading(float voltage) {
-    influxClient.writeBatteryVoltage(voltage);
+// Timestamp of the newest record, for the session's battery point
+uint32_t DataUploader::sessionTimestamp() const {
+    // Channel slots carry no timestamp, skip back to their measurement
+    for (uint16_t i = rtcData->recordCount; i > 0; i--) {
+        if (!rtcData->buffer[i - 1].isChannelSlot()) {
+            return rtcData->buffer[i - 1].getTimestampSeconds(config->timeOffset);
+        }
+    }
+    
+    uint16_t count = MAX_ROM_RECORDS;
+    const SensorRecord* records = RecordStore::span(*rtcData, 0, count);
+    for (uint16_t i = count; i > 0; i--) {
+        if (!records[i - 1].isChannelSlot()) {
+            return records[i - 1].getTimestampSeconds(config->timeOffset);
+        }
+    }
+    
+    // Nothing buffered: whole minutes, like the records
+    return ((uint32_t)time(nullptr) / 60) * 60;
+}
+
+// Retries happen on timer wakes, after a new measurement and with a new
+// voltage reading, so the battery point is fixed by the first attempt
+// and resent unchanged until the session is confirmed
+bool DataUploader::addBatteryReading(float voltage) {
+    if (rtcData->sessionTime == 0) {
+        rtcData->sessionTime = sessionTimestamp();
+        rtcData->sessionMillivolts = voltage > 0 ? (uint16_t)(voltage * 1000 + 0.5f) : 0;
+        rtcData->save();
+    }
+    return sink->writeBatteryVoltage(rtcData->sessionMillivolts / 1000.0f, rtcData->uploadSequence,
+                                     rtcData->sessionTime);
 }
 
 void DataUploader::clearData() {
-    rtcData->romWriteIndex = 0;
-    rtcData->romRecordCount = 0;
+    RecordStore::clear(*rtcData);
     rtcData->clearBuffer();
+    rtcData->sessionTime = 0;
     rtcData->save();
+    
+    // Stored records are minutes since timeOffset. Moving it while any are
+    // pending would shift them by 65536 s on the retry, so it only follows
+    // the clock once they are gone.
+    uint32_t now = time(nullptr);
+    if (now > 1000000000) {
+        config->updateTimeOffset(now);
+        if (!config->save()) {
+            Serial.println("EEPROM commit failed!");
+        }
+    }
+}
+
+void DataUploader::setValidateConnection(bool enabled) {
+    validateFirst = enabled;
+}
+
+UploadError DataUploader::getLastErrorKind() const {
+    return lastErrorKind;
 }
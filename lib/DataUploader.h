@@ -1,26 +1,49 @@
 #ifndef DATA_UPLOADER_H
 #define DATA_UPLOADER_H
 
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
 #include <Arduino.h>
+#endif
+
 #include "Config.h"
 #include "RTCData.h"
-#include "InfluxDBWrapper.h"
+#include "UploadSink.h"
 
 class DataUploader {
 private:
     Config* config;
     RTCData* rtcData;
-    InfluxDBWrapper influxClient;
+    UploadSink* sink;   // Backend selected by config->uploadSink
+    bool validateFirst;
+    UploadError lastErrorKind;
+    
+    static UploadSink* createSink(uint8_t type);
     
     bool uploadROMRecords();
     bool uploadRAMRecords();
-    void addBatteryReading(float voltage);
+    uint32_t sessionTimestamp() const;
+    bool addBatteryReading(float voltage);
+    void checkRemoteConfig();
     
 public:
     DataUploader(Config* cfg, RTCData* rtc);
+    ~DataUploader();
     
+    // One upload session. Retrying after a failure re-sends the same
+    // points with the same timestamps and session sequence number, so
+    // the receiver overwrites instead of duplicating them.
     bool uploadAllData(float batteryVoltage);
+    // Drops all stored records and rebases the time offset to the clock
     void clearData();
+    
+    // Check the backend before writing (default off: the first write
+    // response already tells whether the server is usable)
+    void setValidateConnection(bool enabled);
+    
+    // Cause of the last failed session
+    UploadError getLastErrorKind() const;
 };
 
 #endif
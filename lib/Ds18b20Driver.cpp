@@ -0,0 +1,66 @@
+#include "Ds18b20Driver.h"
+
+#define DS18B20_SKIP_ROM 0xCC
+#define DS18B20_CONVERT 0x44
+#define DS18B20_WRITE_SCRATCHPAD 0x4E
+#define DS18B20_READ_SCRATCHPAD 0xBE
+#define DS18B20_CONFIG_10_BIT 0x3F
+#define DS18B20_POWER_ON_VALUE 0x0550   // 85 °C, read when no conversion ran
+
+Ds18b20Driver::Ds18b20Driver(uint8_t pin) : bus(pin) {
+}
+
+const char* Ds18b20Driver::name() const {
+    return "DS18B20";
+}
+
+uint8_t Ds18b20Driver::channels() const {
+    return SENSOR_PROBE_TEMPERATURE;
+}
+
+uint16_t Ds18b20Driver::powerUpMs() const {
+    return 2;
+}
+
+bool Ds18b20Driver::start() {
+    if (!bus.reset()) {
+        return false;   // No presence pulse
+    }
+    // The resolution is back at its EEPROM default after every power-up
+    bus.write(DS18B20_SKIP_ROM);
+    bus.write(DS18B20_WRITE_SCRATCHPAD);
+    bus.write(0);   // Alarm thresholds, unused
+    bus.write(0);
+    bus.write(DS18B20_CONFIG_10_BIT);
+    
+    bus.reset();
+    bus.write(DS18B20_SKIP_ROM);
+    bus.write(DS18B20_CONVERT);
+    return true;
+}
+
+uint16_t Ds18b20Driver::conversionMs() const {
+    return 188;
+}
+
+bool Ds18b20Driver::read(Measurement& measurement) {
+    uint8_t scratchpad[9];
+    if (!bus.reset()) {
+        return false;
+    }
+    bus.write(DS18B20_SKIP_ROM);
+    bus.write(DS18B20_READ_SCRATCHPAD);
+    bus.read_bytes(scratchpad, sizeof(scratchpad));
+    if (OneWire::crc8(scratchpad, 8) != scratchpad[8]) {
+        Serial.println("DS18B20 CRC mismatch");
+        return false;
+    }
+    
+    // Undefined low bits at 10-bit resolution
+    int16_t raw = (int16_t)(((uint16_t)scratchpad[1] << 8) | scratchpad[0]) & ~0x3;
+    if (raw == DS18B20_POWER_ON_VALUE) {
+        return false;
+    }
+    measurement.set(SENSOR_PROBE_TEMPERATURE, raw / 16.0f);
+    return true;
+}
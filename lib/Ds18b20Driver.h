@@ -0,0 +1,28 @@
+#ifndef DS18B20_DRIVER_H
+#define DS18B20_DRIVER_H
+
+#include <Arduino.h>
+#include <OneWire.h>
+#include "SensorDriver.h"
+
+// Maxim DS18B20 waterproof probe, the only device on its 1-Wire pin and
+// powered (not parasitic) from the switched sensor supply. 10-bit
+// resolution (0.25 °C) converts in 188 ms instead of 750 ms at 12 bits.
+// Reports SENSOR_PROBE_TEMPERATURE; SensorManager uses it as the
+// station temperature when nothing else measures one.
+class Ds18b20Driver : public SensorDriver {
+public:
+    explicit Ds18b20Driver(uint8_t pin);
+    
+    const char* name() const;
+    uint8_t channels() const;
+    uint16_t powerUpMs() const;
+    bool start();
+    uint16_t conversionMs() const;
+    bool read(Measurement& measurement);
+    
+private:
+    OneWire bus;
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "FirmwarePatcher.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STATE_START 0
+#define STATE_IMAGE 1       // Plain image, passed through
+#define STATE_HEADER 2      // Collecting the delta header
+#define STATE_OPERATION 3   // Collecting an operation header
+#define STATE_DATA 4        // Inside a DATA operation
+#define STATE_FAILED 5
+
+#define COPY_BLOCK 256      // Base bytes read at a time
+
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+FirmwarePatcher::FirmwarePatcher(FirmwareTarget& target) : target(target) {
+    uint8_t none[SHA256_SIZE] = { 0 };
+    begin(0, none);
+}
+
+void FirmwarePatcher::begin(uint32_t l, const uint8_t sha256[SHA256_SIZE]) {
+    sha.reset();
+    memcpy(expected, sha256, SHA256_SIZE);
+    length = l;
+    state = STATE_START;
+    started = false;
+    delta = false;
+    pendingLength = 0;
+    imageSize = 0;
+    imageBytes = 0;
+    dataLeft = 0;
+    error[0] = '\0';
+}
+
+bool FirmwarePatcher::write(const uint8_t* data, size_t count) {
+    while (count > 0) {
+        switch (state) {
+        case STATE_START:
+            if (data[0] == FIRMWARE_IMAGE_MAGIC) {
+                if (!startImage(length)) {
+                    return false;
+                }
+                state = STATE_IMAGE;
+            } else if (data[0] == 'M') {
+                delta = true;
+                state = STATE_HEADER;
+            } else {
+                return fail("Not a firmware image");
+            }
+            break;
+            
+        case STATE_IMAGE:
+            return output(data, count);
+            
+        case STATE_HEADER:
+        case STATE_OPERATION: {
+            // Operation headers are 9 (COPY) or 5 (DATA) bytes; the
+            // type byte tells which
+            size_t want = state == STATE_HEADER ? FIRMWARE_DELTA_HEADER_SIZE :
+                          pendingLength == 0 ? 1 : pending[0] == FIRMWARE_DELTA_COPY ? 9 : 5;
+            size_t n = want - pendingLength < count ? want - pendingLength : count;
+            memcpy(pending + pendingLength, data, n);
+            pendingLength += n;
+            data += n;
+            count -= n;
+            if (pendingLength == want && want > 1) {
+                bool ok = state == STATE_HEADER ? parseHeader() : runOperation();
+                if (!ok) {
+                    return false;
+                }
+                pendingLength = 0;
+            }
+            break;
+        }
+            
+        case STATE_DATA: {
+            size_t n = dataLeft < count ? dataLeft : count;
+            if (!output(data, n)) {
+                return false;
+            }
+            data += n;
+            count -= n;
+            dataLeft -= n;
+            if (dataLeft == 0) {
+                state = STATE_OPERATION;
+            }
+            break;
+        }
+            
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FirmwarePatcher::startImage(uint32_t size) {
+    if (size == 0) {
+        return fail("Image size unknown");
+    }
+    if (!target.begin(size)) {
+        return fail("No room for the new image");
+    }
+    started = true;
+    imageSize = size;
+    return true;
+}
+
+bool FirmwarePatcher::parseHeader() {
+    if (pending[0] != 'M' || pending[1] != 'D' || pending[2] != FIRMWARE_DELTA_VERSION) {
+        return fail("Unknown delta format");
+    }
+    uint8_t md5[FIRMWARE_MD5_SIZE];
+    target.baseMd5(md5);
+    if (memcmp(pending + 4, md5, FIRMWARE_MD5_SIZE) != 0 || getU32(pending + 20) != target.baseSize()) {
+        return fail("Delta is for another image");
+    }
+    if (!startImage(getU32(pending + 24))) {
+        return false;
+    }
+    state = STATE_OPERATION;
+    return true;
+}
+
+bool FirmwarePatcher::runOperation() {
+    uint32_t first = getU32(pending + 1);
+    if (pending[0] == FIRMWARE_DELTA_COPY) {
+        uint32_t count = getU32(pending + 5);
+        if (first > target.baseSize() || count > target.baseSize() - first) {
+            return fail("Copy outside the base image");
+        }
+        return copyBase(first, count);
+    }
+    if (pending[0] != FIRMWARE_DELTA_DATA) {
+        return fail("Unknown delta operation");
+    }
+    if (first > imageSize - imageBytes) {
+        return fail("Delta overruns the image");
+    }
+    dataLeft = first;
+    if (dataLeft > 0) {
+        state = STATE_DATA;
+    }
+    return true;
+}
+
+bool FirmwarePatcher::copyBase(uint32_t offset, uint32_t count) {
+    uint8_t block[COPY_BLOCK];
+    while (count > 0) {
+        size_t n = count < COPY_BLOCK ? count : COPY_BLOCK;
+        if (!target.readBase(offset, block, n)) {
+            return fail("Reading the running image failed");
+        }
+        if (!output(block, n)) {
+            return false;
+        }
+        offset += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool FirmwarePatcher::output(const uint8_t* data, size_t count) {
+    if (count > imageSize - imageBytes) {
+        return fail("Delta overruns the image");
+    }
+    if (!target.write(data, count)) {
+        return fail("Flash write failed");
+    }
+    sha.update(data, count);
+    imageBytes += count;
+    return true;
+}
+
+bool FirmwarePatcher::end() {
+    if (state == STATE_FAILED) {
+        abort();
+        return false;
+    }
+    if (!started || imageBytes < imageSize || pendingLength > 0 || dataLeft > 0) {
+        fail("Download incomplete");
+        abort();
+        return false;
+    }
+    
+    uint8_t digest[SHA256_SIZE];
+    sha.finish(digest);
+    if (memcmp(digest, expected, SHA256_SIZE) != 0) {
+        fail("SHA-256 mismatch");
+        abort();
+        return false;
+    }
+    if (!target.finish()) {
+        fail("Finishing the update failed");
+        return false;
+    }
+    return true;
+}
+
+void FirmwarePatcher::abort() {
+    if (started) {
+        target.abort();
+        started = false;
+    }
+}
+
+bool FirmwarePatcher::fail(const char* message) {
+    if (state != STATE_FAILED) {
+        snprintf(error, sizeof(error), "%s", message);
+        state = STATE_FAILED;
+    }
+    return false;
+}
+
+bool FirmwarePatcher::isDelta() const {
+    return delta;
+}
+
+uint32_t FirmwarePatcher::getImageSize() const {
+    return imageSize;
+}
+
+uint32_t FirmwarePatcher::getImageBytes() const {
+    return imageBytes;
+}
+
+const char* FirmwarePatcher::getError() const {
+    return error;
+}
@@ -0,0 +1,95 @@
+#ifndef FIRMWARE_PATCHER_H
+#define FIRMWARE_PATCHER_H
+
+// Turns a downloaded update into the new firmware image, piece by piece
+// as it arrives. Plain C++ - no Arduino headers.
+//
+// The download is either a complete image (starts with 0xE9, like every
+// ESP8266 image) or a delta against the running image (little endian):
+//
+//   0  'M' 'D'      magic
+//   2  version      FIRMWARE_DELTA_VERSION
+//   3  reserved
+//   4  baseMd5[16]  MD5 of the image the delta applies to
+//   20 baseSize     uint32
+//   24 imageSize    uint32, size of the new image
+//   28 operations until imageSize bytes are produced:
+//        FIRMWARE_DELTA_COPY, uint32 offset, uint32 length   bytes of the base
+//        FIRMWARE_DELTA_DATA, uint32 length, then the bytes  new bytes
+//
+// A new build mostly moves code around, so COPY covers most of the image
+// and the download shrinks to the changed parts. tools/ota builds deltas.
+// Either way the new image must match the SHA-256 the server announced.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Sha256.h"
+
+#define FIRMWARE_IMAGE_MAGIC 0xE9
+#define FIRMWARE_DELTA_VERSION 1
+#define FIRMWARE_DELTA_HEADER_SIZE 28
+#define FIRMWARE_DELTA_COPY 1
+#define FIRMWARE_DELTA_DATA 2
+#define FIRMWARE_MD5_SIZE 16
+
+// Where the new image goes. The device writes it to flash through the
+// Updater (FlashFirmwareTarget); tests keep it in memory.
+class FirmwareTarget {
+public:
+    virtual ~FirmwareTarget() {}
+    
+    // The running image, base of a delta
+    virtual uint32_t baseSize() = 0;
+    virtual void baseMd5(uint8_t md5[FIRMWARE_MD5_SIZE]) = 0;
+    virtual bool readBase(uint32_t offset, uint8_t* buf, size_t length) = 0;
+    
+    virtual bool begin(uint32_t size) = 0;
+    virtual bool write(const uint8_t* data, size_t length) = 0;
+    // Boot the new image after the next restart
+    virtual bool finish() = 0;
+    // Throw away what was written; the running image stays
+    virtual void abort() = 0;
+};
+
+class FirmwarePatcher {
+public:
+    explicit FirmwarePatcher(FirmwareTarget& target);
+    
+    // 'length' is the download size, 'sha256' the digest of the new image
+    void begin(uint32_t length, const uint8_t sha256[SHA256_SIZE]);
+    bool write(const uint8_t* data, size_t length);
+    // Finishes the target if the image is complete and its digest
+    // matches; otherwise aborts it
+    bool end();
+    void abort();
+    
+    bool isDelta() const;
+    uint32_t getImageSize() const;
+    uint32_t getImageBytes() const;
+    const char* getError() const;
+    
+private:
+    FirmwareTarget& target;
+    Sha256 sha;
+    uint8_t expected[SHA256_SIZE];
+    uint32_t length;
+    uint8_t state;
+    bool started;             // target.begin() succeeded
+    bool delta;
+    uint8_t pending[FIRMWARE_DELTA_HEADER_SIZE];
+    size_t pendingLength;
+    uint32_t imageSize;
+    uint32_t imageBytes;
+    uint32_t dataLeft;        // Bytes left in the current DATA operation
+    char error[48];
+    
+    bool startImage(uint32_t size);
+    bool parseHeader();
+    bool runOperation();
+    bool copyBase(uint32_t offset, uint32_t count);
+    bool output(const uint8_t* data, size_t count);
+    bool fail(const char* message);
+};
+
+#endif
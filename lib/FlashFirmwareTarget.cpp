@@ -0,0 +1,79 @@
+#include "FlashFirmwareTarget.h"
+#include <Updater.h>
+
+#define FLASH_READ_WORDS 64   // flashRead() wants word-aligned reads
+
+FlashFirmwareTarget::FlashFirmwareTarget() : size(0), written(0), lastByte(0) {
+}
+
+// The running image starts at flash offset 0, like the .bin it came from
+uint32_t FlashFirmwareTarget::baseSize() {
+    return ESP.getSketchSize();
+}
+
+void FlashFirmwareTarget::baseMd5(uint8_t md5[FIRMWARE_MD5_SIZE]) {
+    String hex = ESP.getSketchMD5();
+    memset(md5, 0, FIRMWARE_MD5_SIZE);
+    for (int i = 0; i < FIRMWARE_MD5_SIZE && (size_t)(2 * i + 1) < hex.length(); i++) {
+        char pair[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        md5[i] = (uint8_t)strtoul(pair, nullptr, 16);
+    }
+}
+
+bool FlashFirmwareTarget::readBase(uint32_t offset, uint8_t* buf, size_t length) {
+    uint32_t words[FLASH_READ_WORDS];
+    while (length > 0) {
+        uint32_t aligned = offset & ~3UL;
+        uint32_t skip = offset - aligned;
+        size_t n = sizeof(words) - skip < length ? sizeof(words) - skip : length;
+        if (!ESP.flashRead(aligned, words, (skip + n + 3) & ~3UL)) {
+            return false;
+        }
+        memcpy(buf, (const uint8_t*)words + skip, n);
+        buf += n;
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool FlashFirmwareTarget::begin(uint32_t imageSize) {
+    size = imageSize;
+    written = 0;
+    if (!Update.begin(size, U_FLASH)) {
+        Serial.printf("Update.begin failed: %s\n", Update.getErrorString().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool FlashFirmwareTarget::write(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    if (written + length > size) {
+        return false;
+    }
+    written += length;
+    if (written == size) {
+        lastByte = data[length - 1];
+        length--;
+    }
+    return length == 0 || Update.write(const_cast<uint8_t*>(data), length) == length;
+}
+
+bool FlashFirmwareTarget::finish() {
+    if (written != size || Update.write(&lastByte, 1) != 1) {
+        return false;
+    }
+    if (!Update.end()) {
+        Serial.printf("Update.end failed: %s\n", Update.getErrorString().c_str());
+        return false;
+    }
+    return true;
+}
+
+void FlashFirmwareTarget::abort() {
+    // Never complete, so this only resets the Updater
+    Update.end(false);
+}
@@ -0,0 +1,30 @@
+#ifndef FLASH_FIRMWARE_TARGET_H
+#define FLASH_FIRMWARE_TARGET_H
+
+#include <Arduino.h>
+#include "FirmwarePatcher.h"
+
+// Writes an update into the free flash area through the core's Updater
+// and reads the running image for deltas. The last byte is held back
+// until finish(): Updater::end() accepts a completely written image, so
+// an image that failed the hash check must never be complete.
+class FlashFirmwareTarget : public FirmwareTarget {
+public:
+    FlashFirmwareTarget();
+    
+    uint32_t baseSize();
+    void baseMd5(uint8_t md5[FIRMWARE_MD5_SIZE]);
+    bool readBase(uint32_t offset, uint8_t* buf, size_t length);
+    
+    bool begin(uint32_t size);
+    bool write(const uint8_t* data, size_t length);
+    bool finish();
+    void abort();
+    
+private:
+    uint32_t size;
+    uint32_t written;
+    uint8_t lastByte;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "HostResolver.h"
+
+DnsCache* HostResolver::cache = nullptr;
+uint32_t HostResolver::now = 0;
+uint16_t HostResolver::lookups = 0;
+uint16_t HostResolver::cacheHits = 0;
+uint32_t HostResolver::lookupMs = 0;
+
+void HostResolver::useCache(DnsCache* c, uint32_t n) {
+    cache = c;
+    now = n;
+    lookups = 0;
+    cacheHits = 0;
+    lookupMs = 0;
+}
+
+bool HostResolver::resolve(const char* host, IPAddress& address, bool remember) {
+    if (address.fromString(host)) {
+        return true;
+    }
+    
+    uint32_t key = hash(host);
+    if (cache && cache->hostHash == key && now - cache->resolvedAt < DNS_CACHE_TTL) {
+        address = IPAddress(cache->address[0], cache->address[1], 
+                            cache->address[2], cache->address[3]);
+        cacheHits++;
+        return true;
+    }
+    
+    unsigned long start = millis();
+    bool found = WiFi.hostByName(host, address) == 1;
+    lookupMs += millis() - start;
+    lookups++;
+    
+    if (found && remember && cache) {
+        cache->hostHash = key;
+        for (int i = 0; i < 4; i++) {
+            cache->address[i] = address[i];
+        }
+        cache->resolvedAt = now;
+    }
+    return found;
+}
+
+bool HostResolver::invalidate(const char* host) {
+    if (!cache || cache->hostHash == 0 || cache->hostHash != hash(host)) {
+        return false;
+    }
+    // Looked up during this wake already: asking again will not help
+    bool stale = cache->resolvedAt != now;
+    cache->hostHash = 0;
+    return stale;
+}
+
+uint16_t HostResolver::getLookups() {
+    return lookups;
+}
+
+uint16_t HostResolver::getCacheHits() {
+    return cacheHits;
+}
+
+uint32_t HostResolver::getLookupMs() {
+    return lookupMs;
+}
+
+// FNV-1a; never 0 so 0 can mark an empty cache
+uint32_t HostResolver::hash(const char* host) {
+    uint32_t h = 2166136261UL;
+    for (const char* p = host; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619UL;
+    }
+    return h ? h : 1;
+}
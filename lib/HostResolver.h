@@ -0,0 +1,54 @@
+#ifndef HOST_RESOLVER_H
+#define HOST_RESOLVER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/ESP8266WiFi.h"
+#else
+#include <ESP8266WiFi.h>
+#endif
+
+#define DNS_CACHE_TTL 21600   // Seconds a cached address is trusted (6 hours)
+
+// Last resolved upload server, kept in RTC memory. Only a hash of the
+// name is stored; a changed server name simply misses the cache.
+struct DnsCache {
+    uint32_t hostHash;      // 0 = empty
+    uint8_t address[4];
+    uint32_t resolvedAt;    // RTCData::clock at lookup time
+};
+
+// Name lookup for the upload server, kept apart from connect() so a
+// DNS failure can be told from an unreachable server
+class HostResolver {
+public:
+    // Serve names from 'cache' while younger than DNS_CACHE_TTL.
+    // 'now' is on the same clock as DnsCache::resolvedAt.
+    // Without a cache every call does a lookup.
+    static void useCache(DnsCache* cache, uint32_t now);
+    
+    // IP literals are parsed without a DNS query. The cache holds one
+    // entry, meant for the upload server: other hosts pass remember =
+    // false so their answer does not evict it.
+    static bool resolve(const char* host, IPAddress& address, bool remember = true);
+    
+    // Forget the cached address of 'host' after it failed to connect.
+    // True if it came from an earlier wake, so a fresh lookup may help.
+    static bool invalidate(const char* host);
+    
+    // Lookups that went to DNS, answers from the cache and time spent
+    // waiting for DNS since useCache()
+    static uint16_t getLookups();
+    static uint16_t getCacheHits();
+    static uint32_t getLookupMs();
+    
+private:
+    static DnsCache* cache;
+    static uint32_t now;
+    static uint16_t lookups;
+    static uint16_t cacheHits;
+    static uint32_t lookupMs;
+    
+    static uint32_t hash(const char* host);
+};
+
+#endif
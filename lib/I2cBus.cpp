@@ -0,0 +1,16 @@
+#include "I2cBus.h"
+
+bool I2cBus::readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t length) {
+    return write(address, &reg, 1, false) && read(address, data, length);
+}
+
+uint8_t I2cBus::crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,30 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+// Raw I2C transactions for the sensor drivers. WireBus runs them on the
+// hardware; native tests replay recorded byte streams (I2cStubBus).
+class I2cBus {
+public:
+    virtual ~I2cBus() {}
+    
+    // False if the device does not acknowledge. stop = false ends with a
+    // repeated start, for register reads.
+    virtual bool write(uint8_t address, const uint8_t* data, size_t length, bool stop = true) = 0;
+    
+    // False unless all 'length' bytes arrived
+    virtual bool read(uint8_t address, uint8_t* data, size_t length) = 0;
+    
+    // write(reg) with a repeated start, then read()
+    bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t length);
+    
+    // CRC-8 of Sensirion and Aosong sensors: polynomial 0x31, init 0xFF
+    static uint8_t crc8(const uint8_t* data, size_t length);
+};
+
+#endif
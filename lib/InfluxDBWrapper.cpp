@@ -1,15 +1,14 @@
 #include "InfluxDBWrapper.h"
 
-InfluxDBWrapper::InfluxDBWrapper() : client(nullptr), sensorPoint(nullptr), config(nullptr), initialized(false) {
+InfluxDBWrapper::InfluxDBWrapper() 
+    : initialized(false), requestedPrecision(PRECISION_M), 
+      writer(wifiClient), batchSize(64), batchPoints(0), sessionPoints(0),
+      firstBatchSent(false) {
+    precision = PRECISION_M;
 }
 
 InfluxDBWrapper::~InfluxDBWrapper() {
-    if (sensorPoint) {
-        delete sensorPoint;
-    }
-    if (client) {
-        delete client;
-    }
+    writer.stop();
 }
 
 bool InfluxDBWrapper::begin(Config* cfg) {
@@ -20,103 +19,147 @@ bool InfluxDBWrapper::begin(Config* cfg) {
         return false;
     }
     
-    // Create InfluxDB client instance
-    String serverUrl = "http://" + String(config->influxServer) + ":" + String(config->influxPort);
-    
-    client = new InfluxDBClient(serverUrl.c_str(), config->influxDb);
-    
-    // Set authentication if provided
-    if (strlen(config->influxUser) > 0) {
-        client->setConnectionParams(serverUrl.c_str(), config->influxDb, 
-                                    config->influxUser, config->influxPass);
+    if (!prepareSeries()) {
+        Serial.println("Measurement and tags too long");
+        return false;
     }
     
-    // Create point for sensor data
-    sensorPoint = new Point(config->influxMeasurement);
+    precision = writer.configure(*config, requestedPrecision);
+    writer.beginSession();
+    batchPoints = 0;
+    sessionPoints = 0;
+    firstBatchSent = false;
+    lastError = "";
+    lastErrorKind = UPLOAD_OK;
     
     initialized = true;
     
-    Serial.printf("InfluxDB client initialized: %s\n", serverUrl.c_str());
+    Serial.printf("InfluxDB client initialized: http://%s:%u\n", config->influxServer,
+                  (unsigned int)config->influxPort);
     return true;
 }
 
+void InfluxDBWrapper::setPrecision(TimePrecision p) {
+    requestedPrecision = p;
+    precision = p;
+    if (initialized) {
+        precision = writer.configure(*config, requestedPrecision);
+    }
+}
+
 bool InfluxDBWrapper::validateConnection() {
-    if (!initialized || !client) {
+    if (!initialized) {
         return false;
     }
     
-    if (client->validateConnection()) {
-        Serial.print("Connected to InfluxDB: ");
-        Serial.println(client->getServerUrl());
-        return true;
-    } else {
-        Serial.print("InfluxDB connection failed: ");
-        Serial.println(client->getLastErrorMessage());
+    if (!writer.ping()) {
+        lastError = writer.getError();
+        lastErrorKind = writer.getErrorKind();
+        Serial.printf("InfluxDB connection failed: %s\n", writer.getError());
         return false;
     }
+    Serial.printf("Connected to InfluxDB: %s:%u\n", config->influxServer, (unsigned int)config->influxPort);
+    return true;
 }
 
-bool InfluxDBWrapper::writeSensorRecord(const SensorRecord& record, uint32_t timeOffset) {
-    if (!initialized || !client || !sensorPoint) {
+bool InfluxDBWrapper::writeLine(const char* line, size_t length) {
+    if (!initialized) {
         return false;
     }
     
-    // Clear previous data
-    sensorPoint->clearFields();
-    sensorPoint->clearTags();
-    
-    // Add fields
-    sensorPoint->addField("temperature", record.getTemperature());
-    sensorPoint->addField("humidity", record.getHumidity());
-    
-    // Set timestamp (in seconds, InfluxDB wants nanoseconds)
-    uint32_t timestampSeconds = record.getTimestampSeconds(timeOffset);
-    sensorPoint->setTime(timestampSeconds);
-    
-    // Write to InfluxDB
-    if (!client->writePoint(*sensorPoint)) {
-        Serial.print("InfluxDB write failed: ");
-        Serial.println(client->getLastErrorMessage());
+    if (!writer.begin() || !writer.write(line, length)) {
+        lastError = writer.getError();
+        lastErrorKind = writer.getErrorKind();
         return false;
     }
     
+    batchPoints++;
+    sessionPoints++;
+    
+    // Full batch: send it and start the next one without waiting.
+    // Only the first batch waits for its response, so a bad token or
+    // database stops the session before the rest is streamed.
+    if (batchPoints >= batchSize) {
+        batchPoints = 0;
+        bool wait = !firstBatchSent;
+        firstBatchSent = true;
+        if (!writer.end(wait)) {
+            lastError = writer.getError();
+            lastErrorKind = writer.getErrorKind();
+            return false;
+        }
+    }
     return true;
 }
 
-bool InfluxDBWrapper::writeBatteryVoltage(float voltage) {
-    if (!initialized || !client || !sensorPoint) {
+bool InfluxDBWrapper::flush() {
+    if (!initialized) {
         return false;
     }
     
-    sensorPoint->clearFields();
-    sensorPoint->clearTags();
+    bool success = lastError.length() == 0;
     
-    sensorPoint->addField("battery_voltage", voltage);
-    sensorPoint->setTime(WritePrecision::S);
+    if (writer.isRequestOpen() && !writer.end(false)) {
+        success = false;
+    }
+    if (!writer.collectResponses()) {
+        success = false;
+    }
     
-    if (!client->writePoint(*sensorPoint)) {
-        Serial.print("InfluxDB battery write failed: ");
-        Serial.println(client->getLastErrorMessage());
-        return false;
+    if (success) {
+        Serial.printf("InfluxDB wrote %u points in %u requests over %u connections\n", 
+                      (unsigned int)sessionPoints, (unsigned int)writer.getRequestsSent(),
+                      (unsigned int)writer.getConnectionsOpened());
+    } else if (lastError.length() == 0) {
+        lastError = writer.getError();
+        lastErrorKind = writer.getErrorKind();
     }
     
-    return true;
+    batchPoints = 0;
+    sessionPoints = 0;
+    return success;
 }
 
-bool InfluxDBWrapper::flush() {
-    if (!initialized || !client) {
+void InfluxDBWrapper::close() {
+    writer.stop();
+}
+
+bool InfluxDBWrapper::fetch(const char* path, const char* headers, char* body, size_t size, int& status) {
+    if (!initialized) {
         return false;
     }
-    
-    // The library handles buffering internally
-    // This is a placeholder for future batch operations
+    if (!writer.get(path, headers, body, size)) {
+        Serial.printf("GET %s failed: %s\n", path, writer.getError());
+        return false;
+    }
+    status = writer.getStatus();
     return true;
 }
 
+void InfluxDBWrapper::setBatchSize(uint16_t points) {
+    batchSize = points > 0 ? points : 1;
+}
+
+uint16_t InfluxDBWrapper::pendingPoints() const {
+    return sessionPoints;
+}
+
+uint16_t InfluxDBWrapper::getConnectionsOpened() const {
+    return writer.getConnectionsOpened();
+}
+
+uint16_t InfluxDBWrapper::getRequestsSent() const {
+    return writer.getRequestsSent();
+}
+
 String InfluxDBWrapper::getLastError() const {
-    if (!initialized || !client) {
+    if (!initialized) {
         return "Client not initialized";
     }
     
-    return client->getLastErrorMessage();
+    if (lastError.length() > 0) {
+        return lastError;
+    }
+    
+    return writer.getError();
 }
@@ -1,18 +1,32 @@
 #ifndef INFLUXDB_WRAPPER_H
 #define INFLUXDB_WRAPPER_H
 
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#include "../test/native_mocks/WiFiClient.h"
+#else
 #include <Arduino.h>
-#include <InfluxDbClient.h>
-#include <InfluxDbCloud.h>
+#include <WiFiClient.h>
+#endif
+
 #include "Config.h"
-#include "SensorRecord.h"
+#include "UploadSink.h"
+#include "InfluxHttpWriter.h"
 
-class InfluxDBWrapper {
+// InfluxDB HTTP backend: streams line protocol to the v1 or v2 write API
+class InfluxDBWrapper : public UploadSink {
 private:
-    InfluxDBClient* client;
-    Point* sensorPoint;
-    Config* config;
     bool initialized;
+    TimePrecision requestedPrecision;
+    WiFiClient wifiClient;
+    InfluxHttpWriter writer;   // Streams points straight into the socket
+    uint16_t batchSize;        // Points per request on the shared connection
+    uint16_t batchPoints;
+    uint16_t sessionPoints;
+    bool firstBatchSent;       // First response doubles as the connection check
+    
+protected:
+    bool writeLine(const char* line, size_t length);
     
 public:
     InfluxDBWrapper();
@@ -21,17 +35,33 @@ public:
     // Initialize with configuration
     bool begin(Config* cfg);
     
-    // Validate connection
+    // Timestamp unit sent to the write endpoint (default: minutes,
+    // seconds on the v2 API which has no minute precision)
+    void setPrecision(TimePrecision p);
+    
+    // Explicit /ping round trip on the upload connection; not needed
+    // before writing, since the first batch waits for its response and
+    // fails the same way
     bool validateConnection();
     
-    // Write single sensor record
-    bool writeSensorRecord(const SensorRecord& record, uint32_t timeOffset);
+    // Finish the request and check all server responses
+    bool flush();
     
-    // Write battery voltage
-    bool writeBatteryVoltage(float voltage);
+    // Close the keep-alive connection at the end of the upload session
+    void close();
     
-    // Flush buffered writes
-    bool flush();
+    // GET on the keep-alive connection the points went over
+    bool fetch(const char* path, const char* headers, char* body, size_t size, int& status);
+    
+    // Points per request; full batches are pipelined on one connection
+    void setBatchSize(uint16_t points);
+    
+    // Points streamed since the last flush
+    uint16_t pendingPoints() const;
+    
+    // Connection reuse counters for the current session
+    uint16_t getConnectionsOpened() const;
+    uint16_t getRequestsSent() const;
     
     // Get last error message
     String getLastError() const;
@@ -0,0 +1,525 @@
+#include "InfluxHttpWriter.h"
+#include "HostResolver.h"
+
+InfluxHttpWriter::InfluxHttpWriter(Client& c)
+    : client(c), port(0), contentType("text/plain; charset=utf-8"), chunkLength(0), requestOpen(false), keepAlive(false),
+      status(0), bodyBytes(0), pendingResponses(0), responseFailed(false),
+      errorKind(UPLOAD_OK), connectionsOpened(0), requestsSent(0) {
+    error[0] = '\0';
+}
+
+static void appendEncoded(String& out, const char* value) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (const char* p = value; *p; p++) {
+        char c = *p;
+        if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += c;
+        } else {
+            out += '%';
+            out += hex[(c >> 4) & 0x0F];
+            out += hex[c & 0x0F];
+        }
+    }
+}
+
+TimePrecision InfluxHttpWriter::configure(const Config& config, TimePrecision precision) {
+    String writePath;
+    
+    if (config.influxVersion == INFLUX_API_V2) {
+        // v2 accepts ns/us/ms/s only
+        if (precision == PRECISION_M) {
+            precision = PRECISION_S;
+        }
+        writePath = "/api/v2/write?org=";
+        appendEncoded(writePath, config.influxOrg);
+        writePath += "&bucket=";
+        appendEncoded(writePath, config.influxBucket);
+        authorization = "Token ";
+        authorization += config.influxToken;
+    } else {
+        writePath = "/write?db=";
+        appendEncoded(writePath, config.influxDb);
+        if (strlen(config.influxUser) > 0) {
+            writePath += "&u=";
+            appendEncoded(writePath, config.influxUser);
+            writePath += "&p=";
+            appendEncoded(writePath, config.influxPass);
+        }
+        authorization = "";
+    }
+    
+    writePath += "&precision=";
+    writePath += LineProtocol::precisionParam(precision);
+    
+    setEndpoint(config.influxServer, config.influxPort, writePath);
+    return precision;
+}
+
+void InfluxHttpWriter::setEndpoint(const String& h, uint16_t p, const String& writePath) {
+    host = h;
+    port = p;
+    path = writePath;
+}
+
+void InfluxHttpWriter::setAuthorization(const String& value) {
+    authorization = value;
+}
+
+void InfluxHttpWriter::setContentType(const String& value) {
+    contentType = value;
+}
+
+bool InfluxHttpWriter::begin() {
+    if (requestOpen) {
+        return true;
+    }
+    
+    // Keep at most PIPELINE_DEPTH requests in flight
+    if (pendingResponses >= PIPELINE_DEPTH) {
+        readPendingResponse();
+    }
+    
+    bodyBytes = 0;
+    chunkLength = 0;
+    
+    if (!client.connected()) {
+        if (pendingResponses > 0) {
+            // Server hung up before answering pipelined requests
+            pendingResponses = 0;
+            responseFailed = true;
+        }
+        if (!connect()) {
+            return false;
+        }
+        connectionsOpened++;
+    }
+    
+    char portStr[8];
+    snprintf(portStr, sizeof(portStr), "%u", (unsigned int)port);
+    
+    // Headers go out piecewise so the path never needs a combined buffer
+    bool ok = send("POST ", 5) &&
+              send(path.c_str(), path.length()) &&
+              send(" HTTP/1.1\r\nHost: ", 17) &&
+              send(host.c_str(), host.length()) &&
+              send(":", 1) &&
+              send(portStr, strlen(portStr));
+    
+    if (ok && authorization.length() > 0) {
+        ok = send("\r\nAuthorization: ", 17) &&
+             send(authorization.c_str(), authorization.length());
+    }
+    
+    ok = ok && send("\r\nContent-Type: ", 16) &&
+         send(contentType.c_str(), contentType.length());
+    
+    static const char headers[] =
+        "\r\nUser-Agent: meteo-station\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    ok = ok && send(headers, sizeof(headers) - 1);
+    
+    if (!ok) {
+        setError(UPLOAD_ERROR_NETWORK, "Failed to send request headers");
+        stop();
+        return false;
+    }
+    
+    requestOpen = true;
+    return true;
+}
+
+bool InfluxHttpWriter::write(const char* data, size_t length) {
+    if (!requestOpen) {
+        return false;
+    }
+    
+    while (length > 0) {
+        size_t space = CHUNK_SIZE - chunkLength;
+        size_t n = length < space ? length : space;
+        memcpy(chunk + chunkLength, data, n);
+        chunkLength += n;
+        data += n;
+        length -= n;
+        bodyBytes += n;
+        
+        if (chunkLength == CHUNK_SIZE && !sendChunk()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool InfluxHttpWriter::end(bool waitForResponse) {
+    if (!requestOpen) {
+        return false;
+    }
+    
+    if (chunkLength > 0 && !sendChunk()) {
+        return false;
+    }
+    
+    if (!send("0\r\n\r\n", 5)) {
+        setError(UPLOAD_ERROR_NETWORK, "Failed to terminate request");
+        stop();
+        return false;
+    }
+    requestOpen = false;
+    requestsSent++;
+    pendingResponses++;
+    
+    if (!waitForResponse) {
+        return true;
+    }
+    return collectResponses();
+}
+
+bool InfluxHttpWriter::collectResponses() {
+    while (pendingResponses > 0) {
+        readPendingResponse();
+    }
+    
+    bool success = !responseFailed;
+    responseFailed = false;
+    return success;
+}
+
+bool InfluxHttpWriter::readPendingResponse() {
+    pendingResponses--;
+    
+    if (!readResponse()) {
+        responseFailed = true;
+        pendingResponses = 0;
+        stop();
+        return false;
+    }
+    
+    bool success = status >= 200 && status < 300;
+    if (!success) {
+        responseFailed = true;
+    }
+    
+    if (!keepAlive) {
+        if (pendingResponses > 0) {
+            setError(UPLOAD_ERROR_NETWORK, "Server closed pipelined connection");
+            responseFailed = true;
+            pendingResponses = 0;
+        }
+        client.stop();
+    }
+    
+    return success;
+}
+
+bool InfluxHttpWriter::get(const char* getPath, const char* headers, char* body, size_t size) {
+    if (requestOpen || pendingResponses > 0) {
+        setError(UPLOAD_ERROR_NETWORK, "Write request still in progress");
+        return false;
+    }
+    if (!client.connected()) {
+        if (!connect()) {
+            return false;
+        }
+        connectionsOpened++;
+    }
+    
+    char portStr[8];
+    snprintf(portStr, sizeof(portStr), "%u", (unsigned int)port);
+    
+    bool ok = send("GET ", 4) &&
+              send(getPath, strlen(getPath)) &&
+              send(" HTTP/1.1\r\nHost: ", 17) &&
+              send(host.c_str(), host.length()) &&
+              send(":", 1) &&
+              send(portStr, strlen(portStr));
+    
+    if (ok && authorization.length() > 0) {
+        ok = send("\r\nAuthorization: ", 17) &&
+             send(authorization.c_str(), authorization.length());
+    }
+    
+    static const char common[] =
+        "\r\nUser-Agent: meteo-station\r\n"
+        "Connection: keep-alive\r\n";
+    ok = ok && send(common, sizeof(common) - 1) &&
+         send(headers, strlen(headers)) &&
+         send("\r\n", 2);
+    
+    if (!ok) {
+        setError(UPLOAD_ERROR_NETWORK, "Failed to send request headers");
+        stop();
+        return false;
+    }
+    requestsSent++;
+    
+    if (!readResponse(body, size)) {
+        stop();
+        return false;
+    }
+    if (!keepAlive) {
+        client.stop();
+    }
+    return true;
+}
+
+void InfluxHttpWriter::stop() {
+    if (requestOpen || pendingResponses > 0) {
+        responseFailed = true;
+    }
+    requestOpen = false;
+    pendingResponses = 0;
+    chunkLength = 0;
+    client.stop();
+}
+
+bool InfluxHttpWriter::isRequestOpen() const {
+    return requestOpen;
+}
+
+int InfluxHttpWriter::getStatus() const {
+    return status;
+}
+
+const char* InfluxHttpWriter::getError() const {
+    return error;
+}
+
+UploadError InfluxHttpWriter::getErrorKind() const {
+    return errorKind;
+}
+
+uint32_t InfluxHttpWriter::getBodyBytes() const {
+    return bodyBytes;
+}
+
+uint8_t InfluxHttpWriter::getPendingResponses() const {
+    return pendingResponses;
+}
+
+uint16_t InfluxHttpWriter::getConnectionsOpened() const {
+    return connectionsOpened;
+}
+
+uint16_t InfluxHttpWriter::getRequestsSent() const {
+    return requestsSent;
+}
+
+void InfluxHttpWriter::beginSession() {
+    connectionsOpened = 0;
+    requestsSent = 0;
+    responseFailed = false;
+    error[0] = '\0';
+    errorKind = UPLOAD_OK;
+}
+
+bool InfluxHttpWriter::connect() {
+    IPAddress address;
+    if (!HostResolver::resolve(host.c_str(), address)) {
+        setError(UPLOAD_ERROR_DNS, "DNS lookup failed");
+        return false;
+    }
+    if (client.connect(address, port)) {
+        return true;
+    }
+    
+    // The cached address may be out of date: look it up once more
+    if (HostResolver::invalidate(host.c_str()) &&
+        HostResolver::resolve(host.c_str(), address) &&
+        client.connect(address, port)) {
+        return true;
+    }
+    setError(UPLOAD_ERROR_CONNECT, "Connection failed");
+    return false;
+}
+
+bool InfluxHttpWriter::send(const char* data, size_t length) {
+    return client.write((const uint8_t*)data, length) == length;
+}
+
+bool InfluxHttpWriter::sendChunk() {
+    char sizeLine[8];
+    int n = snprintf(sizeLine, sizeof(sizeLine), "%X\r\n", (unsigned int)chunkLength);
+    
+    if (!send(sizeLine, n) || !send(chunk, chunkLength) || !send("\r\n", 2)) {
+        setError(UPLOAD_ERROR_NETWORK, "Connection lost while streaming");
+        stop();
+        return false;
+    }
+    
+    chunkLength = 0;
+    return true;
+}
+
+bool InfluxHttpWriter::ping() {
+    // InfluxDB 1.x and 2.x both answer 204, without authentication
+    char body[64];
+    if (!get("/ping", "", body, sizeof(body))) {
+        return false;
+    }
+    if (status < 200 || status >= 300) {
+        // Error statuses are already classified; 304 is not an error for get()
+        if (status == 304) {
+            setError(UPLOAD_ERROR_REJECTED, "Unexpected /ping response");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool InfluxHttpWriter::readLine(char* buf, size_t size, unsigned long deadline) {
+    size_t length = 0;
+    
+    while ((long)(deadline - millis()) > 0) {
+        if (!client.available()) {
+            if (!client.connected()) {
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        
+        int c = client.read();
+        if (c < 0) {
+            continue;
+        }
+        if (c == '\n') {
+            if (length > 0 && buf[length - 1] == '\r') {
+                length--;
+            }
+            buf[length] = '\0';
+            return true;
+        }
+        // Over-long lines are truncated, not rejected
+        if (length + 1 < size) {
+            buf[length++] = (char)c;
+        }
+    }
+    return false;
+}
+
+bool InfluxHttpWriter::readResponse(char* body, size_t bodySize) {
+    unsigned long deadline = millis() + RESPONSE_TIMEOUT_MS;
+    char line[96];
+    
+    if (!readLine(line, sizeof(line), deadline)) {
+        setError(UPLOAD_ERROR_NETWORK, "No response from server");
+        return false;
+    }
+    
+    // "HTTP/1.1 204 No Content"
+    const char* space = strchr(line, ' ');
+    status = space ? atoi(space + 1) : 0;
+    keepAlive = strncmp(line, "HTTP/1.1", 8) == 0;
+    
+    long remaining = 0;
+    bool chunked = false;
+    while (readLine(line, sizeof(line), deadline) && line[0] != '\0') {
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            remaining = atol(line + 15);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            keepAlive = strstr(line + 11, "close") == nullptr;
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            // Proxies and app servers may chunk the config document
+            chunked = strstr(line + 18, "chunked") != nullptr;
+        }
+    }
+    if (chunked) {
+        remaining = 0;
+    }
+    
+    // Consume the body so the connection can be reused; keep a GET body,
+    // or the start of an error body as the error message. A chunked body
+    // is "<hex size>[;ext]\r\n<data>\r\n" per chunk, ended by a zero
+    // size and optional trailer lines.
+    bool success = status >= 200 && status < 300;
+    size_t kept = 0;
+    size_t bodyLength = 0;
+    bool bodyFits = true;
+    bool ended = !chunked;
+    bool firstChunk = true;
+    if (body) {
+        body[0] = '\0';
+    }
+    while ((long)(deadline - millis()) > 0) {
+        if (remaining == 0) {
+            if (ended) {
+                break;
+            }
+            // CRLF after the previous chunk's data, then the size line
+            if ((!firstChunk && !readLine(line, sizeof(line), deadline)) ||
+                !readLine(line, sizeof(line), deadline)) {
+                break;
+            }
+            firstChunk = false;
+            remaining = strtol(line, nullptr, 16);
+            if (remaining <= 0) {
+                bool read;
+                while ((read = readLine(line, sizeof(line), deadline)) && line[0] != '\0') {
+                }
+                ended = read;
+                remaining = 0;
+                break;
+            }
+        }
+        if (!client.available()) {
+            if (!client.connected()) {
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        int c = client.read();
+        if (c < 0) {
+            continue;
+        }
+        remaining--;
+        if (success && body) {
+            if (bodyLength + 1 < bodySize) {
+                body[bodyLength++] = (char)c;
+                body[bodyLength] = '\0';
+            } else {
+                bodyFits = false;
+            }
+        } else if (status >= 300 && kept + 1 < sizeof(error)) {
+            error[kept++] = (char)c;
+            error[kept] = '\0';
+        }
+    }
+    if (remaining > 0 || !ended) {
+        keepAlive = false;
+        if (body) {
+            setError(UPLOAD_ERROR_NETWORK, "Response body cut short");
+            return false;
+        }
+    }
+    if (!bodyFits) {
+        setError(UPLOAD_ERROR_REJECTED, "Response body too large");
+        return false;
+    }
+    
+    // A GET may be answered "not modified"
+    if (!success && !(body && status == 304)) {
+        if (status == 401 || status == 403) {
+            errorKind = UPLOAD_ERROR_AUTH;
+        } else if (status >= 500) {
+            errorKind = UPLOAD_ERROR_SERVER;
+        } else {
+            errorKind = UPLOAD_ERROR_REJECTED;
+        }
+        if (kept == 0) {
+            snprintf(error, sizeof(error), "HTTP status %d", status);
+        }
+        if (!body) {
+            Serial.printf("InfluxDB write failed: %s\n", error);
+        }
+    }
+    
+    return status > 0;
+}
+
+void InfluxHttpWriter::setError(UploadError kind, const char* message) {
+    errorKind = kind;
+    strncpy(error, message, sizeof(error) - 1);
+    error[sizeof(error) - 1] = '\0';
+}
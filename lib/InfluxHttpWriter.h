@@ -0,0 +1,112 @@
+#ifndef INFLUX_HTTP_WRITER_H
+#define INFLUX_HTTP_WRITER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#include "../test/native_mocks/Client.h"
+#else
+#include <Arduino.h>
+#include <Client.h>
+#endif
+
+#include "Config.h"
+#include "LineProtocol.h"
+#include "UploadError.h"
+
+// Streams line protocol to an InfluxDB write endpoint with chunked
+// transfer encoding. Only one chunk is buffered at a time, so memory use
+// is fixed no matter how many points go into a request.
+// The connection is kept open between requests, and up to PIPELINE_DEPTH
+// requests may be sent before their responses are read.
+class InfluxHttpWriter {
+public:
+    static const size_t CHUNK_SIZE = 256;
+    static const unsigned long RESPONSE_TIMEOUT_MS = 5000;
+    static const uint8_t PIPELINE_DEPTH = 2;
+    
+    explicit InfluxHttpWriter(Client& client);
+    
+    // Point the writer at the v1 or v2 write API described by config.
+    // Returns the precision actually used (v2 has no minute precision).
+    TimePrecision configure(const Config& config, TimePrecision precision);
+    
+    // Host and path (including query string) of the write endpoint
+    void setEndpoint(const String& host, uint16_t port, const String& path);
+    
+    // Authorization header value, e.g. "Token <token>" (empty = none)
+    void setAuthorization(const String& value);
+    
+    // Body content type (default: line protocol text)
+    void setContentType(const String& value);
+    
+    // Open connection (if needed) and send request headers
+    bool begin();
+    
+    // Append line protocol to the request body
+    bool write(const char* data, size_t length);
+    
+    // Terminate the body. With waitForResponse=false the response is
+    // read later (pipelining); the result then only reflects sending.
+    bool end(bool waitForResponse = true);
+    
+    // Read all outstanding responses; false if any request failed
+    // since the last call
+    bool collectResponses();
+    
+    // GET 'path' on the same host, over the open connection if there is
+    // one. 'headers' are extra "Name: value\r\n" lines. A 2xx body, with
+    // a length or chunked, is stored NUL-terminated in 'body'; false if no
+    // complete response arrived or the body did not fit.
+    bool get(const char* path, const char* headers, char* body, size_t size);
+    
+    // GET /ping over the same connection; true if the server answered 2xx
+    bool ping();
+    
+    // Drop the connection, discarding any open request
+    void stop();
+    
+    bool isRequestOpen() const;
+    int getStatus() const;
+    const char* getError() const;
+    UploadError getErrorKind() const;
+    uint32_t getBodyBytes() const;
+    
+    // Start of an upload session: clears counters and failure state
+    void beginSession();
+    
+    // Connection reuse counters
+    uint8_t getPendingResponses() const;
+    uint16_t getConnectionsOpened() const;
+    uint16_t getRequestsSent() const;
+    
+private:
+    Client& client;
+    String host;
+    uint16_t port;
+    String path;
+    String authorization;
+    String contentType;
+    
+    char chunk[CHUNK_SIZE];
+    size_t chunkLength;
+    bool requestOpen;
+    bool keepAlive;
+    int status;
+    uint32_t bodyBytes;
+    char error[64];
+    uint8_t pendingResponses;
+    bool responseFailed;
+    UploadError errorKind;
+    uint16_t connectionsOpened;
+    uint16_t requestsSent;
+    
+    bool connect();
+    bool send(const char* data, size_t length);
+    bool sendChunk();
+    bool readLine(char* buf, size_t size, unsigned long deadline);
+    bool readResponse(char* body = nullptr, size_t bodySize = 0);
+    bool readPendingResponse();
+    void setError(UploadError kind, const char* message);
+};
+
+#endif
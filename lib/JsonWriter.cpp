@@ -0,0 +1,107 @@
+#include "JsonWriter.h"
+
+JsonWriter::JsonWriter(char* buf, size_t size)
+    : buf(buf), size(size), length(0), overflow(size == 0) {
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+void JsonWriter::append(const char* text, size_t n) {
+    if (overflow || length + n >= size) {
+        overflow = true;
+        return;
+    }
+    memcpy(buf + length, text, n);
+    length += n;
+    buf[length] = '\0';
+}
+
+void JsonWriter::append(char c) {
+    append(&c, 1);
+}
+
+// Comma unless this is the first member, then "name":
+void JsonWriter::key(const char* name) {
+    if (length > 0 && buf[length - 1] != '{') {
+        append(',');
+    }
+    if (name) {
+        quoted(name);
+        append(':');
+    }
+}
+
+void JsonWriter::quoted(const char* text) {
+    append('"');
+    for (const char* p = text; *p; p++) {
+        char c = *p;
+        if (c == '"' || c == '\\') {
+            append('\\');
+            append(c);
+        } else if (c == '\n') {
+            append("\\n", 2);
+        } else if ((uint8_t)c < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (uint8_t)c);
+            append(escaped, 6);
+        } else {
+            append(c);
+        }
+    }
+    append('"');
+}
+
+void JsonWriter::beginObject(const char* name) {
+    if (length > 0) {
+        key(name);
+    }
+    append('{');
+}
+
+void JsonWriter::endObject() {
+    append('}');
+}
+
+void JsonWriter::addString(const char* name, const char* value) {
+    key(name);
+    quoted(value ? value : "");
+}
+
+void JsonWriter::addNumber(const char* name, uint32_t value) {
+    char text[12];
+    key(name);
+    append(text, snprintf(text, sizeof(text), "%u", (unsigned int)value));
+}
+
+void JsonWriter::addNumber(const char* name, float value, uint8_t decimals) {
+    char text[24];
+    key(name);
+    int n = snprintf(text, sizeof(text), "%.*f", decimals, value);
+    if (n <= 0 || n >= (int)sizeof(text) || isnan(value) || isinf(value)) {
+        append("null", 4);   // JSON has no NaN
+        return;
+    }
+    append(text, n);
+}
+
+void JsonWriter::addBool(const char* name, bool value) {
+    key(name);
+    if (value) {
+        append("true", 4);
+    } else {
+        append("false", 5);
+    }
+}
+
+const char* JsonWriter::c_str() const {
+    return buf;
+}
+
+size_t JsonWriter::getLength() const {
+    return length;
+}
+
+bool JsonWriter::ok() const {
+    return !overflow;
+}
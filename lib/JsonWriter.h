@@ -0,0 +1,42 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+// Allocation-free JSON writer into a caller-supplied buffer, for the
+// config mode endpoints. The text is always NUL-terminated; once the
+// buffer runs out further calls are ignored and ok() returns false.
+class JsonWriter {
+private:
+    char* buf;
+    size_t size;
+    size_t length;
+    bool overflow;
+    
+    void append(const char* text, size_t n);
+    void append(char c);
+    void key(const char* name);
+    void quoted(const char* text);
+    
+public:
+    JsonWriter(char* buf, size_t size);
+    
+    // 'name' is required inside an object and ignored at the top level
+    void beginObject(const char* name = nullptr);
+    void endObject();
+    
+    void addString(const char* name, const char* value);
+    void addNumber(const char* name, uint32_t value);
+    void addNumber(const char* name, float value, uint8_t decimals);
+    void addBool(const char* name, bool value);
+    
+    const char* c_str() const;
+    size_t getLength() const;
+    bool ok() const;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "LineProtocol.h"
+#include "SensorRecord.h"
+
+namespace {
+
+// Bounded append helper - once an append overflows, the whole line is rejected
+struct LineBuffer {
+    char* buf;
+    size_t size;
+    size_t pos;
+    bool overflow;
+
+    LineBuffer(char* b, size_t s) : buf(b), size(s), pos(0), overflow(size == 0) {
+        if (size > 0) {
+            buf[0] = '\0';
+        }
+    }
+
+    void append(char c) {
+        if (overflow || pos + 1 >= size) {
+            overflow = true;
+            return;
+        }
+        buf[pos++] = c;
+        buf[pos] = '\0';
+    }
+
+    void append(const char* str) {
+        while (*str) {
+            append(*str++);
+        }
+    }
+
+    // Backslash-escape any character in 'special'
+    void appendEscaped(const char* str, const char* special) {
+        for (; *str; str++) {
+            if (strchr(special, *str)) {
+                append('\\');
+            }
+            append(*str);
+        }
+    }
+
+    void appendUnsigned(uint32_t value) {
+        char digits[10];
+        uint8_t count = 0;
+        do {
+            digits[count++] = '0' + (value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            append(digits[--count]);
+        }
+    }
+
+    size_t finish() {
+        if (overflow) {
+            if (size > 0) {
+                buf[0] = '\0';
+            }
+            return 0;
+        }
+        return pos;
+    }
+};
+
+void appendTimestamp(LineBuffer& out, uint32_t seconds, TimePrecision precision) {
+    switch (precision) {
+        case PRECISION_M:
+            out.appendUnsigned(seconds / 60);
+            break;
+        case PRECISION_S:
+            out.appendUnsigned(seconds);
+            break;
+        case PRECISION_NS:
+        default:
+            // Avoid 64-bit math: seconds followed by nine zeros
+            out.appendUnsigned(seconds);
+            out.append("000000000");
+            break;
+    }
+}
+
+void appendValue(LineBuffer& out, float value, uint8_t decimals) {
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+
+    bool negative = value < 0;
+    float magnitude = negative ? -value : value;
+    uint32_t scaled = (uint32_t)(magnitude * scale + 0.5f);
+    uint32_t whole = scaled / scale;
+    uint32_t fraction = scaled % scale;
+
+    if (negative && scaled > 0) {
+        out.append('-');
+    }
+    out.appendUnsigned(whole);
+
+    if (fraction == 0) {
+        return;
+    }
+
+    // Drop trailing zeros, then left-pad the remaining digits
+    uint8_t digits = decimals;
+    while (fraction % 10 == 0) {
+        fraction /= 10;
+        digits--;
+    }
+    out.append('.');
+    uint32_t limit = 1;
+    for (uint8_t i = 1; i < digits; i++) {
+        limit *= 10;
+    }
+    while (limit > 1 && fraction < limit) {
+        out.append('0');
+        limit /= 10;
+    }
+    out.appendUnsigned(fraction);
+}
+
+}  // namespace
+
+const char* LineProtocol::precisionParam(TimePrecision precision) {
+    switch (precision) {
+        case PRECISION_M:
+            return "m";
+        case PRECISION_S:
+            return "s";
+        case PRECISION_NS:
+        default:
+            return "ns";
+    }
+}
+
+size_t LineProtocol::formatTimestamp(char* buf, size_t size, uint32_t seconds, TimePrecision precision) {
+    LineBuffer out(buf, size);
+    appendTimestamp(out, seconds, precision);
+    return out.finish();
+}
+
+size_t LineProtocol::formatValue(char* buf, size_t size, float value, uint8_t decimals) {
+    LineBuffer out(buf, size);
+    appendValue(out, value, decimals);
+    return out.finish();
+}
+
+size_t LineProtocol::encodeSeries(char* buf, size_t size, const char* measurement,
+                                  const char* device, const char* location) {
+    LineBuffer out(buf, size);
+    out.appendEscaped(measurement, ", ");
+    // Tags in key order, as InfluxDB stores them
+    if (device && *device) {
+        out.append(",device=");
+        out.appendEscaped(device, ",= ");
+    }
+    if (location && *location) {
+        out.append(",location=");
+        out.appendEscaped(location, ",= ");
+    }
+    return out.finish();
+}
+
+size_t LineProtocol::encodeRecord(char* buf, size_t size, const char* measurement,
+                                  const SensorRecord& record, uint32_t timeOffsetSeconds,
+                                  TimePrecision precision) {
+    return encodePoint(buf, size, measurement, record.getTimestampSeconds(timeOffsetSeconds),
+                       (int16_t)record.getTemperature(), record.humidity, precision);
+}
+
+size_t LineProtocol::encodePoint(char* buf, size_t size, const char* measurement,
+                                 uint32_t timestampSeconds, int16_t temperature, uint8_t humidity,
+                                 TimePrecision precision,
+                                 const SensorRecord* slots, size_t slotCount) {
+    // Records hold whole degrees and percent, so no float formatting
+    LineBuffer out(buf, size);
+    out.append(measurement);
+    out.append(" temperature=");
+    if (temperature < 0) {
+        out.append('-');
+    }
+    out.appendUnsigned(temperature < 0 ? -temperature : temperature);
+    if (humidity <= 100) {
+        out.append(",humidity=");
+        out.appendUnsigned(humidity);
+    }
+    for (size_t i = 0; i < slotCount; i++) {
+        const char* name = sensorChannelName(slots[i].getChannel());
+        if (!name) {
+            continue;
+        }
+        out.append(',');
+        out.append(name);
+        out.append('=');
+        appendValue(out, slots[i].getChannelValue(), sensorChannelDecimals(slots[i].getChannel()));
+    }
+    out.append(' ');
+    appendTimestamp(out, timestampSeconds, precision);
+    out.append('\n');
+    return out.finish();
+}
+
+size_t LineProtocol::encodeBattery(char* buf, size_t size, const char* measurement,
+                                   float voltage, uint16_t sequence, uint32_t timestampSeconds,
+                                   TimePrecision precision) {
+    LineBuffer out(buf, size);
+    out.append(measurement);
+    out.append(" battery_voltage=");
+    appendValue(out, voltage, 2);
+    out.append(",upload_seq=");
+    out.appendUnsigned(sequence);
+    out.append('i');
+    out.append(' ');
+    appendTimestamp(out, timestampSeconds, precision);
+    out.append('\n');
+    return out.finish();
+}
@@ -0,0 +1,65 @@
+#ifndef LINE_PROTOCOL_H
+#define LINE_PROTOCOL_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+class SensorRecord;
+
+// Timestamp unit used on the write endpoint (?precision=...)
+enum TimePrecision {
+    PRECISION_NS = 0,   // Nanoseconds (InfluxDB default)
+    PRECISION_S,        // Seconds
+    PRECISION_M         // Minutes - matches SensorRecord resolution
+};
+
+// Allocation-free InfluxDB line protocol encoder.
+// All functions write into a caller-supplied buffer, NUL-terminate it and
+// return the number of characters written (0 if the buffer is too small).
+class LineProtocol {
+public:
+    // Enough for any series key produced by encodeSeries()
+    static const size_t MAX_SERIES = 128;
+
+    // Enough for any line produced by encodeRecord()/encodeBattery()
+    static const size_t MAX_LINE = 256;
+
+    // Value of the "precision" query parameter for the write endpoint
+    static const char* precisionParam(TimePrecision precision);
+
+    // Timestamp in the requested unit (seconds input, minute records)
+    static size_t formatTimestamp(char* buf, size_t size, uint32_t seconds, TimePrecision precision);
+
+    // Number with up to 'decimals' digits, trailing zeros dropped.
+    // Integral values are written without a decimal point ("22", not "22.0").
+    static size_t formatValue(char* buf, size_t size, float value, uint8_t decimals);
+
+    // "<measurement>,device=<id>[,location=<loc>]" with line protocol
+    // escaping. Built once per upload session and then passed as the
+    // measurement to encodeRecord()/encodeBattery(). Empty tags are left out.
+    static size_t encodeSeries(char* buf, size_t size, const char* measurement,
+                               const char* device, const char* location);
+
+    // "<measurement> temperature=..,humidity=.. <time>\n"; humidity is
+    // left out for SENSOR_NO_HUMIDITY
+    static size_t encodeRecord(char* buf, size_t size, const char* measurement,
+                               const SensorRecord& record, uint32_t timeOffsetSeconds,
+                               TimePrecision precision);
+
+    // Same line from values already decoded by SensorRecord::decode(),
+    // plus a field for each of the measurement's channel slots
+    static size_t encodePoint(char* buf, size_t size, const char* measurement,
+                              uint32_t timestampSeconds, int16_t temperature, uint8_t humidity,
+                              TimePrecision precision,
+                              const SensorRecord* slots = nullptr, size_t slotCount = 0);
+
+    // "<measurement> battery_voltage=..,upload_seq=..i <time>\n"
+    static size_t encodeBattery(char* buf, size_t size, const char* measurement,
+                                float voltage, uint16_t sequence, uint32_t timestampSeconds,
+                                TimePrecision precision);
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "MqttLineSink.h"
+#include "HostResolver.h"
+
+// MQTT 3.1.1 control packet types (upper nibble of the fixed header)
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH_QOS1 0x32
+#define MQTT_PUBACK 0x40
+#define MQTT_DISCONNECT 0xE0
+
+MqttLineSink::MqttLineSink() : payloadLength(0), packetId(0), messagesPublished(0) {
+    // Telegraf's influx parser defaults to nanosecond timestamps
+    precision = PRECISION_NS;
+}
+
+bool MqttLineSink::begin(Config* cfg) {
+    config = cfg;
+    
+    if (!config || !config->isValid()) {
+        Serial.println("Invalid configuration for MQTT upload");
+        return false;
+    }
+    
+    if (!prepareSeries()) {
+        Serial.println("Measurement and tags too long");
+        return false;
+    }
+    
+    topic = String(MQTT_TOPIC_PREFIX) + config->influxMeasurement;
+    payloadLength = 0;
+    messagesPublished = 0;
+    lastError = "";
+    lastErrorKind = UPLOAD_OK;
+    
+    Serial.printf("MQTT broker %s:%d, topic %s\n", 
+                  config->influxServer, config->influxPort, topic.c_str());
+    return true;
+}
+
+bool MqttLineSink::validateConnection() {
+    return connect();
+}
+
+bool MqttLineSink::connect() {
+    if (client.connected()) {
+        return true;
+    }
+    
+    IPAddress address;
+    if (!HostResolver::resolve(config->influxServer, address)) {
+        lastError = "DNS lookup failed";
+        lastErrorKind = UPLOAD_ERROR_DNS;
+        return false;
+    }
+    // A cached address may be out of date: look it up once more
+    if (!client.connect(address, config->influxPort) &&
+        !(HostResolver::invalidate(config->influxServer) &&
+          HostResolver::resolve(config->influxServer, address) &&
+          client.connect(address, config->influxPort))) {
+        lastError = "MQTT connection failed";
+        lastErrorKind = UPLOAD_ERROR_CONNECT;
+        return false;
+    }
+    
+    char clientId[24];
+#ifdef NATIVE
+    snprintf(clientId, sizeof(clientId), "meteo-native");
+#else
+    snprintf(clientId, sizeof(clientId), "meteo-%06x", ESP.getChipId());
+#endif
+    
+    bool hasUser = strlen(config->influxUser) > 0;
+    bool hasPass = hasUser && strlen(config->influxPass) > 0;
+    
+    uint8_t flags = 0x02;   // Clean session
+    size_t length = 10 + 2 + strlen(clientId);
+    if (hasUser) {
+        flags |= 0x80;
+        length += 2 + strlen(config->influxUser);
+    }
+    if (hasPass) {
+        flags |= 0x40;
+        length += 2 + strlen(config->influxPass);
+    }
+    
+    const uint8_t variableHeader[10] = {
+        0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, flags,
+        (uint8_t)(KEEP_ALIVE_SECONDS >> 8), (uint8_t)(KEEP_ALIVE_SECONDS & 0xFF)
+    };
+    
+    bool ok = sendHeader(MQTT_CONNECT, length) &&
+              client.write(variableHeader, sizeof(variableHeader)) == sizeof(variableHeader) &&
+              sendString(clientId) &&
+              (!hasUser || sendString(config->influxUser)) &&
+              (!hasPass || sendString(config->influxPass));
+    
+    uint8_t ack[2];
+    if (!ok || !readPacket(MQTT_CONNACK, ack, sizeof(ack))) {
+        lastError = "MQTT handshake failed";
+        lastErrorKind = UPLOAD_ERROR_NETWORK;
+        client.stop();
+        return false;
+    }
+    if (ack[1] != 0) {
+        lastError = String("MQTT connection refused, code ") + String((int)ack[1]);
+        // 4 = bad user name or password, 5 = not authorized
+        lastErrorKind = ack[1] == 4 || ack[1] == 5 ? UPLOAD_ERROR_AUTH : UPLOAD_ERROR_REJECTED;
+        client.stop();
+        return false;
+    }
+    
+    return true;
+}
+
+bool MqttLineSink::writeLine(const char* line, size_t length) {
+    if (!config) {
+        return false;
+    }
+    
+    // One message carries as many whole lines as fit
+    if (payloadLength + length > PAYLOAD_SIZE && !publish()) {
+        return false;
+    }
+    
+    memcpy(payload + payloadLength, line, length);
+    payloadLength += length;
+    return true;
+}
+
+bool MqttLineSink::publish() {
+    if (payloadLength == 0) {
+        return true;
+    }
+    if (!connect()) {
+        return false;
+    }
+    
+    packetId = packetId == 0xFFFF ? 1 : packetId + 1;
+    uint8_t id[2] = { (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF) };
+    
+    bool ok = sendHeader(MQTT_PUBLISH_QOS1, 2 + topic.length() + 2 + payloadLength) &&
+              sendString(topic.c_str()) &&
+              client.write(id, sizeof(id)) == sizeof(id) &&
+              client.write((const uint8_t*)payload, payloadLength) == payloadLength;
+    
+    uint8_t ack[2];
+    if (!ok || !readPacket(MQTT_PUBACK, ack, sizeof(ack)) || memcmp(ack, id, sizeof(id)) != 0) {
+        lastError = "MQTT publish not acknowledged";
+        lastErrorKind = UPLOAD_ERROR_NETWORK;
+        client.stop();
+        return false;
+    }
+    
+    payloadLength = 0;
+    messagesPublished++;
+    return true;
+}
+
+bool MqttLineSink::flush() {
+    if (!config) {
+        return false;
+    }
+    
+    bool success = publish() && lastError.length() == 0;
+    if (success) {
+        Serial.printf("MQTT published %u messages\n", (unsigned int)messagesPublished);
+    }
+    return success;
+}
+
+void MqttLineSink::close() {
+    if (client.connected()) {
+        const uint8_t disconnect[2] = { MQTT_DISCONNECT, 0x00 };
+        client.write(disconnect, sizeof(disconnect));
+    }
+    client.stop();
+    payloadLength = 0;
+}
+
+uint16_t MqttLineSink::getMessagesPublished() const {
+    return messagesPublished;
+}
+
+bool MqttLineSink::sendHeader(uint8_t type, size_t remainingLength) {
+    // Fixed header: type byte plus variable-length "remaining length"
+    uint8_t header[5];
+    size_t n = 0;
+    header[n++] = type;
+    do {
+        uint8_t digit = remainingLength % 128;
+        remainingLength /= 128;
+        header[n++] = remainingLength > 0 ? (digit | 0x80) : digit;
+    } while (remainingLength > 0 && n < sizeof(header));
+    
+    return client.write(header, n) == n;
+}
+
+bool MqttLineSink::sendString(const char* str) {
+    size_t length = strlen(str);
+    uint8_t prefix[2] = { (uint8_t)(length >> 8), (uint8_t)(length & 0xFF) };
+    return client.write(prefix, sizeof(prefix)) == sizeof(prefix) &&
+           client.write((const uint8_t*)str, length) == length;
+}
+
+bool MqttLineSink::readPacket(uint8_t expectedType, uint8_t* body, size_t size) {
+    // CONNACK and PUBACK are both 4 bytes: type, length 2, two body bytes
+    uint8_t packet[4];
+    size_t received = 0;
+    unsigned long start = millis();
+    
+    while (received < sizeof(packet) && millis() - start < ACK_TIMEOUT_MS) {
+        if (!client.available()) {
+            if (!client.connected()) {
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        int c = client.read();
+        if (c >= 0) {
+            packet[received++] = (uint8_t)c;
+        }
+    }
+    
+    if (received < sizeof(packet) || (packet[0] & 0xF0) != expectedType || packet[1] != 2) {
+        return false;
+    }
+    memcpy(body, packet + 2, size < 2 ? size : 2);
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef MQTT_LINE_SINK_H
+#define MQTT_LINE_SINK_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#include "../test/native_mocks/WiFiClient.h"
+#else
+#include <Arduino.h>
+#include <WiFiClient.h>
+#endif
+
+#include "UploadSink.h"
+
+#define MQTT_TOPIC_PREFIX "meteo/"
+
+// Line protocol published to an MQTT broker (e.g. Mosquitto feeding
+// Telegraf mqtt_consumer). Minimal MQTT 3.1.1 client: lines are packed
+// into QoS 1 PUBLISH messages on "meteo/<measurement>", each confirmed
+// by PUBACK. Broker host/port and optional user/password come from the
+// InfluxDB server fields of Config.
+class MqttLineSink : public UploadSink {
+public:
+    static const size_t PAYLOAD_SIZE = 512;
+    static const unsigned long ACK_TIMEOUT_MS = 5000;
+    static const uint16_t KEEP_ALIVE_SECONDS = 60;
+    
+    MqttLineSink();
+    
+    bool begin(Config* cfg);
+    bool validateConnection();
+    bool flush();
+    void close();
+    
+    uint16_t getMessagesPublished() const;
+    
+protected:
+    bool writeLine(const char* line, size_t length);
+    
+private:
+    WiFiClient client;
+    char payload[PAYLOAD_SIZE];
+    size_t payloadLength;
+    uint16_t packetId;
+    uint16_t messagesPublished;
+    String topic;
+    
+    bool connect();
+    bool publish();
+    bool sendHeader(uint8_t type, size_t remainingLength);
+    bool sendString(const char* str);
+    bool readPacket(uint8_t expectedType, uint8_t* body, size_t size);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "OtaUpdater.h"
+#include "HostResolver.h"
+
+#define BODY_BLOCK 512
+
+OtaUpdater::OtaUpdater(Client& client, FirmwareTarget& target)
+    : client(client), target(target), patcher(target), status(0), downloadBytes(0) {
+    error[0] = '\0';
+}
+
+bool OtaUpdater::parseUrl(const char* url, char* host, size_t hostSize, uint16_t& port,
+                          const char*& path) {
+    if (strncmp(url, "http://", 7) != 0) {
+        return false;
+    }
+    const char* start = url + 7;
+    const char* end = start + strcspn(start, ":/");
+    size_t length = end - start;
+    if (length == 0 || length >= hostSize) {
+        return false;
+    }
+    memcpy(host, start, length);
+    host[length] = '\0';
+    
+    port = 80;
+    if (*end == ':') {
+        char* digits;
+        unsigned long value = strtoul(end + 1, &digits, 10);
+        if (digits == end + 1 || value == 0 || value > 65535 || (*digits != '/' && *digits != '\0')) {
+            return false;
+        }
+        port = (uint16_t)value;
+        end = digits;
+    }
+    path = *end == '/' ? end : "/";
+    return true;
+}
+
+uint8_t OtaUpdater::update(const char* url) {
+    status = 0;
+    downloadBytes = 0;
+    error[0] = '\0';
+    
+    char host[64];
+    uint16_t port;
+    const char* path;
+    if (!parseUrl(url, host, sizeof(host), port, path)) {
+        return fail("Invalid update URL");
+    }
+    if (!sendRequest(host, port, path)) {
+        client.stop();
+        return OTA_FAILED;
+    }
+    
+    unsigned long deadline = millis() + RESPONSE_TIMEOUT_MS;
+    char line[128];
+    if (!readLine(line, sizeof(line), deadline)) {
+        client.stop();
+        return fail("No response from update server");
+    }
+    const char* space = strchr(line, ' ');
+    status = space ? atoi(space + 1) : 0;
+    
+    long contentLength = -1;
+    bool hasDigest = false;
+    uint8_t digest[SHA256_SIZE];
+    while (readLine(line, sizeof(line), deadline) && line[0] != '\0') {
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = atol(line + 15);
+        } else if (strncasecmp(line, "X-Image-SHA256:", 15) == 0) {
+            const char* value = line + 15;
+            while (*value == ' ') {
+                value++;
+            }
+            hasDigest = Sha256::fromHex(value, digest);
+        }
+    }
+    
+    uint8_t result;
+    if (status == 304) {
+        result = OTA_NO_UPDATE;
+    } else if (status != 200) {
+        char message[32];
+        snprintf(message, sizeof(message), "Update server returned %d", status);
+        result = fail(message);
+    } else if (contentLength <= 0) {
+        result = fail("Update without Content-Length");
+    } else if (!hasDigest) {
+        result = fail("Update without X-Image-SHA256");
+    } else {
+        patcher.begin((uint32_t)contentLength, digest);
+        result = readBody((uint32_t)contentLength);
+    }
+    client.stop();
+    return result;
+}
+
+bool OtaUpdater::sendRequest(const char* host, uint16_t port, const char* path) {
+    // The update server must not take the upload server's cache entry
+    IPAddress address;
+    if (!HostResolver::resolve(host, address, false)) {
+        fail("DNS lookup failed");
+        return false;
+    }
+    if (!client.connect(address, port)) {
+        fail("Connection failed");
+        return false;
+    }
+    
+    uint8_t md5[FIRMWARE_MD5_SIZE];
+    target.baseMd5(md5);
+    char md5Hex[2 * FIRMWARE_MD5_SIZE + 1];
+    for (int i = 0; i < FIRMWARE_MD5_SIZE; i++) {
+        snprintf(md5Hex + 2 * i, 3, "%02x", md5[i]);
+    }
+    
+    char request[320];
+    int n = snprintf(request, sizeof(request),
+                     "GET %s HTTP/1.1\r\nHost: %s:%u\r\nX-Sketch-MD5: %s\r\nX-Sketch-Size: %u\r\n"
+                     "Connection: close\r\n\r\n",
+                     path, host, (unsigned int)port, md5Hex, (unsigned int)target.baseSize());
+    if (n <= 0 || (size_t)n >= sizeof(request)) {
+        fail("Update URL too long");
+        return false;
+    }
+    if (client.write((const uint8_t*)request, n) != (size_t)n) {
+        fail("Sending the request failed");
+        return false;
+    }
+    return true;
+}
+
+bool OtaUpdater::readLine(char* buf, size_t size, unsigned long deadline) {
+    size_t length = 0;
+    
+    while ((long)(deadline - millis()) > 0) {
+        if (!client.available()) {
+            if (!client.connected()) {
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        
+        int c = client.read();
+        if (c < 0) {
+            continue;
+        }
+        if (c == '\n') {
+            if (length > 0 && buf[length - 1] == '\r') {
+                length--;
+            }
+            buf[length] = '\0';
+            return true;
+        }
+        if (length + 1 < size) {
+            buf[length++] = (char)c;
+        }
+    }
+    return false;
+}
+
+// Feeds the body to the patcher as it arrives; the deadline moves on
+// with every block so only a stalled download times out
+uint8_t OtaUpdater::readBody(uint32_t length) {
+    uint8_t block[BODY_BLOCK];
+    unsigned long deadline = millis() + RESPONSE_TIMEOUT_MS;
+    
+    while (downloadBytes < length) {
+        if ((long)(deadline - millis()) <= 0) {
+            patcher.abort();
+            return fail("Update download timed out");
+        }
+        int available = client.available();
+        if (available <= 0) {
+            if (!client.connected()) {
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        
+        size_t want = length - downloadBytes < sizeof(block) ? length - downloadBytes : sizeof(block);
+        int n = client.read(block, (size_t)available < want ? (size_t)available : want);
+        if (n <= 0) {
+            continue;
+        }
+        downloadBytes += n;
+        deadline = millis() + RESPONSE_TIMEOUT_MS;
+        if (!patcher.write(block, n)) {
+            patcher.abort();
+            return fail(patcher.getError());
+        }
+    }
+    
+    if (!patcher.end()) {
+        return fail(patcher.getError());
+    }
+    return OTA_UPDATED;
+}
+
+uint8_t OtaUpdater::fail(const char* message) {
+    snprintf(error, sizeof(error), "%s", message);
+    return OTA_FAILED;
+}
+
+int OtaUpdater::getStatus() const {
+    return status;
+}
+
+bool OtaUpdater::isDelta() const {
+    return patcher.isDelta();
+}
+
+uint32_t OtaUpdater::getDownloadBytes() const {
+    return downloadBytes;
+}
+
+const char* OtaUpdater::getError() const {
+    return error;
+}
@@ -0,0 +1,62 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#include "../test/native_mocks/Client.h"
+#else
+#include <Arduino.h>
+#include <Client.h>
+#endif
+
+#include "FirmwarePatcher.h"
+
+// update() results
+#define OTA_NO_UPDATE 0   // Server has nothing newer (304)
+#define OTA_UPDATED 1     // New image verified, boots after a restart
+#define OTA_FAILED 2
+
+// Pulls a firmware update over plain HTTP during the upload window.
+// The request tells the server which image is running:
+//
+//   GET <path> HTTP/1.1
+//   X-Sketch-MD5: <md5 of the running image>
+//   X-Sketch-Size: <bytes>
+//
+// and the server answers 304 when that image is current, or 200 with a
+// full image or a delta against it (see FirmwarePatcher.h), a
+// Content-Length and an X-Image-SHA256 header with the digest of the new
+// image. Nothing is flashed unless that digest matches.
+class OtaUpdater {
+public:
+    static const unsigned long RESPONSE_TIMEOUT_MS = 10000;   // Also the limit between body reads
+    
+    OtaUpdater(Client& client, FirmwareTarget& target);
+    
+    // 'url' is "http://host[:port]/path"
+    uint8_t update(const char* url);
+    
+    int getStatus() const;
+    bool isDelta() const;
+    uint32_t getDownloadBytes() const;
+    const char* getError() const;
+    
+    // Splits 'url'; false for anything but an http:// URL
+    static bool parseUrl(const char* url, char* host, size_t hostSize, uint16_t& port,
+                         const char*& path);
+    
+private:
+    Client& client;
+    FirmwareTarget& target;
+    FirmwarePatcher patcher;
+    int status;
+    uint32_t downloadBytes;
+    char error[64];
+    
+    bool sendRequest(const char* host, uint16_t port, const char* path);
+    bool readLine(char* buf, size_t size, unsigned long deadline);
+    uint8_t readBody(uint32_t length);
+    uint8_t fail(const char* message);
+};
+
+#endif
@@ -6,6 +6,8 @@ extern "C" {
 }
 #endif
 
+static_assert(sizeof(RTCData) <= RTC_USER_MEMORY, "RTCData does not fit the user RTC memory");
+
 RTCData::RTCData() {
     initialize();
 }
@@ -16,6 +18,12 @@ void RTCData::initialize() {
     romWriteIndex = 0;
     romRecordCount = 0;
     lastSync = 0;
+    uploadSequence = 0;
+    sessionMillivolts = 0;
+    sessionTime = 0;
+    retry.reset();
+    clock = 0;
+    memset(&dnsCache, 0, sizeof(dnsCache));
     memset(buffer, 0, sizeof(buffer));
 }
 
@@ -23,11 +31,16 @@ bool RTCData::isValid() const {
     return magic == RTC_MAGIC;
 }
 
-void RTCData::save() {
+bool RTCData::save() {
 #ifdef NATIVE
     // In native mode, data persists in memory
+    return true;
 #else
-    system_rtc_mem_write(64, this, sizeof(RTCData));
+    if (!system_rtc_mem_write(RTC_USER_BLOCK, this, sizeof(RTCData))) {
+        Serial.println("RTC data write failed");
+        return false;
+    }
+    return true;
 #endif
 }
 
@@ -39,8 +52,7 @@ bool RTCData::load() {
     }
     return isValid();
 #else
-    system_rtc_mem_read(64, this, sizeof(RTCData));
-    if (!isValid()) {
+    if (!system_rtc_mem_read(RTC_USER_BLOCK, this, sizeof(RTCData)) || !isValid()) {
         Serial.println("RTC data invalid, initializing...");
         initialize();
         save();
@@ -59,6 +71,15 @@ bool RTCData::addRecord(const SensorRecord& record) {
     return false;
 }
 
+bool RTCData::addRecords(const SensorRecord* records, uint8_t count) {
+    if (count > RTC_BUFFER_SIZE - recordCount) {
+        return false;
+    }
+    memcpy(buffer + recordCount, records, count * sizeof(SensorRecord));
+    recordCount += count;
+    return true;
+}
+
 bool RTCData::isBufferFull() const {
     return recordCount >= RTC_BUFFER_SIZE;
 }
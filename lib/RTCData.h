@@ -8,9 +8,16 @@
 #endif
 
 #include "SensorRecord.h"
+#include "RetryScheduler.h"
+#include "HostResolver.h"
 
-#define RTC_BUFFER_SIZE 128
-#define RTC_MAGIC 0x5A5A5A5A
+// User RTC memory: 512 bytes from block 64. The SDK refuses a write that
+// does not fit, so the whole object has to stay below it.
+#define RTC_USER_BLOCK 64
+#define RTC_USER_MEMORY 512
+
+#define RTC_BUFFER_SIZE 112    // What is left after the state fields
+#define RTC_MAGIC 0x5A5A5A60   // Bumped whenever the layout changes
 
 class RTCData {
 public:
@@ -18,17 +25,25 @@ public:
     uint16_t recordCount;
     uint16_t romWriteIndex;
     uint16_t romRecordCount;
+    uint16_t uploadSequence;   // Number of the next upload session
+    uint16_t sessionMillivolts;   // Battery point of the pending session,
+    uint32_t sessionTime;         // fixed by its first attempt (0 = none yet)
     uint32_t lastSync;
+    RetryScheduler retry;      // Backoff after failed uploads
+    uint32_t clock;            // Seconds since power-on, advanced by every deep sleep
+    DnsCache dnsCache;         // Upload server address
     SensorRecord buffer[RTC_BUFFER_SIZE];
     
     RTCData();
     
     void initialize();
     bool isValid() const;
-    void save();
+    bool save();
     bool load();  // Changed to return bool
     
     bool addRecord(const SensorRecord& record);  // Changed to return bool
+    // All of them or none, so a measurement is never split from its slots
+    bool addRecords(const SensorRecord* records, uint8_t count);
     bool isBufferFull() const;
     void clearBuffer();
 };
@@ -0,0 +1,247 @@
+#include "RecordExport.h"
+#include "RecordStore.h"
+
+#define PHASE_HEADER 0
+#define PHASE_RECORDS 1
+#define PHASE_FOOTER 2
+#define PHASE_DONE 3
+
+#define EXPORT_BATCH 16   // Records decoded at a time
+
+RecordExport::RecordExport(const RTCData& rtc, uint32_t timeOffset, ExportFormat format,
+                           const uint8_t* deviceId)
+    : rtc(rtc), timeOffset(timeOffset), format(format), phase(PHASE_HEADER), next(0), position(0),
+      rows(0), measurements(0), channels(0) {
+    uint8_t noDevice[6] = { 0 };
+    BinaryBlockEncoder::encodeExportHeader(header, sizeof(header), deviceId ? deviceId : noDevice,
+                                           timeOffset, getCount());
+    
+    // Columns are fixed by the header, so find the channels up front
+    uint16_t index = 0;
+    uint16_t count;
+    const SensorRecord* records;
+    while ((records = recordsAt(index, count = 0xFFFF)) != nullptr) {
+        for (uint16_t i = 0; i < count; i++) {
+            if (records[i].isChannelSlot()) {
+                channels |= records[i].getChannel() & SENSOR_OPTIONAL_CHANNELS;
+            } else {
+                measurements++;
+            }
+        }
+        index += count;
+    }
+}
+
+uint16_t RecordExport::getCount() const {
+    return RecordStore::count(rtc) + (rtc.recordCount < RTC_BUFFER_SIZE ? rtc.recordCount : RTC_BUFFER_SIZE);
+}
+
+uint16_t RecordExport::getMeasurementCount() const {
+    return measurements;
+}
+
+// Consecutive records from 'index' within one memory area
+const SensorRecord* RecordExport::recordsAt(uint16_t index, uint16_t& count) const {
+    uint16_t stored = RecordStore::count(rtc);
+    if (index < stored) {
+        return RecordStore::span(rtc, index, count);
+    }
+    
+    index -= stored;
+    uint16_t buffered = rtc.recordCount < RTC_BUFFER_SIZE ? rtc.recordCount : RTC_BUFFER_SIZE;
+    if (index >= buffered) {
+        count = 0;
+        return nullptr;
+    }
+    if (count > buffered - index) {
+        count = buffered - index;
+    }
+    return rtc.buffer + index;
+}
+
+size_t RecordExport::read(char* buf, size_t size) {
+    if (size < MIN_CHUNK) {
+        return 0;
+    }
+    size_t length = 0;
+    
+    if (format == EXPORT_BINARY) {
+        size_t available;
+        const uint8_t* data;
+        while (length < size && (data = dataAt(position, available)) != nullptr) {
+            size_t n = available < size - length ? available : size - length;
+            memcpy(buf + length, data, n);
+            length += n;
+            position += n;
+        }
+        return length;
+    }
+    
+    if (phase == PHASE_HEADER) {
+        if (format == EXPORT_JSON) {
+            length = snprintf(buf, size, "{\"timeOffset\":%u,\"count\":%u,\"records\":[",
+                              (unsigned int)timeOffset, (unsigned int)measurements);
+        } else {
+            length = snprintf(buf, size, "time,temperature,humidity");
+            for (uint8_t channel = SENSOR_PRESSURE; channel & SENSOR_OPTIONAL_CHANNELS; channel <<= 1) {
+                if (channels & channel) {
+                    length += snprintf(buf + length, size - length, ",%s", sensorChannelName(channel));
+                }
+            }
+            buf[length++] = '\n';
+        }
+        phase = PHASE_RECORDS;
+    }
+    
+    while (phase == PHASE_RECORDS) {
+        uint16_t count = EXPORT_BATCH;
+        const SensorRecord* records = recordsAt(next, count);
+        if (count == 0) {
+            phase = PHASE_FOOTER;
+            break;
+        }
+        
+        uint32_t timestamps[EXPORT_BATCH];
+        int16_t temperatures[EXPORT_BATCH];
+        uint8_t humidities[EXPORT_BATCH];
+        SensorRecord::decode(records, count, timeOffset, timestamps, temperatures, humidities);
+        
+        for (uint16_t i = 0; i < count; i++) {
+            if (humidities[i] == SENSOR_CHANNEL_SLOT) {
+                next++;   // Written with its measurement
+                continue;
+            }
+            // The slots may lie past this batch, but never in another area
+            uint16_t available = SENSOR_MAX_SLOTS;
+            const SensorRecord* point = recordsAt(next, available);
+            char row[MIN_CHUNK];
+            size_t n = formatRow(row, sizeof(row), timestamps[i], temperatures[i], humidities[i],
+                                 point + 1, SensorRecord::countSlots(point, available));
+            if (length + n > size) {
+                return length;   // Row goes into the next chunk
+            }
+            memcpy(buf + length, row, n);
+            length += n;
+            next++;
+            rows++;
+        }
+    }
+    
+    if (phase == PHASE_FOOTER) {
+        if (format == EXPORT_JSON) {
+            if (length + 3 > size) {
+                return length;
+            }
+            memcpy(buf + length, "\n]}", 3);
+            length += 3;
+        }
+        phase = PHASE_DONE;
+    }
+    return length;
+}
+
+size_t RecordExport::formatRow(char* row, size_t size, uint32_t timestamp, int16_t temperature,
+                               uint8_t humidity, const SensorRecord* slots, uint8_t slotCount) const {
+    bool json = format == EXPORT_JSON;
+    int n = json ? snprintf(row, size, "%s\n{\"time\":%u,\"temperature\":%d",
+                            rows > 0 ? "," : "", (unsigned int)timestamp, (int)temperature)
+                 : snprintf(row, size, "%u,%d,", (unsigned int)timestamp, (int)temperature);
+    if (humidity <= 100) {
+        n += snprintf(row + n, size - n, json ? ",\"humidity\":%u" : "%u", (unsigned int)humidity);
+    }
+    
+    // CSV has a (possibly empty) cell per channel column, JSON a key per value
+    for (uint8_t channel = SENSOR_PRESSURE; channel & SENSOR_OPTIONAL_CHANNELS; channel <<= 1) {
+        if (!(channels & channel)) {
+            continue;
+        }
+        const SensorRecord* slot = nullptr;
+        for (uint8_t i = 0; i < slotCount; i++) {
+            if (slots[i].getChannel() == channel) {
+                slot = slots + i;
+            }
+        }
+        if (!json) {
+            row[n++] = ',';
+        }
+        if (slot) {
+            if (json) {
+                n += snprintf(row + n, size - n, ",\"%s\":", sensorChannelName(channel));
+            }
+            n += LineProtocol::formatValue(row + n, size - n, slot->getChannelValue(),
+                                           sensorChannelDecimals(channel));
+        }
+    }
+    
+    n += snprintf(row + n, size - n, json ? "}" : "\n");
+    return n;
+}
+
+uint32_t RecordExport::getSize() const {
+    return BINARY_HEADER_SIZE + (uint32_t)getCount() * BINARY_EXPORT_RECORD_SIZE;
+}
+
+const uint8_t* RecordExport::dataAt(uint32_t offset, size_t& length) {
+    if (offset < BINARY_HEADER_SIZE) {
+        length = BINARY_HEADER_SIZE - offset;
+        return header + offset;
+    }
+    
+    offset -= BINARY_HEADER_SIZE;
+    if (offset / BINARY_EXPORT_RECORD_SIZE > 0xFFFF) {
+        length = 0;
+        return nullptr;
+    }
+    uint16_t count = 0xFFFF;
+    const SensorRecord* records = recordsAt(offset / BINARY_EXPORT_RECORD_SIZE, count);
+    if (count == 0) {
+        length = 0;
+        return nullptr;
+    }
+    uint32_t within = offset % BINARY_EXPORT_RECORD_SIZE;
+    length = (size_t)count * BINARY_EXPORT_RECORD_SIZE - within;
+    return (const uint8_t*)records + within;
+}
+
+uint8_t RecordExport::parseRange(const char* header, uint32_t size, uint32_t& first, uint32_t& last) {
+    if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',') != nullptr) {
+        return EXPORT_RANGE_NONE;   // Other units and multiple ranges are not supported
+    }
+    const char* p = header + 6;
+    char* end;
+    
+    if (*p == '-') {
+        unsigned long suffix = strtoul(p + 1, &end, 10);
+        if (end == p + 1 || *end != '\0') {
+            return EXPORT_RANGE_NONE;
+        }
+        if (suffix == 0 || size == 0) {
+            return EXPORT_RANGE_INVALID;
+        }
+        first = suffix < size ? size - suffix : 0;
+        last = size - 1;
+        return EXPORT_RANGE_PARTIAL;
+    }
+    
+    if (*p < '0' || *p > '9') {
+        return EXPORT_RANGE_NONE;
+    }
+    unsigned long start = strtoul(p, &end, 10);
+    if (*end != '-') {
+        return EXPORT_RANGE_NONE;
+    }
+    p = end + 1;
+    unsigned long stop = size > 0 ? size - 1 : 0;
+    if (*p != '\0') {
+        stop = strtoul(p, &end, 10);
+        if (end == p || *end != '\0' || stop < start) {
+            return EXPORT_RANGE_NONE;
+        }
+    }
+    if (start >= size) {
+        return EXPORT_RANGE_INVALID;
+    }
+    first = start;
+    last = stop < size ? stop : size - 1;
+    return EXPORT_RANGE_PARTIAL;
+}
@@ -0,0 +1,73 @@
+#ifndef RECORD_EXPORT_H
+#define RECORD_EXPORT_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "RTCData.h"
+#include "BinaryProtocol.h"
+
+enum ExportFormat {
+    EXPORT_CSV = 0,   // "time,temperature,humidity[,<channel>..]" rows
+    EXPORT_JSON,      // {"count":..,"records":[{"time":..,..},..]}
+    EXPORT_BINARY     // Header + raw records, see BinaryProtocol.h
+};
+
+// parseRange() results
+#define EXPORT_RANGE_NONE 0      // No usable Range header: send everything
+#define EXPORT_RANGE_PARTIAL 1   // Send [first, last]
+#define EXPORT_RANGE_INVALID 2   // 416 Range Not Satisfiable
+
+// Decoded backlog, EEPROM records first (oldest), then the RTC buffer.
+// Produced piecewise straight from RTC memory and the EEPROM cache so a
+// web handler can send it in chunks without building the document.
+// CSV and JSON have one row per measurement, with its channel slots as
+// extra columns; the binary export carries the records as stored.
+class RecordExport {
+private:
+    const RTCData& rtc;
+    uint32_t timeOffset;
+    ExportFormat format;
+    uint8_t phase;      // Header, records, footer, done
+    uint16_t next;      // Next record, counted over EEPROM then RTC
+    uint32_t position;  // Next byte of a binary export
+    uint16_t rows;      // Rows written so far
+    uint16_t measurements;
+    uint8_t channels;   // Optional channels present anywhere in the backlog
+    uint8_t header[BINARY_HEADER_SIZE];
+    
+    const SensorRecord* recordsAt(uint16_t index, uint16_t& count) const;
+    size_t formatRow(char* row, size_t size, uint32_t timestamp, int16_t temperature,
+                     uint8_t humidity, const SensorRecord* slots, uint8_t slotCount) const;
+    
+public:
+    // Smallest buffer read() can always make progress with
+    static const size_t MIN_CHUNK = 128;
+    
+    // 'deviceId' (MAC address) goes into the EXPORT_BINARY header
+    RecordExport(const RTCData& rtc, uint32_t timeOffset, ExportFormat format,
+                 const uint8_t* deviceId = nullptr);
+    
+    // Records as stored (binary export) and measurements (CSV/JSON rows)
+    uint16_t getCount() const;
+    uint16_t getMeasurementCount() const;
+    
+    // Fills 'buf' with whole rows and returns the bytes written (no NUL);
+    // 0 once the export is complete
+    size_t read(char* buf, size_t size);
+    
+    // EXPORT_BINARY addressed by byte offset, for Content-Length and ranges
+    uint32_t getSize() const;
+    // The bytes from 'offset' that are contiguous in memory (header, EEPROM
+    // cache or RTC buffer), sent without copying; length 0 past the end
+    const uint8_t* dataAt(uint32_t offset, size_t& length);
+    
+    // Single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range
+    // of a 'size' byte document; 'last' is inclusive
+    static uint8_t parseRange(const char* header, uint32_t size, uint32_t& first, uint32_t& last);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "RecordStore.h"
+
+#ifdef NATIVE
+#include "../test/native_mocks/EEPROM.h"
+#else
+#include <EEPROM.h>
+#endif
+
+uint16_t RecordStore::count(const RTCData& rtc) {
+    return rtc.romRecordCount < MAX_ROM_RECORDS ? rtc.romRecordCount : MAX_ROM_RECORDS;
+}
+
+const SensorRecord* RecordStore::span(const RTCData& rtc, uint16_t start, uint16_t& count) {
+    uint16_t stored = RecordStore::count(rtc);
+    if (start >= stored) {
+        count = 0;
+        return nullptr;
+    }
+    if (count > stored - start) {
+        count = stored - start;
+    }
+    
+    const uint8_t* data = EEPROM.getConstDataPtr();
+    if (!data) {
+        count = 0;
+        return nullptr;
+    }
+    return reinterpret_cast<const SensorRecord*>(data + ROM_DATA_START) + start;
+}
+
+uint16_t RecordStore::append(RTCData& rtc, const SensorRecord* records, uint16_t count) {
+    uint16_t stored = RecordStore::count(rtc);
+    if (count > MAX_ROM_RECORDS - stored) {
+        count = MAX_ROM_RECORDS - stored;
+        // The caller keeps what is left, so cut before a measurement
+        while (count > 0 && records[count].isChannelSlot()) {
+            count--;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    
+    // getDataPtr() marks the cache dirty, so commit() writes it back
+    uint8_t* data = EEPROM.getDataPtr();
+    if (!data) {
+        return 0;
+    }
+    memcpy(data + ROM_DATA_START + stored * sizeof(SensorRecord), records, count * sizeof(SensorRecord));
+    if (!EEPROM.commit()) {
+        Serial.println("EEPROM commit failed!");
+        return 0;
+    }
+    
+    rtc.romRecordCount = stored + count;
+    rtc.romWriteIndex = rtc.romRecordCount;
+    return count;
+}
+
+void RecordStore::clear(RTCData& rtc) {
+    rtc.romWriteIndex = 0;
+    rtc.romRecordCount = 0;
+}
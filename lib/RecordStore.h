@@ -0,0 +1,33 @@
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "SensorRecord.h"
+#include "RTCData.h"
+#include "Config.h"   // ROM_DATA_START, MAX_ROM_RECORDS
+
+// Records that overflowed the RTC buffer, kept in EEPROM after Config.
+// The EEPROM library mirrors the whole flash sector in RAM, so reads
+// hand out pointers into that copy instead of copying records one by
+// one, and writes fill the copy and commit it once.
+class RecordStore {
+public:
+    static uint16_t count(const RTCData& rtc);
+    
+    // Records [start, start + count) in place. 'count' is clamped to the
+    // records stored; the pointer is valid until the next append().
+    static const SensorRecord* span(const RTCData& rtc, uint16_t start, uint16_t& count);
+    
+    // Stores as many records as fit with a single commit, never leaving
+    // a measurement's channel slots behind. Returns the number stored.
+    static uint16_t append(RTCData& rtc, const SensorRecord* records, uint16_t count);
+    
+    static void clear(RTCData& rtc);
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "RemoteConfig.h"
+
+#include <stddef.h>
+
+struct RemoteField {
+    const char* key;
+    uint16_t offset;    // In Config
+    uint16_t size;
+    bool text;
+    uint32_t min;       // Range of numeric fields
+    uint32_t max;
+};
+
+#define REMOTE_TEXT(key, name) { key, offsetof(Config, name), sizeof(Config::name), true, 0, 0 }
+#define REMOTE_NUMBER(key, name, min, max) \
+    { key, offsetof(Config, name), sizeof(Config::name), false, min, max }
+
+// Everything the config portal sets except the WiFi credentials
+static const RemoteField REMOTE_FIELDS[] = {
+    REMOTE_NUMBER("interval", interval, CONFIG_MIN_INTERVAL, CONFIG_MAX_INTERVAL),
+    REMOTE_NUMBER("sink", uploadSink, UPLOAD_SINK_INFLUX_HTTP, UPLOAD_SINK_BINARY),
+    REMOTE_TEXT("server", influxServer),
+    REMOTE_NUMBER("port", influxPort, 1, 65535),
+    REMOTE_NUMBER("apiversion", influxVersion, INFLUX_API_V1, INFLUX_API_V2),
+    REMOTE_TEXT("database", influxDb),
+    REMOTE_TEXT("user", influxUser),
+    REMOTE_TEXT("dbpass", influxPass),
+    REMOTE_TEXT("org", influxOrg),
+    REMOTE_TEXT("bucket", influxBucket),
+    REMOTE_TEXT("token", influxToken),
+    REMOTE_TEXT("measurement", influxMeasurement),
+    REMOTE_TEXT("location", location),
+    REMOTE_TEXT("otaurl", otaUrl),
+    REMOTE_TEXT("configpath", configPath),
+};
+
+static const size_t REMOTE_FIELD_COUNT = sizeof(REMOTE_FIELDS) / sizeof(REMOTE_FIELDS[0]);
+
+// Whole-string unsigned number
+static bool parseNumber(const char* text, uint32_t& value) {
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+    char* end;
+    unsigned long parsed = strtoul(text, &end, 10);
+    if (*end != '\0' || parsed > 0xFFFFFFFFUL) {
+        return false;
+    }
+    value = (uint32_t)parsed;
+    return true;
+}
+
+size_t RemoteConfig::requestHeaders(char* buf, size_t size, const Config& config, const uint8_t deviceId[6]) {
+    int n = snprintf(buf, size, "X-Device-Id: %02x%02x%02x%02x%02x%02x\r\n",
+                     deviceId[0], deviceId[1], deviceId[2], deviceId[3], deviceId[4], deviceId[5]);
+    if (n > 0 && (size_t)n < size && config.configVersion > 0) {
+        n += snprintf(buf + n, size - n, "If-None-Match: \"%u\"\r\n", (unsigned int)config.configVersion);
+    }
+    if (n < 0 || (size_t)n >= size) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return n;
+}
+
+uint8_t RemoteConfig::apply(Config& config, const char* document, const char*& error) {
+    Config candidate(config);
+    bool hasVersion = false;
+    uint32_t version = 0;
+    error = nullptr;
+
+    const char* line = document;
+    while (*line) {
+        size_t length = strcspn(line, "\n");
+        const char* next = line[length] ? line + length + 1 : line + length;
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+
+        const char* equals = (const char*)memchr(line, '=', length);
+        if (length == 0 || line[0] == '#') {
+            // Blank line or comment
+        } else if (!equals || equals == line) {
+            error = error ? error : "Line without key=value";
+        } else {
+            char value[128];
+            size_t keyLength = equals - line;
+            size_t valueLength = length - keyLength - 1;
+            if (valueLength >= sizeof(value)) {
+                error = error ? error : "Value too long";
+            } else {
+                memcpy(value, equals + 1, valueLength);
+                value[valueLength] = '\0';
+                if (keyLength == 7 && strncmp(line, "version", 7) == 0) {
+                    hasVersion = parseNumber(value, version) && version <= 65535;
+                } else if (!applyLine(candidate, line, keyLength, value)) {
+                    error = error ? error : "Value does not fit its setting";
+                }
+            }
+        }
+        line = next;
+    }
+
+    if (!hasVersion) {
+        error = "Document has no version";
+        return REMOTE_CONFIG_INVALID;
+    }
+    if (version == config.configVersion) {
+        error = nullptr;
+        return REMOTE_CONFIG_UNCHANGED;
+    }
+    if (error) {
+        return REMOTE_CONFIG_INVALID;
+    }
+    candidate.configVersion = version;
+    error = candidate.validate();
+    if (error) {
+        return REMOTE_CONFIG_INVALID;
+    }
+
+    config = candidate;
+    return REMOTE_CONFIG_APPLIED;
+}
+
+// False if the value is unusable for a known key; unknown keys are skipped
+bool RemoteConfig::applyLine(Config& config, const char* key, size_t keyLength, const char* value) {
+    for (size_t i = 0; i < REMOTE_FIELD_COUNT; i++) {
+        const RemoteField& field = REMOTE_FIELDS[i];
+        if (strlen(field.key) != keyLength || strncmp(field.key, key, keyLength) != 0) {
+            continue;
+        }
+
+        uint8_t* member = (uint8_t*)&config + field.offset;
+        if (field.text) {
+            size_t length = strlen(value);
+            if (length >= field.size) {
+                return false;
+            }
+            memset(member, 0, field.size);
+            memcpy(member, value, length);
+            return true;
+        }
+
+        uint32_t number;
+        if (!parseNumber(value, number) || number < field.min || number > field.max) {
+            return false;
+        }
+        if (field.size == 1) {
+            uint8_t narrow = (uint8_t)number;
+            memcpy(member, &narrow, 1);
+        } else {
+            uint16_t narrow = (uint16_t)number;
+            memcpy(member, &narrow, 2);
+        }
+        return true;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef REMOTE_CONFIG_H
+#define REMOTE_CONFIG_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "Config.h"
+
+#define REMOTE_CONFIG_MAX_SIZE 512   // Larger documents are refused
+
+// apply() results
+#define REMOTE_CONFIG_UNCHANGED 0   // Same version as applied before
+#define REMOTE_CONFIG_APPLIED 1     // Settings changed, save them
+#define REMOTE_CONFIG_INVALID 2     // Nothing changed, see the error
+
+// Settings pushed from the upload server. The station fetches
+// Config::configPath over the connection it just uploaded on, so a check
+// costs one small request per upload:
+//
+//   GET /meteo.cfg HTTP/1.1
+//   If-None-Match: "<version applied last>"
+//   X-Device-Id: <MAC address, 12 hex digits>
+//
+// The server may answer 304 when nothing changed. A document is plain
+// "key=value" lines, keys as in the config portal form; '#' starts a
+// comment line:
+//
+//   version=12
+//   interval=600
+//   measurement=environment
+//
+// 'version' is required and the rest is only read when it differs from
+// the version applied last. Keys that are missing keep their value, and
+// unknown keys are skipped so newer servers can add some. WiFi
+// credentials cannot be changed this way: a typo there would leave the
+// station unreachable for the next correction.
+class RemoteConfig {
+public:
+    // Request header lines for the document GET
+    static size_t requestHeaders(char* buf, size_t size, const Config& config, const uint8_t deviceId[6]);
+
+    // Applies 'document' to 'config' if its version is new and the
+    // result passes Config::validate(). 'config' is left untouched
+    // otherwise; 'error' says why on REMOTE_CONFIG_INVALID.
+    static uint8_t apply(Config& config, const char* document, const char*& error);
+
+private:
+    static bool applyLine(Config& config, const char* key, size_t keyLength, const char* value);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "RetryScheduler.h"
+
+void RetryScheduler::reset() {
+    failures = 0;
+    lastFailure = 0;
+    channel = 0;
+    memset(bssid, 0, sizeof(bssid));
+    waitSeconds = 0;
+}
+
+bool RetryScheduler::isPending() const {
+    return failures > 0;
+}
+
+bool RetryScheduler::isDue() const {
+    return failures > 0 && waitSeconds == 0;
+}
+
+bool RetryScheduler::isDueAfter(uint32_t seconds) const {
+    return failures > 0 && waitSeconds <= seconds;
+}
+
+void RetryScheduler::elapse(uint32_t seconds) {
+    waitSeconds = seconds < waitSeconds ? waitSeconds - seconds : 0;
+}
+
+void RetryScheduler::recordFailure(uint8_t reason, uint32_t random) {
+    if (reason == RETRY_FAIL_WIFI && useFastConnect()) {
+        // The AP may have moved channel; scan on the next attempt
+        channel = 0;
+    }
+    if (failures < 255) {
+        failures++;
+    }
+    lastFailure = reason;
+
+    // Equal jitter: half the backoff fixed, half random, so a fleet that
+    // lost the same AP does not come back in lockstep
+    uint32_t backoff = backoffSeconds();
+    waitSeconds = backoff / 2 + random % (backoff / 2 + 1);
+}
+
+void RetryScheduler::recordSuccess() {
+    failures = 0;
+    lastFailure = 0;
+    waitSeconds = 0;
+}
+
+void RetryScheduler::rememberAccessPoint(const uint8_t apBssid[6], uint8_t apChannel) {
+    memcpy(bssid, apBssid, sizeof(bssid));
+    channel = apChannel;
+}
+
+bool RetryScheduler::useFastConnect() const {
+    return channel > 0;
+}
+
+uint32_t RetryScheduler::backoffSeconds() const {
+    if (failures == 0) {
+        return 0;
+    }
+    uint32_t backoff = RETRY_BASE_SECONDS;
+    for (uint8_t i = 1; i < failures && backoff < RETRY_MAX_SECONDS; i++) {
+        backoff *= 2;
+    }
+    return backoff < RETRY_MAX_SECONDS ? backoff : RETRY_MAX_SECONDS;
+}
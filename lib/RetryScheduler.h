@@ -0,0 +1,49 @@
+#ifndef RETRY_SCHEDULER_H
+#define RETRY_SCHEDULER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#define RETRY_BASE_SECONDS 300      // Backoff after the first failure, doubled per failure
+#define RETRY_MAX_SECONDS 21600     // Backoff ceiling (6 hours)
+
+// Why an upload attempt failed
+#define RETRY_FAIL_WIFI 1     // Never got on the access point
+#define RETRY_FAIL_UPLOAD 2   // Connected, but the upload did not go through
+
+// Upload retry state kept in RTC memory across deep sleep.
+// There is no wall clock while sleeping, so the wait is counted down by
+// the time slept on each wake instead of comparing against a timestamp.
+class RetryScheduler {
+public:
+    uint8_t failures;       // Consecutive failed attempts, 0 = nothing pending
+    uint8_t lastFailure;    // RETRY_FAIL_* of the last failed attempt
+    uint8_t channel;        // Channel of the last good AP, 0 = unknown
+    uint8_t bssid[6];       // BSSID of the last good AP
+    uint32_t waitSeconds;   // Sleep left before the next attempt
+
+    void reset();
+
+    bool isPending() const;
+    bool isDue() const;
+    // True if an attempt will be due after sleeping this long
+    bool isDueAfter(uint32_t seconds) const;
+    void elapse(uint32_t seconds);
+
+    // Schedules the next attempt; 'random' supplies the jitter
+    void recordFailure(uint8_t reason, uint32_t random);
+    void recordSuccess();
+
+    // Cached AP details allow a connect without a channel scan.
+    // Forgotten after a failed fast connect so the next try scans again.
+    void rememberAccessPoint(const uint8_t apBssid[6], uint8_t apChannel);
+    bool useFastConnect() const;
+
+    // Backoff for the current failure count, before jitter
+    uint32_t backoffSeconds() const;
+};
+
+#endif
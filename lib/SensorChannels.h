@@ -0,0 +1,42 @@
+#ifndef SENSOR_CHANNELS_H
+#define SENSOR_CHANNELS_H
+
+// Measurement channels shared by the station (SensorRecord, drivers) and
+// the host tools (BinaryProtocol). Plain C++ - no Arduino headers.
+//
+// Every record holds temperature and humidity. Other channels are only
+// stored when a sensor provides them, each in a 4-byte channel slot right
+// after its record (see SensorRecord.h), so an AHT-only station keeps
+// 4 bytes per measurement.
+
+#include <stdint.h>
+
+// Channel bits (SensorDriver::channels(), Measurement::channels)
+#define SENSOR_TEMPERATURE 0x01
+#define SENSOR_HUMIDITY 0x02
+#define SENSOR_PRESSURE 0x04            // hPa, stored in 0.1 hPa
+#define SENSOR_PROBE_TEMPERATURE 0x08   // Second (e.g. DS18B20) probe, stored in 0.01 °C
+#define SENSOR_OPTIONAL_CHANNELS (SENSOR_PRESSURE | SENSOR_PROBE_TEMPERATURE)
+
+// Values of the humidity byte of a stored record
+#define SENSOR_NO_HUMIDITY 0xFE    // Measured without a humidity sensor
+#define SENSOR_CHANNEL_SLOT 0xFF   // Not a measurement but a channel slot
+
+// Records one measurement takes at most: itself and one slot per optional channel
+#define SENSOR_MAX_SLOTS 3
+
+// Field name of an optional channel in line protocol and exports
+inline const char* sensorChannelName(uint8_t channel) {
+    switch (channel) {
+        case SENSOR_PRESSURE: return "pressure";
+        case SENSOR_PROBE_TEMPERATURE: return "probe_temperature";
+        default: return nullptr;
+    }
+}
+
+// Decimal places of a stored channel value (value = stored / 10^decimals)
+inline uint8_t sensorChannelDecimals(uint8_t channel) {
+    return channel == SENSOR_PROBE_TEMPERATURE ? 2 : 1;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SENSOR_DRIVER_H
+#define SENSOR_DRIVER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "SensorRecord.h"
+
+// One sensor chip behind SensorManager. All sensors hang off the same
+// switched supply, so a measurement is: power on, start() every driver,
+// then read() each one once its own conversion time has passed. Slow
+// and fast sensors convert in parallel instead of one after the other.
+class SensorDriver {
+public:
+    virtual ~SensorDriver() {}
+
+    virtual const char* name() const = 0;
+
+    // SENSOR_* channels read() can set
+    virtual uint8_t channels() const = 0;
+
+    // Time the chip needs after power-on before it answers
+    virtual uint16_t powerUpMs() const = 0;
+
+    // Probe the chip and start a conversion; false if it does not answer,
+    // which is how fitted sensors are detected
+    virtual bool start() = 0;
+
+    // Time from start() until read() has a result
+    virtual uint16_t conversionMs() const = 0;
+
+    // Collect the conversion with Measurement::set()
+    virtual bool read(Measurement& measurement) = 0;
+};
+
+#endif
@@ -1,57 +1,136 @@
 #include "SensorManager.h"
-#include "SensorRecord.h"
-#include <Wire.h>
-#include <Adafruit_AHTX0.h>
 
-SensorManager::SensorManager(uint8_t pin) : powerPin(pin), aht(nullptr) {
+SensorManager::SensorManager(uint8_t pin) : driverCount(0), powerPin(pin) {
 }
 
-SensorManager::~SensorManager() {
-    if (aht) {
-        delete aht;
+bool SensorManager::addDriver(SensorDriver* driver) {
+    if (driverCount >= SENSOR_MAX_DRIVERS) {
+        return false;
     }
+    drivers[driverCount++] = driver;
+    return true;
 }
 
 bool SensorManager::begin() {
     pinMode(powerPin, OUTPUT);
     powerOff();
-    aht = new Adafruit_AHTX0();
-    return true;
+    return driverCount > 0;
 }
 
 void SensorManager::powerOn() {
     digitalWrite(powerPin, HIGH);
-    delay(100); // Wait for sensor to stabilize
+    
+    // Wait for the slowest sensor to come up
+    uint16_t wait = 0;
+    for (uint8_t i = 0; i < driverCount; i++) {
+        if (drivers[i]->powerUpMs() > wait) {
+            wait = drivers[i]->powerUpMs();
+        }
+    }
+    delay(wait);
 }
 
 void SensorManager::powerOff() {
     digitalWrite(powerPin, LOW);
 }
 
-bool SensorManager::takeMeasurement(float& temperature, float& humidity) {
-    if (!aht) {
-        Serial.println("AHT10 not initialized!");
+bool SensorManager::takeMeasurement(Measurement& measurement) {
+    if (driverCount == 0) {
+        Serial.println("No sensor drivers registered!");
         return false;
     }
     
     powerOn();
-    Wire.begin();
     
-    if (!aht->begin()) {
-        Serial.println("Failed to initialize AHT10!");
-        powerOff();
+    // Start every conversion, then collect them as they finish
+    uint32_t started = millis();
+    bool pending[SENSOR_MAX_DRIVERS];
+    Measurement readings[SENSOR_MAX_DRIVERS];
+    uint8_t found = 0;
+    for (uint8_t i = 0; i < driverCount; i++) {
+        pending[i] = drivers[i]->start();
+        found += pending[i];
+    }
+    
+    bool anyRead = false;
+    while (true) {
+        int8_t next = -1;
+        for (uint8_t i = 0; i < driverCount; i++) {
+            if (pending[i] && (next < 0 || drivers[i]->conversionMs() < drivers[next]->conversionMs())) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        
+        uint32_t elapsed = millis() - started;
+        if (elapsed < drivers[next]->conversionMs()) {
+            delay(drivers[next]->conversionMs() - elapsed);
+        }
+        pending[next] = false;
+        if (drivers[next]->read(readings[next])) {
+            anyRead = true;
+        } else {
+            Serial.printf("%s read failed\n", drivers[next]->name());
+        }
+    }
+    
+    powerOff();
+    
+    if (found == 0) {
+        Serial.println("No sensor found!");
+        return false;
+    }
+    if (!anyRead) {
         return false;
     }
     
-    sensors_event_t humidity_event, temp_event;
-    aht->getEvent(&humidity_event, &temp_event);
+    // In registration order, so the preferred sensor's channels win
+    measurement = Measurement();
+    for (uint8_t i = 0; i < driverCount; i++) {
+        for (uint8_t channel = 1; channel != 0; channel <<= 1) {
+            if (readings[i].channels & channel) {
+                measurement.set(channel, readings[i].get(channel));
+            }
+        }
+    }
     
-    temperature = temp_event.temperature;
-    humidity = humidity_event.relative_humidity;
+    // A lone probe measures the station temperature
+    if (!(measurement.channels & SENSOR_TEMPERATURE) && (measurement.channels & SENSOR_PROBE_TEMPERATURE)) {
+        measurement.set(SENSOR_TEMPERATURE, measurement.probeTemperature);
+        measurement.channels &= ~SENSOR_PROBE_TEMPERATURE;
+    }
     
-    powerOff();
+    Serial.printf("%u of %u sensors in %lu ms\n", (unsigned int)found, (unsigned int)driverCount,
+                  (unsigned long)(millis() - started));
+    return validateChannels(measurement);
+}
+
+// Temperature is required and humidity checked as before; an implausible
+// optional channel is dropped instead of losing the whole measurement
+bool SensorManager::validateChannels(Measurement& measurement) const {
+    if (!(measurement.channels & SENSOR_TEMPERATURE)) {
+        Serial.println("No temperature reading");
+        return false;
+    }
+    float humidity = measurement.channels & SENSOR_HUMIDITY ? measurement.humidity : 50;
+    if (!validateReadings(measurement.temperature, humidity)) {
+        return false;
+    }
     
-    return validateReadings(temperature, humidity);
+    if ((measurement.channels & SENSOR_PRESSURE) &&
+        (isnan(measurement.pressure) || measurement.pressure < 300 || measurement.pressure > 1100)) {
+        Serial.println("Pressure out of valid range");
+        measurement.channels &= ~SENSOR_PRESSURE;
+    }
+    if ((measurement.channels & SENSOR_PROBE_TEMPERATURE) &&
+        (isnan(measurement.probeTemperature) || measurement.probeTemperature < -55 ||
+         measurement.probeTemperature > 125)) {
+        Serial.println("Probe temperature out of valid range");
+        measurement.channels &= ~SENSOR_PROBE_TEMPERATURE;
+    }
+    return true;
 }
 
 bool SensorManager::validateReadings(float temp, float hum) const {
@@ -1,29 +1,44 @@
 #ifndef SENSOR_MANAGER_H
 #define SENSOR_MANAGER_H
 
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
 #include <Arduino.h>
+#endif
+
+#include "SensorDriver.h"
+#include "SensorRecord.h"
 
-// Forward declarations
-class Adafruit_AHTX0;
-class SensorRecord;
+#define SENSOR_MAX_DRIVERS 4
 
+// Measures with every registered driver whose sensor is fitted. All
+// sensors share the switched supply on powerPin and convert in parallel,
+// so a measurement takes the slowest sensor's time, not the sum.
 class SensorManager {
 private:
-    Adafruit_AHTX0* aht;
+    SensorDriver* drivers[SENSOR_MAX_DRIVERS];
+    uint8_t driverCount;
     uint8_t powerPin;
     
 public:
     SensorManager(uint8_t powerPin);
-    ~SensorManager();
+    
+    // Drivers added first win when several sensors measure the same channel
+    bool addDriver(SensorDriver* driver);
     
     bool begin();
     void powerOn();
     void powerOff();
     
-    bool takeMeasurement(float& temperature, float& humidity);
+    // False if no sensor answered or the readings are implausible
+    bool takeMeasurement(Measurement& measurement);
     bool validateReadings(float temp, float hum) const;
     
     SensorRecord createRecord(float temp, float hum, uint32_t timestampSeconds, uint32_t offsetSeconds) const;
+    
+private:
+    bool validateChannels(Measurement& measurement) const;
 };
 
 #endif
@@ -1,5 +1,33 @@
 #include "SensorRecord.h"
 
+Measurement::Measurement()
+    : channels(0), temperature(0), humidity(0), pressure(0), probeTemperature(0) {
+}
+
+void Measurement::set(uint8_t channel, float value) {
+    if (channels & channel) {
+        return;
+    }
+    switch (channel) {
+        case SENSOR_TEMPERATURE: temperature = value; break;
+        case SENSOR_HUMIDITY: humidity = value; break;
+        case SENSOR_PRESSURE: pressure = value; break;
+        case SENSOR_PROBE_TEMPERATURE: probeTemperature = value; break;
+        default: return;
+    }
+    channels |= channel;
+}
+
+float Measurement::get(uint8_t channel) const {
+    switch (channel) {
+        case SENSOR_TEMPERATURE: return temperature;
+        case SENSOR_HUMIDITY: return humidity;
+        case SENSOR_PRESSURE: return pressure;
+        case SENSOR_PROBE_TEMPERATURE: return probeTemperature;
+        default: return NAN;
+    }
+}
+
 SensorRecord SensorRecord::create(float temp, float hum, uint32_t timestampSeconds, uint32_t timeOffsetSeconds) {
     SensorRecord record;
     
@@ -19,6 +47,71 @@ SensorRecord SensorRecord::create(float temp, float hum, uint32_t timestampSecon
     return record;
 }
 
+uint8_t SensorRecord::pack(const Measurement& measurement, uint32_t timestampSeconds,
+                          uint32_t timeOffsetSeconds, SensorRecord* out) {
+    out[0] = create(measurement.temperature, measurement.humidity, timestampSeconds, timeOffsetSeconds);
+    if (!(measurement.channels & SENSOR_HUMIDITY)) {
+        out[0].humidity = SENSOR_NO_HUMIDITY;
+    }
+    
+    uint8_t count = 1;
+    for (uint8_t channel = SENSOR_PRESSURE; channel & SENSOR_OPTIONAL_CHANNELS; channel <<= 1) {
+        if (!(measurement.channels & channel)) {
+            continue;
+        }
+        float scaled = measurement.get(channel);
+        for (uint8_t i = 0; i < sensorChannelDecimals(channel); i++) {
+            scaled *= 10;
+        }
+        long value = constrain(lroundf(scaled), -32768, 32767);
+        out[count].timestamp = (uint16_t)(int16_t)value;
+        out[count].temperature = (int8_t)channel;
+        out[count].humidity = SENSOR_CHANNEL_SLOT;
+        count++;
+    }
+    return count;
+}
+
+bool SensorRecord::isChannelSlot() const {
+    return humidity == SENSOR_CHANNEL_SLOT;
+}
+
+bool SensorRecord::hasHumidity() const {
+    return humidity <= 100;
+}
+
+uint8_t SensorRecord::getChannel() const {
+    return (uint8_t)temperature;
+}
+
+float SensorRecord::getChannelValue() const {
+    float value = (int16_t)timestamp;
+    for (uint8_t i = 0; i < sensorChannelDecimals(getChannel()); i++) {
+        value /= 10;
+    }
+    return value;
+}
+
+uint8_t SensorRecord::countSlots(const SensorRecord* records, size_t count) {
+    uint8_t slots = 0;
+    while (slots + 1u < count && records[slots + 1].isChannelSlot()) {
+        slots++;
+    }
+    return slots;
+}
+
+void SensorRecord::decode(const SensorRecord* records, size_t count, uint32_t timeOffsetSeconds,
+                          uint32_t* __restrict__ timestamps, int16_t* __restrict__ temperatures,
+                          uint8_t* __restrict__ humidities) {
+    // Same arithmetic as getTimestampSeconds()/getTemperature()
+    uint32_t offsetMinutes = timeOffsetSeconds / 60;
+    for (size_t i = 0; i < count; i++) {
+        timestamps[i] = (offsetMinutes + records[i].timestamp) * 60;
+        temperatures[i] = (int16_t)(uint8_t)records[i].temperature - 100;
+        humidities[i] = records[i].humidity;
+    }
+}
+
 float SensorRecord::getTemperature() const {
     // temperature is signed int8_t, need to treat as unsigned for calculation
     uint8_t unsignedTemp = (uint8_t)temperature;
@@ -26,7 +119,7 @@ float SensorRecord::getTemperature() const {
 }
 
 float SensorRecord::getHumidity() const {
-    return humidity;
+    return hasHumidity() ? humidity : NAN;
 }
 
 uint32_t SensorRecord::getTimestampSeconds(uint32_t timeOffsetSeconds) const {
@@ -37,17 +130,20 @@ uint32_t SensorRecord::getTimestampSeconds(uint32_t timeOffsetSeconds) const {
 }
 
 bool SensorRecord::isValid() const {
+    if (isChannelSlot()) {
+        return sensorChannelName(getChannel()) != nullptr;
+    }
+    
     // Check if values are within reasonable ranges
     float temp = getTemperature();
     float hum = getHumidity();
     
-    return (temp >= -100 && temp <= 155 && hum >= 0 && hum <= 100);
+    return (temp >= -100 && temp <= 155 && ((hum >= 0 && hum <= 100) || humidity == SENSOR_NO_HUMIDITY));
 }
 
-String SensorRecord::toInfluxLine(const char* measurement, uint32_t timeOffsetSeconds) const {
-    String line = String(measurement) + " ";
-    line += "temperature=" + String(getTemperature(), 1) + ",";
-    line += "humidity=" + String(getHumidity(), 1) + " ";
-    line += String(getTimestampSeconds(timeOffsetSeconds)) + "000000000\n";
-    return line;
+String SensorRecord::toInfluxLine(const char* measurement, uint32_t timeOffsetSeconds,
+                                  TimePrecision precision) const {
+    char line[LineProtocol::MAX_LINE];
+    LineProtocol::encodeRecord(line, sizeof(line), measurement, *this, timeOffsetSeconds, precision);
+    return String(line);
 }
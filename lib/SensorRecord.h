@@ -7,20 +7,71 @@
 #include <Arduino.h>
 #endif
 
+#include "LineProtocol.h"
+#include "SensorChannels.h"
+
+// One measurement before packing; only the channels set in 'channels'
+// hold a value
+struct Measurement {
+    uint8_t channels;          // SENSOR_* bits
+    float temperature;         // °C
+    float humidity;            // %
+    float pressure;            // hPa
+    float probeTemperature;    // °C
+    
+    Measurement();
+    
+    // Sets a channel unless another sensor already did; the first
+    // driver to report a channel wins
+    void set(uint8_t channel, float value);
+    float get(uint8_t channel) const;
+};
+
+// A stored measurement, or a channel slot carrying one optional channel
+// of the measurement before it:
+//
+//   measurement:  timestamp  temperature  humidity (0-100, SENSOR_NO_HUMIDITY)
+//   channel slot: value      channel      SENSOR_CHANNEL_SLOT
+//
+// Slots are 4 bytes like measurements, so buffers, EEPROM and exports
+// keep handling fixed-size records; readers skip them or attach them to
+// the measurement before.
 class SensorRecord {
 public:
-    uint16_t timestamp;    // Minutes since timeOffset (16-bit = ~45 days)
-    int8_t temperature;    // Temp + 100 (range: -100 to +155°C)
+    uint16_t timestamp;    // Minutes since timeOffset (16-bit = ~45 days); slot: int16 value
+    int8_t temperature;    // Temp + 100 (range: -100 to +155°C); slot: SENSOR_* channel bit
     uint8_t humidity;      // 0-100%
     
     static SensorRecord create(float temp, float hum, uint32_t timestampSeconds, uint32_t timeOffsetSeconds);
     
+    // Measurement and a slot for each optional channel present. 'out'
+    // needs room for SENSOR_MAX_SLOTS records; returns the number used.
+    static uint8_t pack(const Measurement& measurement, uint32_t timestampSeconds,
+                        uint32_t timeOffsetSeconds, SensorRecord* out);
+    
+    bool isChannelSlot() const;
+    bool hasHumidity() const;
+    // Channel slots only
+    uint8_t getChannel() const;
+    float getChannelValue() const;
+    
+    // Number of channel slots following records[0], within 'count' records
+    static uint8_t countSlots(const SensorRecord* records, size_t count);
+    
+    // Decode 'count' consecutive records into separate timestamp (seconds),
+    // temperature (°C) and humidity (%) arrays in one branch-free pass,
+    // which the compiler can vectorize. Channel slots come out with
+    // humidity SENSOR_CHANNEL_SLOT and the other values meaningless.
+    static void decode(const SensorRecord* records, size_t count, uint32_t timeOffsetSeconds,
+                       uint32_t* timestamps, int16_t* temperatures, uint8_t* humidities);
+    
     float getTemperature() const;
     float getHumidity() const;
     uint32_t getTimestampSeconds(uint32_t timeOffsetSeconds) const;
     
     bool isValid() const;
-    String toInfluxLine(const char* measurement, uint32_t timeOffsetSeconds) const;
+    String toInfluxLine(const char* measurement, uint32_t timeOffsetSeconds,
+                        TimePrecision precision = PRECISION_NS) const;
 };
 
 #endif
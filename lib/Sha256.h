@@ -0,0 +1,34 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+// SHA-256 (FIPS 180-4) for checking downloaded firmware. Plain C++ so
+// the same code runs in the native tests and the host tools.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32
+
+class Sha256 {
+public:
+    Sha256();
+    
+    void reset();
+    void update(const uint8_t* data, size_t length);
+    void finish(uint8_t digest[SHA256_SIZE]);
+    
+    // Lower-case hex, 'hex' holds 2 * SHA256_SIZE + 1 characters
+    static void toHex(const uint8_t digest[SHA256_SIZE], char* hex);
+    // False unless 'hex' is exactly 64 hex digits
+    static bool fromHex(const char* hex, uint8_t digest[SHA256_SIZE]);
+    
+private:
+    uint32_t state[8];
+    uint64_t bytes;
+    uint8_t block[64];
+    size_t blockLength;
+    
+    void transform(const uint8_t* data);
+};
+
+#endif
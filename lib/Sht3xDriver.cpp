@@ -0,0 +1,45 @@
+#include "Sht3xDriver.h"
+
+#define SHT3X_MEASURE_HIGH 0x2400   // Single shot, high repeatability
+
+Sht3xDriver::Sht3xDriver(I2cBus& bus, uint8_t address) : bus(bus), address(address) {
+}
+
+const char* Sht3xDriver::name() const {
+    return "SHT3x";
+}
+
+uint8_t Sht3xDriver::channels() const {
+    return SENSOR_TEMPERATURE | SENSOR_HUMIDITY;
+}
+
+uint16_t Sht3xDriver::powerUpMs() const {
+    return 2;
+}
+
+bool Sht3xDriver::start() {
+    const uint8_t command[] = { SHT3X_MEASURE_HIGH >> 8, SHT3X_MEASURE_HIGH & 0xFF };
+    return bus.write(address, command, sizeof(command));
+}
+
+uint16_t Sht3xDriver::conversionMs() const {
+    return 16;
+}
+
+bool Sht3xDriver::read(Measurement& measurement) {
+    uint8_t data[6];
+    if (!bus.read(address, data, sizeof(data))) {
+        return false;
+    }
+    // CRC over each 16-bit word
+    if (I2cBus::crc8(data, 2) != data[2] || I2cBus::crc8(data + 3, 2) != data[5]) {
+        Serial.println("SHT3x CRC mismatch");
+        return false;
+    }
+    
+    uint16_t rawTemperature = ((uint16_t)data[0] << 8) | data[1];
+    uint16_t rawHumidity = ((uint16_t)data[3] << 8) | data[4];
+    measurement.set(SENSOR_TEMPERATURE, -45.0f + 175.0f * rawTemperature / 65535.0f);
+    measurement.set(SENSOR_HUMIDITY, 100.0f * rawHumidity / 65535.0f);
+    return true;
+}
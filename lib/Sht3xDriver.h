@@ -0,0 +1,33 @@
+#ifndef SHT3X_DRIVER_H
+#define SHT3X_DRIVER_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "I2cBus.h"
+#include "SensorDriver.h"
+
+#define SHT3X_ADDRESS 0x44   // ADDR pin low; 0x45 when high
+
+// Sensirion SHT30/31/35: single shot, high repeatability, no clock
+// stretching, so the bus is free while the sensor converts
+class Sht3xDriver : public SensorDriver {
+public:
+    explicit Sht3xDriver(I2cBus& bus, uint8_t address = SHT3X_ADDRESS);
+    
+    const char* name() const;
+    uint8_t channels() const;
+    uint16_t powerUpMs() const;
+    bool start();
+    uint16_t conversionMs() const;
+    bool read(Measurement& measurement);
+    
+private:
+    I2cBus& bus;
+    uint8_t address;
+};
+
+#endif
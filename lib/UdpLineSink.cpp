@@ -0,0 +1,96 @@
+#include "UdpLineSink.h"
+#include "HostResolver.h"
+
+UdpLineSink::UdpLineSink() : resolved(false), packetLength(0), packetsSent(0) {
+    // UDP listeners take the timestamp unit from their own config,
+    // where nanoseconds is the default
+    precision = PRECISION_NS;
+}
+
+bool UdpLineSink::begin(Config* cfg) {
+    config = cfg;
+    
+    if (!config || !config->isValid()) {
+        Serial.println("Invalid configuration for UDP upload");
+        return false;
+    }
+    
+    if (!prepareSeries()) {
+        Serial.println("Measurement and tags too long");
+        return false;
+    }
+    
+    packetLength = 0;
+    packetsSent = 0;
+    resolved = false;
+    lastError = "";
+    lastErrorKind = UPLOAD_OK;
+    
+    Serial.printf("UDP line protocol to %s:%d\n", config->influxServer, config->influxPort);
+    return true;
+}
+
+bool UdpLineSink::writeLine(const char* line, size_t length) {
+    if (!config) {
+        return false;
+    }
+    
+    // Never split a line across datagrams
+    if (packetLength + length > PACKET_SIZE && !sendPacket()) {
+        return false;
+    }
+    
+    memcpy(packet + packetLength, line, length);
+    packetLength += length;
+    return true;
+}
+
+bool UdpLineSink::sendPacket() {
+    if (packetLength == 0) {
+        return true;
+    }
+    
+    if (!resolved) {
+        if (!HostResolver::resolve(config->influxServer, server)) {
+            packetLength = 0;
+            lastError = "DNS lookup failed";
+            lastErrorKind = UPLOAD_ERROR_DNS;
+            return false;
+        }
+        resolved = true;
+    }
+    
+    bool sent = udp.beginPacket(server, config->influxPort) &&
+                udp.write((const uint8_t*)packet, packetLength) == packetLength &&
+                udp.endPacket();
+    packetLength = 0;
+    
+    if (!sent) {
+        lastError = "UDP send failed";
+        lastErrorKind = UPLOAD_ERROR_NETWORK;
+        return false;
+    }
+    
+    packetsSent++;
+    return true;
+}
+
+bool UdpLineSink::flush() {
+    if (!config) {
+        return false;
+    }
+    
+    bool success = sendPacket() && lastError.length() == 0;
+    if (success) {
+        Serial.printf("UDP sent %u packets\n", (unsigned int)packetsSent);
+    }
+    return success;
+}
+
+void UdpLineSink::close() {
+    udp.stop();
+}
+
+uint16_t UdpLineSink::getPacketsSent() const {
+    return packetsSent;
+}
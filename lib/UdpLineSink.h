@@ -0,0 +1,44 @@
+#ifndef UDP_LINE_SINK_H
+#define UDP_LINE_SINK_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#include "../test/native_mocks/WiFiUdp.h"
+#else
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#endif
+
+#include "UploadSink.h"
+
+// Line protocol over UDP (InfluxDB [[udp]] service or Telegraf
+// socket_listener). No handshake and no responses, so it costs the least
+// radio time - but delivery is not confirmed.
+class UdpLineSink : public UploadSink {
+public:
+    // Whole lines per datagram, well below the 1472-byte Ethernet MTU payload
+    static const size_t PACKET_SIZE = 512;
+    
+    UdpLineSink();
+    
+    bool begin(Config* cfg);
+    bool flush();
+    void close();
+    
+    uint16_t getPacketsSent() const;
+    
+protected:
+    bool writeLine(const char* line, size_t length);
+    
+private:
+    WiFiUDP udp;
+    IPAddress server;          // Resolved once per session
+    bool resolved;
+    char packet[PACKET_SIZE];
+    size_t packetLength;
+    uint16_t packetsSent;
+    
+    bool sendPacket();
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef UPLOAD_ERROR_H
+#define UPLOAD_ERROR_H
+
+// Why an upload failed, for diagnostics
+enum UploadError {
+    UPLOAD_OK = 0,
+    UPLOAD_ERROR_DNS,        // Server name did not resolve
+    UPLOAD_ERROR_CONNECT,    // Address known, but no connection (refused, timed out)
+    UPLOAD_ERROR_AUTH,       // Credentials rejected (HTTP 401/403, MQTT refused)
+    UPLOAD_ERROR_REJECTED,   // Request refused for another reason (other 4xx)
+    UPLOAD_ERROR_SERVER,     // Server-side failure (5xx)
+    UPLOAD_ERROR_NETWORK     // Connection lost, or no response in time
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "UploadSink.h"
+
+#ifndef NATIVE
+#include <ESP8266WiFi.h>
+#endif
+
+UploadSink::UploadSink() : config(nullptr), precision(PRECISION_NS), lastErrorKind(UPLOAD_OK) {
+    memset(deviceId, 0, sizeof(deviceId));
+    series[0] = '\0';
+#ifndef NATIVE
+    WiFi.macAddress(deviceId);
+#endif
+}
+
+bool UploadSink::prepareSeries() {
+    char device[13];
+    snprintf(device, sizeof(device), "%02x%02x%02x%02x%02x%02x",
+             deviceId[0], deviceId[1], deviceId[2], deviceId[3], deviceId[4], deviceId[5]);
+    
+    if (LineProtocol::encodeSeries(series, sizeof(series), config->influxMeasurement,
+                                   device, config->location) == 0) {
+        lastError = "Measurement and tags too long";
+        return false;
+    }
+    return true;
+}
+
+void UploadSink::setDeviceId(const uint8_t id[6]) {
+    memcpy(deviceId, id, sizeof(deviceId));
+}
+
+const uint8_t* UploadSink::getDeviceId() const {
+    return deviceId;
+}
+
+const char* UploadSink::getSeriesKey() const {
+    return series;
+}
+
+bool UploadSink::validateConnection() {
+    return true;
+}
+
+void UploadSink::close() {
+}
+
+bool UploadSink::fetch(const char* path, const char* headers, char* body, size_t size, int& status) {
+    return false;
+}
+
+String UploadSink::getLastError() const {
+    return lastError;
+}
+
+UploadError UploadSink::getErrorKind() const {
+    return lastErrorKind;
+}
+
+const char* UploadSink::errorKindName(UploadError kind) {
+    switch (kind) {
+        case UPLOAD_ERROR_DNS: return "dns";
+        case UPLOAD_ERROR_CONNECT: return "connect";
+        case UPLOAD_ERROR_AUTH: return "auth";
+        case UPLOAD_ERROR_REJECTED: return "rejected";
+        case UPLOAD_ERROR_SERVER: return "server";
+        case UPLOAD_ERROR_NETWORK: return "network";
+        default: return "local";
+    }
+}
+
+bool UploadSink::writeSensorRecord(const SensorRecord& record, uint32_t timeOffset) {
+    if (!config) {
+        return false;
+    }
+    if (record.isChannelSlot()) {
+        return true;   // Only travels with its measurement (writeSensorRecords)
+    }
+    
+    char line[LineProtocol::MAX_LINE];
+    size_t length = LineProtocol::encodeRecord(line, sizeof(line), series,
+                                               record, timeOffset, precision);
+    if (length == 0) {
+        lastError = "Line does not fit encode buffer";
+        return false;
+    }
+    return writeLine(line, length);
+}
+
+bool UploadSink::writeSensorRecords(const SensorRecord* records, size_t count, uint32_t timeOffset) {
+    if (!config) {
+        return false;
+    }
+    
+    uint32_t timestamps[DECODE_BATCH];
+    int16_t temperatures[DECODE_BATCH];
+    uint8_t humidities[DECODE_BATCH];
+    char line[LineProtocol::MAX_LINE];
+    
+    for (size_t start = 0; start < count; start += DECODE_BATCH) {
+        size_t n = count - start < DECODE_BATCH ? count - start : DECODE_BATCH;
+        SensorRecord::decode(records + start, n, timeOffset, timestamps, temperatures, humidities);
+        
+        for (size_t i = 0; i < n; i++) {
+            if (humidities[i] == SENSOR_CHANNEL_SLOT) {
+                continue;   // Written as fields of its measurement
+            }
+            // A measurement's slots may sit in the next batch
+            const SensorRecord* point = records + start + i;
+            uint8_t slots = SensorRecord::countSlots(point, count - start - i);
+            size_t length = LineProtocol::encodePoint(line, sizeof(line), series, timestamps[i],
+                                                      temperatures[i], humidities[i], precision,
+                                                      point + 1, slots);
+            if (length == 0) {
+                lastError = "Line does not fit encode buffer";
+                return false;
+            }
+            if (!writeLine(line, length)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool UploadSink::writeBatteryVoltage(float voltage, uint16_t sequence, uint32_t timestampSeconds) {
+    if (!config) {
+        return false;
+    }
+    
+    char line[LineProtocol::MAX_LINE];
+    size_t length = LineProtocol::encodeBattery(line, sizeof(line), series,
+                                                voltage, sequence, timestampSeconds, precision);
+    if (length == 0) {
+        lastError = "Line does not fit encode buffer";
+        return false;
+    }
+    return writeLine(line, length);
+}
+
+TimePrecision UploadSink::getPrecision() const {
+    return precision;
+}
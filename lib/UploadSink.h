@@ -0,0 +1,83 @@
+#ifndef UPLOAD_SINK_H
+#define UPLOAD_SINK_H
+
+#ifdef NATIVE
+#include "../test/native_mocks/Arduino.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "Config.h"
+#include "SensorRecord.h"
+#include "LineProtocol.h"
+#include "UploadError.h"
+
+// Destination for the line protocol produced by DataUploader.
+// Records are encoded here, once, for every backend; implementations
+// only decide how the encoded lines travel.
+class UploadSink {
+public:
+    static const size_t DECODE_BATCH = 32;   // Records per bulk decode (stack arrays)
+    
+protected:
+    Config* config;
+    TimePrecision precision;   // Timestamp unit the receiver expects
+    String lastError;
+    UploadError lastErrorKind;
+    uint8_t deviceId[6];       // WiFi MAC address unless overridden
+    char series[LineProtocol::MAX_SERIES];   // Measurement + tag set
+    
+    // Serialize measurement, device and location tags once per session.
+    // Implementations call this from begin().
+    bool prepareSeries();
+    
+    // Deliver (or buffer) one encoded line, including its newline
+    virtual bool writeLine(const char* line, size_t length) = 0;
+    
+public:
+    UploadSink();
+    virtual ~UploadSink() {}
+    
+    // Start an upload session
+    virtual bool begin(Config* cfg) = 0;
+    
+    // Optional reachability check before writing. DataUploader skips it
+    // by default: the first write response reports the same problems.
+    virtual bool validateConnection();
+    
+    // Deliver everything written so far; false if anything was lost
+    virtual bool flush() = 0;
+    
+    // End the session and release the connection
+    virtual void close();
+    
+    // GET 'path' from the upload server over the session's connection,
+    // before close(). False if the backend has no HTTP connection or no
+    // response arrived; see InfluxHttpWriter::get() for the arguments.
+    virtual bool fetch(const char* path, const char* headers, char* body, size_t size, int& status);
+    
+    virtual String getLastError() const;
+    // Cause of the last error; UPLOAD_OK for local (encoding) errors
+    UploadError getErrorKind() const;
+    static const char* errorKindName(UploadError kind);
+    
+    // Encode as line protocol; binary backends override these
+    virtual bool writeSensorRecord(const SensorRecord& record, uint32_t timeOffset);
+    // Consecutive records, decoded DECODE_BATCH at a time with SensorRecord::decode().
+    // Channel slots become fields of the measurement before them.
+    virtual bool writeSensorRecords(const SensorRecord* records, size_t count, uint32_t timeOffset);
+    // One per session; sequence and timestamp must not change when a
+    // failed session is retried, so the retry overwrites the same point
+    virtual bool writeBatteryVoltage(float voltage, uint16_t sequence, uint32_t timestampSeconds);
+    
+    TimePrecision getPrecision() const;
+    
+    // Station identity for the device tag; takes effect on the next begin()
+    void setDeviceId(const uint8_t id[6]);
+    const uint8_t* getDeviceId() const;
+    
+    // "<measurement>,device=..[,location=..]" of the current session
+    const char* getSeriesKey() const;
+};
+
+#endif
@@ -1,5 +1,9 @@
 #include "WiFiManager.h"
 #include "Config.h"
+#include "JsonWriter.h"
+#include "RTCData.h"
+#include "RecordStore.h"
+#include "RecordExport.h"
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
 #include <LittleFS.h>
@@ -7,28 +11,43 @@
 
 #define NTP_SERVER "pool.ntp.org"
 #define AP_SSID_PREFIX "sensor-"
+#define SAVE_FLUSH_MS 500   // Time for the save response to leave before the AP goes away
+#define AP_TX_POWER_DBM 10  // The phone is next to the station; full power (20.5 dBm) only costs current
 
-WiFiManager::WiFiManager(Config* cfg, uint8_t led) 
-    : config(cfg), ledPin(led), server(nullptr) {
+WiFiManager::WiFiManager(Config* cfg, RTCData* rtc, uint8_t led) 
+    : config(cfg), rtcData(rtc), ledPin(led), server(nullptr),
+      pending(nullptr), pendingSince(0), pendingRestart(false), done(false) {
 }
 
 WiFiManager::~WiFiManager() {
     if (server) {
         delete server;
     }
+    if (pending) {
+        delete pending;
+    }
 }
 
-bool WiFiManager::connect() {
+bool WiFiManager::connect(const uint8_t* bssid, uint8_t channel) {
     unsigned long lastBlink = 0;
     bool ledState = false;
     
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(config->ssid, config->password);
+    // A fast connect normally associates within a second; when it does not
+    // the AP is likely gone or moved, so give up early and scan next time
+    bool fast = bssid && channel > 0;
+    int maxAttempts = fast ? 20 : 60;
     
-    Serial.printf("Connecting to %s", config->ssid);
+    WiFi.mode(WIFI_STA);
+    if (fast) {
+        WiFi.begin(config->ssid, config->password, channel, bssid);
+        Serial.printf("Connecting to %s (channel %u)", config->ssid, channel);
+    } else {
+        WiFi.begin(config->ssid, config->password);
+        Serial.printf("Connecting to %s", config->ssid);
+    }
     int attempts = 0;
     
-    while (WiFi.status() != WL_CONNECTED && attempts < 60) {
+    while (WiFi.status() != WL_CONNECTED && attempts < maxAttempts) {
         delay(250);
         Serial.print(".");
         
@@ -73,9 +92,9 @@ bool WiFiManager::syncNTP() {
     }
     
     if (now > 1000000000) {
+        // The time offset is rebased by DataUploader::clearData(), once
+        // no stored record refers to the old one
         Serial.printf("Time synced: %s", ctime(&now));
-        config->updateTimeOffset(now);
-        config->save();
         return true;
     } else {
         Serial.println("NTP sync failed!");
@@ -97,6 +116,7 @@ void WiFiManager::startConfigMode() {
     Serial.printf("Creating AP: %s\n", apSSID.c_str());
     
     WiFi.mode(WIFI_AP);
+    WiFi.setOutputPower(AP_TX_POWER_DBM);
     WiFi.softAP(apSSID.c_str());
     
     IPAddress IP = WiFi.softAPIP();
@@ -107,84 +127,338 @@ void WiFiManager::startConfigMode() {
         server = new ESP8266WebServer(80);
     }
     
-    server->on("/", HTTP_GET, [this]() { this->handleRoot(); });
-    server->on("/save", HTTP_POST, [this]() { this->handleSave(); });
+    // Needed to decide between the gzipped and the plain assets, and
+    // for resuming /export
+    const char* headers[] = { "Accept-Encoding", "Range", "If-Range" };
+    server->collectHeaders(headers, 3);
+    
+    // Every request restarts the idle timeout
+    auto route = [this](const char* uri, HTTPMethod method, std::function<void()> handler) {
+        server->on(uri, method, [this, handler]() {
+            this->power.noteRequest(millis());
+            handler();
+        });
+    };
+    route("/", HTTP_GET, [this]() { this->handleRoot(); });
+    route("/config.json", HTTP_GET, [this]() { this->handleConfigJson(); });
+    route("/status.json", HTTP_GET, [this]() { this->handleStatus(); });
+    route("/records.csv", HTTP_GET, [this]() { this->sendRecords(EXPORT_CSV); });
+    route("/records.json", HTTP_GET, [this]() { this->sendRecords(EXPORT_JSON); });
+    route("/export", HTTP_GET, [this]() { this->handleExport(); });
+    route("/save", HTTP_POST, [this]() { this->handleSave(); });
     server->begin();
+    power.begin(millis());
     
     Serial.println("Web server started");
 }
 
-void WiFiManager::handleClient() {
+bool WiFiManager::handleClient() {
     if (server) {
         server->handleClient();
     }
+    if (pending && millis() - pendingSince >= SAVE_FLUSH_MS) {
+        commitPending();
+    }
+    
+    unsigned long now = millis();
+    power.update(now, WiFi.softAPgetStationNum());
+    if (!done && !pending && power.expired(now)) {
+        Serial.println(power.getRequests() > 0 ? "Config mode idle, leaving" : "Config mode unused, leaving");
+        done = true;
+    }
+    if (done) {
+        logPower();
+    }
+    return !done;
 }
 
-String WiFiManager::loadHTMLFile(const char* filename) {
-    if (!LittleFS.exists(filename)) {
-        return "";
-    }
+// The soft AP cannot use modem or light sleep, so the CPU idles in
+// delay() between polls once nobody is using the portal
+uint32_t WiFiManager::pollDelay() const {
+    return power.pollDelay();
+}
+
+void WiFiManager::logPower() {
+    Serial.printf("Config mode: %u requests, %us active, %us idle, %us without client, ~%.1f mAh\n",
+                  (unsigned int)power.getRequests(),
+                  (unsigned int)(power.getStateMillis(POWER_ACTIVE) / 1000),
+                  (unsigned int)(power.getStateMillis(POWER_IDLE) / 1000),
+                  (unsigned int)(power.getStateMillis(POWER_NO_CLIENT) / 1000),
+                  power.getChargeMah());
+}
+
+// Sends 'path', or 'path'.gz when the client takes gzip. streamFile()
+// adds Content-Encoding: gzip by itself for a .gz file name.
+bool WiFiManager::serveFile(const char* path, const char* contentType) {
+    char gzPath[32];
+    snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+    bool gzip = server->header("Accept-Encoding").indexOf("gzip") >= 0 && LittleFS.exists(gzPath);
     
-    File file = LittleFS.open(filename, "r");
-    String content = file.readString();
+    File file = LittleFS.open(gzip ? gzPath : path, "r");
+    if (!file) {
+        return false;
+    }
+    server->sendHeader("Vary", "Accept-Encoding");
+    server->streamFile(file, contentType);
     file.close();
+    return true;
+}
+
+void WiFiManager::handleRoot() {
+    if (!serveFile("/config.html", "text/html")) {
+        server->send(404, "text/plain", "config.html not found");
+    }
+}
+
+// Current settings for the static config page; keys are the form field ids
+void WiFiManager::handleConfigJson() {
+    char buf[1024];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.addString("device", apSSID.c_str());
+    json.addString("ssid", config->ssid);
+    json.addString("password", config->password);
+    json.addNumber("interval", config->interval > 0 ? config->interval : 1800);
+    json.addNumber("sink", config->uploadSink);
+    json.addString("server", config->influxServer);
+    json.addNumber("port", config->influxPort > 0 ? config->influxPort : 8086);
+    json.addNumber("apiversion", config->influxVersion == INFLUX_API_V2 ? INFLUX_API_V2 : INFLUX_API_V1);
+    json.addString("database", config->influxDb);
+    json.addString("user", config->influxUser);
+    json.addString("dbpass", config->influxPass);
+    json.addString("org", config->influxOrg);
+    json.addString("bucket", config->influxBucket);
+    json.addString("token", config->influxToken);
+    json.addString("measurement", 
+                   strlen(config->influxMeasurement) > 0 ? config->influxMeasurement : "environment");
+    json.addString("location", config->location);
+    json.addString("otaurl", config->otaUrl);
+    json.addString("configpath", config->configPath);
+    json.endObject();
     
-    return content;
+    if (!json.ok()) {
+        server->send(500, "text/plain", "Configuration does not fit the response buffer");
+        return;
+    }
+    server->sendHeader("Cache-Control", "no-store");
+    server->send(200, "application/json", buf);
 }
 
-String WiFiManager::replaceVariables(String html) {
-    html.replace("%DEVICE_ID%", apSSID);
-    html.replace("%SSID%", config->ssid);
-    html.replace("%PASSWORD%", config->password);
-    html.replace("%INTERVAL%", String(config->interval > 0 ? config->interval : 1800));
-    html.replace("%SERVER%", config->influxServer);
-    html.replace("%PORT%", String(config->influxPort > 0 ? config->influxPort : 8086));
-    html.replace("%DATABASE%", config->influxDb);
-    html.replace("%USER%", config->influxUser);
-    html.replace("%DBPASS%", config->influxPass);
-    html.replace("%MEASUREMENT%", 
-                 strlen(config->influxMeasurement) > 0 ? config->influxMeasurement : "environment");
+// Backlog fill level, for checking a station on site without uploading
+void WiFiManager::handleStatus() {
+    uint16_t stored = RecordStore::count(*rtcData);
+    uint16_t buffered = rtcData->recordCount;
+    uint32_t capacity = RTC_BUFFER_SIZE + MAX_ROM_RECORDS;
     
-    return html;
+    char buf[640];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.addString("device", apSSID.c_str());
+    json.addNumber("records", stored + buffered);
+    json.addNumber("capacity", capacity);
+    json.addNumber("fillPercent", (uint32_t)((stored + buffered) * 100 / capacity));
+    json.beginObject("rtc");
+    json.addNumber("records", buffered);
+    json.addNumber("capacity", RTC_BUFFER_SIZE);
+    json.endObject();
+    json.beginObject("eeprom");
+    json.addNumber("records", stored);
+    json.addNumber("capacity", MAX_ROM_RECORDS);
+    json.endObject();
+    json.addNumber("timeOffset", config->timeOffset);
+    json.addNumber("uploadSequence", rtcData->uploadSequence);
+    json.addNumber("failedUploads", rtcData->retry.failures);
+    json.beginObject("configMode");
+    json.addNumber("requests", power.getRequests());
+    json.addNumber("activeMs", power.getStateMillis(POWER_ACTIVE));
+    json.addNumber("idleMs", power.getStateMillis(POWER_IDLE));
+    json.addNumber("noClientMs", power.getStateMillis(POWER_NO_CLIENT));
+    json.addNumber("chargeMah", power.getChargeMah(), 2);
+    json.addNumber("timeoutSeconds", power.remaining(millis()) / 1000);
+    json.endObject();
+    json.endObject();
+    
+    server->sendHeader("Cache-Control", "no-store");
+    server->send(json.ok() ? 200 : 500, "application/json", json.ok() ? buf : "{}");
 }
 
-void WiFiManager::handleRoot() {
-    String html = loadHTMLFile("/config.html");
+// Streams the decoded backlog in chunks; nothing is uploaded or cleared
+void WiFiManager::sendRecords(uint8_t format) {
+    RecordExport records(*rtcData, config->timeOffset, (ExportFormat)format);
     
-    if (html.length() == 0) {
-        server->send(404, "text/plain", "config.html not found");
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"%s-records.%s\"",
+             apSSID.c_str(), format == EXPORT_JSON ? "json" : "csv");
+    server->sendHeader("Content-Disposition", disposition);
+    server->sendHeader("Cache-Control", "no-store");
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, format == EXPORT_JSON ? "application/json" : "text/csv", "");
+    
+    char chunk[512];
+    size_t length;
+    while ((length = records.read(chunk, sizeof(chunk))) > 0) {
+        server->sendContent(chunk, length);
+        if (!server->client().connected()) {
+            break;
+        }
+    }
+    server->sendContent("");
+}
+
+// Raw backlog (see BinaryProtocol.h), decoded on the host by
+// tools/export. The records are sent straight out of the EEPROM cache and
+// RTC buffer with a known length, and byte ranges let "curl -C -" resume.
+// Nothing changes the backlog in config mode, so the ETag only has to
+// tell sessions apart.
+void WiFiManager::handleExport() {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    RecordExport records(*rtcData, config->timeOffset, EXPORT_BINARY, mac);
+    uint32_t size = records.getSize();
+    
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%08x-%04x-%04x\"", (unsigned int)config->timeOffset,
+             (unsigned int)rtcData->uploadSequence, (unsigned int)records.getCount());
+    
+    uint32_t first = 0;
+    uint32_t last = size - 1;
+    uint8_t range = EXPORT_RANGE_NONE;
+    if (server->hasHeader("Range") &&
+        (!server->hasHeader("If-Range") || strcmp(server->header("If-Range").c_str(), etag) == 0)) {
+        range = RecordExport::parseRange(server->header("Range").c_str(), size, first, last);
+    }
+    
+    char contentRange[48];
+    if (range == EXPORT_RANGE_INVALID) {
+        snprintf(contentRange, sizeof(contentRange), "bytes */%u", (unsigned int)size);
+        server->sendHeader("Content-Range", contentRange);
+        server->send(416, "text/plain", "Range not satisfiable");
         return;
     }
     
-    html = replaceVariables(html);
-    server->send(200, "text/html", html);
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"%s-records.bin\"", apSSID.c_str());
+    server->sendHeader("Content-Disposition", disposition);
+    server->sendHeader("Accept-Ranges", "bytes");
+    server->sendHeader("ETag", etag);
+    if (range == EXPORT_RANGE_PARTIAL) {
+        snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u",
+                 (unsigned int)first, (unsigned int)last, (unsigned int)size);
+        server->sendHeader("Content-Range", contentRange);
+    }
+    server->setContentLength(last - first + 1);
+    server->send(range == EXPORT_RANGE_PARTIAL ? 206 : 200, "application/octet-stream", "");
+    
+    uint32_t position = first;
+    while (position <= last) {
+        size_t length;
+        const uint8_t* data = records.dataAt(position, length);
+        if (!data) {
+            break;
+        }
+        if (length > last - position + 1) {
+            length = last - position + 1;
+        }
+        server->sendContent((const char*)data, length);
+        if (!server->client().connected()) {
+            break;
+        }
+        position += length;
+    }
 }
 
+// Copies a form field, refusing values that would be cut short
+bool WiFiManager::copyArg(const char* name, char* field, size_t size) {
+    String value = server->arg(name);
+    if (value.length() >= size) {
+        return false;
+    }
+    strncpy(field, value.c_str(), size - 1);
+    field[size - 1] = '\0';
+    return true;
+}
+
+// Validates the form and answers right away. The EEPROM commit and the
+// restart wait for handleClient(), so they cannot cut off the response.
 void WiFiManager::handleSave() {
-    Serial.println("Saving configuration...");
+    if (pending) {
+        server->send(409, "text/plain", "A save is already in progress");
+        return;
+    }
+    
+    Config* candidate = new Config(*config);
+    bool fits = copyArg("ssid", candidate->ssid, sizeof(candidate->ssid)) &&
+                copyArg("password", candidate->password, sizeof(candidate->password)) &&
+                copyArg("server", candidate->influxServer, sizeof(candidate->influxServer)) &&
+                copyArg("database", candidate->influxDb, sizeof(candidate->influxDb)) &&
+                copyArg("user", candidate->influxUser, sizeof(candidate->influxUser)) &&
+                copyArg("dbpass", candidate->influxPass, sizeof(candidate->influxPass)) &&
+                copyArg("measurement", candidate->influxMeasurement, sizeof(candidate->influxMeasurement)) &&
+                copyArg("org", candidate->influxOrg, sizeof(candidate->influxOrg)) &&
+                copyArg("bucket", candidate->influxBucket, sizeof(candidate->influxBucket)) &&
+                copyArg("token", candidate->influxToken, sizeof(candidate->influxToken)) &&
+                copyArg("location", candidate->location, sizeof(candidate->location)) &&
+                copyArg("otaurl", candidate->otaUrl, sizeof(candidate->otaUrl)) &&
+                copyArg("configpath", candidate->configPath, sizeof(candidate->configPath));
+    
+    // A different document starts its own version count
+    if (strcmp(candidate->configPath, config->configPath) != 0) {
+        candidate->configVersion = 0;
+    }
+    
+    long interval = server->arg("interval").toInt();
+    long port = server->arg("port").toInt();
+    candidate->interval = (interval >= 0 && interval <= CONFIG_MAX_INTERVAL) ? interval : 0;
+    candidate->influxPort = (port >= 0 && port <= 65535) ? port : 0;
+    candidate->influxVersion = server->arg("apiversion").toInt() == INFLUX_API_V2 ? 
+                               INFLUX_API_V2 : INFLUX_API_V1;
+    int sinkType = server->arg("sink").toInt();
+    candidate->uploadSink = (sinkType == UPLOAD_SINK_INFLUX_UDP || sinkType == UPLOAD_SINK_MQTT ||
+                             sinkType == UPLOAD_SINK_BINARY) ? sinkType : UPLOAD_SINK_INFLUX_HTTP;
+    
+    const char* error = fits ? candidate->validate() : "A value is too long";
+    if (error) {
+        delete candidate;
+        Serial.printf("Configuration rejected: %s\n", error);
+        server->send(400, "text/plain", error);
+        return;
+    }
     
-    strncpy(config->ssid, server->arg("ssid").c_str(), sizeof(config->ssid) - 1);
-    strncpy(config->password, server->arg("password").c_str(), sizeof(config->password) - 1);
-    config->interval = server->arg("interval").toInt();
-    strncpy(config->influxServer, server->arg("server").c_str(), sizeof(config->influxServer) - 1);
-    config->influxPort = server->arg("port").toInt();
-    strncpy(config->influxDb, server->arg("database").c_str(), sizeof(config->influxDb) - 1);
-    strncpy(config->influxUser, server->arg("user").c_str(), sizeof(config->influxUser) - 1);
-    strncpy(config->influxPass, server->arg("dbpass").c_str(), sizeof(config->influxPass) - 1);
-    strncpy(config->influxMeasurement, server->arg("measurement").c_str(), 
-            sizeof(config->influxMeasurement) - 1);
-    
-    config->save();
-    
-    String html = loadHTMLFile("/success.html");
-    if (html.length() == 0) {
-        server->send(200, "text/plain", "Configuration saved! Restarting...");
+    // The interval is read again before every sleep, so changing only
+    // the interval needs no restart
+    Config other(*candidate);
+    other.interval = config->interval;
+    pendingRestart = !config->isValid() || !other.sameSettings(*config);
+    pending = candidate;
+    pendingSince = millis();
+    
+    if (pendingRestart) {
+        if (!serveFile("/success.html", "text/html")) {
+            server->send(200, "text/plain", "Configuration saved! Restarting...");
+        }
     } else {
-        server->send(200, "text/html", html);
+        char message[64];
+        snprintf(message, sizeof(message), "Interval set to %u seconds, no restart needed",
+                 (unsigned int)candidate->interval);
+        server->send(200, "text/plain", message);
+    }
+}
+
+void WiFiManager::commitPending() {
+    *config = *pending;
+    delete pending;
+    pending = nullptr;
+    
+    Serial.println("Saving configuration...");
+    if (!config->save()) {
+        Serial.println("EEPROM commit failed!");
     }
     
-    delay(5000);
-    ESP.restart();
+    if (pendingRestart) {
+        ESP.restart();
+    }
+    Serial.printf("Interval now %u seconds, leaving config mode\n", (unsigned int)config->interval);
+    done = true;
 }
 
 void WiFiManager::blinkLED() {
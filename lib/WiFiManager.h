@@ -2,27 +2,40 @@
 #define WIFI_MANAGER_H
 
 #include <Arduino.h>
+#include "ConfigModePower.h"
 
 // Forward declarations to avoid including ESP8266-specific headers
 class ESP8266WebServer;
 class Config;
+class RTCData;
 
 class WiFiManager {
 private:
     Config* config;
+    RTCData* rtcData;     // Backlog shown in config mode
     uint8_t ledPin;
     ESP8266WebServer* server;
     String apSSID;
+    Config* pending;              // Validated settings, committed once the response is out
+    unsigned long pendingSince;
+    bool pendingRestart;          // Anything but the interval changed
+    bool done;                    // Config mode is over, carry on without a restart
+    ConfigModePower power;        // Poll rate and timeouts of config mode
     
     void blinkLED();
-    String loadHTMLFile(const char* filename);
-    String replaceVariables(String html);
+    bool serveFile(const char* path, const char* contentType);
+    bool copyArg(const char* name, char* field, size_t size);
+    void commitPending();
+    void sendRecords(uint8_t format);
+    void handleExport();
+    void logPower();
     
 public:
-    WiFiManager(Config* cfg, uint8_t led);
+    WiFiManager(Config* cfg, RTCData* rtc, uint8_t led);
     ~WiFiManager();
     
-    bool connect();
+    // With a known BSSID and channel the station skips the channel scan
+    bool connect(const uint8_t* bssid = nullptr, uint8_t channel = 0);
     void disconnect();
     
     bool syncNTP();
@@ -30,10 +43,17 @@ public:
     
     // Config mode / AP mode
     void startConfigMode();
-    void handleClient();
+    // Serves requests and applies a saved config. Returns false when
+    // config mode is over (interval changed, idle timeout or time limit)
+    // and the device can go on without a restart.
+    bool handleClient();
+    // Milliseconds to sleep before the next handleClient()
+    uint32_t pollDelay() const;
     
     // Web handlers
     void handleRoot();
+    void handleConfigJson();
+    void handleStatus();
     void handleSave();
 };
 
@@ -0,0 +1,21 @@
+#include "WireBus.h"
+#include <Wire.h>
+
+bool WireBus::write(uint8_t address, const uint8_t* data, size_t length, bool stop) {
+    Wire.beginTransmission(address);
+    if (length > 0 && Wire.write(data, length) != length) {
+        Wire.endTransmission();
+        return false;
+    }
+    return Wire.endTransmission(stop) == 0;
+}
+
+bool WireBus::read(uint8_t address, uint8_t* data, size_t length) {
+    if (Wire.requestFrom(address, length, true) != length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        data[i] = Wire.read();
+    }
+    return true;
+}
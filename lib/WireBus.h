@@ -0,0 +1,14 @@
+#ifndef WIRE_BUS_H
+#define WIRE_BUS_H
+
+#include <Arduino.h>
+#include "I2cBus.h"
+
+// I2cBus on the Arduino Wire library (D1/D2 on the D1 Mini)
+class WireBus : public I2cBus {
+public:
+    bool write(uint8_t address, const uint8_t* data, size_t length, bool stop = true);
+    bool read(uint8_t address, uint8_t* data, size_t length);
+};
+
+#endif
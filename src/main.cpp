@@ -6,34 +6,53 @@
 #include <ESP8266WiFi.h>
 #include <EEPROM.h>
 #include <LittleFS.h>
+#include <Wire.h>
 
 #include "Config.h"
 #include "SensorRecord.h"
 #include "RTCData.h"
 #include "SensorManager.h"
+#include "WireBus.h"
+#include "AhtDriver.h"
+#include "Sht3xDriver.h"
+#include "Bme280Driver.h"
+#include "Ds18b20Driver.h"
 #include "WiFiManager.h"
 #include "DataUploader.h"
+#include "RecordStore.h"
+#include "OtaUpdater.h"
+#include "FlashFirmwareTarget.h"
 
 // Pin Definitions
-#define AHT_POWER_PIN 12
+#define SENSOR_POWER_PIN 12   // Switched supply of all sensors
+#define ONEWIRE_PIN 14        // DS18B20 probe (D5)
 #define BATTERY_PIN A0
 #define LED_PIN 2
 #define WAKE_PIN 16
 
 // Configuration
+#define AHT_MODEL AHT_MODEL_AHT10   // AHT_MODEL_AHT20 on AHT20 boards
 #define EEPROM_SIZE 4096
 #define BUTTON_LONG_PRESS 5000
 
 // Global objects
 Config config;
 RTCData rtcData;
-SensorManager sensor(AHT_POWER_PIN);
-WiFiManager wifiMgr(&config, LED_PIN);
+SensorManager sensor(SENSOR_POWER_PIN);
+WireBus i2c;
+// Whichever of these is fitted gets used; earlier ones win a shared channel
+AhtDriver ahtSensor(i2c, AHT_MODEL);
+Sht3xDriver shtSensor(i2c);
+Bme280Driver bmeSensor(i2c);
+Ds18b20Driver probeSensor(ONEWIRE_PIN);
+WiFiManager wifiMgr(&config, &rtcData, LED_PIN);
 DataUploader uploader(&config, &rtcData);
 
 // Function prototypes
 void performMeasurement();
+void moveBufferToStore();
 void syncAndUpload();
+void checkFirmwareUpdate();
 void enterConfigMode();
 void deepSleep(uint32_t seconds);
 float readBatteryVoltage();
@@ -55,7 +74,12 @@ void setup() {
     }
     
     // Initialize sensor
+    sensor.addDriver(&ahtSensor);
+    sensor.addDriver(&shtSensor);
+    sensor.addDriver(&bmeSensor);
+    sensor.addDriver(&probeSensor);
     sensor.begin();
+    Wire.begin();
     
     // Load configuration and RTC data
     config.load();
@@ -100,12 +124,18 @@ void setup() {
         return;
     }
     
-    // Timer wake - just take measurement
+    // Timer wake - take measurement, retry a failed upload once its backoff ran out
     if (timerWake) {
         Serial.println("Timer wake - measurement mode");
         digitalWrite(LED_PIN, LOW);
         performMeasurement();
         digitalWrite(LED_PIN, HIGH);
+        
+        rtcData.retry.elapse(config.interval);
+        if (rtcData.retry.isDue()) {
+            Serial.printf("Retrying upload (attempt %u)\n", (unsigned int)rtcData.retry.failures + 1);
+            syncAndUpload();
+        }
         deepSleep(config.interval);
         return;
     }
@@ -133,39 +163,86 @@ void loop() {
 void performMeasurement() {
     Serial.println("=== Taking Measurement ===");
     
-    float temperature, humidity;
-    if (!sensor.takeMeasurement(temperature, humidity)) {
+    Measurement measurement;
+    if (!sensor.takeMeasurement(measurement)) {
         Serial.println("Measurement failed!");
         return;
     }
     
-    Serial.printf("Temperature: %.1f°C, Humidity: %.1f%%\n", temperature, humidity);
+    Serial.printf("Temperature: %.1f°C", measurement.temperature);
+    if (measurement.channels & SENSOR_HUMIDITY) {
+        Serial.printf(", Humidity: %.1f%%", measurement.humidity);
+    }
+    if (measurement.channels & SENSOR_PRESSURE) {
+        Serial.printf(", Pressure: %.1f hPa", measurement.pressure);
+    }
+    if (measurement.channels & SENSOR_PROBE_TEMPERATURE) {
+        Serial.printf(", Probe: %.2f°C", measurement.probeTemperature);
+    }
+    Serial.println();
     
     uint32_t currentTime = wifiMgr.getCurrentTime();
-    SensorRecord record = sensor.createRecord(temperature, humidity, currentTime, config.timeOffset);
+    SensorRecord records[SENSOR_MAX_SLOTS];
+    uint8_t count = SensorRecord::pack(measurement, currentTime, config.timeOffset, records);
     
     if (!rtcData.isValid()) {
         rtcData.initialize();
     }
     
-    rtcData.addRecord(record);
+    // A measurement with channel slots may not fit the rest of the buffer
+    if (!rtcData.addRecords(records, count)) {
+        moveBufferToStore();
+        if (!rtcData.addRecords(records, count)) {
+            Serial.println("Record buffer full, measurement dropped!");
+        }
+    }
     Serial.printf("Buffered record %d/%d\n", rtcData.recordCount, RTC_BUFFER_SIZE);
     
+    if (rtcData.isBufferFull()) {
+        moveBufferToStore();
+    }
+    
     rtcData.save();
 }
 
+// Move the whole buffer to EEPROM with one flash write
+void moveBufferToStore() {
+    uint16_t stored = RecordStore::append(rtcData, rtcData.buffer, rtcData.recordCount);
+    if (stored > 0) {
+        rtcData.recordCount -= stored;
+        memmove(rtcData.buffer, rtcData.buffer + stored, rtcData.recordCount * sizeof(SensorRecord));
+        Serial.printf("Moved %d records to EEPROM, %d stored\n", stored, rtcData.romRecordCount);
+    }
+    if (rtcData.recordCount > 0) {
+        Serial.println("EEPROM record area full!");
+    }
+}
+
 void syncAndUpload() {
     Serial.println("=== Sync and Upload Mode ===");
     
-    if (!wifiMgr.connect()) {
+    RetryScheduler& retry = rtcData.retry;
+    bool fast = retry.useFastConnect();
+    
+    if (!wifiMgr.connect(fast ? retry.bssid : nullptr, fast ? retry.channel : 0)) {
+        retry.recordFailure(RETRY_FAIL_WIFI, ESP.random());
+        Serial.printf("Next upload attempt in %u seconds\n", (unsigned int)retry.waitSeconds);
         digitalWrite(LED_PIN, HIGH);
+        wifiMgr.disconnect();
         return;
     }
+    retry.rememberAccessPoint(WiFi.BSSID(), WiFi.channel());
     
     wifiMgr.syncNTP();
     
     float batteryVoltage = readBatteryVoltage();
-    uploader.uploadAllData(batteryVoltage);
+    if (uploader.uploadAllData(batteryVoltage)) {
+        retry.recordSuccess();
+        checkFirmwareUpdate();
+    } else {
+        retry.recordFailure(RETRY_FAIL_UPLOAD, ESP.random());
+        Serial.printf("Next upload attempt in %u seconds\n", (unsigned int)retry.waitSeconds);
+    }
     
     digitalWrite(LED_PIN, HIGH);
     wifiMgr.disconnect();
@@ -176,10 +253,47 @@ void enterConfigMode() {
     
     wifiMgr.startConfigMode();
     
-    while (true) {
-        wifiMgr.handleClient();
-        yield();
+    // Other changes restart from inside handleClient()
+    while (wifiMgr.handleClient()) {
+        delay(wifiMgr.pollDelay());
     }
+    
+    // Only the interval changed, or nobody used the portal: carry on
+    // measuring, buffered records intact. Unconfigured, there is nothing
+    // to measure for, so sleep until the button resets the board.
+    digitalWrite(LED_PIN, HIGH);
+    deepSleep(config.isValid() ? config.interval : 0);
+}
+
+// Asks the update server for new firmware while the radio is up anyway.
+// Only after a successful upload, so no records wait in RTC memory when
+// the new image boots.
+void checkFirmwareUpdate() {
+    if (strlen(config.otaUrl) == 0) {
+        return;
+    }
+    
+    WiFiClient client;
+    FlashFirmwareTarget target;
+    OtaUpdater ota(client, target);
+    uint8_t result = ota.update(config.otaUrl);
+    if (result == OTA_NO_UPDATE) {
+        Serial.println("Firmware is up to date");
+        return;
+    }
+    if (result == OTA_FAILED) {
+        Serial.printf("Firmware update failed: %s\n", ota.getError());
+        return;
+    }
+    
+    Serial.printf("Firmware updated from a %s (%u bytes), restarting\n",
+                  ota.isDelta() ? "delta" : "full image", (unsigned int)ota.getDownloadBytes());
+    digitalWrite(LED_PIN, HIGH);
+    wifiMgr.disconnect();
+    rtcData.clock += millis() / 1000;
+    rtcData.save();
+    Serial.flush();
+    ESP.restart();
 }
 
 float readBatteryVoltage() {
@@ -193,10 +307,15 @@ void deepSleep(uint32_t seconds) {
     Serial.printf("Entering deep sleep for %d seconds\n", seconds);
     Serial.flush();
     
+    // A button press cuts the sleep short, so the clock runs ahead and
+    // anything timed by it (the DNS cache) expires early rather than late
+    rtcData.clock += millis() / 1000 + seconds;
     rtcData.save();
     WiFi.mode(WIFI_OFF);
     WiFi.forceSleepBegin();
     delay(1);
     
-    ESP.deepSleep(seconds * 1000000ULL, WAKE_RF_DISABLED);
+    // The radio only comes up on the wake that is due to retry an upload
+    bool radio = rtcData.retry.isDueAfter(seconds);
+    ESP.deepSleep(seconds * 1000000ULL, radio ? WAKE_RF_DEFAULT : WAKE_RF_DISABLED);
 }
@@ -7,6 +7,8 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
 
 // Basic types
 typedef uint8_t byte;
@@ -91,7 +93,36 @@ public:
     }
     
     void replace(const char* find, const char* replace) {
-        // Not needed for tests
+        size_t findLen = strlen(find);
+        size_t replaceLen = strlen(replace);
+        if (findLen == 0 || !strstr(buffer, find)) return;
+        
+        size_t count = 0;
+        for (const char* p = strstr(buffer, find); p; p = strstr(p + findLen, find)) count++;
+        
+        size_t newLen = len - count * findLen + count * replaceLen;
+        char* newBuf = (char*)malloc(newLen + 1);
+        char* out = newBuf;
+        const char* in = buffer;
+        for (const char* p = strstr(in, find); p; p = strstr(in, find)) {
+            memcpy(out, in, p - in);
+            out += p - in;
+            memcpy(out, replace, replaceLen);
+            out += replaceLen;
+            in = p + findLen;
+        }
+        strcpy(out, in);
+        free(buffer);
+        buffer = newBuf;
+        len = newLen;
+    }
+    
+    void replace(const char* find, const String& replace) {
+        this->replace(find, replace.c_str());
+    }
+    
+    void replace(const String& find, const String& replace) {
+        this->replace(find.c_str(), replace.c_str());
     }
     
     String& operator+=(const String& other) {
@@ -117,6 +148,11 @@ public:
         return *this;
     }
     
+    String& operator+=(char c) {
+        char str[2] = { c, '\0' };
+        return *this += str;
+    }
+    
     friend String operator+(const String& lhs, const String& rhs) {
         String result(lhs);
         result += rhs;
@@ -151,8 +187,13 @@ extern SerialMock Serial;
 
 // Arduino functions
 inline void delay(unsigned long ms) {}
-inline unsigned long millis() { return 0; }
-inline unsigned long micros() { return 0; }
+inline unsigned long micros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)(ts.tv_sec * 1000000UL + ts.tv_nsec / 1000);
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline void yield() {}
 
 // Math
 inline long constrain(long x, long a, long b) {
@@ -7,11 +7,14 @@
 class EEPROMMock {
 private:
     uint8_t data[4096];
+    size_t size;
     
 public:
-    EEPROMMock() { memset(data, 0, sizeof(data)); }
+    int commits;   // commit() calls, for tests
     
-    void begin(size_t size) {}
+    EEPROMMock() : size(sizeof(data)), commits(0) { memset(data, 0, sizeof(data)); }
+    
+    void begin(size_t requested) { size = requested < sizeof(data) ? requested : sizeof(data); }
     
     template<typename T>
     T& get(int address, T& t) {
@@ -25,10 +28,15 @@ public:
         return t;
     }
     
-    void commit() {}
+    bool commit() { commits++; return true; }
     
     uint8_t read(int address) { return data[address]; }
     void write(int address, uint8_t value) { data[address] = value; }
+    
+    // Direct access to the RAM copy, as on the ESP8266
+    uint8_t* getDataPtr() { return data; }
+    const uint8_t* getConstDataPtr() const { return data; }
+    size_t length() { return size; }
 };
 
 extern EEPROMMock EEPROM;
@@ -0,0 +1,39 @@
+#ifndef ESP8266_WIFI_H_MOCK
+#define ESP8266_WIFI_H_MOCK
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include <map>
+#include <string>
+#include <unistd.h>
+
+// Name lookups come from a table the test fills, so no test depends on
+// the resolver of the machine running it
+class WiFiClass {
+private:
+    std::map<std::string, IPAddress> hosts;
+    
+public:
+    int lookups;                  // hostByName() calls that reached the resolver
+    unsigned long lookupDelayMs;  // Simulated DNS round trip
+    
+    WiFiClass() : lookups(0), lookupDelayMs(0) {}
+    
+    int hostByName(const char* name, IPAddress& result) {
+        lookups++;
+        usleep(lookupDelayMs * 1000);   // delay() is a no-op in the mocks
+        std::map<std::string, IPAddress>::const_iterator it = hosts.find(name);
+        if (it == hosts.end()) {
+            return 0;
+        }
+        result = it->second;
+        return 1;
+    }
+    
+    void addHost(const char* name, const IPAddress& address) { hosts[name] = address; }
+    void clearHosts() { hosts.clear(); lookups = 0; lookupDelayMs = 0; }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef HTTP_STUB_SERVER_H_MOCK
+#define HTTP_STUB_SERVER_H_MOCK
+
+// Minimal local HTTP/1.1 server for native uploader tests.
+// Records every request (headers + de-chunked body) and answers with a
+// configurable status. Handles keep-alive and pipelined requests.
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ctype.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct StubRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers;   // Lower-case names
+    std::string body;
+    bool chunked;
+    size_t wireBytes;   // Request size on the wire, headers and framing included
+
+    std::string header(const std::string& name) const {
+        std::map<std::string, std::string>::const_iterator it = headers.find(name);
+        return it == headers.end() ? std::string() : it->second;
+    }
+};
+
+class HttpStubServer {
+public:
+    int status;                  // Status code for every response
+    std::string responseBody;    // Body sent with every response
+    std::string responseHeaders; // Extra "Name: value\r\n" lines for every response
+    bool closeAfterResponse;     // Send "Connection: close" and hang up
+    size_t closeAfterBodyBytes;  // Drop the connection mid-body (0 = never)
+    size_t closeAfterStreamBytes; // Drop after this many bytes of a connection (0 = never)
+    bool dropResponse;           // Record the request, then hang up without answering
+    size_t truncateResponse;     // Send only this many body bytes, then hang up (0 = all)
+    int documentStatus;          // Status for GET requests (0 = same as the others)
+    std::string documentBody;    // Body sent with GET responses when documentStatus is set
+    size_t chunkResponse;        // Send bodies chunked, this many bytes per chunk (0 = Content-Length)
+
+    HttpStubServer()
+        : status(204), closeAfterResponse(false), closeAfterBodyBytes(0),
+          closeAfterStreamBytes(0), dropResponse(false), truncateResponse(0), documentStatus(0), chunkResponse(0), listenFd(-1), port(0), running(false), accepted(0) {}
+
+    ~HttpStubServer() { stop(); }
+
+    uint16_t start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(listenFd, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listenFd, 16);
+
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, (struct sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+
+        running = true;
+        acceptThread = std::thread(&HttpStubServer::acceptLoop, this);
+        return port;
+    }
+
+    void stop() {
+        if (!running) {
+            return;
+        }
+        running = false;
+        shutdown(listenFd, SHUT_RDWR);
+        close(listenFd);
+        acceptThread.join();
+
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < connectionFds.size(); i++) {
+                shutdown(connectionFds[i], SHUT_RDWR);
+            }
+            threads.swap(connectionThreads);
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+
+    uint16_t getPort() const { return port; }
+
+    size_t connectionCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return accepted;
+    }
+
+    std::vector<StubRequest> requests() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received;
+    }
+
+    // Wait until 'count' requests arrived (requests are recorded after
+    // the response is sent, so this also waits for the last response)
+    bool waitForRequests(size_t count, int timeoutMs = 2000) {
+        for (int waited = 0; waited < timeoutMs; waited += 5) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (received.size() >= count) {
+                    return true;
+                }
+            }
+            usleep(5000);
+        }
+        return false;
+    }
+
+private:
+    int listenFd;
+    uint16_t port;
+    volatile bool running;
+    size_t accepted;
+    std::thread acceptThread;
+    std::vector<std::thread> connectionThreads;
+    std::vector<int> connectionFds;
+    std::vector<StubRequest> received;
+    std::mutex mutex;
+
+    // Buffered reader over one connection
+    struct Reader {
+        int fd;
+        std::string pending;
+        size_t total;
+        size_t limit;   // 0 = unlimited
+
+        bool fill() {
+            char buf[512];
+            size_t want = sizeof(buf);
+            if (limit > 0) {
+                if (total >= limit) {
+                    return false;
+                }
+                want = limit - total < want ? limit - total : want;
+            }
+            ssize_t n = recv(fd, buf, want, 0);
+            if (n <= 0) {
+                return false;
+            }
+            total += n;
+            pending.append(buf, n);
+            return true;
+        }
+
+        bool readLine(std::string& line) {
+            size_t eol;
+            while ((eol = pending.find("\r\n")) == std::string::npos) {
+                if (!fill()) {
+                    return false;
+                }
+            }
+            line = pending.substr(0, eol);
+            pending.erase(0, eol + 2);
+            return true;
+        }
+
+        bool readBytes(std::string& out, size_t count) {
+            while (pending.size() < count) {
+                if (!fill()) {
+                    return false;
+                }
+            }
+            out.append(pending, 0, count);
+            pending.erase(0, count);
+            return true;
+        }
+    };
+
+    void acceptLoop() {
+        while (running) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted++;
+            connectionFds.push_back(fd);
+            connectionThreads.push_back(std::thread(&HttpStubServer::serve, this, fd));
+        }
+    }
+
+    void serve(int fd) {
+        Reader reader;
+        reader.fd = fd;
+        reader.total = 0;
+        reader.limit = closeAfterStreamBytes;
+
+        while (running) {
+            StubRequest request;
+            if (!readRequest(reader, request)) {
+                break;
+            }
+
+            // Recorded before answering so a client never sees a response
+            // for a request that requests() does not list yet
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                received.push_back(request);
+            }
+            if (dropResponse) {
+                break;
+            }
+
+            bool document = request.method == "GET" && documentStatus != 0;
+            const std::string& body = document ? documentBody : responseBody;
+            char head[256];
+            if (chunkResponse > 0) {
+                snprintf(head, sizeof(head),
+                         "HTTP/1.1 %d Stub\r\nTransfer-Encoding: chunked\r\nConnection: %s\r\n",
+                         document ? documentStatus : status, closeAfterResponse ? "close" : "keep-alive");
+            } else {
+                snprintf(head, sizeof(head),
+                         "HTTP/1.1 %d Stub\r\nContent-Length: %u\r\nConnection: %s\r\n",
+                         document ? documentStatus : status, (unsigned int)body.size(),
+                         closeAfterResponse ? "close" : "keep-alive");
+            }
+            std::string payload = chunkResponse > 0 ? chunked(body) : body;
+            std::string response = std::string(head) + responseHeaders + "\r\n" + 
+                                   (truncateResponse > 0 ? payload.substr(0, truncateResponse) : payload);
+            send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+
+            if (closeAfterResponse || truncateResponse > 0) {
+                break;
+            }
+        }
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
+    }
+
+    // Body in chunkResponse-sized chunks, a chunk extension and a trailer
+    // included, as proxies may send them
+    std::string chunked(const std::string& body) const {
+        std::string out;
+        for (size_t pos = 0; pos < body.size(); pos += chunkResponse) {
+            std::string data = body.substr(pos, chunkResponse);
+            char size[32];
+            snprintf(size, sizeof(size), pos == 0 ? "%x;stub=1\r\n" : "%X\r\n", (unsigned int)data.size());
+            out += size + data + "\r\n";
+        }
+        return out + "0\r\nX-Trailer: end\r\n\r\n";
+    }
+
+    bool readRequest(Reader& reader, StubRequest& request) {
+        size_t start = reader.total - reader.pending.size();
+        if (!parseRequest(reader, request)) {
+            return false;
+        }
+        request.wireBytes = reader.total - reader.pending.size() - start;
+        return true;
+    }
+
+    bool parseRequest(Reader& reader, StubRequest& request) {
+        std::string line;
+        if (!reader.readLine(line)) {
+            return false;
+        }
+        size_t sp1 = line.find(' ');
+        size_t sp2 = line.find(' ', sp1 + 1);
+        request.method = line.substr(0, sp1);
+        request.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        while (true) {
+            if (!reader.readLine(line)) {
+                return false;
+            }
+            if (line.empty()) {
+                break;
+            }
+            size_t colon = line.find(':');
+            std::string name = line.substr(0, colon);
+            for (size_t i = 0; i < name.size(); i++) {
+                name[i] = tolower(name[i]);
+            }
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            request.headers[name] = value == std::string::npos ? "" : line.substr(value);
+        }
+
+        request.chunked = request.header("transfer-encoding") == "chunked";
+        if (request.chunked) {
+            while (true) {
+                if (!reader.readLine(line)) {
+                    return false;
+                }
+                size_t size = strtoul(line.c_str(), nullptr, 16);
+                if (size == 0) {
+                    if (!reader.readLine(line)) {
+                        return false;
+                    }
+                    break;
+                }
+                if (closeAfterBodyBytes > 0 && request.body.size() + size >= closeAfterBodyBytes) {
+                    return false;
+                }
+                if (!reader.readBytes(request.body, size) || !reader.readLine(line)) {
+                    return false;
+                }
+            }
+        } else if (!request.header("content-length").empty()) {
+            size_t size = strtoul(request.header("content-length").c_str(), nullptr, 10);
+            if (!reader.readBytes(request.body, size)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef I2C_STUB_BUS_H_MOCK
+#define I2C_STUB_BUS_H_MOCK
+
+// Scripted I2cBus: replays a recorded transaction sequence. Each expected
+// write is compared byte for byte, each read returns its recorded bytes,
+// and 'ack = false' plays a device that does not answer.
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+#include "../../lib/I2cBus.h"
+
+class I2cStubBus : public I2cBus {
+public:
+    I2cStubBus() : position(0) {}
+
+    void expectWrite(uint8_t address, std::vector<uint8_t> data, bool ack = true) {
+        Transaction t = { true, address, data, ack };
+        script.push_back(t);
+    }
+
+    void expectRead(uint8_t address, std::vector<uint8_t> data, bool ack = true) {
+        Transaction t = { false, address, data, ack };
+        script.push_back(t);
+    }
+
+    bool write(uint8_t address, const uint8_t* data, size_t length, bool stop = true) {
+        (void)stop;
+        const Transaction* t = next(true, address);
+        if (!t) {
+            return false;
+        }
+        if (std::vector<uint8_t>(data, data + length) != t->data) {
+            fail("write bytes differ");
+            return false;
+        }
+        return t->ack;
+    }
+
+    bool read(uint8_t address, uint8_t* data, size_t length) {
+        const Transaction* t = next(false, address);
+        if (!t || !t->ack) {
+            return false;
+        }
+        if (length != t->data.size()) {
+            fail("read length differs");
+            return false;
+        }
+        memcpy(data, t->data.data(), length);
+        return true;
+    }
+
+    // Whole script played without a mismatch
+    bool finished() const { return error.empty() && position == script.size(); }
+
+    const std::string& getError() const { return error; }
+
+private:
+    struct Transaction {
+        bool write;
+        uint8_t address;
+        std::vector<uint8_t> data;
+        bool ack;
+    };
+
+    std::vector<Transaction> script;
+    size_t position;
+    std::string error;
+
+    const Transaction* next(bool write, uint8_t address) {
+        if (position >= script.size()) {
+            fail("transaction after end of script");
+            return nullptr;
+        }
+        const Transaction& t = script[position];
+        if (t.write != write || t.address != address) {
+            fail(write ? "unexpected write" : "unexpected read");
+            return nullptr;
+        }
+        position++;
+        return &t;
+    }
+
+    void fail(const char* what) {
+        if (error.empty()) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s at transaction %u", what, (unsigned int)position);
+            error = buf;
+        }
+    }
+};
+
+#endif
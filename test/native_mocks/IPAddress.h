@@ -0,0 +1,42 @@
+#ifndef IPADDRESS_H_MOCK
+#define IPADDRESS_H_MOCK
+
+#include "Arduino.h"
+
+// IPv4 address, the subset of the ESP8266 core class the uploader uses
+class IPAddress {
+private:
+    uint8_t bytes[4];
+    
+public:
+    IPAddress() { memset(bytes, 0, sizeof(bytes)); }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        bytes[0] = a;
+        bytes[1] = b;
+        bytes[2] = c;
+        bytes[3] = d;
+    }
+    
+    bool fromString(const char* address) {
+        unsigned int a, b, c, d;
+        char extra;
+        if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 ||
+            a > 255 || b > 255 || c > 255 || d > 255) {
+            return false;
+        }
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+    
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+        return String(buf);
+    }
+    
+    uint8_t operator[](int index) const { return bytes[index]; }
+    bool operator==(const IPAddress& other) const { return memcmp(bytes, other.bytes, 4) == 0; }
+    bool isSet() const { return bytes[0] || bytes[1] || bytes[2] || bytes[3]; }
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef MQTT_STUB_BROKER_H_MOCK
+#define MQTT_STUB_BROKER_H_MOCK
+
+// Local stand-in for an MQTT 3.1.1 broker. Accepts one client at a time,
+// answers CONNECT and QoS 1 PUBLISH, and records what was published.
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct StubMessage {
+    std::string topic;
+    std::string payload;
+};
+
+class MqttStubBroker {
+public:
+    uint8_t connackCode;       // Return code sent in CONNACK
+    std::string clientId;      // From the last CONNECT
+    std::string username;
+    std::string password;
+
+    MqttStubBroker()
+        : connackCode(0), listenFd(-1), port(0), running(false), disconnects(0) {}
+    ~MqttStubBroker() { stop(); }
+
+    uint16_t start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(listenFd, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listenFd, 4);
+
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, (struct sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+
+        running = true;
+        thread = std::thread(&MqttStubBroker::serveLoop, this);
+        return port;
+    }
+
+    void stop() {
+        if (!running) {
+            return;
+        }
+        running = false;
+        shutdown(listenFd, SHUT_RDWR);
+        close(listenFd);
+        thread.join();
+    }
+
+    uint16_t getPort() const { return port; }
+
+    std::vector<StubMessage> messages() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received;
+    }
+
+    size_t disconnectCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return disconnects;
+    }
+
+private:
+    int listenFd;
+    uint16_t port;
+    volatile bool running;
+    size_t disconnects;
+    std::thread thread;
+    std::vector<StubMessage> received;
+    std::mutex mutex;
+
+    static bool readAll(int fd, uint8_t* buf, size_t size) {
+        size_t got = 0;
+        while (got < size) {
+            ssize_t n = recv(fd, buf + got, size - got, 0);
+            if (n <= 0) {
+                return false;
+            }
+            got += n;
+        }
+        return true;
+    }
+
+    static std::string readString(const std::string& body, size_t& pos) {
+        size_t length = ((uint8_t)body[pos] << 8) | (uint8_t)body[pos + 1];
+        std::string value = body.substr(pos + 2, length);
+        pos += 2 + length;
+        return value;
+    }
+
+    void serveLoop() {
+        while (running) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            serve(fd);
+            close(fd);
+        }
+    }
+
+    void serve(int fd) {
+        while (true) {
+            uint8_t type;
+            if (!readAll(fd, &type, 1)) {
+                return;
+            }
+            size_t length = 0;
+            size_t multiplier = 1;
+            uint8_t digit;
+            do {
+                if (!readAll(fd, &digit, 1)) {
+                    return;
+                }
+                length += (digit & 0x7F) * multiplier;
+                multiplier *= 128;
+            } while (digit & 0x80);
+
+            std::string body(length, '\0');
+            if (length > 0 && !readAll(fd, (uint8_t*)&body[0], length)) {
+                return;
+            }
+
+            switch (type & 0xF0) {
+                case 0x10: {   // CONNECT
+                    uint8_t flags = body[7];
+                    size_t pos = 10;
+                    clientId = readString(body, pos);
+                    username = (flags & 0x80) ? readString(body, pos) : "";
+                    password = (flags & 0x40) ? readString(body, pos) : "";
+                    uint8_t connack[4] = { 0x20, 0x02, 0x00, connackCode };
+                    send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+                    if (connackCode != 0) {
+                        return;
+                    }
+                    break;
+                }
+                case 0x30: {   // PUBLISH
+                    size_t pos = 0;
+                    StubMessage message;
+                    message.topic = readString(body, pos);
+                    uint8_t qos = (type >> 1) & 0x03;
+                    uint8_t puback[4] = { 0x40, 0x02, 0, 0 };
+                    if (qos > 0) {
+                        puback[2] = body[pos];
+                        puback[3] = body[pos + 1];
+                        pos += 2;
+                    }
+                    message.payload = body.substr(pos);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        received.push_back(message);
+                    }
+                    if (qos > 0) {
+                        send(fd, puback, sizeof(puback), MSG_NOSIGNAL);
+                    }
+                    break;
+                }
+                case 0xE0: {   // DISCONNECT
+                    std::lock_guard<std::mutex> lock(mutex);
+                    disconnects++;
+                    return;
+                }
+                default:
+                    return;
+            }
+        }
+    }
+};
+
+#endif
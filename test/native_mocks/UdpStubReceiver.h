@@ -0,0 +1,96 @@
+#ifndef UDP_STUB_RECEIVER_H_MOCK
+#define UDP_STUB_RECEIVER_H_MOCK
+
+// Local stand-in for a Telegraf / InfluxDB UDP listener. Records every
+// datagram it receives.
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+class UdpStubReceiver {
+public:
+    UdpStubReceiver() : fd(-1), port(0), running(false) {}
+    ~UdpStubReceiver() { stop(); }
+
+    uint16_t start() {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (struct sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+
+        running = true;
+        thread = std::thread(&UdpStubReceiver::receiveLoop, this);
+        return port;
+    }
+
+    void stop() {
+        if (!running) {
+            return;
+        }
+        running = false;
+        thread.join();
+        close(fd);
+    }
+
+    uint16_t getPort() const { return port; }
+
+    std::vector<std::string> datagrams() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received;
+    }
+
+    bool waitForDatagrams(size_t count, int timeoutMs = 2000) {
+        for (int waited = 0; waited < timeoutMs; waited += 5) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (received.size() >= count) {
+                    return true;
+                }
+            }
+            usleep(5000);
+        }
+        return false;
+    }
+
+private:
+    int fd;
+    uint16_t port;
+    volatile bool running;
+    std::thread thread;
+    std::vector<std::string> received;
+    std::mutex mutex;
+
+    void receiveLoop() {
+        char buf[2048];
+        while (running) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 10) <= 0) {
+                continue;
+            }
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                received.push_back(std::string(buf, n));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef WIFI_CLIENT_H_MOCK
+#define WIFI_CLIENT_H_MOCK
+
+#include "Client.h"
+
+// TCP client backed by POSIX sockets so native tests can talk to local stubs
+class WiFiClient : public Client {
+private:
+    int fd;
+    
+public:
+    WiFiClient() : fd(-1) {}
+    ~WiFiClient() { stop(); }
+    
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char* host, uint16_t port);
+    size_t write(const uint8_t* buf, size_t size);
+    int available();
+    int read();
+    int read(uint8_t* buf, size_t size);
+    void flush() {}
+    void stop();
+    uint8_t connected();
+    operator bool() { return connected(); }
+    
+    void setTimeout(unsigned long ms) {}
+    void setNoDelay(bool nodelay) {}
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "WiFiUdp.h"
+
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    return beginPacket(ip.toString().c_str(), port);
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        return 0;
+    }
+    target.addr = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    target.port = port;
+    freeaddrinfo(result);
+    
+    if (fd < 0) {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+    packetLength = 0;
+    return fd >= 0 ? 1 : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+    if (packetLength + size > sizeof(packet)) {
+        size = sizeof(packet) - packetLength;
+    }
+    memcpy(packet + packetLength, buf, size);
+    packetLength += size;
+    return size;
+}
+
+int WiFiUDP::endPacket() {
+    if (fd < 0) {
+        return 0;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = target.addr;
+    addr.sin_port = htons(target.port);
+    
+    ssize_t sent = sendto(fd, packet, packetLength, 0, (struct sockaddr*)&addr, sizeof(addr));
+    packetLength = 0;
+    return sent >= 0 ? 1 : 0;
+}
+
+void WiFiUDP::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
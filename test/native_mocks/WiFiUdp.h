@@ -0,0 +1,29 @@
+#ifndef WIFI_UDP_H_MOCK
+#define WIFI_UDP_H_MOCK
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+// UDP sender backed by POSIX sockets so native tests can use local receivers
+class WiFiUDP {
+private:
+    int fd;
+    uint8_t packet[1472];
+    size_t packetLength;
+    struct Target {
+        uint32_t addr;   // Network byte order
+        uint16_t port;
+    } target;
+    
+public:
+    WiFiUDP() : fd(-1), packetLength(0) { target.addr = 0; target.port = 0; }
+    ~WiFiUDP() { stop(); }
+    
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacket(const char* host, uint16_t port);
+    size_t write(const uint8_t* buf, size_t size);
+    int endPacket();
+    void stop();
+};
+
+#endif
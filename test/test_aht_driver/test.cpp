@@ -0,0 +1,126 @@
+#include <unity.h>
+#include "../lib/AhtDriver.h"
+#include "I2cStubBus.h"
+
+// Recorded from an AHT20 at 21.5 °C / 41.9 %RH; status 0x1C = idle, calibrated
+static const std::vector<uint8_t> AHT20_RESULT = { 0x1C, 0x6B, 0x2E, 0x45, 0xB8, 0x6F, 0xD0 };
+// AHT10 at 15.5 °C / 22.0 %RH
+static const std::vector<uint8_t> AHT10_RESULT = { 0x1C, 0x38, 0x51, 0xE5, 0x3D, 0x21 };
+static const std::vector<uint8_t> TRIGGER = { 0xAC, 0x33, 0x00 };
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_aht_driver_aht20_measurement(void) {
+    I2cStubBus bus;
+    bus.expectRead(AHT_ADDRESS, { 0x1C });
+    bus.expectWrite(AHT_ADDRESS, TRIGGER);
+    bus.expectRead(AHT_ADDRESS, AHT20_RESULT);
+    AhtDriver aht(bus, AHT_MODEL_AHT20);
+    Measurement measurement;
+    
+    TEST_ASSERT_TRUE(aht.start());
+    TEST_ASSERT_TRUE(aht.read(measurement));
+    TEST_ASSERT_TRUE_MESSAGE(bus.finished(), bus.getError().c_str());
+    TEST_ASSERT_EQUAL(SENSOR_TEMPERATURE | SENSOR_HUMIDITY, measurement.channels);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 21.51, measurement.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 41.87, measurement.humidity);
+    TEST_ASSERT_EQUAL_STRING("AHT20", aht.name());
+}
+
+void test_aht_driver_aht20_crc_mismatch(void) {
+    I2cStubBus bus;
+    std::vector<uint8_t> corrupted(AHT20_RESULT);
+    corrupted[4] ^= 0x01;
+    bus.expectRead(AHT_ADDRESS, corrupted);
+    AhtDriver aht(bus, AHT_MODEL_AHT20);
+    Measurement measurement;
+    
+    TEST_ASSERT_FALSE(aht.read(measurement));
+    TEST_ASSERT_EQUAL(0, measurement.channels);
+}
+
+void test_aht_driver_aht10_measurement(void) {
+    I2cStubBus bus;
+    bus.expectRead(AHT_ADDRESS, { 0x1C });
+    bus.expectWrite(AHT_ADDRESS, TRIGGER);
+    bus.expectRead(AHT_ADDRESS, AHT10_RESULT);
+    AhtDriver aht(bus, AHT_MODEL_AHT10);
+    Measurement measurement;
+    
+    TEST_ASSERT_TRUE(aht.start());
+    TEST_ASSERT_TRUE(aht.read(measurement));
+    TEST_ASSERT_TRUE_MESSAGE(bus.finished(), bus.getError().c_str());
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 15.48, measurement.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 22.00, measurement.humidity);
+}
+
+void test_aht_driver_absent(void) {
+    I2cStubBus bus;
+    bus.expectRead(AHT_ADDRESS, { 0x00 }, false);
+    AhtDriver aht(bus, AHT_MODEL_AHT10);
+    
+    TEST_ASSERT_FALSE(aht.start());
+    TEST_ASSERT_TRUE_MESSAGE(bus.finished(), bus.getError().c_str());
+}
+
+void test_aht_driver_initializes_uncalibrated(void) {
+    I2cStubBus bus;
+    bus.expectRead(AHT_ADDRESS, { 0x10 });
+    bus.expectWrite(AHT_ADDRESS, { 0xE1, 0x08, 0x00 });
+    bus.expectWrite(AHT_ADDRESS, TRIGGER);
+    bus.expectRead(AHT_ADDRESS, { 0x10 });
+    bus.expectWrite(AHT_ADDRESS, { 0xBE, 0x08, 0x00 });
+    bus.expectWrite(AHT_ADDRESS, TRIGGER);
+    AhtDriver aht10(bus, AHT_MODEL_AHT10);
+    AhtDriver aht20(bus, AHT_MODEL_AHT20);
+    
+    TEST_ASSERT_TRUE(aht10.start());
+    TEST_ASSERT_TRUE(aht20.start());
+    TEST_ASSERT_TRUE_MESSAGE(bus.finished(), bus.getError().c_str());
+}
+
+void test_aht_driver_waits_while_busy(void) {
+    I2cStubBus bus;
+    std::vector<uint8_t> busy(AHT10_RESULT);
+    busy[0] = 0x9C;
+    bus.expectRead(AHT_ADDRESS, busy);
+    bus.expectRead(AHT_ADDRESS, AHT10_RESULT);
+    AhtDriver aht(bus, AHT_MODEL_AHT10);
+    Measurement measurement;
+    
+    TEST_ASSERT_TRUE(aht.read(measurement));
+    TEST_ASSERT_TRUE_MESSAGE(bus.finished(), bus.getError().c_str());
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 15.48, measurement.temperature);
+    
+    // Gives up when the chip stays busy
+    I2cStubBus stuck;
+    for (int i = 0; i < 4; i++) {
+        stuck.expectRead(AHT_ADDRESS, busy);
+    }
+    AhtDriver stuckAht(stuck, AHT_MODEL_AHT10);
+    Measurement none;
+    TEST_ASSERT_FALSE(stuckAht.read(none));
+    TEST_ASSERT_TRUE_MESSAGE(stuck.finished(), stuck.getError().c_str());
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_aht_driver_aht20_measurement);
+    RUN_TEST(test_aht_driver_aht20_crc_mismatch);
+    RUN_TEST(test_aht_driver_aht10_measurement);
+    RUN_TEST(test_aht_driver_absent);
+    RUN_TEST(test_aht_driver_initializes_uncalibrated);
+    RUN_TEST(test_aht_driver_waits_while_busy);
+
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,463 @@
+#include <unity.h>
+#include "../native_mocks/HttpStubServer.h"
+#include "../lib/BinaryProtocol.h"
+#include "../lib/BinaryUploadSink.h"
+#include "../lib/LineProtocol.h"
+#include "../lib/Config.h"
+#include "../lib/SensorRecord.h"
+
+// 2024-01-01 rounded down to a 65536-second boundary, as Config does
+static const uint32_t TEST_OFFSET = (1704067200UL / 65536) * 65536;
+static const uint8_t TEST_DEVICE[6] = { 0x5c, 0xcf, 0x7f, 0x01, 0xab, 0xef };
+
+static Config testConfig;
+
+void setUp(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.influxServer, "127.0.0.1");
+    strcpy(testConfig.influxMeasurement, "environment");
+    testConfig.uploadSink = UPLOAD_SINK_BINARY;
+    testConfig.timeOffset = TEST_OFFSET;
+    testConfig.magic = CONFIG_MAGIC;
+}
+
+void tearDown(void) {
+}
+
+static BinaryRecord makeRecord(uint16_t timestamp, uint8_t temperature, uint8_t humidity) {
+    BinaryRecord record;
+    record.timestamp = timestamp;
+    record.temperature = temperature;
+    record.humidity = humidity;
+    return record;
+}
+
+// An ingest service built before channel slots: refuses blocks above version 2
+static size_t decodeVersion2(const uint8_t* buf, size_t length, BinaryBlock& block) {
+    if (length > 2 && buf[2] > 2) {
+        return 0;
+    }
+    return BinaryBlockDecoder::decode(buf, length, block);
+}
+
+void test_block_round_trip(void) {
+    uint8_t buf[BINARY_MAX_BLOCK_SIZE];
+    BinaryRecord input[BINARY_MAX_BLOCK_RECORDS];
+    BinaryBlockEncoder encoder;
+
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET);
+    for (int i = 0; i < BINARY_MAX_BLOCK_RECORDS; i++) {
+        input[i] = makeRecord(60 + i * 30, 118 + (i % 5), 40 + (i % 7));
+        TEST_ASSERT_TRUE(encoder.add(input[i]));
+    }
+    TEST_ASSERT_FALSE(encoder.add(input[0]));
+    size_t length = encoder.finish();
+
+    BinaryBlock block;
+    TEST_ASSERT_EQUAL(length, BinaryBlockDecoder::decode(buf, length, block));
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_RECORDS, block.type);
+    TEST_ASSERT_EQUAL_MEMORY(TEST_DEVICE, block.deviceId, 6);
+    TEST_ASSERT_EQUAL(TEST_OFFSET, block.timeOffset);
+    TEST_ASSERT_EQUAL(BINARY_MAX_BLOCK_RECORDS, block.count);
+    for (int i = 0; i < BINARY_MAX_BLOCK_RECORDS; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(&input[i], &block.records[i], sizeof(BinaryRecord));
+    }
+}
+
+void test_block_extreme_deltas(void) {
+    uint8_t buf[BINARY_MAX_BLOCK_SIZE];
+    BinaryBlockEncoder encoder;
+    BinaryRecord input[4] = {
+        makeRecord(0, 0, 0),
+        makeRecord(65535, 255, 100),
+        makeRecord(0, 0, 0),
+        makeRecord(12, 155, 50),
+    };
+
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET);
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(encoder.add(input[i]));
+    }
+    size_t length = encoder.finish();
+
+    BinaryBlock block;
+    TEST_ASSERT_EQUAL(length, BinaryBlockDecoder::decode(buf, length, block));
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(&input[i], &block.records[i], sizeof(BinaryRecord));
+    }
+}
+
+void test_block_rejects_bad_input(void) {
+    uint8_t buf[BINARY_MAX_BLOCK_SIZE];
+    BinaryBlockEncoder encoder;
+    BinaryBlock block;
+
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET);
+    for (int i = 0; i < 10; i++) {
+        encoder.add(makeRecord(i * 30, 120, 50));
+    }
+    size_t length = encoder.finish();
+
+    for (size_t cut = 0; cut < length; cut++) {
+        TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(buf, cut, block));
+    }
+
+    buf[0] = 'X';
+    TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(buf, length, block));
+    buf[0] = 'M';
+    buf[2] = BINARY_PROTOCOL_VERSION + 1;
+    TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(buf, length, block));
+}
+
+void test_block_channel_round_trip(void) {
+    uint8_t buf[BINARY_MAX_BLOCK_SIZE];
+    BinaryRecord input[BINARY_MAX_BLOCK_RECORDS];
+    BinaryBlockEncoder encoder;
+
+    // Measurements without humidity, each followed by pressure and probe slots
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET, true);
+    TEST_ASSERT_TRUE(encoder.hasChannels());
+    int count = 0;
+    for (int i = 0; count + 3 <= BINARY_MAX_BLOCK_RECORDS; i++) {
+        input[count++] = makeRecord(60 + i * 30, 118 + (i % 3), SENSOR_NO_HUMIDITY);
+        input[count++] = makeRecord((uint16_t)(10132 - i), SENSOR_PRESSURE, SENSOR_CHANNEL_SLOT);
+        input[count++] = makeRecord((uint16_t)(int16_t)(-250 + i * 7), SENSOR_PROBE_TEMPERATURE,
+                                    SENSOR_CHANNEL_SLOT);
+    }
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(encoder.add(input[i]));
+    }
+    size_t length = encoder.finish();
+    TEST_ASSERT_EQUAL(BINARY_PROTOCOL_VERSION, buf[2]);
+
+    BinaryBlock block;
+    TEST_ASSERT_EQUAL(length, BinaryBlockDecoder::decode(buf, length, block));
+    TEST_ASSERT_EQUAL(count, block.count);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(&input[i], &block.records[i], sizeof(BinaryRecord));
+    }
+
+    for (size_t cut = 0; cut < length; cut++) {
+        TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(buf, cut, block));
+    }
+
+    // Slots need the version 3 layout
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET);
+    TEST_ASSERT_TRUE(encoder.add(input[0]));
+    TEST_ASSERT_FALSE(encoder.add(input[1]));
+    encoder.finish();
+    TEST_ASSERT_EQUAL(BINARY_PLAIN_RECORDS_VERSION, buf[2]);
+}
+
+void test_battery_block(void) {
+    uint8_t buf[BINARY_BATTERY_SIZE];
+    size_t length = BinaryBlockEncoder::encodeBattery(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET,
+                                                      1704067200, 3875, 12);
+    TEST_ASSERT_EQUAL(sizeof(buf), length);
+
+    BinaryBlock block;
+    TEST_ASSERT_EQUAL(length, BinaryBlockDecoder::decode(buf, length, block));
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_BATTERY, block.type);
+
+    char line[128];
+    BinaryBlockDecoder::formatBatteryLine(line, sizeof(line), "environment", block);
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef battery_voltage=3.88,upload_seq=12i 1704067200\n", line);
+
+    // Version 1 battery blocks carry no sequence
+    uint8_t v1[BINARY_HEADER_SIZE + 6];
+    memcpy(v1, buf, sizeof(v1));
+    v1[2] = 1;
+    TEST_ASSERT_EQUAL(sizeof(v1), BinaryBlockDecoder::decode(v1, sizeof(v1), block));
+    BinaryBlockDecoder::formatBatteryLine(line, sizeof(line), "environment", block);
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef battery_voltage=3.88 1704067200\n", line);
+}
+
+// Decoded lines carry the same values and timestamps as the device encoder
+void test_lines_match_device_encoder(void) {
+    uint8_t buf[BINARY_MAX_BLOCK_SIZE];
+    BinaryBlockEncoder encoder;
+    SensorRecord records[3] = {
+        SensorRecord::create(-12.0, 85.0, TEST_OFFSET + 3600, TEST_OFFSET),
+        SensorRecord::create(0.0, 0.0, TEST_OFFSET + 5400, TEST_OFFSET),
+        SensorRecord::create(35.0, 30.0, TEST_OFFSET + 7200, TEST_OFFSET),
+    };
+
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET);
+    for (int i = 0; i < 3; i++) {
+        encoder.add(makeRecord(records[i].timestamp, (uint8_t)records[i].temperature, records[i].humidity));
+    }
+    size_t length = encoder.finish();
+
+    BinaryBlock block;
+    BinaryBlockDecoder::decode(buf, length, block);
+    for (int i = 0; i < 3; i++) {
+        char decoded[128];
+        char expected[LineProtocol::MAX_LINE];
+        BinaryBlockDecoder::formatRecordLine(decoded, sizeof(decoded), "environment",
+                                             block, block.records[i]);
+        LineProtocol::encodeRecord(expected, sizeof(expected), "environment,device=5ccf7f01abef",
+                                   records[i], TEST_OFFSET, PRECISION_S);
+        TEST_ASSERT_EQUAL_STRING(expected, decoded);
+    }
+}
+
+// Channel fields and a missing humidity come out as the station writes them
+void test_channel_lines_match_device_encoder(void) {
+    uint8_t buf[BINARY_MAX_BLOCK_SIZE];
+    BinaryBlockEncoder encoder;
+    Measurement measurement;
+    measurement.set(SENSOR_TEMPERATURE, -4.0);
+    measurement.set(SENSOR_PRESSURE, 1013.0);
+    measurement.set(SENSOR_PROBE_TEMPERATURE, -0.05);
+    SensorRecord records[SENSOR_MAX_SLOTS];
+    uint8_t count = SensorRecord::pack(measurement, TEST_OFFSET + 3600, TEST_OFFSET, records);
+
+    encoder.begin(buf, sizeof(buf), TEST_DEVICE, TEST_OFFSET, true);
+    for (int i = 0; i < count; i++) {
+        encoder.add(makeRecord(records[i].timestamp, (uint8_t)records[i].temperature, records[i].humidity));
+    }
+    BinaryBlock block;
+    BinaryBlockDecoder::decode(buf, encoder.finish(), block);
+
+    char decoded[128];
+    char expected[LineProtocol::MAX_LINE];
+    BinaryBlockDecoder::formatRecordLine(decoded, sizeof(decoded), "environment", block,
+                                         block.records[0], block.records + 1, count - 1);
+    LineProtocol::encodePoint(expected, sizeof(expected), "environment,device=5ccf7f01abef",
+                              records[0].getTimestampSeconds(TEST_OFFSET), -4, records[0].humidity,
+                              PRECISION_S, records + 1, count - 1);
+    TEST_ASSERT_EQUAL_STRING(expected, decoded);
+    TEST_ASSERT_NOT_NULL(strstr(decoded, " temperature=-4,pressure=1013,probe_temperature=-0.05 "));
+}
+
+// The location tag comes out escaped as the station's own series
+void test_location_block(void) {
+    uint8_t buf[BINARY_MAX_LOCATION_SIZE];
+    size_t length = BinaryBlockEncoder::encodeLocation(buf, sizeof(buf), TEST_DEVICE, "back yard,n=1");
+    TEST_ASSERT_EQUAL(BINARY_HEADER_SIZE + 13, length);
+
+    BinaryBlock block;
+    TEST_ASSERT_EQUAL(length, BinaryBlockDecoder::decode(buf, length, block));
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_LOCATION, block.type);
+    TEST_ASSERT_EQUAL_STRING("back yard,n=1", block.location);
+
+    char series[64];
+    char expected[LineProtocol::MAX_LINE];
+    char decoded[128];
+    LineProtocol::encodeSeries(series, sizeof(series), "environment", "5ccf7f01abef", block.location);
+    SensorRecord record = SensorRecord::create(21.0, 55.0, TEST_OFFSET + 3600, TEST_OFFSET);
+    LineProtocol::encodeRecord(expected, sizeof(expected), series, record, TEST_OFFSET, PRECISION_S);
+
+    uint8_t records[BINARY_MAX_BLOCK_SIZE];
+    BinaryBlockEncoder encoder;
+    encoder.begin(records, sizeof(records), TEST_DEVICE, TEST_OFFSET);
+    encoder.add(makeRecord(record.timestamp, (uint8_t)record.temperature, record.humidity));
+    BinaryBlock recordBlock;
+    BinaryBlockDecoder::decode(records, encoder.finish(), recordBlock);
+    BinaryBlockDecoder::formatRecordLine(decoded, sizeof(decoded), "environment", recordBlock,
+                                         recordBlock.records[0], nullptr, 0, block.location);
+    TEST_ASSERT_EQUAL_STRING(expected, decoded);
+
+    // Too long or empty: nothing to send
+    TEST_ASSERT_EQUAL(0, BinaryBlockEncoder::encodeLocation(buf, sizeof(buf), TEST_DEVICE, "0123456789abcdef"));
+    TEST_ASSERT_EQUAL(0, BinaryBlockEncoder::encodeLocation(buf, sizeof(buf), TEST_DEVICE, ""));
+
+    // A line break would split the ingested line
+    length = BinaryBlockEncoder::encodeLocation(buf, sizeof(buf), TEST_DEVICE, "roof");
+    buf[BINARY_HEADER_SIZE + 2] = '\n';
+    TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(buf, length, block));
+    buf[BINARY_HEADER_SIZE + 2] = 'o';
+    TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(buf, length - 1, block));
+}
+
+// Device sink -> HTTP -> decoder, the path the ingest service takes
+void test_sink_round_trip(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+
+    BinaryUploadSink sink;
+    TEST_ASSERT_TRUE(sink.begin(&testConfig));
+    sink.setDeviceId(TEST_DEVICE);
+
+    const int count = 100;
+    SensorRecord records[count];
+    for (int i = 0; i < count; i++) {
+        records[i] = SensorRecord::create(18.0 + (i % 8), 40.0 + (i % 30), 
+                                          TEST_OFFSET + 3600 + i * 1800, TEST_OFFSET);
+        TEST_ASSERT_TRUE(sink.writeSensorRecord(records[i], TEST_OFFSET));
+    }
+    TEST_ASSERT_TRUE(sink.writeBatteryVoltage(3.9, 3, TEST_OFFSET + 3600));
+    TEST_ASSERT_TRUE(sink.flush());
+    sink.close();
+
+    TEST_ASSERT_TRUE(server.waitForRequests(1));
+    std::vector<StubRequest> requests = server.requests();
+    TEST_ASSERT_EQUAL(1, requests.size());
+    TEST_ASSERT_EQUAL_STRING(BINARY_INGEST_PATH, requests[0].path.c_str());
+    std::string contentType = requests[0].header("content-type");
+    TEST_ASSERT_EQUAL_STRING("application/octet-stream", contentType.c_str());
+    TEST_ASSERT_EQUAL(sink.getBytesSent(), requests[0].body.size());
+    TEST_ASSERT_EQUAL(count, sink.getRecordsSent());
+
+    const uint8_t* body = (const uint8_t*)requests[0].body.data();
+    size_t pos = 0;
+    int decoded = 0;
+    bool battery = false;
+    BinaryBlock block;
+    while (pos < requests[0].body.size()) {
+        // No channel slots: the whole session, battery included, is
+        // readable by ingest services that predate them
+        size_t used = decodeVersion2(body + pos, requests[0].body.size() - pos, block);
+        TEST_ASSERT_TRUE(used > 0);
+        pos += used;
+        TEST_ASSERT_EQUAL_MEMORY(TEST_DEVICE, block.deviceId, 6);
+
+        if (block.type == BINARY_BLOCK_BATTERY) {
+            TEST_ASSERT_EQUAL(3900, block.batteryMillivolts);
+            TEST_ASSERT_EQUAL(3, block.sequence);
+            TEST_ASSERT_EQUAL(TEST_OFFSET + 3600, block.batteryTime);
+            battery = true;
+            continue;
+        }
+        TEST_ASSERT_EQUAL(BINARY_PLAIN_RECORDS_VERSION, block.version);
+        for (uint16_t i = 0; i < block.count; i++, decoded++) {
+            TEST_ASSERT_EQUAL(records[decoded].getTimestampSeconds(TEST_OFFSET),
+                              BinaryBlockDecoder::timestampSeconds(block, block.records[i]));
+            TEST_ASSERT_EQUAL((int)records[decoded].getTemperature(),
+                              BinaryBlockDecoder::temperature(block.records[i]));
+            TEST_ASSERT_EQUAL(records[decoded].humidity, block.records[i].humidity);
+        }
+    }
+    TEST_ASSERT_EQUAL(count, decoded);
+    TEST_ASSERT_TRUE(battery);
+
+    char message[96];
+    snprintf(message, sizeof(message), "binary body: %u bytes for %d records (%.1f bytes/record)",
+             (unsigned int)requests[0].body.size(), count, (double)requests[0].body.size() / count);
+    TEST_MESSAGE(message);
+}
+
+// A location leads the request body and tags every line after it
+void test_sink_sends_location(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+    strcpy(testConfig.location, "garden");
+
+    BinaryUploadSink sink;
+    TEST_ASSERT_TRUE(sink.begin(&testConfig));
+    sink.setDeviceId(TEST_DEVICE);
+    SensorRecord record = SensorRecord::create(18.0, 40.0, TEST_OFFSET + 3600, TEST_OFFSET);
+    TEST_ASSERT_TRUE(sink.writeSensorRecord(record, TEST_OFFSET));
+    TEST_ASSERT_TRUE(sink.writeBatteryVoltage(3.9, 3, TEST_OFFSET + 3600));
+    TEST_ASSERT_TRUE(sink.flush());
+    sink.close();
+
+    TEST_ASSERT_TRUE(server.waitForRequests(1));
+    std::string body = server.requests()[0].body;
+    TEST_ASSERT_EQUAL(sink.getBytesSent(), body.size());
+    const uint8_t* data = (const uint8_t*)body.data();
+    BinaryBlock block;
+    size_t pos = BinaryBlockDecoder::decode(data, body.size(), block);
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_LOCATION, block.type);
+    TEST_ASSERT_EQUAL_STRING("garden", block.location);
+
+    char line[128];
+    pos += BinaryBlockDecoder::decode(data + pos, body.size() - pos, block);
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_RECORDS, block.type);
+    BinaryBlockDecoder::formatRecordLine(line, sizeof(line), "environment", block, block.records[0],
+                                         nullptr, 0, "garden");
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef,location=garden temperature=18,humidity=40 1704070620\n",
+                             line);
+
+    pos += BinaryBlockDecoder::decode(data + pos, body.size() - pos, block);
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_BATTERY, block.type);
+    BinaryBlockDecoder::formatBatteryLine(line, sizeof(line), "environment", block, "garden");
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef,location=garden battery_voltage=3.90,upload_seq=3i 1704070672\n",
+                             line);
+    TEST_ASSERT_EQUAL(body.size(), pos);
+}
+
+// Measurements never straddle blocks, and only blocks with slots use version 3
+void test_sink_keeps_measurements_in_one_block(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+
+    BinaryUploadSink sink;
+    TEST_ASSERT_TRUE(sink.begin(&testConfig));
+
+    SensorRecord records[100];
+    size_t count = 0;
+    for (int i = 0; count + SENSOR_MAX_SLOTS <= 100; i++) {
+        Measurement measurement;
+        measurement.set(SENSOR_TEMPERATURE, 20.0);
+        measurement.set(SENSOR_HUMIDITY, 50.0);
+        if (i >= 10) {
+            measurement.set(SENSOR_PRESSURE, 1000.0 + i);
+        }
+        count += SensorRecord::pack(measurement, TEST_OFFSET + i * 600, TEST_OFFSET, records + count);
+    }
+    TEST_ASSERT_TRUE(sink.writeSensorRecords(records, count, TEST_OFFSET));
+    TEST_ASSERT_TRUE(sink.flush());
+    sink.close();
+
+    TEST_ASSERT_TRUE(server.waitForRequests(1));
+    std::vector<StubRequest> requests = server.requests();
+    const uint8_t* body = (const uint8_t*)requests[0].body.data();
+    size_t pos = 0;
+    size_t decoded = 0;
+    BinaryBlock block;
+    while (pos < requests[0].body.size()) {
+        size_t used = BinaryBlockDecoder::decode(body + pos, requests[0].body.size() - pos, block);
+        TEST_ASSERT_TRUE(used > 0);
+        pos += used;
+
+        bool slots = false;
+        for (uint16_t i = 0; i < block.count; i++) {
+            slots = slots || block.records[i].humidity == SENSOR_CHANNEL_SLOT;
+            TEST_ASSERT_EQUAL_MEMORY(&records[decoded + i], &block.records[i], sizeof(BinaryRecord));
+        }
+        TEST_ASSERT_TRUE(block.records[0].humidity != SENSOR_CHANNEL_SLOT);
+        TEST_ASSERT_EQUAL(slots ? BINARY_PROTOCOL_VERSION : BINARY_PLAIN_RECORDS_VERSION, block.version);
+        decoded += block.count;
+    }
+    TEST_ASSERT_EQUAL(count, decoded);
+    TEST_ASSERT_EQUAL(count, sink.getRecordsSent());
+}
+
+void test_sink_server_error(void) {
+    HttpStubServer server;
+    server.status = 502;
+    server.responseBody = "InfluxDB unreachable";
+    testConfig.influxPort = server.start();
+
+    BinaryUploadSink sink;
+    sink.begin(&testConfig);
+    sink.writeSensorRecord(SensorRecord::create(20.0, 50.0, TEST_OFFSET + 60, TEST_OFFSET), TEST_OFFSET);
+
+    TEST_ASSERT_FALSE(sink.flush());
+    TEST_ASSERT_TRUE(sink.getLastError().length() > 0);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_block_round_trip);
+    RUN_TEST(test_block_extreme_deltas);
+    RUN_TEST(test_block_rejects_bad_input);
+    RUN_TEST(test_block_channel_round_trip);
+    RUN_TEST(test_battery_block);
+    RUN_TEST(test_lines_match_device_encoder);
+    RUN_TEST(test_channel_lines_match_device_encoder);
+    RUN_TEST(test_location_block);
+    RUN_TEST(test_sink_round_trip);
+    RUN_TEST(test_sink_sends_location);
+    RUN_TEST(test_sink_keeps_measurements_in_one_block);
+    RUN_TEST(test_sink_server_error);
+
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -27,6 +27,7 @@ void test_config_default_values(void) {
     TEST_ASSERT_EQUAL(1800, config.interval);
     TEST_ASSERT_EQUAL(8086, config.influxPort);
     TEST_ASSERT_EQUAL_STRING("environment", config.influxMeasurement);
+    TEST_ASSERT_EQUAL(INFLUX_API_V1, config.influxVersion);
 }
 
 void test_config_magic_validation(void) {
@@ -55,6 +56,32 @@ void test_config_save_and_load(void) {
     TEST_ASSERT_EQUAL(3600, loadedConfig.interval);
 }
 
+void test_config_save_and_load_v2(void) {
+    testConfig.setDefaults();
+    testConfig.influxVersion = INFLUX_API_V2;
+    strcpy(testConfig.influxOrg, "home");
+    strcpy(testConfig.influxBucket, "meteo");
+    strcpy(testConfig.influxToken, "token-value");
+    strcpy(testConfig.location, "garden");
+    testConfig.save();
+    
+    Config loadedConfig;
+    loadedConfig.load();
+    
+    TEST_ASSERT_TRUE(loadedConfig.isValid());
+    TEST_ASSERT_EQUAL(INFLUX_API_V2, loadedConfig.influxVersion);
+    TEST_ASSERT_EQUAL_STRING("home", loadedConfig.influxOrg);
+    TEST_ASSERT_EQUAL_STRING("meteo", loadedConfig.influxBucket);
+    TEST_ASSERT_EQUAL_STRING("token-value", loadedConfig.influxToken);
+    TEST_ASSERT_EQUAL_STRING("garden", loadedConfig.location);
+}
+
+void test_config_fits_below_rom_data(void) {
+    // Records are stored from ROM_DATA_START; the image is a 12-byte
+    // header and the fields, never more than the object plus the header
+    TEST_ASSERT_TRUE(CONFIG_ADDR + 12 + sizeof(Config) <= ROM_DATA_START);
+}
+
 void test_config_time_offset_update(void) {
     testConfig.setDefaults();
     
@@ -85,6 +112,307 @@ void test_config_load_invalid(void) {
     TEST_ASSERT_FALSE(loaded.isValid());
 }
 
+// Image header fields, see Config.cpp
+static const size_t HEADER_SIZE = 12;
+
+static uint32_t imageCrc(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t storedMagic() {
+    uint32_t magic;
+    EEPROM.get(CONFIG_ADDR, magic);
+    return magic;
+}
+
+// The class as firmware before versioning dumped it
+struct LegacyConfig {
+    char ssid[32];
+    char password[64];
+    uint16_t interval;
+    char influxServer[64];
+    uint16_t influxPort;
+    char influxDb[32];
+    char influxUser[32];
+    char influxPass[64];
+    char influxMeasurement[32];
+    uint32_t timeOffset;
+    uint32_t magic;
+};
+
+// Config::save() of the firmware before versioning, captured after setup
+// with ssid "MeteoNet", password "garden-2024", interval 900, server
+// 192.168.1.20:8086, database "meteo", user "station", password "s3cret"
+// and an NTP sync at 2024-01-01 00:00 UTC
+static const uint8_t LEGACY_IMAGE[332] = {
+    0x4d, 0x65, 0x74, 0x65, 0x6f, 0x4e, 0x65, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x67, 0x61, 0x72, 0x64, 0x65, 0x6e, 0x2d, 0x32, 0x30, 0x32, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x84, 0x03, 0x31, 0x39, 0x32, 0x2e, 0x31, 0x36, 0x38, 0x2e, 0x31, 0x2e, 0x32, 0x30, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x96, 0x1f, 0x6d, 0x65, 0x74, 0x65, 0x6f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x73, 0x74, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x73, 0x33, 0x63, 0x72, 0x65, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x65, 0x6e, 0x76, 0x69, 0x72, 0x6f, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x92, 0x65, 0x34, 0x12, 0xcd, 0xab
+};
+
+void test_config_migrates_legacy_image(void) {
+    for (size_t i = 0; i < sizeof(LEGACY_IMAGE); i++) {
+        EEPROM.write(CONFIG_ADDR + i, LEGACY_IMAGE[i]);
+    }
+    EEPROM.commits = 0;
+    
+    Config loaded;
+    TEST_ASSERT_TRUE(loaded.load());
+    TEST_ASSERT_TRUE(loaded.isValid());
+    TEST_ASSERT_EQUAL_STRING("MeteoNet", loaded.ssid);
+    TEST_ASSERT_EQUAL_STRING("garden-2024", loaded.password);
+    TEST_ASSERT_EQUAL(900, loaded.interval);
+    TEST_ASSERT_EQUAL_STRING("192.168.1.20", loaded.influxServer);
+    TEST_ASSERT_EQUAL(8086, loaded.influxPort);
+    TEST_ASSERT_EQUAL_STRING("meteo", loaded.influxDb);
+    TEST_ASSERT_EQUAL_STRING("station", loaded.influxUser);
+    TEST_ASSERT_EQUAL_STRING("s3cret", loaded.influxPass);
+    TEST_ASSERT_EQUAL_STRING("environment", loaded.influxMeasurement);
+    TEST_ASSERT_EQUAL(1704067072, loaded.timeOffset);
+    // Fields the old firmware did not have get their defaults
+    TEST_ASSERT_EQUAL(INFLUX_API_V1, loaded.influxVersion);
+    TEST_ASSERT_EQUAL(UPLOAD_SINK_INFLUX_HTTP, loaded.uploadSink);
+    TEST_ASSERT_EQUAL_STRING("", loaded.location);
+    TEST_ASSERT_NULL(loaded.validate());
+    
+    // Written back once in the new format, then read without writing
+    TEST_ASSERT_EQUAL(1, EEPROM.commits);
+    TEST_ASSERT_EQUAL(CONFIG_STORE_MAGIC, storedMagic());
+    Config again;
+    TEST_ASSERT_TRUE(again.load());
+    TEST_ASSERT_EQUAL_STRING("MeteoNet", again.ssid);
+    TEST_ASSERT_EQUAL(1, EEPROM.commits);
+}
+
+void test_config_save_skips_unchanged(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.ssid, "SameNetwork");
+    TEST_ASSERT_TRUE(testConfig.save());
+    EEPROM.commits = 0;
+    
+    // NTP sync saves on every upload, usually with the same offset
+    testConfig.updateTimeOffset(testConfig.timeOffset);
+    TEST_ASSERT_TRUE(testConfig.save());
+    TEST_ASSERT_EQUAL(0, EEPROM.commits);
+    
+    testConfig.interval = 600;
+    TEST_ASSERT_TRUE(testConfig.save());
+    TEST_ASSERT_EQUAL(1, EEPROM.commits);
+}
+
+void test_config_rejects_corrupt_image(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.ssid, "Network");
+    testConfig.save();
+    
+    EEPROM.write(CONFIG_ADDR + HEADER_SIZE + 3, 'X');
+    
+    Config loaded;
+    TEST_ASSERT_FALSE(loaded.load());
+    TEST_ASSERT_FALSE(loaded.isValid());
+    TEST_ASSERT_EQUAL(1800, loaded.interval);   // Defaults, not the damaged data
+}
+
+void test_config_keeps_fields_of_newer_firmware(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.ssid, "Network");
+    testConfig.save();
+    
+    // Pretend the next version appended 8 bytes of its own
+    uint8_t* image = EEPROM.getDataPtr() + CONFIG_ADDR;
+    uint16_t length;
+    memcpy(&length, image + 6, sizeof(length));
+    memset(image + HEADER_SIZE + length, 0x5A, 8);
+    length += 8;
+    image[4] = CONFIG_VERSION + 1;
+    memcpy(image + 6, &length, sizeof(length));
+    uint32_t crc = imageCrc(image + HEADER_SIZE, length);
+    memcpy(image + 8, &crc, sizeof(crc));
+    
+    Config loaded;
+    TEST_ASSERT_TRUE(loaded.load());
+    TEST_ASSERT_EQUAL_STRING("Network", loaded.ssid);
+    
+    loaded.interval = 300;
+    TEST_ASSERT_TRUE(loaded.save());
+    
+    uint16_t savedLength;
+    memcpy(&savedLength, image + 6, sizeof(savedLength));
+    TEST_ASSERT_EQUAL(CONFIG_VERSION + 1, image[4]);
+    TEST_ASSERT_EQUAL(length, savedLength);
+    TEST_ASSERT_EQUAL(0x5A, image[HEADER_SIZE + length - 1]);
+    
+    Config reloaded;
+    TEST_ASSERT_TRUE(reloaded.load());
+    TEST_ASSERT_EQUAL(300, reloaded.interval);
+}
+
+// Rewrites the stored image as an older version that ended 'cut' bytes earlier
+static void shortenImage(uint8_t version, size_t cut) {
+    uint8_t* image = EEPROM.getDataPtr() + CONFIG_ADDR;
+    uint16_t length;
+    memcpy(&length, image + 6, sizeof(length));
+    length -= cut;
+    image[4] = version;
+    memcpy(image + 6, &length, sizeof(length));
+    uint32_t crc = imageCrc(image + HEADER_SIZE, length);
+    memcpy(image + 8, &crc, sizeof(crc));
+}
+
+void test_config_loads_older_image(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.ssid, "Network");
+    strcpy(testConfig.otaUrl, "http://updates.local/meteo.bin");
+    strcpy(testConfig.configPath, "/meteo.cfg");
+    testConfig.configVersion = 7;
+    testConfig.save();
+    
+    // Version 3 ended before the remote config fields
+    size_t version4 = sizeof(testConfig.configPath) + sizeof(testConfig.configVersion);
+    shortenImage(3, version4);
+    Config loaded;
+    TEST_ASSERT_TRUE(loaded.load());
+    TEST_ASSERT_EQUAL_STRING("http://updates.local/meteo.bin", loaded.otaUrl);
+    TEST_ASSERT_EQUAL_STRING("", loaded.configPath);
+    TEST_ASSERT_EQUAL(0, loaded.configVersion);
+    
+    // Version 2 ended before the update URL
+    shortenImage(2, sizeof(testConfig.otaUrl));
+    TEST_ASSERT_TRUE(loaded.load());
+    TEST_ASSERT_EQUAL_STRING("Network", loaded.ssid);
+    TEST_ASSERT_EQUAL_STRING("", loaded.otaUrl);
+}
+
+void test_config_downgrade_to_legacy(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.ssid, "Network");
+    strcpy(testConfig.influxDb, "sensors");
+    testConfig.timeOffset = 1704067072;
+    testConfig.save();
+    TEST_ASSERT_TRUE(testConfig.save(CONFIG_VERSION_LEGACY));
+    
+    // Older firmware reads the object straight out of EEPROM
+    LegacyConfig legacy;
+    EEPROM.get(CONFIG_ADDR, legacy);
+    TEST_ASSERT_EQUAL(CONFIG_MAGIC, legacy.magic);
+    TEST_ASSERT_EQUAL_STRING("Network", legacy.ssid);
+    TEST_ASSERT_EQUAL_STRING("sensors", legacy.influxDb);
+    TEST_ASSERT_EQUAL(1704067072, legacy.timeOffset);
+    
+    Config loaded;
+    TEST_ASSERT_TRUE(loaded.load());
+    TEST_ASSERT_EQUAL_STRING("sensors", loaded.influxDb);
+}
+
+static void usableConfig(Config& config) {
+    config.setDefaults();
+    strcpy(config.ssid, "Network");
+    strcpy(config.password, "password1");
+    strcpy(config.influxServer, "influx.local");
+    strcpy(config.influxDb, "sensors");
+}
+
+void test_config_validate(void) {
+    Config config;
+    usableConfig(config);
+    TEST_ASSERT_NULL(config.validate());
+    
+    config.ssid[0] = '\0';
+    TEST_ASSERT_NOT_NULL(config.validate());
+    usableConfig(config);
+    strcpy(config.password, "short");
+    TEST_ASSERT_NOT_NULL(config.validate());
+    config.password[0] = '\0';   // Open network
+    TEST_ASSERT_NULL(config.validate());
+    
+    config.interval = 59;
+    TEST_ASSERT_NOT_NULL(config.validate());
+    config.interval = CONFIG_MAX_INTERVAL;
+    TEST_ASSERT_EQUAL(CONFIG_MAX_INTERVAL, config.interval);   // Fits the field
+    TEST_ASSERT_NULL(config.validate());
+    
+    config.influxPort = 0;
+    TEST_ASSERT_NOT_NULL(config.validate());
+    
+    usableConfig(config);
+    strcpy(config.location, "back yard");
+    TEST_ASSERT_NULL(config.validate());
+    strcpy(config.location, "roof\n");
+    TEST_ASSERT_NOT_NULL(config.validate());
+    
+    usableConfig(config);
+    strcpy(config.otaUrl, "https://updates.local/meteo.bin");
+    TEST_ASSERT_NOT_NULL(config.validate());   // No TLS on the station
+    strcpy(config.otaUrl, "http://updates.local:8266/meteo.bin");
+    TEST_ASSERT_NULL(config.validate());
+    
+    strcpy(config.configPath, "meteo.cfg");
+    TEST_ASSERT_NOT_NULL(config.validate());
+    strcpy(config.configPath, "/meteo.cfg");
+    TEST_ASSERT_NULL(config.validate());
+    config.uploadSink = UPLOAD_SINK_MQTT;   // Fetched over the HTTP upload connection
+    TEST_ASSERT_NOT_NULL(config.validate());
+}
+
+void test_config_validate_per_sink(void) {
+    Config config;
+    usableConfig(config);
+    config.influxVersion = INFLUX_API_V2;
+    TEST_ASSERT_NOT_NULL(config.validate());   // No org, bucket, token
+    
+    strcpy(config.influxOrg, "home");
+    strcpy(config.influxBucket, "meteo");
+    strcpy(config.influxToken, "token");
+    TEST_ASSERT_NULL(config.validate());
+    
+    // UDP, MQTT and binary only need server and port
+    usableConfig(config);
+    config.influxDb[0] = '\0';
+    TEST_ASSERT_NOT_NULL(config.validate());
+    config.uploadSink = UPLOAD_SINK_MQTT;
+    TEST_ASSERT_NULL(config.validate());
+}
+
+void test_config_same_settings(void) {
+    Config a;
+    Config b;
+    usableConfig(a);
+    usableConfig(b);
+    b.magic = CONFIG_MAGIC;
+    TEST_ASSERT_TRUE(a.sameSettings(b));
+    
+    b.interval = 600;
+    TEST_ASSERT_FALSE(a.sameSettings(b));
+    b.interval = a.interval;
+    strcpy(b.location, "attic");
+    TEST_ASSERT_FALSE(a.sameSettings(b));
+}
+
 void setup() {
     delay(2000);
     
@@ -93,9 +421,20 @@ void setup() {
     RUN_TEST(test_config_default_values);
     RUN_TEST(test_config_magic_validation);
     RUN_TEST(test_config_save_and_load);
+    RUN_TEST(test_config_save_and_load_v2);
+    RUN_TEST(test_config_fits_below_rom_data);
     RUN_TEST(test_config_time_offset_update);
     RUN_TEST(test_config_time_offset_string);
     RUN_TEST(test_config_load_invalid);
+    RUN_TEST(test_config_migrates_legacy_image);
+    RUN_TEST(test_config_save_skips_unchanged);
+    RUN_TEST(test_config_rejects_corrupt_image);
+    RUN_TEST(test_config_keeps_fields_of_newer_firmware);
+    RUN_TEST(test_config_loads_older_image);
+    RUN_TEST(test_config_downgrade_to_legacy);
+    RUN_TEST(test_config_validate);
+    RUN_TEST(test_config_validate_per_sink);
+    RUN_TEST(test_config_same_settings);
     
     UNITY_END();
 }
@@ -0,0 +1,98 @@
+#include <unity.h>
+#include "../lib/ConfigModePower.h"
+
+static const uint32_t T0 = 1000;
+
+static ConfigModePower power;
+
+void setUp(void) {
+    power.begin(T0);
+}
+
+void tearDown(void) {
+}
+
+void test_power_states_follow_clients(void) {
+    TEST_ASSERT_EQUAL(POWER_NO_CLIENT, power.update(T0 + 10, 0));
+    TEST_ASSERT_EQUAL(POWER_NO_CLIENT_POLL_MS, power.pollDelay());
+    
+    // Associated but no request yet
+    TEST_ASSERT_EQUAL(POWER_IDLE, power.update(T0 + 20, 1));
+    TEST_ASSERT_EQUAL(POWER_IDLE_POLL_MS, power.pollDelay());
+    
+    power.noteRequest(T0 + 30);
+    TEST_ASSERT_EQUAL(POWER_ACTIVE, power.update(T0 + 40, 1));
+    TEST_ASSERT_EQUAL(0, power.pollDelay());
+    TEST_ASSERT_EQUAL(POWER_ACTIVE, power.update(T0 + 30 + CONFIG_ACTIVE_MS - 1, 1));
+    
+    // Quiet again
+    TEST_ASSERT_EQUAL(POWER_IDLE, power.update(T0 + 30 + CONFIG_ACTIVE_MS, 1));
+    TEST_ASSERT_EQUAL(POWER_NO_CLIENT, power.update(T0 + 30 + CONFIG_ACTIVE_MS + 5, 0));
+    TEST_ASSERT_EQUAL(1, power.getRequests());
+}
+
+void test_power_counts_time_per_state(void) {
+    power.update(T0 + 1000, 1);       // 1 s without a client
+    power.noteRequest(T0 + 3000);
+    power.update(T0 + 3000, 1);       // 2 s idle
+    power.update(T0 + 3500, 1);       // Active from the request on
+    power.update(T0 + 6000, 1);       // 3 s active in all
+    power.update(T0 + 66000, 0);      // 60 s idle
+    
+    TEST_ASSERT_EQUAL(1000, power.getStateMillis(POWER_NO_CLIENT));
+    TEST_ASSERT_EQUAL(62000, power.getStateMillis(POWER_IDLE));
+    TEST_ASSERT_EQUAL(3000, power.getStateMillis(POWER_ACTIVE));
+    TEST_ASSERT_EQUAL(0, power.getStateMillis(POWER_STATES));
+    
+    float expected = (1000.0f * POWER_NO_CLIENT_MA + 62000.0f * POWER_IDLE_MA +
+                      3000.0f * POWER_ACTIVE_MA) / 3600000.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, expected, power.getChargeMah());
+}
+
+void test_power_idle_timeout(void) {
+    TEST_ASSERT_FALSE(power.expired(T0 + CONFIG_IDLE_TIMEOUT_MS - 1));
+    TEST_ASSERT_TRUE(power.expired(T0 + CONFIG_IDLE_TIMEOUT_MS));
+    
+    // Each request restarts the idle timeout
+    power.noteRequest(T0 + CONFIG_IDLE_TIMEOUT_MS - 1);
+    TEST_ASSERT_FALSE(power.expired(T0 + CONFIG_IDLE_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(CONFIG_IDLE_TIMEOUT_MS - 1, power.remaining(T0 + CONFIG_IDLE_TIMEOUT_MS));
+}
+
+void test_power_time_limit(void) {
+    // A busy portal still closes at the limit
+    uint32_t now = T0;
+    while (now < T0 + CONFIG_MAX_TIME_MS - 60000) {
+        now += 60000;
+        power.noteRequest(now);
+        TEST_ASSERT_FALSE(power.expired(now));
+    }
+    TEST_ASSERT_EQUAL(T0 + CONFIG_MAX_TIME_MS - now, power.remaining(now));
+    TEST_ASSERT_TRUE(power.expired(T0 + CONFIG_MAX_TIME_MS));
+}
+
+void test_power_survives_millis_wrap(void) {
+    uint32_t start = 0xFFFFFF00;
+    power.begin(start);
+    power.noteRequest(start + 0x80);
+    TEST_ASSERT_EQUAL(POWER_ACTIVE, power.update(start + 0x200, 1));
+    TEST_ASSERT_FALSE(power.expired(start + 0x200));
+    TEST_ASSERT_EQUAL(0x200, power.getStateMillis(POWER_NO_CLIENT));
+}
+
+void setup() {
+    delay(2000);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_power_states_follow_clients);
+    RUN_TEST(test_power_counts_time_per_state);
+    RUN_TEST(test_power_idle_timeout);
+    RUN_TEST(test_power_time_limit);
+    RUN_TEST(test_power_survives_millis_wrap);
+    
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -1,26 +1,37 @@
 #include <unity.h>
+#include <map>
+#include "../native_mocks/HttpStubServer.h"
+#include "../native_mocks/ESP8266WiFi.h"
 #include "../lib/DataUploader.h"
+#include "../lib/BinaryProtocol.h"
 #include "../lib/Config.h"
 #include "../lib/RTCData.h"
+#include "../lib/SensorRecord.h"
+#include "../lib/HostResolver.h"
+#include "../lib/RecordStore.h"
 #include <EEPROM.h>
 
+// 2024-01-01 rounded down to a 65536-second boundary, as Config does
+static const uint32_t TEST_OFFSET = (1704067200UL / 65536) * 65536;
+static const int TEST_RECORDS = 40;
+
 static Config testConfig;
-static RTCData testRtcData;
+static RTCData testRtc;
 static DataUploader* uploader;
 
 void setUp(void) {
     EEPROM.begin(512);
     
     testConfig.setDefaults();
-    strcpy(testConfig.influxServer, "192.168.1.100");
-    testConfig.influxPort = 8086;
-    strcpy(testConfig.influxDb, "test_db");
-    strcpy(testConfig.influxMeasurement, "test");
+    strcpy(testConfig.influxServer, "127.0.0.1");
+    testConfig.uploadSink = UPLOAD_SINK_BINARY;
+    testConfig.timeOffset = TEST_OFFSET;
     testConfig.magic = CONFIG_MAGIC;
     
-    testRtcData.initialize();
+    testRtc.initialize();
+    WiFi.clearHosts();
     
-    uploader = new DataUploader(&testConfig, &testRtcData);
+    uploader = new DataUploader(&testConfig, &testRtc);
 }
 
 void tearDown(void) {
@@ -34,24 +45,24 @@ void test_data_uploader_creation(void) {
 void test_data_uploader_clear_data(void) {
     // Add some test data
     SensorRecord record = SensorRecord::create(20.0, 50.0, 3600, 0);
-    testRtcData.addRecord(record);
-    testRtcData.romRecordCount = 5;
+    testRtc.addRecord(record);
+    testRtc.romRecordCount = 5;
     
-    TEST_ASSERT_EQUAL(1, testRtcData.recordCount);
-    TEST_ASSERT_EQUAL(5, testRtcData.romRecordCount);
+    TEST_ASSERT_EQUAL(1, testRtc.recordCount);
+    TEST_ASSERT_EQUAL(5, testRtc.romRecordCount);
     
     // Clear data
     uploader->clearData();
     
     // Should be cleared
-    TEST_ASSERT_EQUAL(0, testRtcData.recordCount);
-    TEST_ASSERT_EQUAL(0, testRtcData.romRecordCount);
-    TEST_ASSERT_EQUAL(0, testRtcData.romWriteIndex);
+    TEST_ASSERT_EQUAL(0, testRtc.recordCount);
+    TEST_ASSERT_EQUAL(0, testRtc.romRecordCount);
+    TEST_ASSERT_EQUAL(0, testRtc.romWriteIndex);
 }
 
 void test_data_uploader_upload_with_no_data(void) {
     // Should handle empty data gracefully
-    // Note: Will fail to connect to InfluxDB, but shouldn't crash
+    // Note: Nothing listens on the default port, but shouldn't crash
     bool result = uploader->uploadAllData(3.7);
     
     // Result depends on network, but shouldn't crash
@@ -62,27 +73,347 @@ void test_data_uploader_with_buffer_data(void) {
     // Add some records to buffer
     for (int i = 0; i < 5; i++) {
         SensorRecord record = SensorRecord::create(20.0 + i, 50.0, i * 60, 0);
-        testRtcData.addRecord(record);
+        testRtc.addRecord(record);
     }
     
-    TEST_ASSERT_EQUAL(5, testRtcData.recordCount);
+    TEST_ASSERT_EQUAL(5, testRtc.recordCount);
     
-    // Try to upload (will fail without network, but tests logic)
+    // Try to upload (will fail without a server, but tests logic)
     bool result = uploader->uploadAllData(3.8);
     
     TEST_ASSERT_TRUE(result || !result);
 }
 
+static SensorRecord testRecord(int i) {
+    return SensorRecord::create(15.0 + (i % 9), 40.0 + (i % 25),
+                                TEST_OFFSET + 3600 + i * 1800, TEST_OFFSET);
+}
+
+static void bufferRecords(int count) {
+    for (int i = 0; i < count; i++) {
+        testRtc.addRecord(testRecord(i));
+    }
+}
+
+// What InfluxDB would hold after these requests: one value per
+// series + field + timestamp, later writes overwrite earlier ones
+static std::map<std::string, int> storedPoints(const std::vector<StubRequest>& requests) {
+    std::map<std::string, int> points;
+    for (size_t r = 0; r < requests.size(); r++) {
+        const uint8_t* body = (const uint8_t*)requests[r].body.data();
+        size_t pos = 0;
+        BinaryBlock block;
+        size_t used;
+        while ((used = BinaryBlockDecoder::decode(body + pos, requests[r].body.size() - pos, block)) > 0) {
+            pos += used;
+            char key[64];
+            if (block.type == BINARY_BLOCK_BATTERY) {
+                snprintf(key, sizeof(key), "battery %u", (unsigned int)block.batteryTime);
+                points[key] = block.sequence;
+                continue;
+            }
+            for (uint16_t i = 0; i < block.count; i++) {
+                snprintf(key, sizeof(key), "record %u",
+                         (unsigned int)BinaryBlockDecoder::timestampSeconds(block, block.records[i]));
+                points[key] = BinaryBlockDecoder::temperature(block.records[i]);
+            }
+        }
+        TEST_ASSERT_EQUAL(requests[r].body.size(), pos);
+    }
+    return points;
+}
+
+void test_uploader_success_clears_and_advances_sequence(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+    bufferRecords(TEST_RECORDS);
+
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+
+    TEST_ASSERT_EQUAL(0, testRtc.recordCount);
+    TEST_ASSERT_EQUAL(1, testRtc.uploadSequence);
+    TEST_ASSERT_EQUAL(TEST_RECORDS + 1, storedPoints(server.requests()).size());
+}
+
+void test_uploader_sends_eeprom_records(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+    
+    // Older half spilled to EEPROM, newer half still in RTC memory
+    SensorRecord spilled[TEST_RECORDS / 2];
+    for (int i = 0; i < TEST_RECORDS / 2; i++) {
+        spilled[i] = testRecord(i);
+    }
+    TEST_ASSERT_EQUAL(TEST_RECORDS / 2, RecordStore::append(testRtc, spilled, TEST_RECORDS / 2));
+    for (int i = TEST_RECORDS / 2; i < TEST_RECORDS; i++) {
+        testRtc.addRecord(testRecord(i));
+    }
+    
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    
+    TEST_ASSERT_EQUAL(TEST_RECORDS + 1, storedPoints(server.requests()).size());
+    TEST_ASSERT_EQUAL(0, RecordStore::count(testRtc));
+}
+
+void test_uploader_battery_timestamp_is_deterministic(void) {
+    HttpStubServer server;
+    server.status = 500;
+    testConfig.influxPort = server.start();
+    bufferRecords(TEST_RECORDS);
+
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    // The retry runs on a timer wake, after the next measurement
+    delay(1100);
+    testRtc.addRecord(testRecord(TEST_RECORDS));
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.8));
+
+    // Every record once and a single battery point, with the first reading
+    std::vector<StubRequest> requests = server.requests();
+    TEST_ASSERT_EQUAL(2, requests.size());
+    std::map<std::string, int> points = storedPoints(requests);
+    TEST_ASSERT_EQUAL(TEST_RECORDS + 1 + 1, points.size());
+    char battery[64];
+    snprintf(battery, sizeof(battery), "battery %u",
+             (unsigned int)testRecord(TEST_RECORDS - 1).getTimestampSeconds(TEST_OFFSET));
+    TEST_ASSERT_TRUE(points.count(battery) == 1);
+    TEST_ASSERT_EQUAL(3900, testRtc.sessionMillivolts);
+    TEST_ASSERT_EQUAL(0, testRtc.uploadSequence);
+    TEST_ASSERT_EQUAL(TEST_RECORDS + 1, testRtc.recordCount);
+}
+
+// Runs one failing attempt with the given fault, then a clean retry, and
+// checks that InfluxDB ends up with every point exactly once
+static void replayWithFault(size_t cutAfter, bool dropResponse) {
+    tearDown();
+    setUp();
+    bufferRecords(TEST_RECORDS);
+
+    HttpStubServer server;
+    server.closeAfterStreamBytes = cutAfter;
+    server.dropResponse = dropResponse;
+    testConfig.influxPort = server.start();
+
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(TEST_RECORDS, testRtc.recordCount);
+    TEST_ASSERT_EQUAL(0, testRtc.uploadSequence);
+
+    // Measured on the wake that retries
+    testRtc.addRecord(testRecord(TEST_RECORDS));
+    server.closeAfterStreamBytes = 0;
+    server.dropResponse = false;
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.7));
+    TEST_ASSERT_EQUAL(0, testRtc.recordCount);
+    TEST_ASSERT_EQUAL(1, testRtc.uploadSequence);
+    TEST_ASSERT_EQUAL(0, testRtc.sessionTime);
+
+    // Every record, the new one included, and one battery point
+    std::vector<StubRequest> requests = server.requests();
+    std::map<std::string, int> points = storedPoints(requests);
+    TEST_ASSERT_EQUAL(TEST_RECORDS + 1 + 1, points.size());
+    for (int i = 0; i <= TEST_RECORDS; i++) {
+        char key[64];
+        snprintf(key, sizeof(key), "record %u",
+                 (unsigned int)testRecord(i).getTimestampSeconds(TEST_OFFSET));
+        TEST_ASSERT_TRUE(points.count(key) == 1);
+    }
+    // Cut before the battery point went out, the retry fixes it instead
+    std::map<std::string, int>::iterator battery = points.lower_bound("battery ");
+    TEST_ASSERT_TRUE(battery != points.end() && battery->first.compare(0, 8, "battery ") == 0);
+    TEST_ASSERT_EQUAL(0, battery->second);   // Sequence of the retried session
+}
+
+// A retry that runs after the clock crossed a 65536-second boundary still
+// decodes the pending records against the offset they were stored with
+void test_uploader_replay_keeps_offset_until_confirmed(void) {
+    uint32_t current = ((uint32_t)time(nullptr) / 65536) * 65536;
+    uint32_t stale = current - 65536;
+    testConfig.timeOffset = stale;
+    for (int i = 0; i < TEST_RECORDS; i++) {
+        testRtc.addRecord(SensorRecord::create(15.0 + (i % 9), 40.0, stale + 3600 + i * 60, stale));
+    }
+    
+    HttpStubServer server;
+    server.status = 500;
+    testConfig.influxPort = server.start();
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(stale, testConfig.timeOffset);
+    
+    server.status = 204;
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    
+    // Both attempts carried the same points, at the time they were taken
+    std::vector<StubRequest> requests = server.requests();
+    TEST_ASSERT_EQUAL(2, requests.size());
+    TEST_ASSERT_TRUE(requests[0].body == requests[1].body);
+    std::map<std::string, int> points = storedPoints(requests);
+    TEST_ASSERT_EQUAL(TEST_RECORDS + 1, points.size());
+    char key[64];
+    snprintf(key, sizeof(key), "record %u", (unsigned int)((stale + 3600) / 60 * 60));
+    TEST_ASSERT_TRUE(points.count(key) == 1);
+    
+    // Nothing pending any more: the offset follows the clock
+    TEST_ASSERT_EQUAL(current, testConfig.timeOffset);
+    TEST_ASSERT_EQUAL(0, testRtc.recordCount);
+}
+
+void test_uploader_replay_cut_at_every_byte(void) {
+    // Size of one complete upload on the wire
+    HttpStubServer probe;
+    testConfig.influxPort = probe.start();
+    bufferRecords(TEST_RECORDS);
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    probe.stop();
+    size_t streamSize = probe.requests()[0].wireBytes;
+
+    for (size_t cut = 1; cut < streamSize; cut++) {
+        replayWithFault(cut, false);
+    }
+
+    char message[64];
+    snprintf(message, sizeof(message), "replayed cuts at 1..%u bytes", (unsigned int)streamSize);
+    TEST_MESSAGE(message);
+}
+
+void test_uploader_replay_lost_response(void) {
+    replayWithFault(0, true);
+}
+
+// No separate reachability round trip: the session is one connection
+// carrying one request
+void test_uploader_single_round_trip(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+    bufferRecords(TEST_RECORDS);
+
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(1, server.connectionCount());
+    TEST_ASSERT_EQUAL(1, server.requests().size());
+    TEST_ASSERT_EQUAL(UPLOAD_OK, uploader->getLastErrorKind());
+}
+
+// The line protocol sink checks reachability on the connection it then
+// writes over
+void test_uploader_http_ping_shares_connection(void) {
+    HttpStubServer server;
+    testConfig.uploadSink = UPLOAD_SINK_INFLUX_HTTP;
+    testConfig.influxPort = server.start();
+    bufferRecords(TEST_RECORDS);
+    uploader->setValidateConnection(true);
+
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(1, server.connectionCount());
+    TEST_ASSERT_TRUE(server.requests().size() >= 2);
+    TEST_ASSERT_EQUAL_STRING("GET", server.requests()[0].method.c_str());
+    TEST_ASSERT_EQUAL_STRING("/ping", server.requests()[0].path.c_str());
+    TEST_ASSERT_EQUAL_STRING("POST", server.requests()[1].method.c_str());
+}
+
+void test_uploader_classifies_failures(void) {
+    HttpStubServer server;
+    server.status = 401;
+    testConfig.influxPort = server.start();
+    bufferRecords(TEST_RECORDS);
+
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_AUTH, uploader->getLastErrorKind());
+
+    strcpy(testConfig.influxServer, "ingest.invalid");
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_DNS, uploader->getLastErrorKind());
+
+    strcpy(testConfig.influxServer, "127.0.0.1");
+    server.stop();
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_CONNECT, uploader->getLastErrorKind());
+    TEST_ASSERT_EQUAL(TEST_RECORDS, testRtc.recordCount);
+}
+
+void test_uploader_caches_dns(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+    strcpy(testConfig.influxServer, "ingest.local");
+    WiFi.addHost("ingest.local", IPAddress(127, 0, 0, 1));
+    WiFi.lookupDelayMs = 200;
+
+    bufferRecords(TEST_RECORDS);
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    unsigned long uncached = millis() - start;
+    TEST_ASSERT_EQUAL(1, HostResolver::getLookups());
+    TEST_ASSERT_TRUE(HostResolver::getLookupMs() >= 200);
+
+    // Next wake: the address comes from RTC memory
+    testRtc.clock += 1800;
+    bufferRecords(TEST_RECORDS);
+    start = millis();
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    unsigned long cached = millis() - start;
+    TEST_ASSERT_EQUAL(0, HostResolver::getLookups());
+    TEST_ASSERT_EQUAL(1, HostResolver::getCacheHits());
+    TEST_ASSERT_EQUAL(0, HostResolver::getLookupMs());
+    TEST_ASSERT_EQUAL(1, WiFi.lookups);
+
+    // Expired entries are looked up again
+    testRtc.clock += DNS_CACHE_TTL;
+    bufferRecords(TEST_RECORDS);
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(1, HostResolver::getLookups());
+
+    char message[96];
+    snprintf(message, sizeof(message), "session with DNS lookup %lu ms, from cache %lu ms",
+             uncached, cached);
+    TEST_MESSAGE(message);
+}
+
+void test_uploader_refreshes_stale_dns(void) {
+    HttpStubServer server;
+    testConfig.influxPort = server.start();
+    strcpy(testConfig.influxServer, "ingest.local");
+
+    // Cached on an earlier wake; the server has moved since
+    IPAddress address;
+    WiFi.addHost("ingest.local", IPAddress(127, 0, 0, 2));
+    HostResolver::useCache(&testRtc.dnsCache, testRtc.clock);
+    TEST_ASSERT_TRUE(HostResolver::resolve("ingest.local", address));
+    WiFi.addHost("ingest.local", IPAddress(127, 0, 0, 1));
+    testRtc.clock += 1800;
+
+    bufferRecords(TEST_RECORDS);
+    TEST_ASSERT_TRUE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(1, HostResolver::getCacheHits());
+    TEST_ASSERT_EQUAL(1, HostResolver::getLookups());
+    TEST_ASSERT_EQUAL(1, testRtc.dnsCache.address[3]);
+
+    // A fresh address that does not answer is not looked up twice
+    memset(&testRtc.dnsCache, 0, sizeof(testRtc.dnsCache));
+    WiFi.addHost("ingest.local", IPAddress(127, 0, 0, 2));
+    bufferRecords(TEST_RECORDS);
+    TEST_ASSERT_FALSE(uploader->uploadAllData(3.9));
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_CONNECT, uploader->getLastErrorKind());
+    TEST_ASSERT_EQUAL(1, HostResolver::getLookups());
+}
+
 void setup() {
     delay(2000);
-    
+
     UNITY_BEGIN();
     
     RUN_TEST(test_data_uploader_creation);
     RUN_TEST(test_data_uploader_clear_data);
     RUN_TEST(test_data_uploader_upload_with_no_data);
     RUN_TEST(test_data_uploader_with_buffer_data);
-    
+    RUN_TEST(test_uploader_success_clears_and_advances_sequence);
+    RUN_TEST(test_uploader_sends_eeprom_records);
+    RUN_TEST(test_uploader_battery_timestamp_is_deterministic);
+    RUN_TEST(test_uploader_replay_cut_at_every_byte);
+    RUN_TEST(test_uploader_replay_lost_response);
+    RUN_TEST(test_uploader_replay_keeps_offset_until_confirmed);
+    RUN_TEST(test_uploader_single_round_trip);
+    RUN_TEST(test_uploader_http_ping_shares_connection);
+    RUN_TEST(test_uploader_classifies_failures);
+    RUN_TEST(test_uploader_caches_dns);
+    RUN_TEST(test_uploader_refreshes_stale_dns);
+
     UNITY_END();
 }
 
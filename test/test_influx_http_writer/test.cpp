@@ -0,0 +1,403 @@
+#include <unity.h>
+#include "../native_mocks/HttpStubServer.h"
+#include "../native_mocks/WiFiClient.h"
+#include "../native_mocks/ESP8266WiFi.h"
+#include "../lib/InfluxHttpWriter.h"
+#include "../lib/Config.h"
+#include "../lib/LineProtocol.h"
+#include "../lib/SensorRecord.h"
+
+static HttpStubServer* stub;
+static WiFiClient* wifiClient;
+static InfluxHttpWriter* writer;
+
+void setUp(void) {
+    stub = new HttpStubServer();
+    stub->start();
+    wifiClient = new WiFiClient();
+    writer = new InfluxHttpWriter(*wifiClient);
+    writer->setEndpoint("127.0.0.1", stub->getPort(), "/write?db=test&precision=m");
+}
+
+void tearDown(void) {
+    delete writer;
+    delete wifiClient;
+    stub->stop();
+    delete stub;
+}
+
+void test_http_writer_single_request(void) {
+    const char* line = "environment temperature=22,humidity=65 60\n";
+    
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write(line, strlen(line)));
+    TEST_ASSERT_TRUE(writer->end());
+    TEST_ASSERT_EQUAL(204, writer->getStatus());
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(1));
+    StubRequest request = stub->requests()[0];
+    TEST_ASSERT_EQUAL_STRING("POST", request.method.c_str());
+    TEST_ASSERT_EQUAL_STRING("/write?db=test&precision=m", request.path.c_str());
+    TEST_ASSERT_TRUE(request.chunked);
+    TEST_ASSERT_EQUAL_STRING(line, request.body.c_str());
+}
+
+void test_http_writer_streams_large_backlog(void) {
+    // Far more data than the chunk buffer - must arrive intact
+    const int points = 5000;
+    std::string expected;
+    char line[LineProtocol::MAX_LINE];
+    
+    TEST_ASSERT_TRUE(writer->begin());
+    for (int i = 0; i < points; i++) {
+        SensorRecord record = SensorRecord::create(10.0 + (i % 20), 30.0 + (i % 50), i * 60, 0);
+        size_t length = LineProtocol::encodeRecord(line, sizeof(line), "environment", record, 0, PRECISION_M);
+        TEST_ASSERT_TRUE(writer->write(line, length));
+        expected.append(line, length);
+    }
+    TEST_ASSERT_TRUE(writer->end());
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(1));
+    StubRequest request = stub->requests()[0];
+    TEST_ASSERT_EQUAL(expected.size(), request.body.size());
+    TEST_ASSERT_TRUE(expected == request.body);
+    TEST_ASSERT_EQUAL(expected.size(), writer->getBodyBytes());
+}
+
+void test_http_writer_fixed_memory(void) {
+    // Writer state is independent of backlog size
+    TEST_ASSERT_TRUE(sizeof(InfluxHttpWriter) < 512);
+}
+
+void test_http_writer_error_status(void) {
+    stub->status = 400;
+    stub->responseBody = "{\"error\":\"unable to parse\"}";
+    
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write("bad\n", 4));
+    TEST_ASSERT_FALSE(writer->end());
+    
+    TEST_ASSERT_EQUAL(400, writer->getStatus());
+    TEST_ASSERT_TRUE(strstr(writer->getError(), "unable to parse") != nullptr);
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_REJECTED, writer->getErrorKind());
+}
+
+void test_http_writer_classifies_status(void) {
+    const int statuses[4] = { 401, 403, 404, 503 };
+    const UploadError kinds[4] = { UPLOAD_ERROR_AUTH, UPLOAD_ERROR_AUTH, 
+                                   UPLOAD_ERROR_REJECTED, UPLOAD_ERROR_SERVER };
+    
+    for (int i = 0; i < 4; i++) {
+        stub->status = statuses[i];
+        writer->beginSession();
+        TEST_ASSERT_TRUE(writer->begin());
+        TEST_ASSERT_TRUE(writer->write("x v=1\n", 6));
+        TEST_ASSERT_FALSE(writer->end());
+        TEST_ASSERT_EQUAL(kinds[i], writer->getErrorKind());
+    }
+    
+    stub->status = 204;
+    writer->beginSession();
+    TEST_ASSERT_EQUAL(UPLOAD_OK, writer->getErrorKind());
+}
+
+void test_http_writer_dns_failure(void) {
+    WiFi.clearHosts();
+    writer->setEndpoint("influx.example", stub->getPort(), "/write?db=test");
+    
+    TEST_ASSERT_FALSE(writer->begin());
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_DNS, writer->getErrorKind());
+    TEST_ASSERT_EQUAL(0, stub->connectionCount());
+    
+    // Same endpoint once the name resolves
+    WiFi.addHost("influx.example", IPAddress(127, 0, 0, 1));
+    writer->beginSession();
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write("x v=1\n", 6));
+    TEST_ASSERT_TRUE(writer->end());
+    
+    StubRequest request = stub->requests()[0];
+    TEST_ASSERT_EQUAL_STRING("influx.example", request.header("host").substr(0, 14).c_str());
+}
+
+void test_http_writer_connection_refused(void) {
+    uint16_t port = stub->getPort();
+    stub->stop();
+    writer->setEndpoint("127.0.0.1", port, "/write?db=test");
+    
+    TEST_ASSERT_FALSE(writer->begin());
+    TEST_ASSERT_FALSE(writer->isRequestOpen());
+    TEST_ASSERT_EQUAL_STRING("Connection failed", writer->getError());
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_CONNECT, writer->getErrorKind());
+}
+
+void test_http_writer_write_without_begin(void) {
+    TEST_ASSERT_FALSE(writer->write("x\n", 2));
+    TEST_ASSERT_FALSE(writer->end());
+}
+
+void test_http_writer_keep_alive(void) {
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(writer->begin());
+        TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+        TEST_ASSERT_TRUE(writer->end());
+    }
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(3));
+    TEST_ASSERT_EQUAL(1, stub->connectionCount());
+}
+
+void test_http_writer_reconnects_after_close(void) {
+    stub->closeAfterResponse = true;
+    
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_TRUE(writer->begin());
+        TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+        TEST_ASSERT_TRUE(writer->end());
+    }
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(2));
+    TEST_ASSERT_EQUAL(2, stub->connectionCount());
+}
+
+void test_http_writer_pipelined_batches(void) {
+    writer->beginSession();
+    
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(writer->begin());
+        TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+        TEST_ASSERT_TRUE(writer->end(false));
+        TEST_ASSERT_TRUE(writer->getPendingResponses() <= InfluxHttpWriter::PIPELINE_DEPTH);
+    }
+    TEST_ASSERT_TRUE(writer->collectResponses());
+    TEST_ASSERT_EQUAL(0, writer->getPendingResponses());
+    
+    TEST_ASSERT_EQUAL(1, writer->getConnectionsOpened());
+    TEST_ASSERT_EQUAL(10, writer->getRequestsSent());
+    TEST_ASSERT_TRUE(stub->waitForRequests(10));
+    TEST_ASSERT_EQUAL(1, stub->connectionCount());
+}
+
+void test_http_writer_pipelined_failure_reported(void) {
+    stub->status = 500;
+    writer->beginSession();
+    
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(writer->begin());
+        TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+        writer->end(false);
+    }
+    
+    TEST_ASSERT_FALSE(writer->collectResponses());
+    TEST_ASSERT_EQUAL(500, writer->getStatus());
+    
+    // Failure state is cleared once reported
+    TEST_ASSERT_TRUE(writer->collectResponses());
+}
+
+void test_http_writer_pipeline_broken_by_close(void) {
+    stub->closeAfterResponse = true;
+    writer->beginSession();
+    
+    // Second request goes out before the first response says "close";
+    // depending on timing the send itself may already fail
+    for (int i = 0; i < 2; i++) {
+        if (writer->begin()) {
+            writer->write("m v=1 1\n", 8);
+            writer->end(false);
+        }
+    }
+    
+    TEST_ASSERT_FALSE(writer->collectResponses());
+}
+
+void test_http_writer_get_reuses_connection(void) {
+    stub->documentStatus = 200;
+    stub->documentBody = "version=2\ninterval=600\n";
+    
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+    TEST_ASSERT_TRUE(writer->end());
+    
+    char body[64];
+    TEST_ASSERT_TRUE(writer->get("/meteo.cfg", "X-Device-Id: 0a0b0c0d0e0f\r\n", body, sizeof(body)));
+    TEST_ASSERT_EQUAL(200, writer->getStatus());
+    TEST_ASSERT_EQUAL_STRING("version=2\ninterval=600\n", body);
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(2));
+    TEST_ASSERT_EQUAL(1, stub->connectionCount());
+    StubRequest request = stub->requests()[1];
+    std::string device = request.header("x-device-id");
+    TEST_ASSERT_EQUAL_STRING("GET", request.method.c_str());
+    TEST_ASSERT_EQUAL_STRING("/meteo.cfg", request.path.c_str());
+    TEST_ASSERT_EQUAL_STRING("0a0b0c0d0e0f", device.c_str());
+    
+    // The connection is still good for writing
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write("m v=2 2\n", 8));
+    TEST_ASSERT_TRUE(writer->end());
+    TEST_ASSERT_TRUE(stub->waitForRequests(3));
+    TEST_ASSERT_EQUAL(1, stub->connectionCount());
+}
+
+void test_http_writer_get_not_modified(void) {
+    stub->documentStatus = 304;
+    
+    char body[64];
+    TEST_ASSERT_TRUE(writer->get("/meteo.cfg", "If-None-Match: \"2\"\r\n", body, sizeof(body)));
+    TEST_ASSERT_EQUAL(304, writer->getStatus());
+    TEST_ASSERT_EQUAL_STRING("", body);
+    TEST_ASSERT_EQUAL(UPLOAD_OK, writer->getErrorKind());
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(1));
+    StubRequest request = stub->requests()[0];
+    std::string etag = request.header("if-none-match");
+    TEST_ASSERT_EQUAL_STRING("\"2\"", etag.c_str());
+}
+
+void test_http_writer_get_refuses_large_body(void) {
+    stub->documentStatus = 200;
+    stub->documentBody = std::string(100, 'x');
+    
+    char body[64];
+    TEST_ASSERT_FALSE(writer->get("/meteo.cfg", "", body, sizeof(body)));
+    
+    // Cut short is no better
+    stub->documentBody = "version=3\n";
+    stub->truncateResponse = 4;
+    TEST_ASSERT_FALSE(writer->get("/meteo.cfg", "", body, sizeof(body)));
+}
+
+// Proxies and app servers may chunk the document instead of sending a length
+void test_http_writer_get_chunked(void) {
+    stub->documentStatus = 200;
+    stub->documentBody = "version=4\ninterval=600\nlocation=garden\n";
+    stub->chunkResponse = 7;
+    
+    char body[64];
+    TEST_ASSERT_TRUE(writer->get("/meteo.cfg", "", body, sizeof(body)));
+    TEST_ASSERT_EQUAL(200, writer->getStatus());
+    TEST_ASSERT_EQUAL_STRING("version=4\ninterval=600\nlocation=garden\n", body);
+    
+    // Read to the end, trailer included: the connection stays usable
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+    TEST_ASSERT_TRUE(writer->end());
+    TEST_ASSERT_TRUE(stub->waitForRequests(2));
+    TEST_ASSERT_EQUAL(1, stub->connectionCount());
+    
+    stub->documentBody = std::string(100, 'x');
+    TEST_ASSERT_FALSE(writer->get("/meteo.cfg", "", body, sizeof(body)));
+    
+    // Hung up inside a chunk
+    stub->documentBody = "version=5\n";
+    stub->truncateResponse = 12;
+    TEST_ASSERT_FALSE(writer->get("/meteo.cfg", "", body, sizeof(body)));
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_NETWORK, writer->getErrorKind());
+}
+
+// The reachability check shares the upload connection
+void test_http_writer_ping(void) {
+    TEST_ASSERT_TRUE(writer->ping());
+    TEST_ASSERT_EQUAL(204, writer->getStatus());
+    TEST_ASSERT_TRUE(writer->begin());
+    TEST_ASSERT_TRUE(writer->write("m v=1 1\n", 8));
+    TEST_ASSERT_TRUE(writer->end());
+    
+    TEST_ASSERT_TRUE(stub->waitForRequests(2));
+    TEST_ASSERT_EQUAL(1, stub->connectionCount());
+    StubRequest request = stub->requests()[0];
+    TEST_ASSERT_EQUAL_STRING("GET", request.method.c_str());
+    TEST_ASSERT_EQUAL_STRING("/ping", request.path.c_str());
+    
+    stub->documentStatus = 503;
+    TEST_ASSERT_FALSE(writer->ping());
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_SERVER, writer->getErrorKind());
+}
+
+static Config makeConfig(uint8_t version) {
+    Config config;
+    config.setDefaults();
+    strcpy(config.influxServer, "127.0.0.1");
+    config.influxPort = stub->getPort();
+    config.influxVersion = version;
+    strcpy(config.influxDb, "meteo");
+    strcpy(config.influxOrg, "home lab");
+    strcpy(config.influxBucket, "meteo");
+    strcpy(config.influxToken, "s3cr3t==");
+    config.magic = CONFIG_MAGIC;
+    return config;
+}
+
+static StubRequest sendOneLine(void) {
+    writer->begin();
+    writer->write("m v=1 1\n", 8);
+    TEST_ASSERT_TRUE(writer->end());
+    TEST_ASSERT_TRUE(stub->waitForRequests(1));
+    return stub->requests()[0];
+}
+
+void test_http_writer_v1_endpoint(void) {
+    Config config = makeConfig(INFLUX_API_V1);
+    strcpy(config.influxUser, "writer");
+    strcpy(config.influxPass, "p&ss");
+    
+    TEST_ASSERT_EQUAL(PRECISION_M, writer->configure(config, PRECISION_M));
+    StubRequest request = sendOneLine();
+    
+    TEST_ASSERT_EQUAL_STRING("/write?db=meteo&u=writer&p=p%26ss&precision=m", request.path.c_str());
+    TEST_ASSERT_TRUE(request.header("authorization").empty());
+}
+
+void test_http_writer_v2_endpoint(void) {
+    Config config = makeConfig(INFLUX_API_V2);
+    
+    TEST_ASSERT_EQUAL(PRECISION_S, writer->configure(config, PRECISION_S));
+    StubRequest request = sendOneLine();
+    
+    TEST_ASSERT_EQUAL_STRING("/api/v2/write?org=home%20lab&bucket=meteo&precision=s", request.path.c_str());
+    TEST_ASSERT_EQUAL_STRING("Token s3cr3t==", request.header("authorization").c_str());
+    TEST_ASSERT_EQUAL_STRING("m v=1 1\n", request.body.c_str());
+}
+
+void test_http_writer_v2_has_no_minute_precision(void) {
+    Config config = makeConfig(INFLUX_API_V2);
+    
+    TEST_ASSERT_EQUAL(PRECISION_S, writer->configure(config, PRECISION_M));
+    StubRequest request = sendOneLine();
+    
+    TEST_ASSERT_TRUE(request.path.find("&precision=s") != std::string::npos);
+}
+
+void setup() {
+    delay(2000);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_http_writer_single_request);
+    RUN_TEST(test_http_writer_streams_large_backlog);
+    RUN_TEST(test_http_writer_fixed_memory);
+    RUN_TEST(test_http_writer_error_status);
+    RUN_TEST(test_http_writer_classifies_status);
+    RUN_TEST(test_http_writer_dns_failure);
+    RUN_TEST(test_http_writer_connection_refused);
+    RUN_TEST(test_http_writer_write_without_begin);
+    RUN_TEST(test_http_writer_keep_alive);
+    RUN_TEST(test_http_writer_reconnects_after_close);
+    RUN_TEST(test_http_writer_pipelined_batches);
+    RUN_TEST(test_http_writer_pipelined_failure_reported);
+    RUN_TEST(test_http_writer_pipeline_broken_by_close);
+    RUN_TEST(test_http_writer_get_reuses_connection);
+    RUN_TEST(test_http_writer_get_not_modified);
+    RUN_TEST(test_http_writer_get_refuses_large_body);
+    RUN_TEST(test_http_writer_get_chunked);
+    RUN_TEST(test_http_writer_ping);
+    RUN_TEST(test_http_writer_v1_endpoint);
+    RUN_TEST(test_http_writer_v2_endpoint);
+    RUN_TEST(test_http_writer_v2_has_no_minute_precision);
+    
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -78,7 +78,7 @@ void test_influxdb_client_battery_write(void) {
     float batteryVoltage = 3.87;
     
     // May fail without server, but shouldn't crash
-    bool written = client.writeBatteryVoltage(batteryVoltage);
+    bool written = client.writeBatteryVoltage(batteryVoltage, 0, 7200);
     
     // Just verify it returns a boolean
     TEST_ASSERT_TRUE(written || !written);
@@ -144,12 +144,35 @@ void test_influxdb_client_multiple_writes(void) {
     }
     
     // Write battery voltage
-    client.writeBatteryVoltage(3.85);
+    client.writeBatteryVoltage(3.85, 0, 4 * 3600);
     
-    // Flush
-    bool flushed = client.flush();
+    // Flush (may fail without server, but always ends the request)
+    client.flush();
     
-    TEST_ASSERT_TRUE(flushed);
+    TEST_ASSERT_EQUAL(0, client.pendingPoints());
+}
+
+void test_influxdb_client_precision(void) {
+    InfluxDBWrapper client;
+    
+    // Minute precision matches SensorRecord resolution
+    TEST_ASSERT_EQUAL(PRECISION_M, client.getPrecision());
+    
+    client.begin(&testConfig);
+    client.setPrecision(PRECISION_S);
+    
+    TEST_ASSERT_EQUAL(PRECISION_S, client.getPrecision());
+}
+
+void test_influxdb_client_connection_counters(void) {
+    InfluxDBWrapper client;
+    client.begin(&testConfig);
+    
+    // Nothing sent yet - no connection opened
+    TEST_ASSERT_EQUAL(0, client.getConnectionsOpened());
+    TEST_ASSERT_EQUAL(0, client.getRequestsSent());
+    
+    client.close();
 }
 
 void setup() {
@@ -168,6 +191,8 @@ void setup() {
     RUN_TEST(test_influxdb_client_with_authentication);
     RUN_TEST(test_influxdb_client_destructor);
     RUN_TEST(test_influxdb_client_multiple_writes);
+    RUN_TEST(test_influxdb_client_precision);
+    RUN_TEST(test_influxdb_client_connection_counters);
     
     UNITY_END();
 }
@@ -0,0 +1,87 @@
+#include <unity.h>
+#include "../lib/JsonWriter.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_json_writer_object(void) {
+    char buf[128];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.addString("ssid", "home");
+    json.addNumber("interval", 1800);
+    json.addBool("pending", false);
+    json.endObject();
+    
+    TEST_ASSERT_TRUE(json.ok());
+    TEST_ASSERT_EQUAL_STRING("{\"ssid\":\"home\",\"interval\":1800,\"pending\":false}", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), json.getLength());
+}
+
+void test_json_writer_nested(void) {
+    char buf[128];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.beginObject("rtc");
+    json.addNumber("records", 12);
+    json.endObject();
+    json.beginObject("rom");
+    json.endObject();
+    json.addNumber("battery", 3.9f, 2);
+    json.endObject();
+    
+    TEST_ASSERT_EQUAL_STRING("{\"rtc\":{\"records\":12},\"rom\":{},\"battery\":3.90}", buf);
+}
+
+void test_json_writer_escapes_strings(void) {
+    char buf[128];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.addString("password", "a\"b\\c\nd\x01");
+    json.addString("empty", nullptr);
+    json.endObject();
+    
+    TEST_ASSERT_EQUAL_STRING("{\"password\":\"a\\\"b\\\\c\\nd\\u0001\",\"empty\":\"\"}", buf);
+}
+
+void test_json_writer_overflow(void) {
+    char buf[16];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.addString("ssid", "a-very-long-network-name");
+    json.addNumber("interval", 1);
+    json.endObject();
+    
+    TEST_ASSERT_FALSE(json.ok());
+    TEST_ASSERT_TRUE(strlen(buf) < sizeof(buf));
+}
+
+void test_json_writer_non_finite(void) {
+    char buf[64];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    json.addNumber("battery", NAN, 2);
+    json.endObject();
+    
+    TEST_ASSERT_EQUAL_STRING("{\"battery\":null}", buf);
+}
+
+void setup() {
+    delay(2000);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_json_writer_object);
+    RUN_TEST(test_json_writer_nested);
+    RUN_TEST(test_json_writer_escapes_strings);
+    RUN_TEST(test_json_writer_overflow);
+    RUN_TEST(test_json_writer_non_finite);
+    
+    UNITY_END();
+}
+
+void loop() {
+}
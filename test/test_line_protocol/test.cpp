@@ -0,0 +1,193 @@
+#include <unity.h>
+#include "../lib/LineProtocol.h"
+#include "../lib/SensorRecord.h"
+
+// 2024-01-01 rounded down to a 65536-second boundary, as Config does
+static const uint32_t TEST_OFFSET = (1704067200UL / 65536) * 65536;
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_line_protocol_precision_param(void) {
+    TEST_ASSERT_EQUAL_STRING("ns", LineProtocol::precisionParam(PRECISION_NS));
+    TEST_ASSERT_EQUAL_STRING("s", LineProtocol::precisionParam(PRECISION_S));
+    TEST_ASSERT_EQUAL_STRING("m", LineProtocol::precisionParam(PRECISION_M));
+}
+
+void test_line_protocol_timestamp_units(void) {
+    char buf[32];
+
+    LineProtocol::formatTimestamp(buf, sizeof(buf), 3600, PRECISION_NS);
+    TEST_ASSERT_EQUAL_STRING("3600000000000", buf);
+
+    LineProtocol::formatTimestamp(buf, sizeof(buf), 3600, PRECISION_S);
+    TEST_ASSERT_EQUAL_STRING("3600", buf);
+
+    LineProtocol::formatTimestamp(buf, sizeof(buf), 3600, PRECISION_M);
+    TEST_ASSERT_EQUAL_STRING("60", buf);
+}
+
+void test_line_protocol_integral_values(void) {
+    char buf[16];
+
+    LineProtocol::formatValue(buf, sizeof(buf), 22.0, 1);
+    TEST_ASSERT_EQUAL_STRING("22", buf);
+
+    LineProtocol::formatValue(buf, sizeof(buf), -5.0, 1);
+    TEST_ASSERT_EQUAL_STRING("-5", buf);
+
+    LineProtocol::formatValue(buf, sizeof(buf), 0.0, 2);
+    TEST_ASSERT_EQUAL_STRING("0", buf);
+}
+
+void test_line_protocol_fractional_values(void) {
+    char buf[16];
+
+    LineProtocol::formatValue(buf, sizeof(buf), 3.87, 2);
+    TEST_ASSERT_EQUAL_STRING("3.87", buf);
+
+    LineProtocol::formatValue(buf, sizeof(buf), 3.5, 2);
+    TEST_ASSERT_EQUAL_STRING("3.5", buf);
+
+    LineProtocol::formatValue(buf, sizeof(buf), 3.05, 2);
+    TEST_ASSERT_EQUAL_STRING("3.05", buf);
+
+    LineProtocol::formatValue(buf, sizeof(buf), -0.25, 2);
+    TEST_ASSERT_EQUAL_STRING("-0.25", buf);
+}
+
+void test_line_protocol_encode_record(void) {
+    char line[LineProtocol::MAX_LINE];
+    SensorRecord record = SensorRecord::create(22.0, 65.0, 3600, 0);
+
+    size_t length = LineProtocol::encodeRecord(line, sizeof(line), "environment", record, 0, PRECISION_M);
+
+    TEST_ASSERT_EQUAL_STRING("environment temperature=22,humidity=65 60\n", line);
+    TEST_ASSERT_EQUAL(strlen(line), length);
+}
+
+void test_line_protocol_optional_channels(void) {
+    char line[LineProtocol::MAX_LINE];
+    Measurement measurement;
+    measurement.set(SENSOR_TEMPERATURE, 22.0);
+    measurement.set(SENSOR_PRESSURE, 1013.25);
+    measurement.set(SENSOR_PROBE_TEMPERATURE, -3.5);
+    SensorRecord records[SENSOR_MAX_SLOTS];
+    TEST_ASSERT_EQUAL(3, SensorRecord::pack(measurement, 3600, 0, records));
+
+    // No humidity sensor: the field is left out rather than sent as 0
+    LineProtocol::encodePoint(line, sizeof(line), "environment", 3600, 22, records[0].humidity,
+                              PRECISION_S, records + 1, 2);
+    TEST_ASSERT_EQUAL_STRING("environment temperature=22,pressure=1013.3,probe_temperature=-3.5 3600\n", line);
+
+    LineProtocol::encodeRecord(line, sizeof(line), "environment", records[0], 0, PRECISION_S);
+    TEST_ASSERT_EQUAL_STRING("environment temperature=22 3600\n", line);
+}
+
+void test_line_protocol_encode_battery(void) {
+    char line[LineProtocol::MAX_LINE];
+
+    LineProtocol::encodeBattery(line, sizeof(line), "environment", 3.87, 12, 1704067200, PRECISION_S);
+
+    TEST_ASSERT_EQUAL_STRING("environment battery_voltage=3.87,upload_seq=12i 1704067200\n", line);
+}
+
+void test_line_protocol_series_tags(void) {
+    char series[LineProtocol::MAX_SERIES];
+
+    LineProtocol::encodeSeries(series, sizeof(series), "environment", "5ccf7f01abef", "");
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef", series);
+
+    LineProtocol::encodeSeries(series, sizeof(series), "environment", "5ccf7f01abef", "garden");
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef,location=garden", series);
+}
+
+void test_line_protocol_series_escaping(void) {
+    char series[LineProtocol::MAX_SERIES];
+
+    LineProtocol::encodeSeries(series, sizeof(series), "env data,x", "5ccf7f01abef", "north side,a=b");
+    TEST_ASSERT_EQUAL_STRING("env\\ data\\,x,device=5ccf7f01abef,location=north\\ side\\,a\\=b", series);
+}
+
+// The pre-serialized series is used verbatim as the measurement
+void test_line_protocol_record_with_series(void) {
+    char series[LineProtocol::MAX_SERIES];
+    char line[LineProtocol::MAX_LINE];
+    SensorRecord record = SensorRecord::create(22.0, 65.0, 3600, 0);
+
+    LineProtocol::encodeSeries(series, sizeof(series), "environment", "5ccf7f01abef", "garden");
+    LineProtocol::encodeRecord(line, sizeof(line), series, record, 0, PRECISION_S);
+
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef,location=garden temperature=22,humidity=65 3600\n", line);
+}
+
+void test_line_protocol_buffer_too_small(void) {
+    char line[16];
+    SensorRecord record = SensorRecord::create(22.0, 65.0, 3600, 0);
+
+    size_t length = LineProtocol::encodeRecord(line, sizeof(line), "environment", record, 0, PRECISION_NS);
+
+    TEST_ASSERT_EQUAL(0, length);
+    TEST_ASSERT_EQUAL_STRING("", line);
+}
+
+// Payload size per point for a full RTC buffer of realistic records
+void test_line_protocol_bytes_per_point(void) {
+    const int points = 128;
+    char line[LineProtocol::MAX_LINE];
+    size_t legacyBytes = 0;
+    size_t nsBytes = 0;
+    size_t sBytes = 0;
+    size_t mBytes = 0;
+
+    for (int i = 0; i < points; i++) {
+        uint32_t now = TEST_OFFSET + 3600 + i * 1800;
+        SensorRecord record = SensorRecord::create(18.0 + (i % 8), 40.0 + (i % 30), now, TEST_OFFSET);
+
+        // Previous encoder: one decimal and nanosecond timestamps
+        legacyBytes += snprintf(line, sizeof(line), "environment temperature=%.1f,humidity=%.1f %u000000000\n",
+                                record.getTemperature(), record.getHumidity(),
+                                (unsigned int)record.getTimestampSeconds(TEST_OFFSET));
+
+        nsBytes += LineProtocol::encodeRecord(line, sizeof(line), "environment", record, TEST_OFFSET, PRECISION_NS);
+        sBytes += LineProtocol::encodeRecord(line, sizeof(line), "environment", record, TEST_OFFSET, PRECISION_S);
+        mBytes += LineProtocol::encodeRecord(line, sizeof(line), "environment", record, TEST_OFFSET, PRECISION_M);
+    }
+
+    char message[128];
+    snprintf(message, sizeof(message), "bytes/point: legacy=%.1f ns=%.1f s=%.1f m=%.1f",
+             (double)legacyBytes / points, (double)nsBytes / points,
+             (double)sBytes / points, (double)mBytes / points);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_TRUE(nsBytes < legacyBytes);
+    TEST_ASSERT_TRUE(sBytes < nsBytes);
+    TEST_ASSERT_TRUE(mBytes < sBytes);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_line_protocol_precision_param);
+    RUN_TEST(test_line_protocol_timestamp_units);
+    RUN_TEST(test_line_protocol_integral_values);
+    RUN_TEST(test_line_protocol_fractional_values);
+    RUN_TEST(test_line_protocol_encode_record);
+    RUN_TEST(test_line_protocol_optional_channels);
+    RUN_TEST(test_line_protocol_encode_battery);
+    RUN_TEST(test_line_protocol_series_tags);
+    RUN_TEST(test_line_protocol_series_escaping);
+    RUN_TEST(test_line_protocol_record_with_series);
+    RUN_TEST(test_line_protocol_buffer_too_small);
+    RUN_TEST(test_line_protocol_bytes_per_point);
+
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,389 @@
+#include <unity.h>
+#include <string>
+#include "../native_mocks/HttpStubServer.h"
+#include "../native_mocks/WiFiClient.h"
+#include "../lib/OtaUpdater.h"
+#include "../lib/FirmwarePatcher.h"
+#include "../lib/Sha256.h"
+#include "../lib/HostResolver.h"
+
+// Flash stand-in: the running image and whatever the update writes
+class MemoryTarget : public FirmwareTarget {
+public:
+    std::string base;
+    uint8_t md5[FIRMWARE_MD5_SIZE];
+    std::string image;
+    uint32_t size;
+    bool begun;
+    bool finished;
+    bool aborted;
+    
+    void reset() {
+        image.clear();
+        size = 0;
+        begun = finished = aborted = false;
+    }
+    
+    uint32_t baseSize() { return base.size(); }
+    void baseMd5(uint8_t out[FIRMWARE_MD5_SIZE]) { memcpy(out, md5, FIRMWARE_MD5_SIZE); }
+    bool readBase(uint32_t offset, uint8_t* buf, size_t length) {
+        if (offset + length > base.size()) {
+            return false;
+        }
+        memcpy(buf, base.data() + offset, length);
+        return true;
+    }
+    bool begin(uint32_t s) {
+        size = s;
+        begun = true;
+        return true;
+    }
+    bool write(const uint8_t* data, size_t length) {
+        image.append((const char*)data, length);
+        return image.size() <= size;
+    }
+    bool finish() {
+        finished = true;
+        return true;
+    }
+    void abort() { aborted = true; }
+};
+
+static HttpStubServer server;
+static MemoryTarget target;
+static char url[64];
+
+// Deterministic image that starts like an ESP8266 image
+static std::string makeImage(size_t length, uint32_t seed) {
+    std::string image(length, '\0');
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (char)(seed >> 16);
+    }
+    image[0] = (char)FIRMWARE_IMAGE_MAGIC;
+    return image;
+}
+
+static std::string digestOf(const std::string& data, uint8_t digest[SHA256_SIZE]) {
+    Sha256 sha;
+    sha.update((const uint8_t*)data.data(), data.size());
+    sha.finish(digest);
+    char hex[2 * SHA256_SIZE + 1];
+    Sha256::toHex(digest, hex);
+    return hex;
+}
+
+static void putU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+static std::string deltaHeader(uint32_t imageSize) {
+    std::string delta = "MD";
+    delta += (char)FIRMWARE_DELTA_VERSION;
+    delta += '\0';
+    delta.append((const char*)target.md5, FIRMWARE_MD5_SIZE);
+    putU32(delta, target.base.size());
+    putU32(delta, imageSize);
+    return delta;
+}
+
+static void copyOp(std::string& delta, uint32_t offset, uint32_t length) {
+    delta += (char)FIRMWARE_DELTA_COPY;
+    putU32(delta, offset);
+    putU32(delta, length);
+}
+
+static void dataOp(std::string& delta, const std::string& bytes) {
+    delta += (char)FIRMWARE_DELTA_DATA;
+    putU32(delta, bytes.size());
+    delta += bytes;
+}
+
+// New image: base with a patched middle and a new tail, and its delta
+static std::string makeDelta(std::string& image) {
+    const std::string& base = target.base;
+    image = base.substr(0, 1000) + "PATCHED" + base.substr(1500) + "NEW TAIL";
+    std::string delta = deltaHeader(image.size());
+    copyOp(delta, 0, 1000);
+    dataOp(delta, "PATCHED");
+    copyOp(delta, 1500, base.size() - 1500);
+    dataOp(delta, "NEW TAIL");
+    return delta;
+}
+
+static void serve(const std::string& body, const std::string& digestHex) {
+    server.status = 200;
+    server.responseBody = body;
+    server.responseHeaders = "X-Image-SHA256: " + digestHex + "\r\n";
+}
+
+void setUp(void) {
+    target.base = makeImage(4000, 1);
+    for (int i = 0; i < FIRMWARE_MD5_SIZE; i++) {
+        target.md5[i] = (uint8_t)(0xA0 + i);
+    }
+    target.reset();
+    server.status = 304;
+    server.responseBody.clear();
+    server.responseHeaders.clear();
+    server.truncateResponse = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_sha256_known_digests(void) {
+    uint8_t digest[SHA256_SIZE];
+    std::string hex = digestOf("abc", digest);
+    TEST_ASSERT_EQUAL_STRING("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hex.c_str());
+    hex = digestOf("", digest);
+    TEST_ASSERT_EQUAL_STRING("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hex.c_str());
+    hex = digestOf("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", digest);
+    TEST_ASSERT_EQUAL_STRING("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", hex.c_str());
+    
+    // Pieces of any size give the same digest
+    std::string image = makeImage(1000, 7);
+    uint8_t whole[SHA256_SIZE];
+    digestOf(image, whole);
+    Sha256 sha;
+    for (size_t i = 0; i < image.size(); i += 13) {
+        sha.update((const uint8_t*)image.data() + i, image.size() - i < 13 ? image.size() - i : 13);
+    }
+    sha.finish(digest);
+    TEST_ASSERT_EQUAL_MEMORY(whole, digest, SHA256_SIZE);
+    
+    uint8_t parsed[SHA256_SIZE];
+    char wholeHex[2 * SHA256_SIZE + 1];
+    Sha256::toHex(whole, wholeHex);
+    TEST_ASSERT_TRUE(Sha256::fromHex(wholeHex, parsed));
+    TEST_ASSERT_EQUAL_MEMORY(whole, parsed, SHA256_SIZE);
+    TEST_ASSERT_FALSE(Sha256::fromHex("abc", parsed));
+}
+
+void test_patcher_applies_delta_in_any_pieces(void) {
+    std::string image;
+    std::string delta = makeDelta(image);
+    uint8_t digest[SHA256_SIZE];
+    digestOf(image, digest);
+    
+    size_t pieces[] = { 1, 3, 9, 28, 512, delta.size() };
+    for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) {
+        target.reset();
+        FirmwarePatcher patcher(target);
+        patcher.begin(delta.size(), digest);
+        for (size_t i = 0; i < delta.size(); i += pieces[p]) {
+            size_t n = delta.size() - i < pieces[p] ? delta.size() - i : pieces[p];
+            TEST_ASSERT_TRUE(patcher.write((const uint8_t*)delta.data() + i, n));
+        }
+        TEST_ASSERT_TRUE(patcher.end());
+        TEST_ASSERT_TRUE(patcher.isDelta());
+        TEST_ASSERT_EQUAL(image.size(), target.size);
+        TEST_ASSERT_TRUE(image == target.image);
+        TEST_ASSERT_TRUE(target.finished);
+    }
+    
+    // Most of the image came from the running one
+    TEST_ASSERT_TRUE(delta.size() < image.size() / 20);
+}
+
+void test_patcher_rejects_bad_deltas(void) {
+    uint8_t digest[SHA256_SIZE] = { 0 };
+    FirmwarePatcher patcher(target);
+    
+    // Built against another image
+    std::string delta = deltaHeader(100);
+    delta[4] ^= 1;
+    patcher.begin(delta.size(), digest);
+    TEST_ASSERT_FALSE(patcher.write((const uint8_t*)delta.data(), delta.size()));
+    TEST_ASSERT_EQUAL_STRING("Delta is for another image", patcher.getError());
+    TEST_ASSERT_FALSE(target.begun);
+    
+    // Copy past the end of the running image
+    delta = deltaHeader(100);
+    copyOp(delta, 3950, 100);
+    patcher.begin(delta.size(), digest);
+    TEST_ASSERT_FALSE(patcher.write((const uint8_t*)delta.data(), delta.size()));
+    TEST_ASSERT_FALSE(patcher.end());
+    TEST_ASSERT_TRUE(target.aborted);
+    TEST_ASSERT_FALSE(target.finished);
+    
+    // More data than the announced image size
+    target.reset();
+    delta = deltaHeader(4);
+    dataOp(delta, "12345");
+    patcher.begin(delta.size(), digest);
+    TEST_ASSERT_FALSE(patcher.write((const uint8_t*)delta.data(), delta.size()));
+    
+    // Neither an image nor a delta
+    patcher.begin(5, digest);
+    TEST_ASSERT_FALSE(patcher.write((const uint8_t*)"<html", 5));
+    TEST_ASSERT_EQUAL_STRING("Not a firmware image", patcher.getError());
+}
+
+void test_ota_no_update(void) {
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    size_t before = server.requests().size();
+    TEST_ASSERT_EQUAL(OTA_NO_UPDATE, ota.update(url));
+    TEST_ASSERT_EQUAL(304, ota.getStatus());
+    TEST_ASSERT_FALSE(target.begun);
+    
+    std::vector<StubRequest> requests = server.requests();
+    TEST_ASSERT_EQUAL(before + 1, requests.size());
+    const StubRequest& request = requests.back();
+    TEST_ASSERT_EQUAL_STRING("/firmware/meteo.bin", request.path.c_str());
+    std::string md5 = request.header("x-sketch-md5");
+    TEST_ASSERT_EQUAL_STRING("a0a1a2a3a4a5a6a7a8a9aaabacadaeaf", md5.c_str());
+    std::string size = request.header("x-sketch-size");
+    TEST_ASSERT_EQUAL_STRING("4000", size.c_str());
+}
+
+void test_ota_full_image(void) {
+    std::string image = makeImage(3000, 2);
+    uint8_t digest[SHA256_SIZE];
+    serve(image, digestOf(image, digest));
+    
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    TEST_ASSERT_EQUAL(OTA_UPDATED, ota.update(url));
+    TEST_ASSERT_FALSE(ota.isDelta());
+    TEST_ASSERT_EQUAL(3000, ota.getDownloadBytes());
+    TEST_ASSERT_TRUE(image == target.image);
+    TEST_ASSERT_TRUE(target.finished);
+}
+
+void test_ota_delta(void) {
+    std::string image;
+    std::string delta = makeDelta(image);
+    uint8_t digest[SHA256_SIZE];
+    serve(delta, digestOf(image, digest));
+    
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    TEST_ASSERT_EQUAL(OTA_UPDATED, ota.update(url));
+    TEST_ASSERT_TRUE(ota.isDelta());
+    TEST_ASSERT_EQUAL(delta.size(), ota.getDownloadBytes());
+    TEST_ASSERT_TRUE(image == target.image);
+    TEST_ASSERT_TRUE(target.finished);
+}
+
+void test_ota_digest_mismatch_is_not_flashed(void) {
+    std::string image = makeImage(3000, 2);
+    uint8_t digest[SHA256_SIZE];
+    serve(image, digestOf(image + "x", digest));
+    
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    TEST_ASSERT_EQUAL(OTA_FAILED, ota.update(url));
+    TEST_ASSERT_EQUAL_STRING("SHA-256 mismatch", ota.getError());
+    TEST_ASSERT_TRUE(target.aborted);
+    TEST_ASSERT_FALSE(target.finished);
+}
+
+void test_ota_incomplete_download(void) {
+    std::string image = makeImage(3000, 2);
+    uint8_t digest[SHA256_SIZE];
+    serve(image, digestOf(image, digest));
+    server.truncateResponse = 1200;
+    
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    TEST_ASSERT_EQUAL(OTA_FAILED, ota.update(url));
+    TEST_ASSERT_EQUAL_STRING("Download incomplete", ota.getError());
+    TEST_ASSERT_EQUAL(1200, ota.getDownloadBytes());
+    TEST_ASSERT_TRUE(target.aborted);
+    TEST_ASSERT_FALSE(target.finished);
+}
+
+void test_ota_requires_digest(void) {
+    server.status = 200;
+    server.responseBody = makeImage(100, 3);
+    
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    TEST_ASSERT_EQUAL(OTA_FAILED, ota.update(url));
+    TEST_ASSERT_EQUAL_STRING("Update without X-Image-SHA256", ota.getError());
+    TEST_ASSERT_FALSE(target.begun);
+    
+    server.status = 404;
+    TEST_ASSERT_EQUAL(OTA_FAILED, ota.update(url));
+    TEST_ASSERT_EQUAL(404, ota.getStatus());
+}
+
+void test_ota_parse_url(void) {
+    char host[32];
+    uint16_t port;
+    const char* path;
+    TEST_ASSERT_TRUE(OtaUpdater::parseUrl("http://updates.local:8080/fw/meteo.bin", host, sizeof(host), port, path));
+    TEST_ASSERT_EQUAL_STRING("updates.local", host);
+    TEST_ASSERT_EQUAL(8080, port);
+    TEST_ASSERT_EQUAL_STRING("/fw/meteo.bin", path);
+    
+    TEST_ASSERT_TRUE(OtaUpdater::parseUrl("http://10.0.0.2", host, sizeof(host), port, path));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.2", host);
+    TEST_ASSERT_EQUAL(80, port);
+    TEST_ASSERT_EQUAL_STRING("/", path);
+    
+    TEST_ASSERT_FALSE(OtaUpdater::parseUrl("https://updates.local/fw.bin", host, sizeof(host), port, path));
+    TEST_ASSERT_FALSE(OtaUpdater::parseUrl("http://:80/fw.bin", host, sizeof(host), port, path));
+    TEST_ASSERT_FALSE(OtaUpdater::parseUrl("http://host:99999/fw.bin", host, sizeof(host), port, path));
+    TEST_ASSERT_FALSE(OtaUpdater::parseUrl("http://a-very-long-host-name-that-does-not-fit.local/", 
+                                           host, sizeof(host), port, path));
+}
+
+// The check runs right after an upload, while the resolver still holds
+// the RTC cache of the upload server
+void test_ota_keeps_upload_dns_cache(void) {
+    WiFi.clearHosts();
+    WiFi.addHost("ingest.local", IPAddress(127, 0, 0, 1));
+    WiFi.addHost("updates.local", IPAddress(127, 0, 0, 1));
+    DnsCache cache = {};
+    IPAddress address;
+    
+    HostResolver::useCache(&cache, 1000);
+    TEST_ASSERT_TRUE(HostResolver::resolve("ingest.local", address));
+    char updateUrl[64];
+    snprintf(updateUrl, sizeof(updateUrl), "http://updates.local:%u/firmware/meteo.bin",
+             (unsigned int)server.getPort());
+    WiFiClient client;
+    OtaUpdater ota(client, target);
+    TEST_ASSERT_EQUAL(OTA_NO_UPDATE, ota.update(updateUrl));
+    TEST_ASSERT_EQUAL(2, WiFi.lookups);
+    
+    // Next wake: the upload server still comes from the cache
+    HostResolver::useCache(&cache, 2800);
+    TEST_ASSERT_TRUE(HostResolver::resolve("ingest.local", address));
+    TEST_ASSERT_EQUAL(1, HostResolver::getCacheHits());
+    TEST_ASSERT_EQUAL(0, HostResolver::getLookups());
+    HostResolver::useCache(nullptr, 0);
+}
+
+void setup() {
+    delay(2000);
+    
+    uint16_t port = server.start();
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/firmware/meteo.bin", (unsigned int)port);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_sha256_known_digests);
+    RUN_TEST(test_patcher_applies_delta_in_any_pieces);
+    RUN_TEST(test_patcher_rejects_bad_deltas);
+    RUN_TEST(test_ota_no_update);
+    RUN_TEST(test_ota_full_image);
+    RUN_TEST(test_ota_delta);
+    RUN_TEST(test_ota_digest_mismatch_is_not_flashed);
+    RUN_TEST(test_ota_incomplete_download);
+    RUN_TEST(test_ota_requires_digest);
+    RUN_TEST(test_ota_parse_url);
+    RUN_TEST(test_ota_keeps_upload_dns_cache);
+    
+    UNITY_END();
+    
+    server.stop();
+}
+
+void loop() {
+}
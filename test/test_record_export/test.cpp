@@ -0,0 +1,247 @@
+#include <unity.h>
+#include <string>
+#include "../lib/RecordExport.h"
+#include "../lib/RecordStore.h"
+#include <EEPROM.h>
+
+static const uint32_t TEST_OFFSET = (1704067200UL / 65536) * 65536;
+
+static RTCData rtc;
+
+static SensorRecord testRecord(int i) {
+    return SensorRecord::create(-5.0 + i, 40.0 + i, TEST_OFFSET + 60 * i, TEST_OFFSET);
+}
+
+static unsigned int timeOf(int i) {
+    return testRecord(i).getTimestampSeconds(TEST_OFFSET);
+}
+
+// Everything read() produces, in chunks of 'size'
+static std::string exportAll(ExportFormat format, size_t size) {
+    RecordExport records(rtc, TEST_OFFSET, format);
+    std::string text;
+    char chunk[2048];
+    size_t length;
+    int chunks = 0;
+    while ((length = records.read(chunk, size)) > 0) {
+        TEST_ASSERT_TRUE(length <= size);
+        text.append(chunk, length);
+        chunks++;
+        TEST_ASSERT_TRUE(chunks < 10000);
+    }
+    return text;
+}
+
+void setUp(void) {
+    EEPROM.begin(4096);
+    rtc.initialize();
+}
+
+void tearDown(void) {
+}
+
+void test_record_export_empty(void) {
+    std::string csv = exportAll(EXPORT_CSV, 512);
+    TEST_ASSERT_EQUAL_STRING("time,temperature,humidity\n", csv.c_str());
+    
+    std::string json = exportAll(EXPORT_JSON, 512);
+    std::string expected = "{\"timeOffset\":" + std::to_string(TEST_OFFSET) + ",\"count\":0,\"records\":[\n]}";
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), json.c_str());
+}
+
+void test_record_export_csv_eeprom_then_rtc(void) {
+    SensorRecord spilled[3] = { testRecord(0), testRecord(1), testRecord(2) };
+    RecordStore::append(rtc, spilled, 3);
+    rtc.addRecord(testRecord(3));
+    rtc.addRecord(testRecord(4));
+    
+    RecordExport records(rtc, TEST_OFFSET, EXPORT_CSV);
+    TEST_ASSERT_EQUAL(5, records.getCount());
+    
+    char expected[256];
+    snprintf(expected, sizeof(expected),
+             "time,temperature,humidity\n%u,-5,40\n%u,-4,41\n%u,-3,42\n%u,-2,43\n%u,-1,44\n",
+             timeOf(0), timeOf(1), timeOf(2), timeOf(3), timeOf(4));
+    std::string csv = exportAll(EXPORT_CSV, 512);
+    TEST_ASSERT_EQUAL_STRING(expected, csv.c_str());
+}
+
+void test_record_export_json_rows(void) {
+    rtc.addRecord(testRecord(0));
+    rtc.addRecord(testRecord(30));
+    
+    char expected[256];
+    snprintf(expected, sizeof(expected),
+             "{\"timeOffset\":%u,\"count\":2,\"records\":[\n"
+             "{\"time\":%u,\"temperature\":-5,\"humidity\":40},\n"
+             "{\"time\":%u,\"temperature\":25,\"humidity\":70}\n]}",
+             (unsigned int)TEST_OFFSET, timeOf(0), timeOf(30));
+    std::string json = exportAll(EXPORT_JSON, 512);
+    TEST_ASSERT_EQUAL_STRING(expected, json.c_str());
+}
+
+// Channel slots become columns; the EEPROM part has none of them
+void test_record_export_channel_columns(void) {
+    SensorRecord spilled[1] = { testRecord(0) };
+    RecordStore::append(rtc, spilled, 1);
+    
+    Measurement measurement;
+    measurement.set(SENSOR_TEMPERATURE, 12.0);
+    measurement.set(SENSOR_PRESSURE, 1001.5);
+    SensorRecord packed[SENSOR_MAX_SLOTS];
+    uint8_t count = SensorRecord::pack(measurement, TEST_OFFSET + 60, TEST_OFFSET, packed);
+    rtc.addRecords(packed, count);
+    
+    RecordExport records(rtc, TEST_OFFSET, EXPORT_CSV);
+    TEST_ASSERT_EQUAL(3, records.getCount());
+    TEST_ASSERT_EQUAL(2, records.getMeasurementCount());
+    
+    char expected[256];
+    snprintf(expected, sizeof(expected), "time,temperature,humidity,pressure\n%u,-5,40,\n%u,12,,1001.5\n",
+             timeOf(0), timeOf(1));
+    std::string csv = exportAll(EXPORT_CSV, 512);
+    TEST_ASSERT_EQUAL_STRING(expected, csv.c_str());
+    
+    snprintf(expected, sizeof(expected),
+             "{\"timeOffset\":%u,\"count\":2,\"records\":[\n"
+             "{\"time\":%u,\"temperature\":-5,\"humidity\":40},\n"
+             "{\"time\":%u,\"temperature\":12,\"pressure\":1001.5}\n]}",
+             (unsigned int)TEST_OFFSET, timeOf(0), timeOf(1));
+    std::string json = exportAll(EXPORT_JSON, 512);
+    TEST_ASSERT_EQUAL_STRING(expected, json.c_str());
+}
+
+void test_record_export_chunks_split_on_rows(void) {
+    SensorRecord spilled[RTC_BUFFER_SIZE];
+    for (int i = 0; i < RTC_BUFFER_SIZE; i++) {
+        spilled[i] = testRecord(i % 60);
+    }
+    RecordStore::append(rtc, spilled, RTC_BUFFER_SIZE);
+    for (int i = 0; i < 50; i++) {
+        rtc.addRecord(testRecord(i));
+    }
+    
+    // Smallest chunk gives the same document as one big chunk
+    TEST_ASSERT_TRUE(exportAll(EXPORT_CSV, RecordExport::MIN_CHUNK) == exportAll(EXPORT_CSV, 2048));
+    TEST_ASSERT_TRUE(exportAll(EXPORT_JSON, RecordExport::MIN_CHUNK) == exportAll(EXPORT_JSON, 2048));
+    
+    // Every CSV chunk ends on a row
+    RecordExport records(rtc, TEST_OFFSET, EXPORT_CSV);
+    char chunk[RecordExport::MIN_CHUNK];
+    size_t length;
+    size_t rows = 0;
+    while ((length = records.read(chunk, sizeof(chunk))) > 0) {
+        TEST_ASSERT_EQUAL('\n', chunk[length - 1]);
+        for (size_t i = 0; i < length; i++) {
+            rows += chunk[i] == '\n';
+        }
+    }
+    TEST_ASSERT_EQUAL(1 + RTC_BUFFER_SIZE + 50, rows);
+}
+
+void test_record_export_binary_decodes(void) {
+    SensorRecord spilled[2] = { testRecord(0), testRecord(1) };
+    RecordStore::append(rtc, spilled, 2);
+    rtc.addRecord(testRecord(2));
+    
+    const uint8_t mac[6] = { 0xA0, 0x20, 0xA6, 0x01, 0x02, 0x03 };
+    RecordExport records(rtc, TEST_OFFSET, EXPORT_BINARY, mac);
+    TEST_ASSERT_EQUAL(BINARY_HEADER_SIZE + 3 * BINARY_EXPORT_RECORD_SIZE, records.getSize());
+    
+    uint8_t image[256];
+    size_t length = records.read((char*)image, sizeof(image));
+    TEST_ASSERT_EQUAL(records.getSize(), length);
+    TEST_ASSERT_EQUAL(0, records.read((char*)image + length, sizeof(image) - length));
+    
+    BinaryBlock block;
+    TEST_ASSERT_EQUAL(BINARY_HEADER_SIZE, BinaryBlockDecoder::decodeExportHeader(image, length, block));
+    TEST_ASSERT_EQUAL(BINARY_BLOCK_EXPORT, block.type);
+    TEST_ASSERT_EQUAL_MEMORY(mac, block.deviceId, 6);
+    TEST_ASSERT_EQUAL(TEST_OFFSET, block.timeOffset);
+    TEST_ASSERT_EQUAL(3, block.count);
+    for (int i = 0; i < 3; i++) {
+        BinaryRecord record = BinaryBlockDecoder::decodeExportRecord(
+            image + BINARY_HEADER_SIZE + i * BINARY_EXPORT_RECORD_SIZE);
+        TEST_ASSERT_EQUAL(timeOf(i), BinaryBlockDecoder::timestampSeconds(block, record));
+        TEST_ASSERT_EQUAL(-5 + i, BinaryBlockDecoder::temperature(record));
+        TEST_ASSERT_EQUAL(40 + i, record.humidity);
+    }
+    
+    // An upload block is not an export and vice versa
+    TEST_ASSERT_EQUAL(0, BinaryBlockDecoder::decode(image, length, block));
+}
+
+void test_record_export_binary_spans_memory(void) {
+    SensorRecord spilled[RTC_BUFFER_SIZE];
+    for (int i = 0; i < RTC_BUFFER_SIZE; i++) {
+        spilled[i] = testRecord(i % 60);
+    }
+    RecordStore::append(rtc, spilled, RTC_BUFFER_SIZE);
+    for (int i = 0; i < 10; i++) {
+        rtc.addRecord(testRecord(i));
+    }
+    RecordExport records(rtc, TEST_OFFSET, EXPORT_BINARY);
+    
+    // The whole EEPROM area comes back as one block, in place
+    size_t length;
+    const uint8_t* data = records.dataAt(BINARY_HEADER_SIZE, length);
+    TEST_ASSERT_EQUAL(RTC_BUFFER_SIZE * BINARY_EXPORT_RECORD_SIZE, length);
+    TEST_ASSERT_EQUAL_PTR(EEPROM.getConstDataPtr() + ROM_DATA_START, data);
+    
+    // Resuming mid-record continues inside the RTC buffer
+    uint32_t offset = BINARY_HEADER_SIZE + (RTC_BUFFER_SIZE + 3) * BINARY_EXPORT_RECORD_SIZE + 1;
+    data = records.dataAt(offset, length);
+    TEST_ASSERT_EQUAL(7 * BINARY_EXPORT_RECORD_SIZE - 1, length);
+    TEST_ASSERT_EQUAL_PTR((const uint8_t*)(rtc.buffer + 3) + 1, data);
+    
+    TEST_ASSERT_NULL(records.dataAt(records.getSize(), length));
+    TEST_ASSERT_EQUAL(0, length);
+}
+
+void test_record_export_parse_range(void) {
+    uint32_t first = 0, last = 0;
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_PARTIAL, RecordExport::parseRange("bytes=0-99", 1000, first, last));
+    TEST_ASSERT_EQUAL(0, first);
+    TEST_ASSERT_EQUAL(99, last);
+    
+    // Open end, as sent by a resuming download
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_PARTIAL, RecordExport::parseRange("bytes=400-", 1000, first, last));
+    TEST_ASSERT_EQUAL(400, first);
+    TEST_ASSERT_EQUAL(999, last);
+    
+    // End past the document is clamped, a suffix counts from the end
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_PARTIAL, RecordExport::parseRange("bytes=990-5000", 1000, first, last));
+    TEST_ASSERT_EQUAL(999, last);
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_PARTIAL, RecordExport::parseRange("bytes=-100", 1000, first, last));
+    TEST_ASSERT_EQUAL(900, first);
+    TEST_ASSERT_EQUAL(999, last);
+    
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_INVALID, RecordExport::parseRange("bytes=1000-", 1000, first, last));
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_INVALID, RecordExport::parseRange("bytes=-0", 1000, first, last));
+    
+    // Anything else is ignored and the whole document is sent
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_NONE, RecordExport::parseRange("bytes=0-9,20-29", 1000, first, last));
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_NONE, RecordExport::parseRange("bytes=50-10", 1000, first, last));
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_NONE, RecordExport::parseRange("items=0-9", 1000, first, last));
+    TEST_ASSERT_EQUAL(EXPORT_RANGE_NONE, RecordExport::parseRange("bytes=x-9", 1000, first, last));
+}
+
+void setup() {
+    delay(2000);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_record_export_empty);
+    RUN_TEST(test_record_export_csv_eeprom_then_rtc);
+    RUN_TEST(test_record_export_json_rows);
+    RUN_TEST(test_record_export_channel_columns);
+    RUN_TEST(test_record_export_chunks_split_on_rows);
+    RUN_TEST(test_record_export_binary_decodes);
+    RUN_TEST(test_record_export_binary_spans_memory);
+    RUN_TEST(test_record_export_parse_range);
+    
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,167 @@
+#include <unity.h>
+#include "../lib/RecordStore.h"
+#include <EEPROM.h>
+#include <chrono>
+
+static RTCData rtc;
+
+static SensorRecord testRecord(uint16_t i) {
+    SensorRecord record;
+    record.timestamp = i;
+    record.temperature = i % 256;
+    record.humidity = i % 101;
+    return record;
+}
+
+void setUp(void) {
+    EEPROM.begin(4096);
+    memset(EEPROM.getDataPtr(), 0, EEPROM.length());
+    EEPROM.commits = 0;
+    rtc.initialize();
+}
+
+void tearDown(void) {
+}
+
+void test_record_store_empty(void) {
+    uint16_t count = 10;
+    TEST_ASSERT_NULL(RecordStore::span(rtc, 0, count));
+    TEST_ASSERT_EQUAL(0, count);
+    TEST_ASSERT_EQUAL(0, RecordStore::count(rtc));
+}
+
+void test_record_store_append_commits_once(void) {
+    SensorRecord records[RTC_BUFFER_SIZE];
+    for (uint16_t i = 0; i < RTC_BUFFER_SIZE; i++) {
+        records[i] = testRecord(i);
+    }
+    
+    TEST_ASSERT_EQUAL(RTC_BUFFER_SIZE, RecordStore::append(rtc, records, RTC_BUFFER_SIZE));
+    TEST_ASSERT_EQUAL(1, EEPROM.commits);
+    TEST_ASSERT_EQUAL(RTC_BUFFER_SIZE, rtc.romRecordCount);
+    
+    // Same layout the per-record EEPROM.get() reads used
+    for (uint16_t i = 0; i < RTC_BUFFER_SIZE; i++) {
+        SensorRecord record;
+        EEPROM.get(ROM_DATA_START + i * sizeof(SensorRecord), record);
+        TEST_ASSERT_EQUAL_MEMORY(&records[i], &record, sizeof(SensorRecord));
+    }
+}
+
+void test_record_store_span_reads_in_place(void) {
+    SensorRecord records[RTC_BUFFER_SIZE];
+    for (uint16_t i = 0; i < RTC_BUFFER_SIZE; i++) {
+        records[i] = testRecord(i);
+    }
+    RecordStore::append(rtc, records, RTC_BUFFER_SIZE);
+    RecordStore::append(rtc, records, 10);
+    
+    uint16_t count = 20;
+    const SensorRecord* span = RecordStore::span(rtc, 104, count);
+    TEST_ASSERT_EQUAL(18, count);   // Clamped to the 122 stored
+    TEST_ASSERT_EQUAL_PTR(EEPROM.getConstDataPtr() + ROM_DATA_START + 104 * sizeof(SensorRecord), span);
+    TEST_ASSERT_EQUAL_MEMORY(&records[104], &span[0], 8 * sizeof(SensorRecord));
+    TEST_ASSERT_EQUAL_MEMORY(&records[0], &span[8], 10 * sizeof(SensorRecord));
+}
+
+void test_record_store_stops_when_full(void) {
+    SensorRecord records[RTC_BUFFER_SIZE];
+    for (uint16_t i = 0; i < RTC_BUFFER_SIZE; i++) {
+        records[i] = testRecord(i);
+    }
+    
+    uint16_t total = 0;
+    for (int i = 0; i < 8; i++) {
+        total += RecordStore::append(rtc, records, RTC_BUFFER_SIZE);
+    }
+    TEST_ASSERT_EQUAL(MAX_ROM_RECORDS, total);   // The last one only partly
+    TEST_ASSERT_EQUAL(0, RecordStore::append(rtc, records, RTC_BUFFER_SIZE));
+    TEST_ASSERT_EQUAL(8, EEPROM.commits);   // Nothing to write, no commit
+    
+    // The record area ends exactly at the end of the 4 KB EEPROM
+    TEST_ASSERT_EQUAL(4096, ROM_DATA_START + MAX_ROM_RECORDS * sizeof(SensorRecord));
+    
+    RecordStore::clear(rtc);
+    TEST_ASSERT_EQUAL(0, RecordStore::count(rtc));
+}
+
+// A measurement and its channel slots are stored together or not at all
+void test_record_store_keeps_measurements_whole(void) {
+    SensorRecord filler[MAX_ROM_RECORDS];
+    for (uint16_t i = 0; i < MAX_ROM_RECORDS; i++) {
+        filler[i] = testRecord(i);
+    }
+    RecordStore::append(rtc, filler, MAX_ROM_RECORDS - 3);
+    
+    Measurement measurement;
+    measurement.set(SENSOR_TEMPERATURE, 20.0);
+    measurement.set(SENSOR_HUMIDITY, 50.0);
+    measurement.set(SENSOR_PRESSURE, 990.0);
+    SensorRecord records[2 * SENSOR_MAX_SLOTS];
+    uint8_t first = SensorRecord::pack(measurement, 60, 0, records);
+    uint8_t count = first + SensorRecord::pack(measurement, 120, 0, records + first);
+    TEST_ASSERT_EQUAL(4, count);
+    
+    // Room for three records: the second measurement waits for an upload
+    TEST_ASSERT_EQUAL(2, RecordStore::append(rtc, records, count));
+    TEST_ASSERT_EQUAL(MAX_ROM_RECORDS - 1, RecordStore::count(rtc));
+}
+
+// Not a pass/fail check: reports the cost of both read paths
+void test_record_store_read_benchmark(void) {
+    for (uint16_t i = 0; i < MAX_ROM_RECORDS; i++) {
+        SensorRecord record = testRecord(i);
+        RecordStore::append(rtc, &record, 1);
+    }
+    TEST_ASSERT_EQUAL(MAX_ROM_RECORDS, EEPROM.commits);
+    
+    const int rounds = 1000;
+    uint32_t copied = 0;
+    uint32_t inPlace = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint16_t i = 0; i < MAX_ROM_RECORDS; i++) {
+            SensorRecord record;
+            EEPROM.get(ROM_DATA_START + i * sizeof(SensorRecord), record);
+            copied += record.timestamp + record.humidity;
+        }
+    }
+    auto perRecord = std::chrono::steady_clock::now() - start;
+    
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        uint16_t count = MAX_ROM_RECORDS;
+        const SensorRecord* records = RecordStore::span(rtc, 0, count);
+        for (uint16_t i = 0; i < count; i++) {
+            inPlace += records[i].timestamp + records[i].humidity;
+        }
+    }
+    auto span = std::chrono::steady_clock::now() - start;
+    
+    TEST_ASSERT_EQUAL(copied, inPlace);
+    
+    char message[96];
+    snprintf(message, sizeof(message), "EEPROM.get %.2f ns/record, span %.2f ns/record",
+             std::chrono::duration<double, std::nano>(perRecord).count() / (rounds * MAX_ROM_RECORDS),
+             std::chrono::duration<double, std::nano>(span).count() / (rounds * MAX_ROM_RECORDS));
+    TEST_MESSAGE(message);
+}
+
+void setup() {
+    delay(2000);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_record_store_empty);
+    RUN_TEST(test_record_store_append_commits_once);
+    RUN_TEST(test_record_store_span_reads_in_place);
+    RUN_TEST(test_record_store_stops_when_full);
+    RUN_TEST(test_record_store_keeps_measurements_whole);
+    RUN_TEST(test_record_store_read_benchmark);
+    
+    UNITY_END();
+}
+
+void loop() {
+}
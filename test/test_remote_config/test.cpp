@@ -0,0 +1,123 @@
+#include <unity.h>
+#include "../lib/RemoteConfig.h"
+
+static const uint8_t TEST_DEVICE[6] = { 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+
+static Config config;
+
+void setUp(void) {
+    config.setDefaults();
+    strcpy(config.ssid, "Network");
+    strcpy(config.password, "password1");
+    strcpy(config.influxServer, "influx.local");
+    strcpy(config.influxDb, "sensors");
+    strcpy(config.configPath, "/meteo.cfg");
+    config.configVersion = 3;
+}
+
+void tearDown(void) {
+}
+
+void test_remote_config_applies_new_version(void) {
+    const char* error;
+    uint8_t result = RemoteConfig::apply(config,
+        "# Garden stations\r\n"
+        "version=4\r\n"
+        "interval=600\r\n"
+        "\r\n"
+        "location=garden\r\n"
+        "apiversion=2\r\n"
+        "org=home\r\n"
+        "bucket=meteo\r\n"
+        "token=secret\r\n", error);
+
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_APPLIED, result);
+    TEST_ASSERT_NULL(error);
+    TEST_ASSERT_EQUAL(4, config.configVersion);
+    TEST_ASSERT_EQUAL(600, config.interval);
+    TEST_ASSERT_EQUAL(INFLUX_API_V2, config.influxVersion);
+    TEST_ASSERT_EQUAL_STRING("garden", config.location);
+    TEST_ASSERT_EQUAL_STRING("home", config.influxOrg);
+    TEST_ASSERT_EQUAL_STRING("secret", config.influxToken);
+
+    // Keys the document leaves out keep their value
+    TEST_ASSERT_EQUAL_STRING("influx.local", config.influxServer);
+    TEST_ASSERT_EQUAL(8086, config.influxPort);
+}
+
+void test_remote_config_same_version_is_ignored(void) {
+    const char* error;
+    uint8_t result = RemoteConfig::apply(config, "version=3\ninterval=600\n", error);
+
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_UNCHANGED, result);
+    TEST_ASSERT_EQUAL(1800, config.interval);
+}
+
+void test_remote_config_invalid_leaves_config_alone(void) {
+    Config before(config);
+    const char* error;
+
+    // Out of range for the field
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config, "version=4\ninterval=30\n", error));
+    TEST_ASSERT_NOT_NULL(error);
+    // Does not fit
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config,
+        "version=4\nlocation=a-location-name-too-long\n", error));
+    // Not a number
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config, "version=4\nport=80a\n", error));
+    // Fails Config::validate() as a whole
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config, "version=4\ndatabase=\n", error));
+    // No version, no key
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config, "interval=600\n", error));
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config, "version=4\n=600\n", error));
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_INVALID, RemoteConfig::apply(config, "", error));
+
+    TEST_ASSERT_TRUE(before.sameSettings(config));
+}
+
+void test_remote_config_skips_unknown_and_wifi_keys(void) {
+    const char* error;
+    uint8_t result = RemoteConfig::apply(config,
+        "version=5\n"
+        "ssid=Elsewhere\n"
+        "password=other-password\n"
+        "futurekey=1\n"
+        "measurement=climate", error);   // No final newline
+
+    TEST_ASSERT_EQUAL(REMOTE_CONFIG_APPLIED, result);
+    TEST_ASSERT_EQUAL_STRING("Network", config.ssid);
+    TEST_ASSERT_EQUAL_STRING("password1", config.password);
+    TEST_ASSERT_EQUAL_STRING("climate", config.influxMeasurement);
+}
+
+void test_remote_config_request_headers(void) {
+    char headers[96];
+    size_t length = RemoteConfig::requestHeaders(headers, sizeof(headers), config, TEST_DEVICE);
+    TEST_ASSERT_EQUAL(strlen(headers), length);
+    TEST_ASSERT_EQUAL_STRING("X-Device-Id: 0a0b0c0d0e0f\r\nIf-None-Match: \"3\"\r\n", headers);
+
+    // Nothing applied yet: always send the document
+    config.configVersion = 0;
+    RemoteConfig::requestHeaders(headers, sizeof(headers), config, TEST_DEVICE);
+    TEST_ASSERT_EQUAL_STRING("X-Device-Id: 0a0b0c0d0e0f\r\n", headers);
+
+    TEST_ASSERT_EQUAL(0, RemoteConfig::requestHeaders(headers, 16, config, TEST_DEVICE));
+    TEST_ASSERT_EQUAL_STRING("", headers);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_remote_config_applies_new_version);
+    RUN_TEST(test_remote_config_same_version_is_ignored);
+    RUN_TEST(test_remote_config_invalid_leaves_config_alone);
+    RUN_TEST(test_remote_config_skips_unknown_and_wifi_keys);
+    RUN_TEST(test_remote_config_request_headers);
+
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,117 @@
+#include <unity.h>
+#include "../lib/RetryScheduler.h"
+
+static const uint8_t TEST_BSSID[6] = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 };
+
+static RetryScheduler retry;
+
+void setUp(void) {
+    retry.reset();
+}
+
+void tearDown(void) {
+}
+
+void test_retry_initial_state(void) {
+    TEST_ASSERT_FALSE(retry.isPending());
+    TEST_ASSERT_FALSE(retry.isDue());
+    TEST_ASSERT_FALSE(retry.isDueAfter(100000));
+    TEST_ASSERT_FALSE(retry.useFastConnect());
+    TEST_ASSERT_EQUAL(0, retry.backoffSeconds());
+}
+
+void test_retry_backoff_doubles_up_to_ceiling(void) {
+    uint32_t expected = RETRY_BASE_SECONDS;
+    for (int i = 0; i < 20; i++) {
+        retry.recordFailure(RETRY_FAIL_UPLOAD, 0);
+        TEST_ASSERT_EQUAL(expected, retry.backoffSeconds());
+        expected = expected * 2 < RETRY_MAX_SECONDS ? expected * 2 : RETRY_MAX_SECONDS;
+    }
+    TEST_ASSERT_EQUAL(RETRY_MAX_SECONDS, retry.backoffSeconds());
+    TEST_ASSERT_EQUAL(20, retry.failures);
+}
+
+void test_retry_jitter_stays_within_bounds(void) {
+    uint32_t seed = 12345;
+    for (int i = 0; i < 12; i++) {
+        seed = seed * 1103515245 + 12345;
+        retry.recordFailure(RETRY_FAIL_UPLOAD, seed);
+        uint32_t backoff = retry.backoffSeconds();
+        TEST_ASSERT_TRUE(retry.waitSeconds >= backoff / 2);
+        TEST_ASSERT_TRUE(retry.waitSeconds <= backoff);
+    }
+
+    // Extremes of the random input hit both ends of the window
+    retry.reset();
+    retry.recordFailure(RETRY_FAIL_UPLOAD, 0);
+    TEST_ASSERT_EQUAL(RETRY_BASE_SECONDS / 2, retry.waitSeconds);
+    retry.reset();
+    retry.recordFailure(RETRY_FAIL_UPLOAD, RETRY_BASE_SECONDS / 2);
+    TEST_ASSERT_EQUAL(RETRY_BASE_SECONDS, retry.waitSeconds);
+}
+
+void test_retry_counts_down_sleep(void) {
+    retry.recordFailure(RETRY_FAIL_UPLOAD, RETRY_BASE_SECONDS / 2);   // Full 300 s
+    TEST_ASSERT_TRUE(retry.isPending());
+    TEST_ASSERT_FALSE(retry.isDue());
+    TEST_ASSERT_FALSE(retry.isDueAfter(120));
+    TEST_ASSERT_TRUE(retry.isDueAfter(300));
+
+    retry.elapse(120);
+    TEST_ASSERT_FALSE(retry.isDue());
+    TEST_ASSERT_TRUE(retry.isDueAfter(180));
+    retry.elapse(1800);
+    TEST_ASSERT_TRUE(retry.isDue());
+    TEST_ASSERT_EQUAL(0, retry.waitSeconds);
+}
+
+void test_retry_success_clears_backoff(void) {
+    retry.recordFailure(RETRY_FAIL_UPLOAD, 7);
+    retry.recordFailure(RETRY_FAIL_WIFI, 7);
+    TEST_ASSERT_EQUAL(RETRY_FAIL_WIFI, retry.lastFailure);
+
+    retry.recordSuccess();
+    TEST_ASSERT_FALSE(retry.isPending());
+    TEST_ASSERT_FALSE(retry.isDueAfter(100000));
+
+    // The next failure starts from the base backoff again
+    retry.recordFailure(RETRY_FAIL_UPLOAD, 0);
+    TEST_ASSERT_EQUAL(RETRY_BASE_SECONDS, retry.backoffSeconds());
+}
+
+void test_retry_wifi_failure_forces_scan(void) {
+    retry.rememberAccessPoint(TEST_BSSID, 6);
+    TEST_ASSERT_TRUE(retry.useFastConnect());
+    TEST_ASSERT_EQUAL_MEMORY(TEST_BSSID, retry.bssid, 6);
+
+    // The AP was reachable, the server was not: keep the fast path
+    retry.recordFailure(RETRY_FAIL_UPLOAD, 0);
+    TEST_ASSERT_TRUE(retry.useFastConnect());
+
+    retry.recordFailure(RETRY_FAIL_WIFI, 0);
+    TEST_ASSERT_FALSE(retry.useFastConnect());
+
+    // A successful scan makes the fast path available again
+    retry.rememberAccessPoint(TEST_BSSID, 11);
+    retry.recordSuccess();
+    TEST_ASSERT_TRUE(retry.useFastConnect());
+    TEST_ASSERT_EQUAL(11, retry.channel);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_retry_initial_state);
+    RUN_TEST(test_retry_backoff_doubles_up_to_ceiling);
+    RUN_TEST(test_retry_jitter_stays_within_bounds);
+    RUN_TEST(test_retry_counts_down_sleep);
+    RUN_TEST(test_retry_success_clears_backoff);
+    RUN_TEST(test_retry_wifi_failure_forces_scan);
+
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -21,6 +21,10 @@ void test_rtc_data_initialization(void) {
     TEST_ASSERT_EQUAL(0, rtc.recordCount);
     TEST_ASSERT_EQUAL(0, rtc.romWriteIndex);
     TEST_ASSERT_EQUAL(0, rtc.romRecordCount);
+    TEST_ASSERT_EQUAL(0, rtc.uploadSequence);
+    TEST_ASSERT_FALSE(rtc.retry.isPending());
+    TEST_ASSERT_EQUAL(0, rtc.clock);
+    TEST_ASSERT_EQUAL(0, rtc.dnsCache.hostHash);
 }
 
 void test_rtc_data_is_valid(void) {
@@ -56,6 +60,23 @@ void test_rtc_data_add_multiple_records(void) {
     TEST_ASSERT_EQUAL(10, testRtcData.recordCount);
 }
 
+// A measurement with its channel slots goes in whole or not at all
+void test_rtc_data_add_records_all_or_nothing(void) {
+    SensorRecord records[3];
+    for (int i = 0; i < 3; i++) {
+        records[i] = SensorRecord::create(20.0, 50.0, i * 60, 0);
+    }
+    for (int i = 0; i < RTC_BUFFER_SIZE - 2; i++) {
+        testRtcData.addRecord(records[0]);
+    }
+    
+    TEST_ASSERT_FALSE(testRtcData.addRecords(records, 3));
+    TEST_ASSERT_EQUAL(RTC_BUFFER_SIZE - 2, testRtcData.recordCount);
+    TEST_ASSERT_TRUE(testRtcData.addRecords(records + 1, 2));
+    TEST_ASSERT_TRUE(testRtcData.isBufferFull());
+    TEST_ASSERT_EQUAL(records[2].timestamp, testRtcData.buffer[RTC_BUFFER_SIZE - 1].timestamp);
+}
+
 void test_rtc_data_buffer_full(void) {
     // Initially not full
     TEST_ASSERT_FALSE(testRtcData.isBufferFull());
@@ -149,13 +170,18 @@ void test_rtc_data_rom_indices(void) {
 
 void test_rtc_data_buffer_size_constant(void) {
     // Verify buffer size matches constant
-    TEST_ASSERT_EQUAL(128, RTC_BUFFER_SIZE);
+    TEST_ASSERT_EQUAL(112, RTC_BUFFER_SIZE);
     
     // Verify buffer can hold that many records
     SensorRecord testBuffer[RTC_BUFFER_SIZE];
     TEST_ASSERT_EQUAL(sizeof(testRtcData.buffer), sizeof(testBuffer));
 }
 
+void test_rtc_data_fits_rtc_memory(void) {
+    // system_rtc_mem_write() rejects the whole object if it is larger
+    TEST_ASSERT_TRUE(sizeof(RTCData) <= RTC_USER_MEMORY);
+}
+
 void setup() {
     delay(2000);
     
@@ -165,12 +191,14 @@ void setup() {
     RUN_TEST(test_rtc_data_is_valid);
     RUN_TEST(test_rtc_data_add_record);
     RUN_TEST(test_rtc_data_add_multiple_records);
+    RUN_TEST(test_rtc_data_add_records_all_or_nothing);
     RUN_TEST(test_rtc_data_buffer_full);
     RUN_TEST(test_rtc_data_clear_buffer);
     RUN_TEST(test_rtc_data_save_and_load);
     RUN_TEST(test_rtc_data_load_invalid);
     RUN_TEST(test_rtc_data_rom_indices);
     RUN_TEST(test_rtc_data_buffer_size_constant);
+    RUN_TEST(test_rtc_data_fits_rtc_memory);
     
     UNITY_END();
 }
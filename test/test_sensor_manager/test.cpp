@@ -2,7 +2,37 @@
 #include "../lib/SensorManager.h"
 #include "../lib/SensorRecord.h"
 
+static char readOrder[8];
+
+// Sensor with fixed timing and readings; read() logs its tag in readOrder
+class FakeDriver : public SensorDriver {
+public:
+    char tag;
+    bool present;
+    uint16_t conversion;
+    Measurement values;
+    
+    FakeDriver(char tag, bool present, uint16_t conversion)
+        : tag(tag), present(present), conversion(conversion) {
+    }
+    
+    const char* name() const { return "fake"; }
+    uint8_t channels() const { return values.channels; }
+    uint16_t powerUpMs() const { return 1; }
+    bool start() { return present; }
+    uint16_t conversionMs() const { return conversion; }
+    
+    bool read(Measurement& measurement) {
+        size_t length = strlen(readOrder);
+        readOrder[length] = tag;
+        readOrder[length + 1] = '\0';
+        measurement = values;
+        return true;
+    }
+};
+
 void setUp(void) {
+    readOrder[0] = '\0';
 }
 
 void tearDown(void) {
@@ -43,6 +73,89 @@ void test_sensor_manager_create_record(void) {
     TEST_ASSERT_FLOAT_WITHIN(1.0, 65.0, record.getHumidity());
 }
 
+void test_sensor_manager_reads_in_conversion_order(void) {
+    SensorManager sensor(12);
+    FakeDriver probe('p', true, 188);
+    probe.values.set(SENSOR_PROBE_TEMPERATURE, 11.5);
+    FakeDriver absent('a', false, 10);
+    absent.values.set(SENSOR_PRESSURE, 1000);
+    FakeDriver climate('c', true, 16);
+    climate.values.set(SENSOR_TEMPERATURE, 21.0);
+    climate.values.set(SENSOR_HUMIDITY, 55.0);
+    TEST_ASSERT_TRUE(sensor.addDriver(&probe));
+    TEST_ASSERT_TRUE(sensor.addDriver(&absent));
+    TEST_ASSERT_TRUE(sensor.addDriver(&climate));
+    
+    Measurement measurement;
+    TEST_ASSERT_TRUE(sensor.takeMeasurement(measurement));
+    TEST_ASSERT_EQUAL_STRING("cp", readOrder);
+    TEST_ASSERT_EQUAL(SENSOR_TEMPERATURE | SENSOR_HUMIDITY | SENSOR_PROBE_TEMPERATURE, measurement.channels);
+    TEST_ASSERT_EQUAL_FLOAT(21.0, measurement.temperature);
+    TEST_ASSERT_EQUAL_FLOAT(11.5, measurement.probeTemperature);
+}
+
+void test_sensor_manager_first_driver_wins(void) {
+    SensorManager sensor(12);
+    FakeDriver preferred('s', true, 16);
+    preferred.values.set(SENSOR_TEMPERATURE, 20.0);
+    preferred.values.set(SENSOR_HUMIDITY, 40.0);
+    FakeDriver other('b', true, 10);
+    other.values.set(SENSOR_TEMPERATURE, 23.0);
+    other.values.set(SENSOR_HUMIDITY, 45.0);
+    other.values.set(SENSOR_PRESSURE, 1009.5);
+    sensor.addDriver(&preferred);
+    sensor.addDriver(&other);
+    
+    Measurement measurement;
+    TEST_ASSERT_TRUE(sensor.takeMeasurement(measurement));
+    TEST_ASSERT_EQUAL_STRING("bs", readOrder);
+    TEST_ASSERT_EQUAL_FLOAT(20.0, measurement.temperature);
+    TEST_ASSERT_EQUAL_FLOAT(40.0, measurement.humidity);
+    TEST_ASSERT_EQUAL_FLOAT(1009.5, measurement.pressure);
+}
+
+void test_sensor_manager_lone_probe_is_temperature(void) {
+    SensorManager sensor(12);
+    FakeDriver probe('p', true, 188);
+    probe.values.set(SENSOR_PROBE_TEMPERATURE, -3.25);
+    sensor.addDriver(&probe);
+    
+    Measurement measurement;
+    TEST_ASSERT_TRUE(sensor.takeMeasurement(measurement));
+    TEST_ASSERT_EQUAL(SENSOR_TEMPERATURE, measurement.channels);
+    TEST_ASSERT_EQUAL_FLOAT(-3.25, measurement.temperature);
+    
+    SensorRecord records[SENSOR_MAX_SLOTS];
+    TEST_ASSERT_EQUAL(1, SensorRecord::pack(measurement, 60, 0, records));
+    TEST_ASSERT_EQUAL(SENSOR_NO_HUMIDITY, records[0].humidity);
+}
+
+void test_sensor_manager_rejects_missing_or_bad_readings(void) {
+    SensorManager sensor(12);
+    Measurement measurement;
+    TEST_ASSERT_FALSE(sensor.takeMeasurement(measurement));   // No drivers
+    
+    FakeDriver absent('a', false, 10);
+    sensor.addDriver(&absent);
+    TEST_ASSERT_FALSE(sensor.takeMeasurement(measurement));
+    TEST_ASSERT_EQUAL_STRING("", readOrder);
+    
+    // Implausible pressure is dropped, the rest is kept
+    FakeDriver barometer('b', true, 10);
+    barometer.values.set(SENSOR_TEMPERATURE, 19.0);
+    barometer.values.set(SENSOR_PRESSURE, 20.0);
+    sensor.addDriver(&barometer);
+    TEST_ASSERT_TRUE(sensor.takeMeasurement(measurement));
+    TEST_ASSERT_EQUAL(SENSOR_TEMPERATURE, measurement.channels);
+    
+    barometer.values.temperature = 120.0;
+    TEST_ASSERT_FALSE(sensor.takeMeasurement(measurement));
+    
+    TEST_ASSERT_TRUE(sensor.addDriver(&absent));
+    TEST_ASSERT_TRUE(sensor.addDriver(&absent));
+    TEST_ASSERT_FALSE(sensor.addDriver(&absent));   // SENSOR_MAX_DRIVERS
+}
+
 void setup() {
     delay(2000);
     
@@ -52,6 +165,10 @@ void setup() {
     RUN_TEST(test_sensor_manager_validate_readings_invalid_temp);
     RUN_TEST(test_sensor_manager_validate_readings_invalid_humidity);
     RUN_TEST(test_sensor_manager_create_record);
+    RUN_TEST(test_sensor_manager_reads_in_conversion_order);
+    RUN_TEST(test_sensor_manager_first_driver_wins);
+    RUN_TEST(test_sensor_manager_lone_probe_is_temperature);
+    RUN_TEST(test_sensor_manager_rejects_missing_or_bad_readings);
     
     UNITY_END();
 }
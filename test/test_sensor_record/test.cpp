@@ -1,5 +1,7 @@
 #include <unity.h>
 #include "../lib/SensorRecord.h"
+#include "../lib/LineProtocol.h"
+#include <chrono>
 
 void setUp(void) {
 }
@@ -111,6 +113,14 @@ void test_sensor_record_influx_line_protocol(void) {
     TEST_ASSERT_TRUE(line.indexOf("3600000000000") >= 0);
 }
 
+void test_sensor_record_influx_line_minute_precision(void) {
+    SensorRecord record = SensorRecord::create(22.0, 65.0, 3600, 0);
+    
+    String line = record.toInfluxLine("environment", 0, PRECISION_M);
+    
+    TEST_ASSERT_EQUAL_STRING("environment temperature=22,humidity=65 60\n", line.c_str());
+}
+
 void test_sensor_record_minutes_overflow(void) {
     uint32_t maxMinutes = 65535;
     uint32_t maxSeconds = maxMinutes * 60;
@@ -120,6 +130,151 @@ void test_sensor_record_minutes_overflow(void) {
     TEST_ASSERT_EQUAL(65535, record.timestamp);
 }
 
+void test_sensor_record_bulk_decode_matches_getters(void) {
+    const size_t count = 300;
+    SensorRecord records[count];
+    for (size_t i = 0; i < count; i++) {
+        records[i].timestamp = 65535 - i * 200;
+        records[i].temperature = i % 256;
+        records[i].humidity = i % 101;
+    }
+    
+    uint32_t timestamps[count];
+    int16_t temperatures[count];
+    uint8_t humidities[count];
+    SensorRecord::decode(records, count, 1700000000, timestamps, temperatures, humidities);
+    
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(records[i].getTimestampSeconds(1700000000), timestamps[i]);
+        TEST_ASSERT_EQUAL((int)records[i].getTemperature(), temperatures[i]);
+        TEST_ASSERT_EQUAL((int)records[i].getHumidity(), humidities[i]);
+    }
+}
+
+void test_sensor_record_encode_point_matches_record(void) {
+    char expected[LineProtocol::MAX_LINE];
+    char actual[LineProtocol::MAX_LINE];
+    TimePrecision precisions[] = { PRECISION_NS, PRECISION_S, PRECISION_M };
+    
+    for (int t = 0; t < 256; t += 5) {
+        SensorRecord record;
+        record.timestamp = 1234;
+        record.temperature = t;
+        record.humidity = t % 101;
+        
+        for (size_t p = 0; p < 3; p++) {
+            size_t expectedLength = LineProtocol::encodeRecord(expected, sizeof(expected), "environment",
+                                                               record, 0, precisions[p]);
+            size_t actualLength = LineProtocol::encodePoint(actual, sizeof(actual), "environment",
+                                                            record.getTimestampSeconds(0),
+                                                            (int16_t)record.getTemperature(),
+                                                            record.humidity, precisions[p]);
+            TEST_ASSERT_EQUAL(expectedLength, actualLength);
+            TEST_ASSERT_EQUAL_STRING(expected, actual);
+        }
+    }
+}
+
+// Adds up a decoded batch, so neither loop below can be optimised away
+static uint32_t sumBatch(const uint32_t* timestamps, const int16_t* temperatures,
+                         const uint8_t* humidities, size_t count) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += timestamps[i] + (uint16_t)temperatures[i] + humidities[i];
+    }
+    return sum;
+}
+
+// Not a pass/fail check: reports the cost of decode() against the
+// per-field getters over the same records. Line formatting is left out
+// of both loops, it would dwarf the difference.
+void test_sensor_record_decode_benchmark(void) {
+    const size_t count = 100000;
+    const size_t batch = 32;
+    const int rounds = 20;
+    const uint32_t offset = 1704067200UL;
+    SensorRecord* records = new SensorRecord[count];
+    for (size_t i = 0; i < count; i++) {
+        records[i].timestamp = i % 65536;
+        records[i].temperature = i % 256;
+        records[i].humidity = i % 101;
+    }
+    uint32_t timestamps[batch];
+    int16_t temperatures[batch];
+    uint8_t humidities[batch];
+    uint32_t getterSum = 0;
+    uint32_t decodeSum = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t b = 0; b < count; b += batch) {
+            for (size_t i = 0; i < batch; i++) {
+                const SensorRecord& record = records[b + i];
+                timestamps[i] = record.getTimestampSeconds(offset);
+                temperatures[i] = (int16_t)record.getTemperature();
+                humidities[i] = record.humidity;
+            }
+            getterSum += sumBatch(timestamps, temperatures, humidities, batch);
+        }
+    }
+    auto getters = std::chrono::steady_clock::now() - start;
+    
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t b = 0; b < count; b += batch) {
+            SensorRecord::decode(records + b, batch, offset, timestamps, temperatures, humidities);
+            decodeSum += sumBatch(timestamps, temperatures, humidities, batch);
+        }
+    }
+    auto decoded = std::chrono::steady_clock::now() - start;
+    
+    delete[] records;
+    TEST_ASSERT_EQUAL_UINT32(getterSum, decodeSum);   // Same values either way
+    
+    const double total = (double)count * rounds;
+    char message[96];
+    snprintf(message, sizeof(message), "getters %.2f ns/record, decode() %.2f ns/record",
+             std::chrono::duration<double, std::nano>(getters).count() / total,
+             std::chrono::duration<double, std::nano>(decoded).count() / total);
+    TEST_MESSAGE(message);
+}
+
+void test_sensor_record_pack_channel_slots(void) {
+    SensorRecord records[SENSOR_MAX_SLOTS];
+    
+    // Temperature and humidity only: a single record, as before
+    Measurement aht;
+    aht.set(SENSOR_TEMPERATURE, 21.4);
+    aht.set(SENSOR_HUMIDITY, 48.0);
+    aht.set(SENSOR_TEMPERATURE, 30.0);   // First driver wins
+    TEST_ASSERT_EQUAL(1, SensorRecord::pack(aht, 3600, 0, records));
+    TEST_ASSERT_EQUAL(60, records[0].timestamp);
+    TEST_ASSERT_EQUAL_FLOAT(21.0, records[0].getTemperature());
+    TEST_ASSERT_EQUAL(48, records[0].humidity);
+    
+    Measurement bmp;
+    bmp.set(SENSOR_TEMPERATURE, 18.0);
+    bmp.set(SENSOR_PRESSURE, 1002.46);
+    bmp.set(SENSOR_PROBE_TEMPERATURE, -7.125);
+    TEST_ASSERT_EQUAL(3, SensorRecord::pack(bmp, 7200, 0, records));
+    TEST_ASSERT_FALSE(records[0].hasHumidity());
+    TEST_ASSERT_TRUE(isnan(records[0].getHumidity()));
+    TEST_ASSERT_TRUE(records[0].isValid());
+    TEST_ASSERT_EQUAL(2, SensorRecord::countSlots(records, 3));
+    TEST_ASSERT_EQUAL(1, SensorRecord::countSlots(records, 2));
+    
+    TEST_ASSERT_TRUE(records[1].isChannelSlot());
+    TEST_ASSERT_TRUE(records[1].isValid());
+    TEST_ASSERT_EQUAL(SENSOR_PRESSURE, records[1].getChannel());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1002.5, records[1].getChannelValue());
+    TEST_ASSERT_EQUAL(SENSOR_PROBE_TEMPERATURE, records[2].getChannel());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, -7.13, records[2].getChannelValue());
+    
+    // Unknown channel bits are not valid slots
+    records[2].temperature = 0x40;
+    TEST_ASSERT_FALSE(records[2].isValid());
+}
+
 void setup() {
     delay(2000);
     
@@ -134,7 +289,12 @@ void setup() {
     RUN_TEST(test_sensor_record_humidity_range);
     RUN_TEST(test_sensor_record_is_valid);
     RUN_TEST(test_sensor_record_influx_line_protocol);
+    RUN_TEST(test_sensor_record_influx_line_minute_precision);
     RUN_TEST(test_sensor_record_minutes_overflow);
+    RUN_TEST(test_sensor_record_bulk_decode_matches_getters);
+    RUN_TEST(test_sensor_record_encode_point_matches_record);
+    RUN_TEST(test_sensor_record_pack_channel_slots);
+    RUN_TEST(test_sensor_record_decode_benchmark);
     
     UNITY_END();
 }
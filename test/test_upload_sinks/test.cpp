@@ -0,0 +1,217 @@
+#include <unity.h>
+#include "../native_mocks/UdpStubReceiver.h"
+#include "../native_mocks/MqttStubBroker.h"
+#include "../lib/UdpLineSink.h"
+#include "../lib/MqttLineSink.h"
+#include "../lib/Config.h"
+#include "../lib/SensorRecord.h"
+
+static Config testConfig;
+static const uint8_t TEST_DEVICE[6] = { 0x5c, 0xcf, 0x7f, 0x01, 0xab, 0xef };
+
+void setUp(void) {
+    testConfig.setDefaults();
+    strcpy(testConfig.influxServer, "127.0.0.1");
+    strcpy(testConfig.influxMeasurement, "environment");
+    testConfig.magic = CONFIG_MAGIC;
+}
+
+void tearDown(void) {
+}
+
+// Every line written, in order, as the shared encoder produces it
+static std::string writeRecords(UploadSink& sink, int count) {
+    std::string expected;
+    for (int i = 0; i < count; i++) {
+        SensorRecord record = SensorRecord::create(15.0 + (i % 10), 40.0 + (i % 40), i * 60, 0);
+        TEST_ASSERT_TRUE(sink.writeSensorRecord(record, 0));
+        expected += record.toInfluxLine(sink.getSeriesKey(), 0, sink.getPrecision()).c_str();
+    }
+    return expected;
+}
+
+void test_udp_sink_rejects_invalid_config(void) {
+    UdpLineSink sink;
+    Config invalid;
+
+    TEST_ASSERT_FALSE(sink.begin(nullptr));
+    TEST_ASSERT_FALSE(sink.begin(&invalid));
+}
+
+void test_udp_sink_sends_whole_lines(void) {
+    UdpStubReceiver receiver;
+    testConfig.influxPort = receiver.start();
+    testConfig.uploadSink = UPLOAD_SINK_INFLUX_UDP;
+
+    UdpLineSink sink;
+    sink.setDeviceId(TEST_DEVICE);
+    TEST_ASSERT_TRUE(sink.begin(&testConfig));
+    TEST_ASSERT_EQUAL_STRING("environment,device=5ccf7f01abef", sink.getSeriesKey());
+    std::string expected = writeRecords(sink, 50);
+    TEST_ASSERT_TRUE(sink.flush());
+    sink.close();
+
+    TEST_ASSERT_TRUE(sink.getPacketsSent() > 1);
+    TEST_ASSERT_TRUE(receiver.waitForDatagrams(sink.getPacketsSent()));
+
+    std::vector<std::string> datagrams = receiver.datagrams();
+    std::string joined;
+    for (size_t i = 0; i < datagrams.size(); i++) {
+        TEST_ASSERT_TRUE(datagrams[i].size() <= UdpLineSink::PACKET_SIZE);
+        TEST_ASSERT_EQUAL('\n', datagrams[i][datagrams[i].size() - 1]);
+        joined += datagrams[i];
+    }
+    TEST_ASSERT_TRUE(expected == joined);
+}
+
+void test_udp_sink_battery_line(void) {
+    UdpStubReceiver receiver;
+    testConfig.influxPort = receiver.start();
+
+    strcpy(testConfig.location, "garden");
+
+    UdpLineSink sink;
+    sink.setDeviceId(TEST_DEVICE);
+    sink.begin(&testConfig);
+    TEST_ASSERT_TRUE(sink.writeBatteryVoltage(3.9, 7, 1704067200));
+    TEST_ASSERT_TRUE(sink.flush());
+
+    TEST_ASSERT_TRUE(receiver.waitForDatagrams(1));
+    TEST_ASSERT_TRUE(receiver.datagrams()[0].find(
+        "environment,device=5ccf7f01abef,location=garden battery_voltage=3.9,upload_seq=7i 1704067200") == 0);
+}
+
+// Slots become fields of their measurement, also across decode batches
+void test_udp_sink_channel_fields(void) {
+    UdpStubReceiver receiver;
+    testConfig.influxPort = receiver.start();
+    testConfig.uploadSink = UPLOAD_SINK_INFLUX_UDP;
+
+    Measurement measurement;
+    measurement.set(SENSOR_TEMPERATURE, 21.0);
+    measurement.set(SENSOR_HUMIDITY, 45.0);
+    SensorRecord records[UploadSink::DECODE_BATCH + SENSOR_MAX_SLOTS];
+    size_t count = SensorRecord::pack(measurement, 0, 0, records);
+    size_t lines = 1;
+    measurement.set(SENSOR_PRESSURE, 1013.2);
+    while (count + 2 <= UploadSink::DECODE_BATCH + 1) {
+        count += SensorRecord::pack(measurement, lines++ * 60, 0, records + count);
+    }
+    TEST_ASSERT_TRUE(records[UploadSink::DECODE_BATCH].isChannelSlot());
+
+    UdpLineSink sink;
+    sink.setDeviceId(TEST_DEVICE);
+    TEST_ASSERT_TRUE(sink.begin(&testConfig));
+    TEST_ASSERT_TRUE(sink.writeSensorRecords(records, count, 0));
+    TEST_ASSERT_TRUE(sink.flush());
+    sink.close();
+
+    TEST_ASSERT_TRUE(receiver.waitForDatagrams(sink.getPacketsSent()));
+    std::vector<std::string> datagrams = receiver.datagrams();
+    std::string joined;
+    for (size_t i = 0; i < datagrams.size(); i++) {
+        joined += datagrams[i];
+    }
+    size_t written = 0;
+    for (size_t pos = joined.find('\n'); pos != std::string::npos; pos = joined.find('\n', pos + 1)) {
+        written++;
+    }
+    TEST_ASSERT_EQUAL(lines, written);
+    // Nanosecond timestamps
+    TEST_ASSERT_TRUE(joined.find("environment,device=5ccf7f01abef temperature=21,humidity=45 0000000000\n") == 0);
+    std::string last = "temperature=21,humidity=45,pressure=1013.2 " + std::to_string((lines - 1) * 60) +
+                       "000000000\n";
+    TEST_ASSERT_TRUE(joined.find(last) != std::string::npos);
+}
+
+void test_mqtt_sink_publishes_lines(void) {
+    MqttStubBroker broker;
+    testConfig.influxPort = broker.start();
+
+    MqttLineSink sink;
+    sink.setDeviceId(TEST_DEVICE);
+    TEST_ASSERT_TRUE(sink.begin(&testConfig));
+    TEST_ASSERT_TRUE(sink.validateConnection());
+    std::string expected = writeRecords(sink, 50);
+    TEST_ASSERT_TRUE(sink.flush());
+    sink.close();
+
+    std::vector<StubMessage> messages = broker.messages();
+    TEST_ASSERT_EQUAL(sink.getMessagesPublished(), messages.size());
+    TEST_ASSERT_TRUE(messages.size() > 1);
+
+    std::string joined;
+    for (size_t i = 0; i < messages.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING("meteo/environment", messages[i].topic.c_str());
+        TEST_ASSERT_TRUE(messages[i].payload.size() <= MqttLineSink::PAYLOAD_SIZE);
+        joined += messages[i].payload;
+    }
+    TEST_ASSERT_TRUE(expected == joined);
+
+    for (int i = 0; i < 200 && broker.disconnectCount() == 0; i++) {
+        usleep(5000);
+    }
+    TEST_ASSERT_EQUAL(1, broker.disconnectCount());
+}
+
+void test_mqtt_sink_credentials(void) {
+    MqttStubBroker broker;
+    testConfig.influxPort = broker.start();
+    strcpy(testConfig.influxUser, "station");
+    strcpy(testConfig.influxPass, "secret");
+
+    MqttLineSink sink;
+    sink.begin(&testConfig);
+    TEST_ASSERT_TRUE(sink.validateConnection());
+    sink.close();
+
+    TEST_ASSERT_EQUAL_STRING("meteo-native", broker.clientId.c_str());
+    TEST_ASSERT_EQUAL_STRING("station", broker.username.c_str());
+    TEST_ASSERT_EQUAL_STRING("secret", broker.password.c_str());
+}
+
+void test_mqtt_sink_connection_refused(void) {
+    MqttStubBroker broker;
+    broker.connackCode = 5;   // Not authorized
+    testConfig.influxPort = broker.start();
+
+    MqttLineSink sink;
+    sink.begin(&testConfig);
+
+    TEST_ASSERT_FALSE(sink.validateConnection());
+    TEST_ASSERT_TRUE(sink.getLastError().indexOf("refused") >= 0);
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_AUTH, sink.getErrorKind());
+}
+
+void test_mqtt_sink_no_broker(void) {
+    MqttStubBroker broker;
+    testConfig.influxPort = broker.start();
+    broker.stop();
+
+    MqttLineSink sink;
+    sink.begin(&testConfig);
+    writeRecords(sink, 1);
+
+    TEST_ASSERT_FALSE(sink.flush());
+    TEST_ASSERT_EQUAL(UPLOAD_ERROR_CONNECT, sink.getErrorKind());
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_udp_sink_rejects_invalid_config);
+    RUN_TEST(test_udp_sink_sends_whole_lines);
+    RUN_TEST(test_udp_sink_battery_line);
+    RUN_TEST(test_udp_sink_channel_fields);
+    RUN_TEST(test_mqtt_sink_publishes_lines);
+    RUN_TEST(test_mqtt_sink_credentials);
+    RUN_TEST(test_mqtt_sink_connection_refused);
+    RUN_TEST(test_mqtt_sink_no_broker);
+
+    UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,139 @@
+// meteo-export: decodes a backlog downloaded from a station's config
+// portal (GET /export, format in lib/BinaryProtocol.h) into CSV, or into
+// line protocol that can be written to InfluxDB as it is.
+//
+// Build (Linux/macOS, from the repository root):
+//   g++ -std=c++11 -O2 -I lib -o meteo-export tools/export/meteo_export.cpp lib/BinaryProtocol.cpp
+//
+// Run (while connected to the station's access point):
+//   curl -C - -o backlog.bin http://192.168.4.1/export
+//   ./meteo-export backlog.bin > backlog.csv
+//   ./meteo-export --line environment backlog.bin > backlog.lp
+//
+// curl -C - resumes an interrupted download with a Range request. A
+// truncated file still decodes; the missing records are reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "BinaryProtocol.h"
+
+static void usage() {
+    fprintf(stderr, "usage: meteo-export [--line <measurement>] [file]\n"
+                    "Reads the export from stdin when no file is given.\n");
+}
+
+int main(int argc, char** argv) {
+    const char* measurement = nullptr;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--line") == 0 && i + 1 < argc) {
+            measurement = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage();
+            return 2;
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    FILE* file = path && strcmp(path, "-") != 0 ? fopen(path, "rb") : stdin;
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    if (file != stdin) {
+        fclose(file);
+    }
+
+    BinaryBlock block;
+    if (BinaryBlockDecoder::decodeExportHeader(data.data(), data.size(), block) == 0) {
+        fprintf(stderr, "meteo-export: not a station export\n");
+        return 1;
+    }
+
+    size_t available = (data.size() - BINARY_HEADER_SIZE) / BINARY_EXPORT_RECORD_SIZE;
+    size_t count = available < block.count ? available : block.count;
+
+    char deviceId[13];
+    BinaryBlockDecoder::formatDeviceId(deviceId, block.deviceId);
+    fprintf(stderr, "meteo-export: device %s, %u records\n", deviceId, (unsigned int)block.count);
+    if (count < block.count) {
+        fprintf(stderr, "meteo-export: truncated, %u records missing (resume the download with curl -C -)\n",
+                (unsigned int)(block.count - count));
+    }
+
+    std::vector<BinaryRecord> records(count);
+    uint8_t channels = 0;
+    for (size_t i = 0; i < count; i++) {
+        records[i] = BinaryBlockDecoder::decodeExportRecord(
+            data.data() + BINARY_HEADER_SIZE + i * BINARY_EXPORT_RECORD_SIZE);
+        if (records[i].humidity == SENSOR_CHANNEL_SLOT) {
+            channels |= records[i].temperature & SENSOR_OPTIONAL_CHANNELS;
+        }
+    }
+
+    // One row per measurement; its channel slots follow it
+    if (!measurement) {
+        printf("time,temperature,humidity");
+        for (uint8_t channel = SENSOR_PRESSURE; channel & SENSOR_OPTIONAL_CHANNELS; channel <<= 1) {
+            if (channels & channel) {
+                printf(",%s", sensorChannelName(channel));
+            }
+        }
+        printf("\n");
+    }
+    for (size_t i = 0; i < count; i++) {
+        const BinaryRecord& record = records[i];
+        if (record.humidity == SENSOR_CHANNEL_SLOT) {
+            continue;
+        }
+        size_t slots = 0;
+        while (i + slots + 1 < count && records[i + slots + 1].humidity == SENSOR_CHANNEL_SLOT) {
+            slots++;
+        }
+        if (measurement) {
+            char line[256];
+            if (BinaryBlockDecoder::formatRecordLine(line, sizeof(line), measurement, block, record,
+                                                     &records[i + 1], slots) > 0) {
+                fputs(line, stdout);
+            }
+            continue;
+        }
+
+        printf("%u,%d,", (unsigned int)BinaryBlockDecoder::timestampSeconds(block, record),
+               BinaryBlockDecoder::temperature(record));
+        if (record.humidity <= 100) {
+            printf("%u", (unsigned int)record.humidity);
+        }
+        for (uint8_t channel = SENSOR_PRESSURE; channel & SENSOR_OPTIONAL_CHANNELS; channel <<= 1) {
+            if (!(channels & channel)) {
+                continue;
+            }
+            printf(",");
+            for (size_t s = 1; s <= slots; s++) {
+                if (records[i + s].temperature == channel) {
+                    int16_t value = (int16_t)records[i + s].timestamp;
+                    int scale = sensorChannelDecimals(channel) == 2 ? 100 : 10;
+                    printf("%s%d.%0*d", value < 0 ? "-" : "", abs(value) / scale,
+                           sensorChannelDecimals(channel), abs(value) % scale);
+                }
+            }
+        }
+        printf("\n");
+    }
+    return count < block.count ? 3 : 0;
+}
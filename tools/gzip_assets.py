@@ -0,0 +1,40 @@
+"""Writes a .gz copy of every web asset in data/ for the LittleFS image.
+
+WiFiManager sends the .gz variant with Content-Encoding: gzip to clients
+that accept it, which cuts the config page to about a third over the
+soft-AP link. The plain files stay in the image for the other clients.
+
+Runs as a PlatformIO extra script before buildfs/uploadfs, or by hand:
+    python3 tools/gzip_assets.py [data_dir]
+"""
+
+import gzip
+import os
+import sys
+
+EXTENSIONS = (".html", ".css", ".js", ".json", ".svg")
+
+
+def compress_assets(data_dir):
+    for name in sorted(os.listdir(data_dir)):
+        if not name.endswith(EXTENSIONS):
+            continue
+        source = os.path.join(data_dir, name)
+        target = source + ".gz"
+        if os.path.exists(target) and os.path.getmtime(target) >= os.path.getmtime(source):
+            continue
+        with open(source, "rb") as f:
+            content = f.read()
+        # mtime=0 keeps the output identical for identical input
+        with open(target, "wb") as f:
+            f.write(gzip.compress(content, compresslevel=9, mtime=0))
+        print("gzip %s: %d -> %d bytes" % (name, len(content), os.path.getsize(target)))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+except NameError:
+    compress_assets(sys.argv[1] if len(sys.argv) > 1 else "data")
+else:
+    if any(t in ("buildfs", "uploadfs", "uploadfsota") for t in COMMAND_LINE_TARGETS):  # noqa: F821
+        compress_assets(env.subst("$PROJECT_DATA_DIR"))  # noqa: F821
@@ -0,0 +1,422 @@
+#include "Aggregator.h"
+#include "HttpConnection.h"
+#include "BinaryProtocol.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t monotonicSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(Clock::now().time_since_epoch()).count();
+}
+
+AggregatorOptions::AggregatorOptions()
+    : influxPort(8086), measurement("environment"), batchSize(5000), flushMs(200), lingerMs(5), writers(4),
+      dedupHours(72), maxPending(500000), ackTimeoutMs(10000) {
+}
+
+Aggregator::Aggregator(const AggregatorOptions& opts)
+    : options(opts), running(false), requests(0), pointsReceived(0), duplicates(0),
+      pointsWritten(0), batches(0), writeFailures(0) {
+}
+
+Aggregator::~Aggregator() {
+    stop();
+}
+
+void Aggregator::start() {
+    running = true;
+    for (int i = 0; i < options.writers; i++) {
+        writerThreads.push_back(std::thread(&Aggregator::writerLoop, this));
+    }
+}
+
+void Aggregator::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    queueReady.notify_all();
+    for (size_t i = 0; i < writerThreads.size(); i++) {
+        writerThreads[i].join();
+    }
+    writerThreads.clear();
+}
+
+bool Aggregator::toSeconds(const std::string& timestamp, const std::string& precision, uint32_t& seconds) {
+    if (timestamp.empty() || timestamp.size() > 19 ||
+        timestamp.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    unsigned long long value = strtoull(timestamp.c_str(), nullptr, 10);
+
+    if (precision.empty() || precision == "n" || precision == "ns") {
+        value /= 1000000000ULL;
+    } else if (precision == "u" || precision == "us") {
+        value /= 1000000ULL;
+    } else if (precision == "ms") {
+        value /= 1000ULL;
+    } else if (precision == "m") {
+        value *= 60;
+    } else if (precision == "h") {
+        value *= 3600;
+    } else if (precision != "s") {
+        return false;
+    }
+
+    if (value > 0xFFFFFFFFULL) {
+        return false;
+    }
+    seconds = (uint32_t)value;
+    return true;
+}
+
+bool Aggregator::parseLine(const std::string& raw, const std::string& precision, Point& point) const {
+    std::string line = raw;
+    while (!line.empty() && isspace((unsigned char)line[line.size() - 1])) {
+        line.erase(line.size() - 1);
+    }
+
+    // Series ends at the first unescaped space
+    size_t seriesEnd = 0;
+    while ((seriesEnd = line.find(' ', seriesEnd)) != std::string::npos &&
+           seriesEnd > 0 && line[seriesEnd - 1] == '\\') {
+        seriesEnd++;
+    }
+    if (seriesEnd == std::string::npos || seriesEnd == 0) {
+        return false;
+    }
+    std::string series = line.substr(0, seriesEnd);
+
+    // Station lines carry no string fields, so the last space starts the timestamp
+    std::string fields = line.substr(seriesEnd + 1);
+    std::string timestamp;
+    size_t lastSpace = fields.rfind(' ');
+    if (lastSpace != std::string::npos && fields.find('=', lastSpace) == std::string::npos) {
+        timestamp = fields.substr(lastSpace + 1);
+        fields.erase(lastSpace);
+    }
+
+    size_t equals = fields.find('=');
+    if (equals == std::string::npos || equals == 0) {
+        return false;
+    }
+
+    uint32_t seconds;
+    if (timestamp.empty()) {
+        seconds = (uint32_t)time(nullptr);
+    } else if (!toSeconds(timestamp, precision, seconds)) {
+        return false;
+    }
+
+    char ts[16];
+    snprintf(ts, sizeof(ts), "%u", seconds);
+    point.line = series + " " + fields + " " + ts + "\n";
+    point.key = series + " " + fields.substr(0, equals) + " " + ts;
+    return true;
+}
+
+int Aggregator::ingestBinary(const std::string& body, std::string& error) {
+    requests++;
+
+    std::vector<Point> points;
+    const uint8_t* data = (const uint8_t*)body.data();
+    size_t pos = 0;
+    BinaryBlock block;
+    char line[256];
+    // From the body's location block, for the station that sent it
+    char location[BINARY_MAX_LOCATION + 1] = "";
+    uint8_t locationDevice[6] = {};
+
+    while (pos < body.size()) {
+        size_t used = BinaryBlockDecoder::decode(data + pos, body.size() - pos, block);
+        if (used == 0) {
+            char message[64];
+            snprintf(message, sizeof(message), "invalid block at byte %u", (unsigned int)pos);
+            error = message;
+            return 400;
+        }
+        pos += used;
+
+        if (block.type == BINARY_BLOCK_LOCATION) {
+            memcpy(location, block.location, sizeof(location));
+            memcpy(locationDevice, block.deviceId, sizeof(locationDevice));
+            continue;
+        }
+        const char* tag = memcmp(block.deviceId, locationDevice, 6) == 0 ? location : nullptr;
+
+        Point point;
+        if (block.type == BINARY_BLOCK_BATTERY) {
+            size_t length = BinaryBlockDecoder::formatBatteryLine(line, sizeof(line),
+                                                                  options.measurement.c_str(), block, tag);
+            if (!parseLine(std::string(line, length), "s", point)) {
+                error = "unable to convert battery block";
+                return 400;
+            }
+            points.push_back(point);
+            continue;
+        }
+        for (uint16_t i = 0; i < block.count; i++) {
+            // Channel slots become fields of the measurement before them
+            if (block.records[i].humidity == SENSOR_CHANNEL_SLOT) {
+                continue;
+            }
+            uint16_t slots = 0;
+            while (i + slots + 1 < block.count && block.records[i + slots + 1].humidity == SENSOR_CHANNEL_SLOT) {
+                slots++;
+            }
+            size_t length = BinaryBlockDecoder::formatRecordLine(line, sizeof(line), options.measurement.c_str(),
+                                                                 block, block.records[i],
+                                                                 block.records + i + 1, slots, tag);
+            if (!parseLine(std::string(line, length), "s", point)) {
+                error = "unable to convert record block";
+                return 400;
+            }
+            points.push_back(point);
+        }
+    }
+    return submit(points, error);
+}
+
+int Aggregator::ingestLines(const std::string& body, const std::string& precision, std::string& error) {
+    requests++;
+
+    std::vector<Point> points;
+    size_t start = 0;
+    while (start < body.size()) {
+        size_t end = body.find('\n', start);
+        if (end == std::string::npos) {
+            end = body.size();
+        }
+        std::string raw = body.substr(start, end - start);
+        start = end + 1;
+
+        if (raw.empty() || raw[0] == '#') {
+            continue;
+        }
+        Point point;
+        if (!parseLine(raw, precision, point)) {
+            error = "unable to parse '" + raw + "'";
+            return 400;
+        }
+        points.push_back(point);
+    }
+    return submit(points, error);
+}
+
+int Aggregator::submit(std::vector<Point>& points, std::string& error) {
+    pointsReceived += points.size();
+
+    std::vector<Point> fresh;
+    {
+        std::lock_guard<std::mutex> lock(seenMutex);
+
+        int64_t horizon = monotonicSeconds() - (int64_t)options.dedupHours * 3600;
+        while (!seenOrder.empty() && seenOrder.front().first < horizon) {
+            seen.erase(seenOrder.front().second);
+            seenOrder.pop_front();
+        }
+
+        for (size_t i = 0; i < points.size(); i++) {
+            if (seen.count(points[i].key)) {
+                duplicates++;
+            } else {
+                fresh.push_back(points[i]);
+            }
+        }
+    }
+
+    if (fresh.empty()) {
+        return 204;
+    }
+
+    std::shared_ptr<Ticket> ticket(new Ticket());
+    ticket->remaining = fresh.size();
+    ticket->failed = false;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!running || queue.size() + fresh.size() > options.maxPending) {
+            error = "ingest queue full, retry later";
+            return 503;
+        }
+        for (size_t i = 0; i < fresh.size(); i++) {
+            Entry entry;
+            entry.line.swap(fresh[i].line);
+            entry.key.swap(fresh[i].key);
+            entry.ticket = ticket;
+            queue.push_back(entry);
+        }
+    }
+    queueReady.notify_one();
+
+    std::unique_lock<std::mutex> lock(ticket->mutex);
+    bool finished = ticket->done.wait_for(lock, std::chrono::milliseconds(options.ackTimeoutMs),
+                                          [&ticket] { return ticket->remaining == 0; });
+    if (!finished) {
+        // Points may still be written; the station's retry is deduplicated
+        error = "timed out waiting for InfluxDB";
+        return 504;
+    }
+    if (ticket->failed) {
+        error = "InfluxDB write failed";
+        return 502;
+    }
+    return 204;
+}
+
+void Aggregator::writerLoop() {
+    HttpConnection* influx = nullptr;
+
+    while (true) {
+        std::vector<Entry> batch;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return !running || !queue.empty(); });
+
+            // Let a partial batch fill up while uploads keep arriving,
+            // for at most flushMs
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(options.flushMs);
+            while (running && queue.size() < options.batchSize) {
+                Clock::time_point idle = std::min(deadline, Clock::now() + std::chrono::milliseconds(options.lingerMs));
+                if (queueReady.wait_until(lock, idle) == std::cv_status::timeout) {
+                    break;
+                }
+            }
+
+            if (queue.empty()) {
+                if (!running) {
+                    break;
+                }
+                continue;
+            }
+
+            size_t count = std::min(queue.size(), options.batchSize);
+            batch.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                batch.push_back(Entry());
+                batch.back().line.swap(queue.front().line);
+                batch.back().key.swap(queue.front().key);
+                batch.back().ticket.swap(queue.front().ticket);
+                queue.pop_front();
+            }
+        }
+        // More work may be queued for the other writers
+        queueReady.notify_one();
+
+        std::string body;
+        for (size_t i = 0; i < batch.size(); i++) {
+            body += batch[i].line;
+        }
+
+        std::string reply;
+        bool ok = writeBatch(influx, body, reply);
+        if (ok) {
+            remember(batch);
+            pointsWritten += batch.size();
+            batches++;
+        } else {
+            writeFailures++;
+            fprintf(stderr, "InfluxDB write of %u points failed: %s\n",
+                    (unsigned int)batch.size(), reply.c_str());
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            Ticket& ticket = *batch[i].ticket;
+            std::lock_guard<std::mutex> lock(ticket.mutex);
+            ticket.failed = ticket.failed || !ok;
+            if (--ticket.remaining == 0) {
+                ticket.done.notify_all();
+            }
+        }
+    }
+
+    delete influx;
+}
+
+bool Aggregator::writeBatch(HttpConnection*& influx, const std::string& body, std::string& reply) {
+    char length[24];
+    snprintf(length, sizeof(length), "%u", (unsigned int)body.size());
+
+    std::string request = "POST " + options.writePath + " HTTP/1.1\r\n"
+                          "Host: " + options.influxHost + "\r\n"
+                          "Content-Type: text/plain; charset=utf-8\r\n"
+                          "Connection: keep-alive\r\n";
+    if (!options.authorization.empty()) {
+        request += "Authorization: " + options.authorization + "\r\n";
+    }
+    request += std::string("Content-Length: ") + length + "\r\n\r\n" + body;
+
+    // A kept-alive connection may have been closed by the server; retry once on a new one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!influx) {
+            int fd = HttpConnection::connectTo(options.influxHost, options.influxPort);
+            if (fd < 0) {
+                reply = "cannot connect to InfluxDB";
+                return false;
+            }
+            influx = new HttpConnection(fd);
+        }
+
+        int status = 0;
+        bool keepAlive = false;
+        if (influx->sendAll(request) && influx->readResponse(status, reply, keepAlive)) {
+            if (!keepAlive) {
+                delete influx;
+                influx = nullptr;
+            }
+            return status >= 200 && status < 300;
+        }
+
+        delete influx;
+        influx = nullptr;
+        reply = "no response from InfluxDB";
+    }
+    return false;
+}
+
+void Aggregator::remember(const std::vector<Entry>& batch) {
+    int64_t now = monotonicSeconds();
+    std::lock_guard<std::mutex> lock(seenMutex);
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (seen.insert(batch[i].key).second) {
+            seenOrder.push_back(std::make_pair(now, batch[i].key));
+        }
+    }
+}
+
+void Aggregator::recordLatency(double ms) {
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    latencies.push_back(ms);
+}
+
+AggregatorStats Aggregator::collectStats() {
+    AggregatorStats stats;
+    stats.requests = requests;
+    stats.pointsReceived = pointsReceived;
+    stats.duplicates = duplicates;
+    stats.pointsWritten = pointsWritten;
+    stats.batches = batches;
+    stats.writeFailures = writeFailures;
+
+    std::vector<double> sample;
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex);
+        sample.swap(latencies);
+    }
+    std::sort(sample.begin(), sample.end());
+    stats.p50Ms = sample.empty() ? 0 : sample[sample.size() / 2];
+    stats.p99Ms = sample.empty() ? 0 : sample[std::min(sample.size() - 1, sample.size() * 99 / 100)];
+    stats.maxMs = sample.empty() ? 0 : sample.back();
+    return stats;
+}
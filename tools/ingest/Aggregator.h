@@ -0,0 +1,123 @@
+#ifndef INGEST_AGGREGATOR_H
+#define INGEST_AGGREGATOR_H
+
+// Fleet-side half of meteo-ingest: normalizes uploads from many stations
+// to second-precision line protocol, drops points already written
+// (same series, field and timestamp - i.e. a station retrying), and
+// writes to InfluxDB in large batches from a pool of writer threads.
+// An upload is acknowledged only after every one of its points has been
+// written, so stations keep their data when InfluxDB is down.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class HttpConnection;
+
+struct AggregatorOptions {
+    std::string influxHost;
+    int influxPort;
+    std::string writePath;        // Including query, precision=s
+    std::string authorization;    // Header value, empty = none
+    std::string measurement;      // For binary uploads
+    size_t batchSize;             // Lines per InfluxDB write
+    int flushMs;                  // Max wait for a batch to fill
+    int lingerMs;                 // Flush early once uploads pause this long
+    int writers;                  // Writer threads (= InfluxDB connections)
+    int dedupHours;               // How long written points are remembered
+    size_t maxPending;            // Back-pressure limit (503 above this)
+    int ackTimeoutMs;             // Max time an upload waits for its batch
+
+    AggregatorOptions();
+};
+
+struct AggregatorStats {
+    uint64_t requests;
+    uint64_t pointsReceived;
+    uint64_t duplicates;
+    uint64_t pointsWritten;
+    uint64_t batches;
+    uint64_t writeFailures;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+class Aggregator {
+public:
+    explicit Aggregator(const AggregatorOptions& options);
+    ~Aggregator();
+
+    void start();
+    void stop();
+
+    // Each returns the HTTP status for the upload; error explains 4xx/5xx
+    int ingestBinary(const std::string& body, std::string& error);
+    int ingestLines(const std::string& body, const std::string& precision, std::string& error);
+
+    // Request latency as seen by the HTTP handler
+    void recordLatency(double ms);
+
+    // Counters since start; latency percentiles since the previous call
+    AggregatorStats collectStats();
+
+    // Line protocol timestamp in 'precision' -> seconds (false if invalid)
+    static bool toSeconds(const std::string& timestamp, const std::string& precision, uint32_t& seconds);
+
+private:
+    struct Ticket {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining;
+        bool failed;
+    };
+
+    struct Entry {
+        std::string line;   // Normalized, newline-terminated
+        std::string key;    // Series + field + timestamp
+        std::shared_ptr<Ticket> ticket;
+    };
+
+    struct Point {
+        std::string line;
+        std::string key;
+    };
+
+    AggregatorOptions options;
+    std::vector<std::thread> writerThreads;
+    bool running;
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<Entry> queue;
+
+    std::mutex seenMutex;
+    std::unordered_set<std::string> seen;
+    std::deque<std::pair<int64_t, std::string> > seenOrder;   // Insert time, key
+
+    std::mutex latencyMutex;
+    std::vector<double> latencies;
+
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> pointsReceived;
+    std::atomic<uint64_t> duplicates;
+    std::atomic<uint64_t> pointsWritten;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> writeFailures;
+
+    bool parseLine(const std::string& raw, const std::string& precision, Point& point) const;
+    int submit(std::vector<Point>& points, std::string& error);
+    void writerLoop();
+    bool writeBatch(HttpConnection*& influx, const std::string& body, std::string& reply);
+    void remember(const std::vector<Entry>& batch);
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "HttpConnection.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static const size_t MAX_LINE = 8192;
+static const size_t MAX_BODY = 16 * 1024 * 1024;
+
+static std::string lower(std::string value) {
+    for (size_t i = 0; i < value.size(); i++) {
+        value[i] = tolower((unsigned char)value[i]);
+    }
+    return value;
+}
+
+static std::string lookup(const std::map<std::string, std::string>& values, const std::string& name) {
+    std::map<std::string, std::string>::const_iterator it = values.find(name);
+    return it == values.end() ? std::string() : it->second;
+}
+
+std::string HttpRequest::header(const std::string& name) const {
+    return lookup(headers, name);
+}
+
+std::string HttpRequest::param(const std::string& name) const {
+    return lookup(query, name);
+}
+
+HttpConnection::HttpConnection(int socket) : fd(socket) {
+}
+
+HttpConnection::~HttpConnection() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool HttpConnection::isOpen() const {
+    return fd >= 0;
+}
+
+bool HttpConnection::fill() {
+    char buf[16384];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        return false;
+    }
+    pending.append(buf, n);
+    return true;
+}
+
+bool HttpConnection::readLine(std::string& line) {
+    size_t eol;
+    while ((eol = pending.find("\r\n")) == std::string::npos) {
+        if (pending.size() > MAX_LINE || !fill()) {
+            return false;
+        }
+    }
+    line = pending.substr(0, eol);
+    pending.erase(0, eol + 2);
+    return true;
+}
+
+bool HttpConnection::readBytes(std::string& out, size_t count) {
+    while (pending.size() < count) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    out.append(pending, 0, count);
+    pending.erase(0, count);
+    return true;
+}
+
+bool HttpConnection::readHeaders(std::map<std::string, std::string>& headers) {
+    std::string line;
+    while (true) {
+        if (!readLine(line)) {
+            return false;
+        }
+        if (line.empty()) {
+            return true;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        size_t start = line.find_first_not_of(' ', colon + 1);
+        headers[lower(line.substr(0, colon))] = start == std::string::npos ? "" : line.substr(start);
+    }
+}
+
+bool HttpConnection::readBody(const std::map<std::string, std::string>& headers, std::string& body) {
+    if (lower(lookup(headers, "transfer-encoding")) != "chunked") {
+        size_t length = strtoul(lookup(headers, "content-length").c_str(), nullptr, 10);
+        return length <= MAX_BODY && readBytes(body, length);
+    }
+
+    std::string line;
+    while (true) {
+        if (!readLine(line)) {
+            return false;
+        }
+        size_t size = strtoul(line.c_str(), nullptr, 16);
+        if (size == 0) {
+            return readLine(line);
+        }
+        if (body.size() + size > MAX_BODY || !readBytes(body, size) || !readLine(line)) {
+            return false;
+        }
+    }
+}
+
+bool HttpConnection::readRequest(HttpRequest& request) {
+    std::string line;
+    if (!readLine(line)) {
+        return false;
+    }
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) {
+        return false;
+    }
+
+    request.method = line.substr(0, sp1);
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    request.keepAlive = line.compare(sp2 + 1, std::string::npos, "HTTP/1.1") == 0;
+    request.query.clear();
+    request.headers.clear();
+    request.body.clear();
+
+    size_t question = target.find('?');
+    request.path = target.substr(0, question);
+    while (question != std::string::npos) {
+        size_t next = target.find('&', question + 1);
+        std::string pair = target.substr(question + 1, next == std::string::npos ? std::string::npos :
+                                                        next - question - 1);
+        size_t equals = pair.find('=');
+        request.query[pair.substr(0, equals)] = equals == std::string::npos ? "" : pair.substr(equals + 1);
+        question = next;
+    }
+
+    if (!readHeaders(request.headers)) {
+        return false;
+    }
+    std::string connection = lower(request.header("connection"));
+    if (!connection.empty()) {
+        request.keepAlive = connection != "close";
+    }
+    return readBody(request.headers, request.body);
+}
+
+bool HttpConnection::readResponse(int& status, std::string& body, bool& keepAlive) {
+    std::string line;
+    if (!readLine(line) || sscanf(line.c_str(), "HTTP/1.%*d %d", &status) != 1) {
+        return false;
+    }
+
+    std::map<std::string, std::string> headers;
+    if (!readHeaders(headers)) {
+        return false;
+    }
+    keepAlive = lower(lookup(headers, "connection")) != "close";
+    body.clear();
+    return readBody(headers, body);
+}
+
+bool HttpConnection::sendAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+bool HttpConnection::sendResponse(int status, const char* reason, const std::string& body, bool keepAlive) {
+    char head[256];
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n",
+             status, reason, (unsigned int)body.size(), keepAlive ? "keep-alive" : "close");
+    return sendAll(std::string(head) + body);
+}
+
+int HttpConnection::connectTo(const std::string& host, int port) {
+    struct addrinfo hints;
+    struct addrinfo* result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(host.c_str(), service, &hints, &result) != 0) {
+        return -1;
+    }
+
+    int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+int HttpConnection::listenOn(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 512) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,55 @@
+#ifndef INGEST_HTTP_CONNECTION_H
+#define INGEST_HTTP_CONNECTION_H
+
+// Minimal blocking HTTP/1.1 over POSIX sockets, shared by meteo-ingest
+// and the load-test harness. Handles Content-Length and chunked bodies
+// and keep-alive; nothing else.
+
+#include <map>
+#include <string>
+
+struct HttpRequest {
+    std::string method;
+    std::string path;                             // Without query string
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers;   // Lower-case names
+    std::string body;
+    bool keepAlive;
+
+    std::string header(const std::string& name) const;
+    std::string param(const std::string& name) const;
+};
+
+class HttpConnection {
+public:
+    // Takes ownership of the socket
+    explicit HttpConnection(int fd);
+    ~HttpConnection();
+
+    bool isOpen() const;
+
+    bool readRequest(HttpRequest& request);
+    bool readResponse(int& status, std::string& body, bool& keepAlive);
+
+    bool sendResponse(int status, const char* reason, const std::string& body, bool keepAlive);
+    bool sendAll(const std::string& data);
+
+    // Blocking connect / listen helpers; -1 on failure
+    static int connectTo(const std::string& host, int port);
+    static int listenOn(int port);
+
+private:
+    int fd;
+    std::string pending;
+
+    HttpConnection(const HttpConnection&);
+    HttpConnection& operator=(const HttpConnection&);
+
+    bool fill();
+    bool readLine(std::string& line);
+    bool readBytes(std::string& out, size_t count);
+    bool readHeaders(std::map<std::string, std::string>& headers);
+    bool readBody(const std::map<std::string, std::string>& headers, std::string& body);
+};
+
+#endif
@@ -0,0 +1,310 @@
+// Load-test harness for meteo-ingest: simulates a fleet of stations, each
+// waking up, opening a fresh connection and uploading its backlog, and
+// reports ingest throughput and request latency percentiles.
+//
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -pthread -I lib -o ingest-load-test tools/ingest/load_test.cpp
+//       tools/ingest/HttpConnection.cpp lib/BinaryProtocol.cpp
+//
+// Self-contained run against the built-in InfluxDB stub (meteo-ingest
+// only connects to InfluxDB on its first write):
+//   ./meteo-ingest --port 8087 --influx 127.0.0.1:18086 --db load &
+//   ./ingest-load-test --target 127.0.0.1:8087 --devices 5000 --stub-influx 18086
+//
+// With --stub-influx the harness also checks that every unique point
+// reached InfluxDB exactly once despite the re-sent (duplicate) uploads.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BinaryProtocol.h"
+#include "HttpConnection.h"
+
+struct LoadOptions {
+    std::string host;
+    int port;
+    int devices;
+    int uploads;        // Upload rounds per device
+    int records;        // Records per upload
+    int threads;        // Concurrent stations
+    bool binary;
+    double duplicateRate;
+    int stubPort;       // 0 = no InfluxDB stub
+    int stubDelayMs;
+};
+
+static const uint32_t TIME_OFFSET = (1704067200UL / 65536) * 65536;
+
+static std::atomic<uint64_t> stubLines(0);
+static std::atomic<uint64_t> stubWrites(0);
+
+// Stand-in InfluxDB: counts lines, answers 204
+static void stubConnection(int fd, int delayMs) {
+    HttpConnection conn(fd);
+    HttpRequest request;
+    while (conn.readRequest(request)) {
+        stubLines += std::count(request.body.begin(), request.body.end(), '\n');
+        stubWrites++;
+        if (delayMs > 0) {
+            usleep(delayMs * 1000);
+        }
+        if (!conn.sendResponse(204, "No Content", "", request.keepAlive) || !request.keepAlive) {
+            break;
+        }
+    }
+}
+
+static void stubServer(int listenFd, int delayMs) {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd >= 0) {
+            std::thread(stubConnection, fd, delayMs).detach();
+        }
+    }
+}
+
+static void deviceId(int device, uint8_t id[6]) {
+    id[0] = 0x02;   // Locally administered
+    id[1] = 0x00;
+    id[2] = (device >> 24) & 0xFF;
+    id[3] = (device >> 16) & 0xFF;
+    id[4] = (device >> 8) & 0xFF;
+    id[5] = device & 0xFF;
+}
+
+static BinaryRecord makeRecord(int device, int index) {
+    BinaryRecord record;
+    record.timestamp = (uint16_t)(60 + index * 30);
+    record.temperature = 100 + 15 + (device + index / 4) % 12;
+    record.humidity = 40 + (device + index / 3) % 30;
+    return record;
+}
+
+static std::string buildBody(const LoadOptions& options, int device, int upload, std::string& path) {
+    uint8_t id[6];
+    deviceId(device, id);
+    int first = upload * options.records;
+    uint32_t batteryTime = TIME_OFFSET + 60 * (60 + (first + options.records) * 30);
+    std::string body;
+
+    if (options.binary) {
+        path = BINARY_INGEST_PATH;
+        uint8_t block[BINARY_MAX_BLOCK_SIZE];
+        BinaryBlockEncoder encoder;
+        for (int i = 0; i < options.records; i++) {
+            if (encoder.count() == 0) {
+                encoder.begin(block, sizeof(block), id, TIME_OFFSET);
+            }
+            encoder.add(makeRecord(device, first + i));
+            if (encoder.count() == BINARY_MAX_BLOCK_RECORDS || i == options.records - 1) {
+                body.append((const char*)block, encoder.finish());
+                encoder.begin(block, sizeof(block), id, TIME_OFFSET);
+            }
+        }
+        size_t length = BinaryBlockEncoder::encodeBattery(block, sizeof(block), id, TIME_OFFSET,
+                                                          batteryTime, 3700 + device % 500, upload);
+        body.append((const char*)block, length);
+        return body;
+    }
+
+    path = "/write?db=load&precision=s";
+    char mac[13];
+    BinaryBlockDecoder::formatDeviceId(mac, id);
+    char line[160];
+    for (int i = 0; i < options.records; i++) {
+        BinaryRecord record = makeRecord(device, first + i);
+        snprintf(line, sizeof(line), "environment,device=%s temperature=%d,humidity=%u %u\n",
+                 mac, (int)record.temperature - 100, (unsigned int)record.humidity,
+                 (unsigned int)(TIME_OFFSET + record.timestamp * 60));
+        body += line;
+    }
+    snprintf(line, sizeof(line), "environment,device=%s battery_voltage=3.9,upload_seq=%di %u\n",
+             mac, upload, batteryTime);
+    body += line;
+    return body;
+}
+
+struct WorkerResult {
+    std::vector<double> latencies;
+    std::map<int, uint64_t> statuses;   // 0 = connection error
+    uint64_t bytes;
+};
+
+// One station wake-up: new connection, one POST, hang up
+static int upload(const LoadOptions& options, const std::string& path, const std::string& body) {
+    int fd = HttpConnection::connectTo(options.host, options.port);
+    if (fd < 0) {
+        return 0;
+    }
+    HttpConnection conn(fd);
+
+    char head[256];
+    snprintf(head, sizeof(head),
+             "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+             "Connection: close\r\n\r\n",
+             path.c_str(), options.host.c_str(),
+             options.binary ? "application/octet-stream" : "text/plain",
+             (unsigned int)body.size());
+
+    int status = 0;
+    bool keepAlive;
+    std::string reply;
+    if (!conn.sendAll(std::string(head) + body) || !conn.readResponse(status, reply, keepAlive)) {
+        return 0;
+    }
+    return status;
+}
+
+static void worker(const LoadOptions& options, int index, WorkerResult* result) {
+    unsigned int seed = 12345 + index;
+    result->bytes = 0;
+
+    for (int round = 0; round < options.uploads; round++) {
+        for (int device = index; device < options.devices; device += options.threads) {
+            std::string path;
+            std::string body = buildBody(options, device, round, path);
+            int sends = (double)rand_r(&seed) / RAND_MAX < options.duplicateRate ? 2 : 1;
+
+            for (int i = 0; i < sends; i++) {
+                std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+                int status = upload(options, path, body);
+                result->latencies.push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - started).count());
+                result->statuses[status]++;
+                result->bytes += body.size();
+            }
+        }
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [--target host:port] [--devices N] [--uploads N] [--records N]\n"
+            "          [--threads N] [--format binary|line] [--duplicates RATE]\n"
+            "          [--stub-influx PORT] [--stub-delay-ms MS]\n", name);
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    options.host = "127.0.0.1";
+    options.port = 8087;
+    options.devices = 2000;
+    options.uploads = 3;
+    options.records = 48;
+    options.threads = 64;
+    options.binary = true;
+    options.duplicateRate = 0.1;
+    options.stubPort = 0;
+    options.stubDelayMs = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        const char* value = argv[i + 1];
+        if (arg == "--target") {
+            std::string hostPort = value;
+            size_t colon = hostPort.rfind(':');
+            options.host = hostPort.substr(0, colon);
+            if (colon != std::string::npos) {
+                options.port = atoi(hostPort.c_str() + colon + 1);
+            }
+        } else if (arg == "--devices") {
+            options.devices = atoi(value);
+        } else if (arg == "--uploads") {
+            options.uploads = atoi(value);
+        } else if (arg == "--records") {
+            options.records = atoi(value);
+        } else if (arg == "--threads") {
+            options.threads = atoi(value);
+        } else if (arg == "--format") {
+            options.binary = strcmp(value, "line") != 0;
+        } else if (arg == "--duplicates") {
+            options.duplicateRate = atof(value);
+        } else if (arg == "--stub-influx") {
+            options.stubPort = atoi(value);
+        } else if (arg == "--stub-delay-ms") {
+            options.stubDelayMs = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || options.devices < 1 || options.threads < 1 || options.records < 1 ||
+        (options.uploads * options.records + 2) * 30 + 60 > 0xFFFF) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    if (options.stubPort > 0) {
+        int listenFd = HttpConnection::listenOn(options.stubPort);
+        if (listenFd < 0) {
+            perror("stub listen");
+            return 1;
+        }
+        std::thread(stubServer, listenFd, options.stubDelayMs).detach();
+        printf("InfluxDB stub on :%d\n", options.stubPort);
+    }
+
+    printf("%d devices x %d uploads x %d records (%s), %d concurrent, %.0f%% re-sent\n",
+           options.devices, options.uploads, options.records, options.binary ? "binary" : "line protocol",
+           options.threads, options.duplicateRate * 100);
+
+    std::vector<WorkerResult> results(options.threads);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.threads; i++) {
+        threads.push_back(std::thread(worker, std::cref(options), i, &results[i]));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<double> latencies;
+    std::map<int, uint64_t> statuses;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        latencies.insert(latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+        for (std::map<int, uint64_t>::iterator it = results[i].statuses.begin();
+             it != results[i].statuses.end(); ++it) {
+            statuses[it->first] += it->second;
+        }
+        bytes += results[i].bytes;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    uint64_t requests = latencies.size();
+    uint64_t points = requests * (options.records + 1);
+    printf("requests: %llu in %.2f s (%.0f req/s), %.0f points/s offered, %.1f MB sent\n",
+           (unsigned long long)requests, seconds, requests / seconds, points / seconds, bytes / 1e6);
+    printf("latency ms: p50=%.2f p90=%.2f p99=%.2f max=%.2f\n",
+           latencies[latencies.size() / 2], latencies[latencies.size() * 9 / 10],
+           latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)], latencies.back());
+    for (std::map<int, uint64_t>::iterator it = statuses.begin(); it != statuses.end(); ++it) {
+        printf("status %d: %llu\n", it->first, (unsigned long long)it->second);
+    }
+
+    bool ok = statuses.size() == 1 && statuses.count(204);
+    if (options.stubPort > 0) {
+        uint64_t unique = (uint64_t)options.devices * options.uploads * (options.records + 1);
+        printf("InfluxDB stub: %llu lines in %llu writes, %llu unique points expected\n",
+               (unsigned long long)stubLines, (unsigned long long)stubWrites, (unsigned long long)unique);
+        ok = ok && stubLines == unique;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// meteo-ingest: upload gateway for a fleet of stations. Accepts the
+// binary upload (upload sink "Binary", see lib/BinaryProtocol.h) on
+// /ingest and line protocol on the InfluxDB write endpoints (/write,
+// /api/v2/write), so stations on either format can point at it. Points
+// are deduplicated by series, field and timestamp and written to
+// InfluxDB in large batches (see Aggregator.h).
+//
+// Build (Linux/macOS, from the repository root):
+//   g++ -std=c++11 -O2 -pthread -I lib -o meteo-ingest tools/ingest/meteo_ingest.cpp
+//       tools/ingest/Aggregator.cpp tools/ingest/HttpConnection.cpp lib/BinaryProtocol.cpp
+//
+// Run:
+//   ./meteo-ingest --port 8087 --influx 127.0.0.1:8086 --db weather
+//   ./meteo-ingest --port 8087 --influx 127.0.0.1:8086 --org home --bucket weather --token <token>
+//
+// The station only sees 204 once InfluxDB accepted every point, so a
+// failed forward keeps the data on the device for the next upload.
+// GET /stats returns the counters that are also logged periodically.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BinaryProtocol.h"
+#include "Aggregator.h"
+#include "HttpConnection.h"
+
+static bool verbose = false;
+
+// Accepted sockets waiting for a handler thread
+static std::mutex connectionMutex;
+static std::condition_variable connectionReady;
+static std::deque<int> connections;
+
+static std::string formatStats(const AggregatorStats& stats) {
+    char text[320];
+    snprintf(text, sizeof(text),
+             "requests=%llu points=%llu duplicates=%llu written=%llu batches=%llu failures=%llu "
+             "latency_p50_ms=%.1f latency_p99_ms=%.1f latency_max_ms=%.1f\n",
+             (unsigned long long)stats.requests, (unsigned long long)stats.pointsReceived,
+             (unsigned long long)stats.duplicates, (unsigned long long)stats.pointsWritten,
+             (unsigned long long)stats.batches, (unsigned long long)stats.writeFailures,
+             stats.p50Ms, stats.p99Ms, stats.maxMs);
+    return text;
+}
+
+static const char* reasonPhrase(int status) {
+    switch (status) {
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "OK";
+    }
+}
+
+static void serve(Aggregator& aggregator, int fd) {
+    HttpConnection conn(fd);
+    HttpRequest request;
+
+    while (conn.readRequest(request)) {
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        std::string error;
+        int status;
+
+        if (request.method == "GET" && request.path == "/stats") {
+            std::string body = formatStats(aggregator.collectStats());
+            conn.sendResponse(200, "OK", body, request.keepAlive);
+            if (!request.keepAlive) {
+                break;
+            }
+            continue;
+        }
+
+        if (request.method != "POST") {
+            status = 404;
+            error = "unknown endpoint";
+        } else if (request.path == BINARY_INGEST_PATH) {
+            status = aggregator.ingestBinary(request.body, error);
+        } else if (request.path == "/write" || request.path == "/api/v2/write") {
+            status = aggregator.ingestLines(request.body, request.param("precision"), error);
+        } else {
+            status = 404;
+            error = "unknown endpoint";
+        }
+
+        if (status >= 400) {
+            fprintf(stderr, "%s %s: %d %s\n", request.method.c_str(), request.path.c_str(),
+                    status, error.c_str());
+            error += "\n";
+        } else if (verbose) {
+            printf("%s %s: %u bytes\n", request.method.c_str(), request.path.c_str(),
+                   (unsigned int)request.body.size());
+        }
+        bool sent = conn.sendResponse(status, reasonPhrase(status), error, request.keepAlive);
+
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - started).count();
+        aggregator.recordLatency(ms);
+
+        if (!sent || !request.keepAlive) {
+            break;
+        }
+    }
+}
+
+static void handlerLoop(Aggregator* aggregator) {
+    while (true) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(connectionMutex);
+            connectionReady.wait(lock, [] { return !connections.empty(); });
+            fd = connections.front();
+            connections.pop_front();
+        }
+        serve(*aggregator, fd);
+    }
+}
+
+static void statsLoop(Aggregator* aggregator, int intervalSeconds) {
+    uint64_t lastWritten = 0;
+    while (true) {
+        sleep(intervalSeconds);
+        AggregatorStats stats = aggregator->collectStats();
+        printf("points/s=%.0f %s", (double)(stats.pointsWritten - lastWritten) / intervalSeconds,
+               formatStats(stats).c_str());
+        lastWritten = stats.pointsWritten;
+    }
+}
+
+static std::string urlEncode(const std::string& value) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = value[i];
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += c;
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 0x0F];
+        }
+    }
+    return out;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [--port N] --influx host:port (--db NAME | --org ORG --bucket B --token T)\n"
+            "          [--measurement NAME] [--threads N] [--writers N] [--batch LINES]\n"
+            "          [--flush-ms MS] [--linger-ms MS] [--dedup-hours H] [--stats-interval S]\n"
+            "          [--verbose]\n", name);
+}
+
+int main(int argc, char** argv) {
+    AggregatorOptions options;
+    int port = 8087;
+    int threads = 64;
+    int statsInterval = 10;
+    std::string db, org, bucket, token;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--verbose") {
+            verbose = true;
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (arg == "--port") {
+            port = atoi(value);
+        } else if (arg == "--influx") {
+            std::string hostPort = value;
+            size_t colon = hostPort.rfind(':');
+            options.influxHost = hostPort.substr(0, colon);
+            if (colon != std::string::npos) {
+                options.influxPort = atoi(hostPort.c_str() + colon + 1);
+            }
+        } else if (arg == "--db") {
+            db = value;
+        } else if (arg == "--org") {
+            org = value;
+        } else if (arg == "--bucket") {
+            bucket = value;
+        } else if (arg == "--token") {
+            token = value;
+        } else if (arg == "--measurement") {
+            options.measurement = value;
+        } else if (arg == "--threads") {
+            threads = atoi(value);
+        } else if (arg == "--writers") {
+            options.writers = atoi(value);
+        } else if (arg == "--batch") {
+            options.batchSize = strtoul(value, nullptr, 10);
+        } else if (arg == "--flush-ms") {
+            options.flushMs = atoi(value);
+        } else if (arg == "--linger-ms") {
+            options.lingerMs = atoi(value);
+        } else if (arg == "--dedup-hours") {
+            options.dedupHours = atoi(value);
+        } else if (arg == "--stats-interval") {
+            statsInterval = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.influxHost.empty() || (db.empty() && bucket.empty()) ||
+        threads < 1 || options.writers < 1 || options.batchSize < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!bucket.empty()) {
+        options.writePath = "/api/v2/write?org=" + urlEncode(org) + "&bucket=" + urlEncode(bucket) +
+                            "&precision=s";
+        options.authorization = "Token " + token;
+    } else {
+        options.writePath = "/write?db=" + urlEncode(db) + "&precision=s";
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    int listenFd = HttpConnection::listenOn(port);
+    if (listenFd < 0) {
+        perror("listen");
+        return 1;
+    }
+
+    Aggregator aggregator(options);
+    aggregator.start();
+
+    for (int i = 0; i < threads; i++) {
+        std::thread(handlerLoop, &aggregator).detach();
+    }
+    if (statsInterval > 0) {
+        std::thread(statsLoop, &aggregator, statsInterval).detach();
+    }
+
+    printf("meteo-ingest listening on :%d (%d handlers, %d writers, batch %u), forwarding to %s:%d%s\n",
+           port, threads, options.writers, (unsigned int)options.batchSize,
+           options.influxHost.c_str(), options.influxPort, options.writePath.c_str());
+
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        struct timeval timeout = { 30, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        connections.push_back(fd);
+        connectionReady.notify_one();
+    }
+}
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Firmware update server for the stations (see lib/OtaUpdater.h).
+
+Serves the current build to every station that asks for it. A station
+running an image from --releases gets a delta against that image
+instead of the full image (format in lib/FirmwarePatcher.h). Keep a copy
+of every firmware.bin you roll out in that directory so later updates
+can be sent as deltas.
+
+    python3 tools/ota/ota_server.py --firmware .pio/build/d1_mini/firmware.bin \\
+        --releases releases/ --port 8266
+
+Then set the station's Firmware Update URL to http://<this host>:8266/meteo.bin.
+It checks after each successful upload and flashes the image only if
+its SHA-256 matches the X-Image-SHA256 header.
+
+    python3 tools/ota/ota_server.py --delta old.bin new.bin out.delta
+
+writes a delta without serving anything, e.g. to check its size.
+"""
+
+import argparse
+import glob
+import hashlib
+import os
+import struct
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DELTA_VERSION = 1
+COPY = 1
+DATA = 2
+KEY = 16          # Bytes hashed to find a match in the base image
+MIN_COPY = 24     # A COPY costs 9 bytes; shorter matches go out as data
+
+
+def match_length(base, base_pos, image, image_pos):
+    n = 0
+    limit = min(len(base) - base_pos, len(image) - image_pos)
+    while n + 64 <= limit and base[base_pos + n:base_pos + n + 64] == image[image_pos + n:image_pos + n + 64]:
+        n += 64
+    while n < limit and base[base_pos + n] == image[image_pos + n]:
+        n += 1
+    return n
+
+
+def make_delta(base, image):
+    """Greedy COPY/DATA delta. Besides the hash index it tries the
+    position right after the previous match, which catches code that only
+    moved by a fixed distance."""
+    index = {}
+    for i in range(len(base) - KEY + 1):
+        index.setdefault(base[i:i + KEY], i)
+
+    out = bytearray(struct.pack('<2sBB16sII', b'MD', DELTA_VERSION, 0,
+                                hashlib.md5(base).digest(), len(base), len(image)))
+    literal = bytearray()
+    shift = 0
+    i = 0
+
+    def flush():
+        if literal:
+            out.extend(struct.pack('<BI', DATA, len(literal)))
+            out.extend(literal)
+            del literal[:]
+
+    while i < len(image):
+        best_length, best_offset = 0, 0
+        candidates = [i + shift]
+        found = index.get(image[i:i + KEY])
+        if found is not None:
+            candidates.append(found)
+        for offset in candidates:
+            if 0 <= offset < len(base):
+                length = match_length(base, offset, image, i)
+                if length > best_length:
+                    best_length, best_offset = length, offset
+
+        if best_length >= MIN_COPY:
+            flush()
+            out.extend(struct.pack('<BII', COPY, best_offset, best_length))
+            shift = best_offset - i
+            i += best_length
+        else:
+            literal.append(image[i])
+            i += 1
+    flush()
+    return bytes(out)
+
+
+class Firmware:
+    def __init__(self, path, releases):
+        with open(path, 'rb') as f:
+            self.image = f.read()
+        if not self.image or self.image[0] != 0xE9:
+            sys.exit('%s is not an ESP8266 image' % path)
+        self.md5 = hashlib.md5(self.image).hexdigest()
+        self.sha256 = hashlib.sha256(self.image).hexdigest()
+        self.releases = {}
+        for release in glob.glob(os.path.join(releases, '*.bin')) if releases else []:
+            with open(release, 'rb') as f:
+                data = f.read()
+            self.releases[hashlib.md5(data).hexdigest()] = data
+        self.deltas = {}
+
+    def delta_for(self, md5):
+        base = self.releases.get(md5)
+        if base is None:
+            return None
+        if md5 not in self.deltas:
+            self.deltas[md5] = make_delta(base, self.image)
+        return self.deltas[md5]
+
+
+class Handler(BaseHTTPRequestHandler):
+    firmware = None
+    path_served = '/meteo.bin'
+    protocol_version = 'HTTP/1.1'
+
+    def do_GET(self):
+        if self.path != self.path_served:
+            self.send_error(404)
+            return
+        md5 = (self.headers.get('X-Sketch-MD5') or '').lower()
+        if md5 == self.firmware.md5:
+            self.send_response(304)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return
+
+        delta = self.firmware.delta_for(md5)
+        # A delta that saves little is not worth the extra flash reads
+        body = delta if delta is not None and len(delta) < len(self.firmware.image) * 3 // 4 \
+            else self.firmware.image
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('X-Image-SHA256', self.firmware.sha256)
+        self.end_headers()
+        self.wfile.write(body)
+        self.log_message('%s: sent %s, %d bytes', md5 or 'unknown image',
+                         'delta' if body is delta else 'full image', len(body))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--firmware', help='current build (firmware.bin)')
+    parser.add_argument('--releases', help='directory of images stations may be running')
+    parser.add_argument('--port', type=int, default=8266)
+    parser.add_argument('--path', default='/meteo.bin', help='URL path to serve (default /meteo.bin)')
+    parser.add_argument('--delta', nargs=3, metavar=('BASE', 'IMAGE', 'OUT'),
+                        help='write a delta from BASE to IMAGE and exit')
+    args = parser.parse_args()
+
+    if args.delta:
+        with open(args.delta[0], 'rb') as f:
+            base = f.read()
+        with open(args.delta[1], 'rb') as f:
+            image = f.read()
+        delta = make_delta(base, image)
+        with open(args.delta[2], 'wb') as f:
+            f.write(delta)
+        print('%d byte image, %d byte delta (%.1f%%)' % (len(image), len(delta), 100.0 * len(delta) / len(image)))
+        return
+    if not args.firmware:
+        parser.error('--firmware is required')
+
+    Handler.firmware = Firmware(args.firmware, args.releases)
+    Handler.path_served = args.path
+    print('Serving %s (md5 %s, %d releases for deltas) on port %d' %
+          (args.firmware, Handler.firmware.md5, len(Handler.firmware.releases), args.port))
+    ThreadingHTTPServer(('', args.port), Handler).serve_forever()
+
+
+if __name__ == '__main__':
+    main()